@@ -0,0 +1,35 @@
+;; Example of control.fiber
+;; Does the same as echo-server.scm, with a fiber per connection.
+
+(use gauche.net)
+(use control.fiber)
+
+(define (echo-server port)
+  (let1 servers (make-server-sockets #f port :reuse-addr? #t)
+
+    (define (echo client)
+      (let loop ()
+        (let1 data (guard (e (else ""))
+                     (fiber-socket-recv client 4096))
+          (if (zero? (string-size data))
+            (begin (format #t "client disconnected (~a)~%" (socket-address client))
+                   (socket-close client))
+            (begin (fiber-socket-send client data)
+                   (loop))))))
+
+    (define (accept-loop server)
+      (let loop ()
+        (let1 client (fiber-socket-accept server)
+          (format #t "client connected (~a)~%" (socket-address client))
+          (spawn-fiber (cut echo client))
+          (loop))))
+
+    (run-fibers (^[] (for-each fiber-join
+                               (map (^s (spawn-fiber (cut accept-loop s)))
+                                    servers))))))
+
+(define (main args)
+  (define port (if (pair? (cdr args)) (x->integer (cadr args)) 3131))
+  (format #t "echo server starting on port ~d~%" port)
+  (echo-server port)
+  0)
@@ -527,3 +527,478 @@ void Scm_PutBinaryF64(ScmUVector *uv, int off, ScmObj val, ScmSymbol *e)
     SWAP_D(e, v);
     inject(uv, v.buf, off, 8);
 }
+
+/*===========================================================
+ * Record layouts
+ */
+
+/* A layout is compiled from a list of field specs once, resolving
+   the element type, the offset and the byte swapping required by
+   the endian for each field.  The record accessors below then
+   process whole records, or arrays of records, in a single call. */
+
+enum {
+    LAYOUT_SWAP_NONE,
+    LAYOUT_SWAP_REVERSE,        /* BE <-> LE */
+    LAYOUT_SWAP_ARM2BE,         /* [01234567] <-> [32107654] */
+    LAYOUT_SWAP_ARM2LE          /* [01234567] <-> [45670123] */
+};
+
+static const struct {
+    const char *name;
+    ScmUVectorType type;
+    int size;
+} layout_types[] = {
+    { "u8",  SCM_UVECTOR_U8,  1 },
+    { "s8",  SCM_UVECTOR_S8,  1 },
+    { "u16", SCM_UVECTOR_U16, 2 },
+    { "s16", SCM_UVECTOR_S16, 2 },
+    { "u32", SCM_UVECTOR_U32, 4 },
+    { "s32", SCM_UVECTOR_S32, 4 },
+    { "u64", SCM_UVECTOR_U64, 8 },
+    { "s64", SCM_UVECTOR_S64, 8 },
+    { "f16", SCM_UVECTOR_F16, 2 },
+    { "f32", SCM_UVECTOR_F32, 4 },
+    { "f64", SCM_UVECTOR_F64, 8 },
+    { NULL,  SCM_UVECTOR_INVALID, 0 }
+};
+
+static ScmClass *layout_column_class(ScmUVectorType type)
+{
+    switch (type) {
+    case SCM_UVECTOR_U8:  return SCM_CLASS_U8VECTOR;
+    case SCM_UVECTOR_S8:  return SCM_CLASS_S8VECTOR;
+    case SCM_UVECTOR_U16: return SCM_CLASS_U16VECTOR;
+    case SCM_UVECTOR_S16: return SCM_CLASS_S16VECTOR;
+    case SCM_UVECTOR_U32: return SCM_CLASS_U32VECTOR;
+    case SCM_UVECTOR_S32: return SCM_CLASS_S32VECTOR;
+    case SCM_UVECTOR_U64: return SCM_CLASS_U64VECTOR;
+    case SCM_UVECTOR_S64: return SCM_CLASS_S64VECTOR;
+    case SCM_UVECTOR_F16: return SCM_CLASS_F16VECTOR;
+    case SCM_UVECTOR_F32: return SCM_CLASS_F32VECTOR;
+    case SCM_UVECTOR_F64: return SCM_CLASS_F64VECTOR;
+    default: Scm_Panic("layout_column_class: invalid type %d", type);
+    }
+    return NULL;                /* dummy */
+}
+
+/* Decide how to swap a field of SIZE octets to/from ENDIAN. */
+static int layout_swap_mode(ScmSymbol *endian, int size, int doublep)
+{
+    if (size == 1) return LAYOUT_SWAP_NONE;
+    if (!doublep) {
+        return SWAP_REQUIRED(endian)? LAYOUT_SWAP_REVERSE : LAYOUT_SWAP_NONE;
+    }
+#ifdef DOUBLE_ARMENDIAN
+    if (SCM_IS_ARM_LE(Scm_NativeEndian())) {
+        if (SCM_IS_BE(endian)) return LAYOUT_SWAP_ARM2BE;
+        if (SCM_IS_LE(endian)) return LAYOUT_SWAP_ARM2LE;
+        return LAYOUT_SWAP_NONE;
+    } else {
+        if (SCM_IS_ARM_LE(endian)) return LAYOUT_SWAP_ARM2LE;
+        if (SCM_IS_BE(endian)) return LAYOUT_SWAP_REVERSE;
+        return LAYOUT_SWAP_NONE;
+    }
+#elif WORDS_BIGENDIAN
+    if (SCM_IS_LE(endian)) return LAYOUT_SWAP_REVERSE;
+    if (SCM_IS_ARM_LE(endian)) return LAYOUT_SWAP_ARM2BE;
+    return LAYOUT_SWAP_NONE;
+#else  /*!WORDS_BIGENDIAN*/
+    if (SCM_IS_BE(endian)) return LAYOUT_SWAP_REVERSE;
+    if (SCM_IS_ARM_LE(endian)) return LAYOUT_SWAP_ARM2LE;
+    return LAYOUT_SWAP_NONE;
+#endif /*!WORDS_BIGENDIAN*/
+}
+
+/* Parse a type symbol, e.g. u16, u16be or f64le. */
+static void layout_parse_type(ScmObj type, ScmSymbol *endian,
+                              ScmBinaryField *f)
+{
+    if (!SCM_SYMBOLP(type)) goto bad;
+    const char *name = Scm_GetStringConst(SCM_SYMBOL_NAME(type));
+    for (int i=0; layout_types[i].name; i++) {
+        size_t len = strlen(layout_types[i].name);
+        if (strncmp(name, layout_types[i].name, len) != 0) continue;
+        ScmSymbol *e = endian;
+        if (strcmp(name+len, "be") == 0) {
+            e = SCM_SYMBOL(SCM_SYM_BIG_ENDIAN);
+        } else if (strcmp(name+len, "le") == 0) {
+            e = SCM_SYMBOL(SCM_SYM_LITTLE_ENDIAN);
+        } else if (name[len] != '\0') {
+            continue;
+        }
+        f->type = layout_types[i].type;
+        f->size = layout_types[i].size;
+        f->swap = layout_swap_mode(e, f->size,
+                                   f->type == SCM_UVECTOR_F64);
+        return;
+    }
+ bad:
+    Scm_Error("bad binary layout field type: %S", type);
+}
+
+static void layout_print(ScmObj obj, ScmPort *port,
+                         ScmWriteContext *ctx SCM_UNUSED)
+{
+    ScmBinaryLayout *l = SCM_BINARY_LAYOUT(obj);
+    Scm_Printf(port, "#<binary-layout %d fields %d bytes>",
+               l->nfields, l->size);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_BinaryLayoutClass, layout_print);
+
+/* SPEC is a list of (name type) and integers; an integer N stands
+   for N octets of padding. */
+ScmObj Scm_MakeBinaryLayout(ScmObj spec, ScmSymbol *endian)
+{
+    ScmObj cp, h = SCM_NIL, t = SCM_NIL;
+    int nfields = 0, off = 0, i = 0;
+
+    SCM_CHECK_ENDIAN(endian);
+    SCM_FOR_EACH(cp, spec) {
+        ScmObj s = SCM_CAR(cp);
+        if (SCM_INTP(s) && SCM_INT_VALUE(s) >= 0) continue;
+        if (!SCM_PAIRP(s) || !SCM_PAIRP(SCM_CDR(s))
+            || !SCM_NULLP(SCM_CDDR(s))) {
+            Scm_Error("bad binary layout field spec: %S", s);
+        }
+        nfields++;
+    }
+    if (!SCM_NULLP(cp)) Scm_Error("proper list required, but got %S", spec);
+
+    ScmBinaryLayout *l = SCM_NEW(ScmBinaryLayout);
+    SCM_SET_CLASS(l, SCM_CLASS_BINARY_LAYOUT);
+    l->nfields = nfields;
+    l->fields = SCM_NEW_ARRAY(ScmBinaryField, nfields);
+
+    SCM_FOR_EACH(cp, spec) {
+        ScmObj s = SCM_CAR(cp);
+        if (SCM_INTP(s)) {
+            off += SCM_INT_VALUE(s);
+            continue;
+        }
+        ScmBinaryField *f = &l->fields[i++];
+        f->name = SCM_CAR(s);
+        f->offset = off;
+        layout_parse_type(SCM_CADR(s), endian, f);
+        off += f->size;
+        SCM_APPEND1(h, t, f->name);
+    }
+    l->size = off;
+    l->names = h;
+    return SCM_OBJ(l);
+}
+
+typedef union {
+    unsigned char buf[8];
+    uint8_t  u8;  int8_t  s8;
+    uint16_t u16; int16_t s16;
+    uint32_t u32; int32_t s32;
+    uint64_t u64; int64_t s64;
+    ScmHalfFloat f16;
+    float    f32;
+    double   f64;
+} layout_elt_t;
+
+/* Swaps the octets of a field in place.  The swapping is an involution,
+   so the same routine serves both directions. */
+static inline void layout_swap(unsigned char *b, int size, int mode)
+{
+    unsigned char tmp;
+    switch (mode) {
+    case LAYOUT_SWAP_NONE:
+        break;
+    case LAYOUT_SWAP_REVERSE:
+        for (int i=0, j=size-1; i<j; i++, j--) CSWAP(b, tmp, i, j);
+        break;
+    case LAYOUT_SWAP_ARM2BE:
+        CSWAP(b, tmp, 0, 3); CSWAP(b, tmp, 1, 2);
+        CSWAP(b, tmp, 4, 7); CSWAP(b, tmp, 5, 6);
+        break;
+    case LAYOUT_SWAP_ARM2LE:
+        CSWAP(b, tmp, 0, 4); CSWAP(b, tmp, 1, 5);
+        CSWAP(b, tmp, 2, 6); CSWAP(b, tmp, 3, 7);
+        break;
+    }
+}
+
+static ScmObj layout_field_ref(const ScmBinaryField *f,
+                               const unsigned char *rec)
+{
+    layout_elt_t v;
+    memcpy(v.buf, rec + f->offset, f->size);
+    layout_swap(v.buf, f->size, f->swap);
+    switch (f->type) {
+    case SCM_UVECTOR_U8:  return SCM_MAKE_INT(v.u8);
+    case SCM_UVECTOR_S8:  return SCM_MAKE_INT(v.s8);
+    case SCM_UVECTOR_U16: return SCM_MAKE_INT(v.u16);
+    case SCM_UVECTOR_S16: return SCM_MAKE_INT(v.s16);
+    case SCM_UVECTOR_U32: return Scm_MakeIntegerFromUI(v.u32);
+    case SCM_UVECTOR_S32: return Scm_MakeInteger(v.s32);
+    case SCM_UVECTOR_U64: return Scm_MakeIntegerU64(v.u64);
+    case SCM_UVECTOR_S64: return Scm_MakeInteger64(v.s64);
+    case SCM_UVECTOR_F16: return Scm_MakeFlonum(Scm_HalfToDouble(v.f16));
+    case SCM_UVECTOR_F32: return Scm_MakeFlonum((double)v.f32);
+    case SCM_UVECTOR_F64: return Scm_MakeFlonum(v.f64);
+    default: Scm_Panic("layout_field_ref: invalid type %d", f->type);
+    }
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+static void layout_field_set(const ScmBinaryField *f, unsigned char *rec,
+                             ScmObj val)
+{
+    layout_elt_t v;
+    switch (f->type) {
+    case SCM_UVECTOR_U8:  v.u8  = Scm_GetIntegerU8(val); break;
+    case SCM_UVECTOR_S8:  v.s8  = Scm_GetInteger8(val); break;
+    case SCM_UVECTOR_U16: v.u16 = Scm_GetIntegerU16(val); break;
+    case SCM_UVECTOR_S16: v.s16 = Scm_GetInteger16(val); break;
+    case SCM_UVECTOR_U32: v.u32 = Scm_GetIntegerU32(val); break;
+    case SCM_UVECTOR_S32: v.s32 = Scm_GetInteger32(val); break;
+    case SCM_UVECTOR_U64: v.u64 = Scm_GetIntegerU64(val); break;
+    case SCM_UVECTOR_S64: v.s64 = Scm_GetInteger64(val); break;
+    default:
+        if (!SCM_REALP(val)) {
+            Scm_Error("real number required for field %S, but got %S",
+                      f->name, val);
+        }
+        switch (f->type) {
+        case SCM_UVECTOR_F16: v.f16 = Scm_DoubleToHalf(Scm_GetDouble(val)); break;
+        case SCM_UVECTOR_F32: v.f32 = (float)Scm_GetDouble(val); break;
+        default:              v.f64 = Scm_GetDouble(val); break;
+        }
+    }
+    layout_swap(v.buf, f->size, f->swap);
+    memcpy(rec + f->offset, v.buf, f->size);
+}
+
+/* Copies N elements of a field between records and a column.
+   The size is dispatched outside of the loop so that the compiler
+   can turn memcpy into a single load/store. */
+#define LAYOUT_COPY_LOOP(size, dst, dstep, src, sstep, n, mode) \
+    do {                                                        \
+        for (ScmSmallInt k_=0; k_<n; k_++) {                    \
+            memcpy(dst, src, size);                             \
+            layout_swap(dst, size, mode);                       \
+            dst += dstep; src += sstep;                         \
+        }                                                       \
+    } while (0)
+
+static void layout_copy_field(unsigned char *dst, ScmSmallInt dstep,
+                              const unsigned char *src, ScmSmallInt sstep,
+                              ScmSmallInt n, int size, int mode)
+{
+    switch (size) {
+    case 1: LAYOUT_COPY_LOOP(1, dst, dstep, src, sstep, n, mode); break;
+    case 2: LAYOUT_COPY_LOOP(2, dst, dstep, src, sstep, n, mode); break;
+    case 4: LAYOUT_COPY_LOOP(4, dst, dstep, src, sstep, n, mode); break;
+    case 8: LAYOUT_COPY_LOOP(8, dst, dstep, src, sstep, n, mode); break;
+    }
+}
+
+/* Decode N records from SRC into a vector of columns. */
+static ScmObj layout_decode(ScmBinaryLayout *l, const unsigned char *src,
+                            ScmSmallInt n)
+{
+    ScmObj cols = Scm_MakeVector(l->nfields, SCM_FALSE);
+    for (int i=0; i<l->nfields; i++) {
+        const ScmBinaryField *f = &l->fields[i];
+        ScmObj col = Scm_MakeUVector(layout_column_class(f->type), n, NULL);
+        if (n > 0) {
+            layout_copy_field((unsigned char*)SCM_UVECTOR_ELEMENTS(col),
+                              f->size, src + f->offset, l->size,
+                              n, f->size, f->swap);
+        }
+        SCM_VECTOR_ELEMENT(cols, i) = col;
+    }
+    return cols;
+}
+
+/* Returns the number of records in COLUMNS, after checking them. */
+static ScmSmallInt layout_check_columns(ScmBinaryLayout *l, ScmObj columns)
+{
+    ScmSmallInt n = -1;
+    if (!SCM_VECTORP(columns) || SCM_VECTOR_SIZE(columns) != l->nfields) {
+        Scm_Error("vector of %d columns required, but got %S",
+                  l->nfields, columns);
+    }
+    for (int i=0; i<l->nfields; i++) {
+        ScmObj col = SCM_VECTOR_ELEMENT(columns, i);
+        ScmSmallInt len;
+        if (SCM_XTYPEP(col, layout_column_class(l->fields[i].type))) {
+            len = SCM_UVECTOR_SIZE(col);
+        } else if (SCM_VECTORP(col)) {
+            len = SCM_VECTOR_SIZE(col);
+        } else {
+            Scm_Error("column for field %S must be a %s or a vector, "
+                      "but got %S", l->fields[i].name,
+                      Scm_UVectorTypeName(l->fields[i].type), col);
+            len = 0;            /* dummy */
+        }
+        if (n < 0) n = len;
+        else if (n != len) {
+            Scm_Error("columns have different lengths: %S", columns);
+        }
+    }
+    return (n < 0)? 0 : n;
+}
+
+/* Encode N records from checked COLUMNS into DST. */
+static void layout_encode(ScmBinaryLayout *l, ScmObj columns,
+                          unsigned char *dst, ScmSmallInt n)
+{
+    for (int i=0; i<l->nfields; i++) {
+        const ScmBinaryField *f = &l->fields[i];
+        ScmObj col = SCM_VECTOR_ELEMENT(columns, i);
+        unsigned char *rec = dst;
+        if (SCM_UVECTORP(col)) {
+            layout_copy_field(rec + f->offset, l->size,
+                              (unsigned char*)SCM_UVECTOR_ELEMENTS(col),
+                              f->size, n, f->size, f->swap);
+        } else {
+            for (ScmSmallInt k=0; k<n; k++, rec += l->size) {
+                layout_field_set(f, rec, SCM_VECTOR_ELEMENT(col, k));
+            }
+        }
+    }
+}
+
+static ScmObj layout_decode_record(ScmBinaryLayout *l,
+                                   const unsigned char *rec)
+{
+    ScmObj r = Scm_MakeVector(l->nfields, SCM_FALSE);
+    for (int i=0; i<l->nfields; i++) {
+        SCM_VECTOR_ELEMENT(r, i) = layout_field_ref(&l->fields[i], rec);
+    }
+    return r;
+}
+
+static void layout_encode_record(ScmBinaryLayout *l, ScmObj vals,
+                                 unsigned char *rec)
+{
+    if (SCM_LISTP(vals)) vals = Scm_ListToVector(vals, 0, -1);
+    if (!SCM_VECTORP(vals) || SCM_VECTOR_SIZE(vals) != l->nfields) {
+        Scm_Error("vector or list of %d values required, but got %S",
+                  l->nfields, vals);
+    }
+    for (int i=0; i<l->nfields; i++) {
+        layout_field_set(&l->fields[i], rec, SCM_VECTOR_ELEMENT(vals, i));
+    }
+}
+
+static unsigned char *layout_region(ScmBinaryLayout *l, ScmUVector *uv,
+                                    ScmSmallInt off, ScmSmallInt n)
+{
+    ScmSmallInt size = Scm_UVectorSizeInBytes(uv);
+    if (off < 0 || off > size || n > (size - off) / (l->size? l->size : 1)) {
+        Scm_Error("offset %ld is out of bound of the uvector.", off);
+    }
+    return (unsigned char*)SCM_UVECTOR_ELEMENTS(uv) + off;
+}
+
+ScmObj Scm_GetBinaryRecord(ScmBinaryLayout *l, ScmUVector *uv,
+                           ScmSmallInt off)
+{
+    return layout_decode_record(l, layout_region(l, uv, off, 1));
+}
+
+void Scm_PutBinaryRecord(ScmBinaryLayout *l, ScmUVector *uv,
+                         ScmSmallInt off, ScmObj vals)
+{
+    SCM_UVECTOR_CHECK_MUTABLE(SCM_OBJ(uv));
+    layout_encode_record(l, vals, layout_region(l, uv, off, 1));
+}
+
+/* If COUNT is negative, decode as many records as the uvector holds. */
+ScmObj Scm_GetBinaryRecords(ScmBinaryLayout *l, ScmUVector *uv,
+                            ScmSmallInt off, ScmSmallInt count)
+{
+    if (count < 0) {
+        ScmSmallInt size = Scm_UVectorSizeInBytes(uv);
+        if (off < 0 || off > size) {
+            Scm_Error("offset %ld is out of bound of the uvector.", off);
+        }
+        count = l->size? (size - off) / l->size : 0;
+    }
+    return layout_decode(l, layout_region(l, uv, off, count), count);
+}
+
+void Scm_PutBinaryRecords(ScmBinaryLayout *l, ScmUVector *uv,
+                          ScmSmallInt off, ScmObj columns)
+{
+    SCM_UVECTOR_CHECK_MUTABLE(SCM_OBJ(uv));
+    ScmSmallInt n = layout_check_columns(l, columns);
+    layout_encode(l, columns, layout_region(l, uv, off, n), n);
+}
+
+/* Read up to LEN octets; returns the number of octets actually read. */
+static ScmSmallInt getbytes_partial(char *buf, ScmSmallInt len,
+                                    ScmPort *iport)
+{
+    ScmSmallInt nread = 0;
+    while (nread < len) {
+        ScmSize r = Scm_Getz(buf + nread, len - nread, iport);
+        if (r <= 0) break;
+        nread += r;
+    }
+    return nread;
+}
+
+ScmObj Scm_ReadBinaryRecord(ScmBinaryLayout *l, ScmPort *iport)
+{
+    ENSURE_IPORT(iport);
+    char *buf = SCM_NEW_ATOMIC_ARRAY(char, l->size);
+    if (getbytes_partial(buf, l->size, iport) < l->size) return SCM_EOF;
+    return layout_decode_record(l, (unsigned char*)buf);
+}
+
+/* Reads up to COUNT records at once and returns them in columns.
+   Returns EOF if not a single complete record is available.
+   Trailing octets that don't make up a complete record are consumed
+   and discarded, as the single-value readers do. */
+ScmObj Scm_ReadBinaryRecords(ScmBinaryLayout *l, ScmSmallInt count,
+                             ScmPort *iport)
+{
+    ENSURE_IPORT(iport);
+    if (count < 0) Scm_Error("count must be nonnegative, but got %ld", count);
+    if (l->size == 0 || count == 0) return layout_decode(l, NULL, 0);
+    if (count > SCM_SMALL_INT_MAX / l->size) {
+        Scm_Error("count too large: %ld", count);
+    }
+    char *buf = SCM_NEW_ATOMIC_ARRAY(char, count * l->size);
+    ScmSmallInt n = getbytes_partial(buf, count * l->size, iport) / l->size;
+    if (n == 0) return SCM_EOF;
+    return layout_decode(l, (unsigned char*)buf, n);
+}
+
+void Scm_WriteBinaryRecord(ScmBinaryLayout *l, ScmObj vals, ScmPort *oport)
+{
+    ENSURE_OPORT(oport);
+    unsigned char *buf = SCM_NEW_ATOMIC_ARRAY(unsigned char, l->size);
+    memset(buf, 0, l->size);
+    layout_encode_record(l, vals, buf);
+    Scm_Putz((char*)buf, l->size, oport);
+}
+
+void Scm_WriteBinaryRecords(ScmBinaryLayout *l, ScmObj columns,
+                            ScmPort *oport)
+{
+    ENSURE_OPORT(oport);
+    ScmSmallInt n = layout_check_columns(l, columns);
+    ScmSmallInt len = n * l->size;
+    unsigned char *buf = SCM_NEW_ATOMIC_ARRAY(unsigned char, len);
+    memset(buf, 0, len);
+    layout_encode(l, columns, buf, n);
+    Scm_Putz((char*)buf, len, oport);
+}
+
+/*===========================================================
+ * Initialization
+ */
+
+void Scm_Init_binary(ScmModule *mod)
+{
+    Scm_InitStaticClass(&Scm_BinaryLayoutClass, "<binary-layout>",
+                        mod, NULL, 0);
+}
@@ -81,3 +81,46 @@ extern void Scm_PutBinaryS64(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
 extern void Scm_PutBinaryF16(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
 extern void Scm_PutBinaryF32(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
 extern void Scm_PutBinaryF64(ScmUVector *uv, int off, ScmObj v, ScmSymbol *e);
+
+/* Compiled record layout */
+
+typedef struct ScmBinaryFieldRec {
+    ScmObj name;
+    int type;                   /* ScmUVectorType */
+    int size;                   /* in octets */
+    int offset;                 /* from the beginning of the record */
+    int swap;                   /* how to swap octets; see binary.c */
+} ScmBinaryField;
+
+typedef struct ScmBinaryLayoutRec {
+    SCM_HEADER;
+    int nfields;
+    int size;                   /* record size in octets */
+    ScmBinaryField *fields;
+    ScmObj names;               /* list of field names */
+} ScmBinaryLayout;
+
+extern ScmClass Scm_BinaryLayoutClass;
+#define SCM_CLASS_BINARY_LAYOUT   (&Scm_BinaryLayoutClass)
+#define SCM_BINARY_LAYOUT(obj)    ((ScmBinaryLayout*)(obj))
+#define SCM_BINARY_LAYOUT_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_BINARY_LAYOUT)
+
+extern ScmObj Scm_MakeBinaryLayout(ScmObj spec, ScmSymbol *e);
+
+extern ScmObj Scm_GetBinaryRecord(ScmBinaryLayout *l, ScmUVector *uv,
+                                  ScmSmallInt off);
+extern void   Scm_PutBinaryRecord(ScmBinaryLayout *l, ScmUVector *uv,
+                                  ScmSmallInt off, ScmObj vals);
+extern ScmObj Scm_GetBinaryRecords(ScmBinaryLayout *l, ScmUVector *uv,
+                                   ScmSmallInt off, ScmSmallInt count);
+extern void   Scm_PutBinaryRecords(ScmBinaryLayout *l, ScmUVector *uv,
+                                   ScmSmallInt off, ScmObj columns);
+extern ScmObj Scm_ReadBinaryRecord(ScmBinaryLayout *l, ScmPort *iport);
+extern ScmObj Scm_ReadBinaryRecords(ScmBinaryLayout *l, ScmSmallInt count,
+                                    ScmPort *iport);
+extern void   Scm_WriteBinaryRecord(ScmBinaryLayout *l, ScmObj vals,
+                                    ScmPort *oport);
+extern void   Scm_WriteBinaryRecords(ScmBinaryLayout *l, ScmObj columns,
+                                     ScmPort *oport);
+
+extern void Scm_Init_binary(ScmModule *mod);
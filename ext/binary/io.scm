@@ -35,6 +35,10 @@
           put-u16be! put-u16le! put-u32be! put-u32le! put-u64be! put-u64le!
           put-s16be! put-s16le! put-s32be! put-s32le! put-s64be! put-s64le!
           put-f16be! put-f16le! put-f32be! put-f32le! put-f64be! put-f64le!
+          <binary-layout> make-binary-layout binary-layout?
+          binary-layout-size binary-layout-field-names
+          get-record put-record! get-records put-records!
+          read-record write-record read-records write-records
 
           ;; old names
           read-binary-uint
@@ -512,6 +516,59 @@
     [(8) (put-s64! uv pos val endian)]
     [else (%put-int! size uv pos val endian)]))
 
+;;;
+;;; Record layouts
+;;;
+
+;; A layout is compiled once from a list of field specs, and then
+;; used to decode/encode whole records.  The array versions work
+;; column-wise; a vector of uvectors, one per field.
+
+(inline-stub
+ (initcode "Scm_Init_binary(Scm_CurrentModule());")
+
+ (define-type <binary-layout> "ScmBinaryLayout*" "binary layout"
+   "SCM_BINARY_LAYOUT_P" "SCM_BINARY_LAYOUT")
+
+ (define-cproc make-binary-layout (spec::<list>
+                                   :optional (endian::<symbol>? #f))
+   Scm_MakeBinaryLayout)
+ (define-cproc binary-layout? (obj) ::<boolean> SCM_BINARY_LAYOUT_P)
+ (define-cproc binary-layout-size (layout::<binary-layout>) ::<int>
+   (return (-> layout size)))
+ (define-cproc binary-layout-field-names (layout::<binary-layout>)
+   (return (-> layout names)))
+
+ (define-cproc get-record (layout::<binary-layout> v::<uvector> off::<uint>)
+   Scm_GetBinaryRecord)
+ (define-cproc put-record! (layout::<binary-layout> v::<uvector> off::<uint>
+                            vals)
+   ::<void> Scm_PutBinaryRecord)
+
+ (define-cproc get-records (layout::<binary-layout> v::<uvector> off::<uint>
+                            :optional (count #f))
+   (let* ([n::ScmSmallInt -1])
+     (cond [(SCM_INTP count) (set! n (SCM_INT_VALUE count))]
+           [(not (SCM_FALSEP count)) (SCM_TYPE_ERROR count "fixnum or #f")])
+     (return (Scm_GetBinaryRecords layout v off n))))
+ (define-cproc put-records! (layout::<binary-layout> v::<uvector> off::<uint>
+                             columns)
+   ::<void> Scm_PutBinaryRecords)
+
+ (define-cproc read-record (layout::<binary-layout>
+                            :optional (port::<input-port>? #f))
+   Scm_ReadBinaryRecord)
+ (define-cproc read-records (layout::<binary-layout> count::<fixnum>
+                             :optional (port::<input-port>? #f))
+   Scm_ReadBinaryRecords)
+ (define-cproc write-record (layout::<binary-layout> vals
+                             :optional (port::<output-port>? #f))
+   ::<void> Scm_WriteBinaryRecord)
+ (define-cproc write-records (layout::<binary-layout> columns
+                              :optional (port::<output-port>? #f))
+   ::<void> Scm_WriteBinaryRecords)
+ )
+
 ;;;
 ;;; Machine-dependent binary parameters
 ;;;
@@ -584,6 +584,69 @@
          (put-sint! 3 v 4 -512 'big-endian)
          (put-sint! 3 v 7 -512 'little-endian)))
 
+;; record layouts
+(let ([l (make-binary-layout '((a u8) (b s16be) 1 (c u32le) (d f64be)))]
+      [rec '#u8(#xff #xff #xfe 0 1 2 3 4 #x3f #xf0 0 0 0 0 0 0)])
+  (test* "binary-layout" '(#t 16 (a b c d))
+         (list (binary-layout? l)
+               (binary-layout-size l)
+               (binary-layout-field-names l)))
+  (test* "get-record" '#(255 -2 #x04030201 1.0)
+         (get-record l rec 0))
+  (test* "put-record!" rec
+         (rlet1 v (make-u8vector 16 0)
+           (put-record! l v 0 '#(255 -2 #x04030201 1.0))))
+  (test* "put-record! (out of range)" (test-error)
+         (put-record! l (make-u8vector 16 0) 0 '(256 0 0 0.0)))
+  (test* "get-record (out of bound)" (test-error)
+         (get-record l rec 1))
+  (test* "get-records" '#(#u8(255 255) #s16(-2 -2)
+                          #u32(#x04030201 #x04030201) #f64(1.0 1.0))
+         (get-records l (u8vector-append rec rec) 0))
+  (test* "get-records (count)" '#(#u8() #s16() #u32() #f64())
+         (get-records l rec 0 0))
+  (test* "put-records!" (u8vector-append rec rec)
+         (rlet1 v (make-u8vector 32 0)
+           (put-records! l v 0 '#(#u8(255 255) #(-2 -2)
+                                  #u32(#x04030201 #x04030201)
+                                  #f64(1.0 1.0)))))
+  (test* "put-records! (length mismatch)" (test-error)
+         (put-records! l (make-u8vector 32 0) 0
+                       '#(#u8(255 255) #(-2) #u32(1 2) #f64(1.0 1.0))))
+  (test* "read-record" '(#(255 -2 #x04030201 1.0) #t)
+         (with-input-from-string (u8vector->string rec)
+           (^[] (list (read-record l) (eof-object? (read-record l))))))
+  (test* "read-records" '(#(#u8(255 255) #s16(-2 -2)
+                            #u32(#x04030201 #x04030201) #f64(1.0 1.0))
+                          #(#u8(255) #s16(-2) #u32(#x04030201) #f64(1.0))
+                          #t)
+         (with-input-from-string (u8vector->string
+                                  (u8vector-append rec rec rec '#u8(1 2)))
+           (^[] (list (read-records l 2)
+                      (read-records l 2)
+                      (eof-object? (read-records l 2))))))
+  (test* "write-record" rec
+         (string->u8vector
+          (with-output-to-string
+            (^[] (write-record l '(255 -2 #x04030201 1.0))))))
+  (test* "write-records" (u8vector-append rec rec)
+         (string->u8vector
+          (with-output-to-string
+            (^[] (write-records l (get-records l (u8vector-append rec rec)
+                                               0))))))
+  )
+
+(let1 l (make-binary-layout '((x f32) (y f32) (id u16)) 'little-endian)
+  (test* "records roundtrip" '#(#f32(0.5 1.5 2.5) #f32(-1.0 -2.0 -3.0)
+                                #u16(1 2 3))
+         (let1 v (make-u8vector (* 3 (binary-layout-size l)))
+           (put-records! l v 0 '#(#f32(0.5 1.5 2.5) #f32(-1.0 -2.0 -3.0)
+                                  #u16(1 2 3)))
+           (get-records l v 0)))
+  (test* "layout with bad type" (test-error)
+         (make-binary-layout '((x f128))))
+  )
+
 ;;----------------------------------------------------------
 (test-section "binary.ftype")
 
@@ -20,31 +20,35 @@
 #define SHA1_Final      Scm_SHA1_Final
 #define SHA1_End        Scm_SHA1_End
 #define SHA1_Data       Scm_SHA1_Data
+#define SHA1_Multi      Scm_SHA1_Multi
 
 #define SHA224_Init     Scm_SHA224_Init
 #define SHA224_Update   Scm_SHA224_Update
 #define SHA224_Final    Scm_SHA224_Final
 #define SHA224_End      Scm_SHA224_End
 #define SHA224_Data     Scm_SHA224_Data
+#define SHA224_Multi    Scm_SHA224_Multi
 
 #define SHA256_Init     Scm_SHA256_Init
 #define SHA256_Update   Scm_SHA256_Update
 #define SHA256_Final    Scm_SHA256_Final
 #define SHA256_End      Scm_SHA256_End
 #define SHA256_Data     Scm_SHA256_Data
+#define SHA256_Multi    Scm_SHA256_Multi
 
 #define SHA384_Init     Scm_SHA384_Init
 #define SHA384_Update   Scm_SHA384_Update
 #define SHA384_Final    Scm_SHA384_Final
 #define SHA384_End      Scm_SHA384_End
 #define SHA384_Data     Scm_SHA384_Data
+#define SHA384_Multi    Scm_SHA384_Multi
 
 #define SHA512_Init     Scm_SHA512_Init
 #define SHA512_Update   Scm_SHA512_Update
 #define SHA512_Final    Scm_SHA512_Final
 #define SHA512_End      Scm_SHA512_End
 #define SHA512_Data     Scm_SHA512_Data
+#define SHA512_Multi    Scm_SHA512_Multi
 
-
-
-
+#define SHA2_Select_Kernel Scm_SHA2_Select_Kernel
+#define SHA2_Kernel_Name   Scm_SHA2_Kernel_Name
@@ -38,11 +38,11 @@
 (define-module rfc.sha
   (use gauche.uvector)
   (extend util.digest)
-  (export <sha1> sha1-digest sha1-digest-string
-          <sha224> sha224-digest sha224-digest-string
-          <sha256> sha256-digest sha256-digest-string
-          <sha384> sha384-digest sha384-digest-string
-          <sha512> sha512-digest sha512-digest-string))
+  (export <sha1> sha1-digest sha1-digest-string sha1-digest-strings
+          <sha224> sha224-digest sha224-digest-string sha224-digest-strings
+          <sha256> sha256-digest sha256-digest-string sha256-digest-strings
+          <sha384> sha384-digest sha384-digest-string sha384-digest-strings
+          <sha512> sha512-digest sha512-digest-string sha512-digest-strings))
 (select-module rfc.sha)
 
 ;;;
@@ -70,11 +70,21 @@
 (define sha384-digest (gen-digest %sha384-init %sha384-update %sha384-final))
 (define sha512-digest (gen-digest %sha512-init %sha512-update %sha512-final))
 
-(define (sha1-digest-string s)   (with-input-from-string s sha1-digest))
-(define (sha224-digest-string s) (with-input-from-string s sha224-digest))
-(define (sha256-digest-string s) (with-input-from-string s sha256-digest))
-(define (sha384-digest-string s) (with-input-from-string s sha384-digest))
-(define (sha512-digest-string s) (with-input-from-string s sha512-digest))
+
+;; These hash the string body or the u8vector storage in place,
+;; without going through a port.
+(define sha1-digest-string   %sha1-digest-message)
+(define sha224-digest-string %sha224-digest-message)
+(define sha256-digest-string %sha256-digest-message)
+(define sha384-digest-string %sha384-digest-message)
+(define sha512-digest-string %sha512-digest-message)
+
+;; Digests each message in a list or a vector in one call.
+(define sha1-digest-strings   %sha1-digest-multi)
+(define sha224-digest-strings %sha224-digest-multi)
+(define sha256-digest-strings %sha256-digest-multi)
+(define sha384-digest-strings %sha384-digest-multi)
+(define sha512-digest-strings %sha512-digest-multi)
 
 ;;;
 ;;; Digest framework
@@ -86,7 +96,8 @@
         [init   (string->symbol #"%sha~|n|-init")]
         [update (string->symbol #"%sha~|n|-update")]
         [final  (string->symbol #"%sha~|n|-final")]
-        [digest (string->symbol #"sha~|n|-digest")])
+        [digest (string->symbol #"sha~|n|-digest")]
+        [dstr   (string->symbol #"sha~|n|-digest-string")])
     `(begin
        (define-class ,meta (<message-digest-algorithm-meta>) ())
        (define-class ,cls (<message-digest-algorithm>)
@@ -103,7 +114,9 @@
        (define-method digest-final! ((self ,cls))
          (,final (slot-ref self'context)))
        (define-method digest ((class ,meta))
-         (,digest)))))
+         (,digest))
+       (define-method digest-string ((class ,meta) string)
+         (,dstr string)))))
 
 (define-framework 1    64)
 (define-framework 224  64)
@@ -126,6 +139,9 @@
   (.include <gauche/extern.h>)      ; fix SCM_EXTERN in SCM_CLASS_DECL
   )
 
+ ;; signature of SHAx_Multi
+ "typedef void (*sha_multi_proc)(size_t, const uint8_t *const[], const size_t[], uint8_t*);"
+
  (define-ctype ScmShaContext::(.struct
                                (SCM_HEADER :: ""
                                 ctx::SHA_CTX)))
@@ -194,6 +210,112 @@
    (common-final SHA384_Final ctx SHA384_DIGEST_LENGTH))
  (define-cproc %sha512-final (ctx::<sha-context>)
    (common-final SHA512_Final ctx SHA512_DIGEST_LENGTH))
+
+ ;; Direct digest of a string or u8vector.  The content is hashed
+ ;; in place; no copy is made.
+ (define-cfn sha_message (data len::size_t*) ::(const unsigned char*) :static
+   (cond
+    [(SCM_U8VECTORP data)
+     (set! (* len) (SCM_U8VECTOR_SIZE (SCM_U8VECTOR data)))
+     (return (cast (const unsigned char*)
+                   (SCM_UVECTOR_ELEMENTS (SCM_U8VECTOR data))))]
+    [(SCM_STRINGP data)
+     (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY data)])
+       (set! (* len) (SCM_STRING_BODY_SIZE b))
+       (return (cast (const unsigned char*) (SCM_STRING_BODY_START b))))]
+    [else
+     (SCM_TYPE_ERROR data "u8vector or string")
+     (return NULL)]))
+
+ (define-cfn sha_digest_string (digest::(const unsigned char*) size::int)
+   :static
+   (return (Scm_MakeString (cast (const char*) digest) size size
+                           (logior SCM_STRING_INCOMPLETE
+                                   SCM_STRING_COPYING))))
+
+ (define-cise-stmt common-digest
+   [(_ init update final data size)
+    `(let* ([ctx::SHA_CTX]
+            [len::size_t 0]
+            [p::(const unsigned char*) (sha_message ,data (& len))]
+            [digest::(.array (unsigned char) (,size))])
+       (,init (& ctx))
+       (,update (& ctx) p len)
+       (,final digest (& ctx))
+       (return (sha_digest_string digest ,size)))])
+
+ (define-cproc %sha1-digest-message (data)
+   (common-digest SHA1_Init SHA1_Update SHA1_Final data
+                  SHA1_DIGEST_LENGTH))
+ (define-cproc %sha224-digest-message (data)
+   (common-digest SHA224_Init SHA224_Update SHA224_Final data
+                  SHA224_DIGEST_LENGTH))
+ (define-cproc %sha256-digest-message (data)
+   (common-digest SHA256_Init SHA256_Update SHA256_Final data
+                  SHA256_DIGEST_LENGTH))
+ (define-cproc %sha384-digest-message (data)
+   (common-digest SHA384_Init SHA384_Update SHA384_Final data
+                  SHA384_DIGEST_LENGTH))
+ (define-cproc %sha512-digest-message (data)
+   (common-digest SHA512_Init SHA512_Update SHA512_Final data
+                  SHA512_DIGEST_LENGTH))
+
+ ;; Multi-message digest.  MSGS is a list or a vector of strings and
+ ;; u8vectors; returns the digests in the same kind of sequence.
+ ;; SHAx_Multi may hash several messages in parallel.
+ (define-cfn sha_digest_multi (msgs multi::sha_multi_proc size::int)
+   :static
+   (let* ([n::ScmSize 0]
+          [i::ScmSize 0])
+     (if (SCM_VECTORP msgs)
+       (set! n (SCM_VECTOR_SIZE msgs))
+       (begin
+         (set! n (Scm_Length msgs))
+         (when (< n 0) (SCM_TYPE_ERROR msgs "proper list or vector"))))
+     (when (== n 0) (return msgs))
+     (let* ([data::(const unsigned char**)
+             (SCM_NEW_ARRAY (.type const unsigned char*) n)]
+            [len::size_t* (SCM_NEW_ATOMIC_ARRAY (.type size_t) n)]
+            [out::(unsigned char*)
+             (SCM_NEW_ATOMIC_ARRAY (.type unsigned char) (* n size))])
+       (if (SCM_VECTORP msgs)
+         (for [(set! i 0) (< i n) (pre++ i)]
+           (set! (aref data i)
+                 (sha_message (SCM_VECTOR_ELEMENT msgs i) (+ len i))))
+         (dolist [m msgs]
+           (set! (aref data i) (sha_message m (+ len i)))
+           (pre++ i)))
+       (multi n data len out)
+       (if (SCM_VECTORP msgs)
+         (let* ([v (Scm_MakeVector n SCM_FALSE)])
+           (for [(set! i 0) (< i n) (pre++ i)]
+             (set! (SCM_VECTOR_ELEMENT v i)
+                   (sha_digest_string (+ out (* i size)) size)))
+           (return v))
+         (let* ([h SCM_NIL] [t SCM_NIL])
+           (for [(set! i 0) (< i n) (pre++ i)]
+             (SCM_APPEND1 h t (sha_digest_string (+ out (* i size)) size)))
+           (return h))))))
+
+ (define-cproc %sha1-digest-multi (msgs)
+   (return (sha_digest_multi msgs SHA1_Multi SHA1_DIGEST_LENGTH)))
+ (define-cproc %sha224-digest-multi (msgs)
+   (return (sha_digest_multi msgs SHA224_Multi SHA224_DIGEST_LENGTH)))
+ (define-cproc %sha256-digest-multi (msgs)
+   (return (sha_digest_multi msgs SHA256_Multi SHA256_DIGEST_LENGTH)))
+ (define-cproc %sha384-digest-multi (msgs)
+   (return (sha_digest_multi msgs SHA384_Multi SHA384_DIGEST_LENGTH)))
+ (define-cproc %sha512-digest-multi (msgs)
+   (return (sha_digest_multi msgs SHA512_Multi SHA512_DIGEST_LENGTH)))
+
+ ;; The environment variable GAUCHE_SHA_KERNEL can force a less capable
+ ;; implementation ("generic", or "avx2" to skip SHA extensions).
+ (initcode (SHA2_Select_Kernel (Scm_GetEnv "GAUCHE_SHA_KERNEL")))
+
+ ;; Returns the name of the chosen implementation; "sha-ni", "avx2" or
+ ;; "generic".  For benchmarks and troubleshooting.
+ (define-cproc %sha-kernel-name () ::<const-cstring>
+   SHA2_Kernel_Name)
  )
 
 
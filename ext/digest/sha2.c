@@ -237,6 +237,12 @@ void SHA512_Internal_Init(SHA_CTX*, const sha_word64*);
 void SHA512_Internal_Last(SHA_CTX*);
 void SHA512_Internal_Transform(SHA_CTX*, const sha_word64*);
 
+/*[Gauche] Process consecutive blocks; these dispatch to the accelerated
+  transforms if available.  See SHA2_Select_Kernel(). */
+static void SHA1_Blocks(SHA_CTX*, const sha_byte*, size_t);
+static void SHA256_Blocks(SHA_CTX*, const sha_byte*, size_t);
+/*[/Gauche]*/
+
 
 /*** SHA2 INITIAL HASH VALUES AND CONSTANTS ***************************/
 
@@ -660,7 +666,7 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			context->s1.bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
+			SHA1_Blocks(context, context->s1.buffer, 1);
 		} else {
 			/* The buffer is not yet full */
 			MEMCPY_BCOPY(&context->s1.buffer[usedspace], data, len);
@@ -670,12 +676,13 @@ void SHA1_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			return;
 		}
 	}
-	while (len >= 64) {
+	if (len >= 64) {
 		/* Process as many complete blocks as we can */
-		SHA1_Internal_Transform(context, (sha_word32*)data);
-		context->s1.bitcount += 512;
-		len -= 64;
-		data += 64;
+		size_t nblocks = len / 64;
+		SHA1_Blocks(context, data, nblocks);
+		context->s1.bitcount += (sha_word64)nblocks << 9;
+		len -= nblocks * 64;
+		data += nblocks * 64;
 	}
 	if (len > 0) {
 		/* There's left-overs, so save 'em */
@@ -721,7 +728,7 @@ void SHA1_Final(sha_byte digest[], SHA_CTX* context) {
 				MEMSET_BZERO(&context->s1.buffer[usedspace], 64 - usedspace);
 			}
 			/* Do second-to-last transform: */
-			SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
+			SHA1_Blocks(context, context->s1.buffer, 1);
 
 			/* And set-up for the last transform: */
 			MEMSET_BZERO(context->s1.buffer, 56);
@@ -738,7 +745,7 @@ void SHA1_Final(sha_byte digest[], SHA_CTX* context) {
 	*(sha_word64*)buf56 = context->s1.bitcount;
 
 	/* Final transform: */
-	SHA1_Internal_Transform(context, (sha_word32*)context->s1.buffer);
+	SHA1_Blocks(context, context->s1.buffer, 1);
 
 	/* Save the hash data for output: */
 #if BYTE_ORDER == LITTLE_ENDIAN
@@ -1001,7 +1008,7 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			context->s256.bitcount += freespace << 3;
 			len -= freespace;
 			data += freespace;
-			SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
+			SHA256_Blocks(context, context->s256.buffer, 1);
 		} else {
 			/* The buffer is not yet full */
 			MEMCPY_BCOPY(&context->s256.buffer[usedspace], data, len);
@@ -1011,12 +1018,13 @@ void SHA256_Update(SHA_CTX* context, const sha_byte *data, size_t len) {
 			return;
 		}
 	}
-	while (len >= 64) {
+	if (len >= 64) {
 		/* Process as many complete blocks as we can */
-		SHA256_Internal_Transform(context, (sha_word32*)data);
-		context->s256.bitcount += 512;
-		len -= 64;
-		data += 64;
+		size_t nblocks = len / 64;
+		SHA256_Blocks(context, data, nblocks);
+		context->s256.bitcount += (sha_word64)nblocks << 9;
+		len -= nblocks * 64;
+		data += nblocks * 64;
 	}
 	if (len > 0) {
 		/* There's left-overs, so save 'em */
@@ -1047,7 +1055,7 @@ void SHA256_Internal_Last(SHA_CTX* context) {
 				MEMSET_BZERO(&context->s256.buffer[usedspace], 64 - usedspace);
 			}
 			/* Do second-to-last transform: */
-			SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
+			SHA256_Blocks(context, context->s256.buffer, 1);
 
 			/* And set-up for the last transform: */
 			MEMSET_BZERO(context->s256.buffer, 56);
@@ -1066,7 +1074,7 @@ void SHA256_Internal_Last(SHA_CTX* context) {
 	*(sha_word64*)buf56 = context->s256.bitcount;
 
 	/* Final transform: */
-	SHA256_Internal_Transform(context, (sha_word32*)context->s256.buffer);
+	SHA256_Blocks(context, context->s256.buffer, 1);
 }
 
 void SHA256_Final(sha_byte digest[], SHA_CTX* context) {
@@ -1610,3 +1618,150 @@ char* SHA384_Data(const sha_byte* data, size_t len, char digest[SHA384_DIGEST_ST
 	return SHA384_End(&context, digest);
 }
 
+
+
+/*[Gauche]*************************************************************/
+/*
+ * Block dispatching, hardware acceleration, and multi-message hashing.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(SHA2_NO_SIMD)
+#define SHA2_X86 1
+#include <cpuid.h>
+#include "sha2_x86.c"
+#endif
+
+typedef void (*sha2_blocks_fn)(sha_word32*, const sha_byte*, size_t);
+
+/* Set up by SHA2_Select_Kernel().  NULL means the portable transform. */
+static sha2_blocks_fn sha1_blocks_accel = NULL;
+static sha2_blocks_fn sha256_blocks_accel = NULL;
+static int sha256_multi_x8 = 0;
+static const char *sha2_kernel_name = "generic";
+
+static void SHA1_Blocks(SHA_CTX* context, const sha_byte *data, size_t nblocks) {
+	if (sha1_blocks_accel) {
+		sha1_blocks_accel(context->s1.state, data, nblocks);
+		return;
+	}
+	for (; nblocks > 0; nblocks--, data += 64) {
+		SHA1_Internal_Transform(context, (const sha_word32*)data);
+	}
+}
+
+static void SHA256_Blocks(SHA_CTX* context, const sha_byte *data, size_t nblocks) {
+	if (sha256_blocks_accel) {
+		sha256_blocks_accel(context->s256.state, data, nblocks);
+		return;
+	}
+	for (; nblocks > 0; nblocks--, data += 64) {
+		SHA256_Internal_Transform(context, (const sha_word32*)data);
+	}
+}
+
+/*
+ * Chooses the fastest implementation the CPU supports.  REQ can be
+ * NULL, or "generic" or "avx2" to restrict the choice, for benchmarking
+ * and troubleshooting.  SHA-NI is used for SHA-1 and SHA-256; AVX2
+ * is used for SHA-224/256 multi-message hashing when SHA-NI isn't
+ * available (SHA-NI on one message at a time is faster than
+ * AVX2 on eight).
+ */
+void SHA2_Select_Kernel(const char *req) {
+	sha1_blocks_accel = NULL;
+	sha256_blocks_accel = NULL;
+	sha256_multi_x8 = 0;
+	sha2_kernel_name = "generic";
+	if (req != NULL && strcmp(req, "generic") == 0) return;
+#ifdef SHA2_X86
+	{
+		unsigned int a, b, c, d;
+		int has_sha = 0;
+		__builtin_cpu_init();
+		if (__get_cpuid_max(0, NULL) >= 7) {
+			__cpuid_count(7, 0, a, b, c, d);
+			has_sha = (b >> 29) & 1;
+		}
+		if (__builtin_cpu_supports("avx2")) {
+			sha256_multi_x8 = 1;
+			sha2_kernel_name = "avx2";
+		}
+		if (has_sha && __builtin_cpu_supports("sse4.1")
+		    && !(req != NULL && strcmp(req, "avx2") == 0)) {
+			sha1_blocks_accel = sha1_blocks_shani;
+			sha256_blocks_accel = sha256_blocks_shani;
+			sha256_multi_x8 = 0;
+			sha2_kernel_name = "sha-ni";
+		}
+	}
+#endif /* SHA2_X86 */
+}
+
+const char *SHA2_Kernel_Name(void) {
+	return sha2_kernel_name;
+}
+
+/*
+ * Hash N messages DATA[i] of LEN[i] octets each at once, storing the
+ * digests consecutively into OUT.
+ */
+static void SHA2_Multi_Generic(size_t n, const sha_byte *const data[],
+			       const size_t len[], sha_byte *out, int dlen,
+			       void (*init)(SHA_CTX*),
+			       void (*update)(SHA_CTX*, const sha_byte*, size_t),
+			       void (*final)(sha_byte*, SHA_CTX*)) {
+	SHA_CTX	context;
+	size_t	i;
+
+	for (i = 0; i < n; i++) {
+		init(&context);
+		update(&context, data[i], len[i]);
+		final(out + i*dlen, &context);
+	}
+}
+
+void SHA1_Multi(size_t n, const sha_byte *const data[], const size_t len[],
+		sha_byte *out) {
+	SHA2_Multi_Generic(n, data, len, out, SHA1_DIGEST_LENGTH,
+			   SHA1_Init, SHA1_Update, SHA1_Final);
+}
+
+void SHA224_Multi(size_t n, const sha_byte *const data[], const size_t len[],
+		  sha_byte *out) {
+#ifdef SHA2_X86
+	if (sha256_multi_x8) {
+		sha256_multi_avx2(n, data, len, out, sha224_initial_hash_value,
+				  SHA224_DIGEST_LENGTH);
+		return;
+	}
+#endif /* SHA2_X86 */
+	SHA2_Multi_Generic(n, data, len, out, SHA224_DIGEST_LENGTH,
+			   SHA224_Init, SHA224_Update, SHA224_Final);
+}
+
+void SHA256_Multi(size_t n, const sha_byte *const data[], const size_t len[],
+		  sha_byte *out) {
+#ifdef SHA2_X86
+	if (sha256_multi_x8) {
+		sha256_multi_avx2(n, data, len, out, sha256_initial_hash_value,
+				  SHA256_DIGEST_LENGTH);
+		return;
+	}
+#endif /* SHA2_X86 */
+	SHA2_Multi_Generic(n, data, len, out, SHA256_DIGEST_LENGTH,
+			   SHA256_Init, SHA256_Update, SHA256_Final);
+}
+
+void SHA384_Multi(size_t n, const sha_byte *const data[], const size_t len[],
+		  sha_byte *out) {
+	SHA2_Multi_Generic(n, data, len, out, SHA384_DIGEST_LENGTH,
+			   SHA384_Init, SHA384_Update, SHA384_Final);
+}
+
+void SHA512_Multi(size_t n, const sha_byte *const data[], const size_t len[],
+		  sha_byte *out) {
+	SHA2_Multi_Generic(n, data, len, out, SHA512_DIGEST_LENGTH,
+			   SHA512_Init, SHA512_Update, SHA512_Final);
+}
+/*[/Gauche]************************************************************/
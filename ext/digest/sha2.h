@@ -274,6 +274,17 @@ char* SHA512_Data();
 
 #endif /* NOPROTO */
 
+/*[Gauche] Additional APIs; see the end of sha2.c */
+void SHA2_Select_Kernel(const char *);
+const char *SHA2_Kernel_Name(void);
+
+void SHA1_Multi(size_t, const uint8_t *const[], const size_t[], uint8_t*);
+void SHA224_Multi(size_t, const uint8_t *const[], const size_t[], uint8_t*);
+void SHA256_Multi(size_t, const uint8_t *const[], const size_t[], uint8_t*);
+void SHA384_Multi(size_t, const uint8_t *const[], const size_t[], uint8_t*);
+void SHA512_Multi(size_t, const uint8_t *const[], const size_t[], uint8_t*);
+/*[/Gauche]*/
+
 #ifdef    __cplusplus
 }
 #endif /* __cplusplus */
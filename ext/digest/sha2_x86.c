@@ -0,0 +1,383 @@
+/*
+ * sha2_x86.c - x86 specific SHA-1/SHA-256 transforms
+ *
+ *   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file is included from sha2.c when compiled with gcc-compatible
+ * compilers on x86.  It provides:
+ *
+ *  - SHA-1 and SHA-256 block functions using the SHA extensions
+ *    (SHA-NI), which process consecutive blocks of a single message.
+ *  - An 8-lane SHA-256 block function using AVX2, which processes
+ *    one block from each of eight independent messages.  It is only
+ *    useful to hash many messages at once (SHA256_Multi).
+ *
+ * The functions are compiled with the target attribute; sha2.c
+ * calls them only after checking the CPU supports them.
+ */
+
+#include <immintrin.h>
+
+/*** SHA-NI ***********************************************************/
+
+#define SHANI_ATTR __attribute__((target("sha,sse4.1")))
+
+/* One group of four SHA-256 rounds, 0 <= g < 16.  The message schedule
+   is kept in four registers m0..m3, rotated at each group; m0 holds
+   the words of the current group. */
+#define SHA256_NI_GROUP(g, m0, m1, m2, m3)                              \
+    do {                                                                \
+        if ((g) < 4) {                                                  \
+            m0 = _mm_shuffle_epi8(                                      \
+                _mm_loadu_si128((const __m128i*)(data+(g)*16)), mask);  \
+        }                                                               \
+        msg = _mm_add_epi32(m0,                                         \
+                  _mm_loadu_si128((const __m128i*)(K256+(g)*4)));       \
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);            \
+        if ((g) >= 3 && (g) <= 14) {                                    \
+            m1 = _mm_add_epi32(m1, _mm_alignr_epi8(m0, m3, 4));         \
+            m1 = _mm_sha256msg2_epu32(m1, m0);                          \
+        }                                                               \
+        msg = _mm_shuffle_epi32(msg, 0x0e);                             \
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);            \
+        if ((g) >= 1 && (g) <= 12) {                                    \
+            m3 = _mm_sha256msg1_epu32(m3, m0);                          \
+        }                                                               \
+    } while (0)
+
+static SHANI_ATTR void sha256_blocks_shani(sha_word32 *state,
+                                           const sha_byte *data,
+                                           size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i state0, state1, msg, tmp, abef, cdgh;
+    __m128i w0 = _mm_setzero_si128(), w1 = w0, w2 = w0, w3 = w0;
+
+    /* The instructions want the state as ABEF and CDGH. */
+    tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xb1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state+4)), 0x1b);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    for (; nblocks > 0; nblocks--, data += 64) {
+        abef = state0;
+        cdgh = state1;
+        SHA256_NI_GROUP(0,  w0, w1, w2, w3);
+        SHA256_NI_GROUP(1,  w1, w2, w3, w0);
+        SHA256_NI_GROUP(2,  w2, w3, w0, w1);
+        SHA256_NI_GROUP(3,  w3, w0, w1, w2);
+        SHA256_NI_GROUP(4,  w0, w1, w2, w3);
+        SHA256_NI_GROUP(5,  w1, w2, w3, w0);
+        SHA256_NI_GROUP(6,  w2, w3, w0, w1);
+        SHA256_NI_GROUP(7,  w3, w0, w1, w2);
+        SHA256_NI_GROUP(8,  w0, w1, w2, w3);
+        SHA256_NI_GROUP(9,  w1, w2, w3, w0);
+        SHA256_NI_GROUP(10, w2, w3, w0, w1);
+        SHA256_NI_GROUP(11, w3, w0, w1, w2);
+        SHA256_NI_GROUP(12, w0, w1, w2, w3);
+        SHA256_NI_GROUP(13, w1, w2, w3, w0);
+        SHA256_NI_GROUP(14, w2, w3, w0, w1);
+        SHA256_NI_GROUP(15, w3, w0, w1, w2);
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*)state, state0);
+    _mm_storeu_si128((__m128i*)(state+4), state1);
+}
+
+/* One group of four SHA-1 rounds, 0 <= g < 20.  e0 is the E value
+   to be consumed by this group, and e1 receives the one for the next. */
+#define SHA1_NI_GROUP(g, e0, e1, m0, m1, m2, m3)                        \
+    do {                                                                \
+        if ((g) < 4) {                                                  \
+            m0 = _mm_shuffle_epi8(                                      \
+                _mm_loadu_si128((const __m128i*)(data+(g)*16)), mask);  \
+        }                                                               \
+        if ((g) == 0) e0 = _mm_add_epi32(e0, m0);                       \
+        else          e0 = _mm_sha1nexte_epu32(e0, m0);                 \
+        e1 = abcd;                                                      \
+        if ((g) >= 3 && (g) <= 18) m1 = _mm_sha1msg2_epu32(m1, m0);     \
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, (g)/5);                    \
+        if ((g) >= 1 && (g) <= 16) m3 = _mm_sha1msg1_epu32(m3, m0);     \
+        if ((g) >= 2 && (g) <= 17) m2 = _mm_xor_si128(m2, m0);          \
+    } while (0)
+
+static SHANI_ATTR void sha1_blocks_shani(sha_word32 *state,
+                                         const sha_byte *data,
+                                         size_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e0, e0_save, e1;
+    __m128i w0 = _mm_setzero_si128(), w1 = w0, w2 = w0, w3 = w0;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+    e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    for (; nblocks > 0; nblocks--, data += 64) {
+        abcd_save = abcd;
+        e0_save = e0;
+        SHA1_NI_GROUP(0,  e0, e1, w0, w1, w2, w3);
+        SHA1_NI_GROUP(1,  e1, e0, w1, w2, w3, w0);
+        SHA1_NI_GROUP(2,  e0, e1, w2, w3, w0, w1);
+        SHA1_NI_GROUP(3,  e1, e0, w3, w0, w1, w2);
+        SHA1_NI_GROUP(4,  e0, e1, w0, w1, w2, w3);
+        SHA1_NI_GROUP(5,  e1, e0, w1, w2, w3, w0);
+        SHA1_NI_GROUP(6,  e0, e1, w2, w3, w0, w1);
+        SHA1_NI_GROUP(7,  e1, e0, w3, w0, w1, w2);
+        SHA1_NI_GROUP(8,  e0, e1, w0, w1, w2, w3);
+        SHA1_NI_GROUP(9,  e1, e0, w1, w2, w3, w0);
+        SHA1_NI_GROUP(10, e0, e1, w2, w3, w0, w1);
+        SHA1_NI_GROUP(11, e1, e0, w3, w0, w1, w2);
+        SHA1_NI_GROUP(12, e0, e1, w0, w1, w2, w3);
+        SHA1_NI_GROUP(13, e1, e0, w1, w2, w3, w0);
+        SHA1_NI_GROUP(14, e0, e1, w2, w3, w0, w1);
+        SHA1_NI_GROUP(15, e1, e0, w3, w0, w1, w2);
+        SHA1_NI_GROUP(16, e0, e1, w0, w1, w2, w3);
+        SHA1_NI_GROUP(17, e1, e0, w1, w2, w3, w0);
+        SHA1_NI_GROUP(18, e0, e1, w2, w3, w0, w1);
+        SHA1_NI_GROUP(19, e1, e0, w3, w0, w1, w2);
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1b);
+    _mm_storeu_si128((__m128i*)state, abcd);
+    state[4] = (sha_word32)_mm_extract_epi32(e0, 3);
+}
+
+#undef SHA256_NI_GROUP
+#undef SHA1_NI_GROUP
+
+/*** AVX2 8-lane SHA-256 **********************************************/
+
+#define AVX2_ATTR __attribute__((target("avx2")))
+
+#define V_ROTR(x, n) \
+    _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32-(n)))
+#define V_XOR3(a, b, c) _mm256_xor_si256(_mm256_xor_si256(a, b), c)
+#define V_ADD(a, b)     _mm256_add_epi32(a, b)
+
+static inline sha_word32 sha256_load_be32(const sha_byte *p)
+{
+    return ((sha_word32)p[0] << 24) | ((sha_word32)p[1] << 16)
+        | ((sha_word32)p[2] << 8) | (sha_word32)p[3];
+}
+
+/* Processes one block of each of eight messages.  ST[i][k] is the i-th
+   state word of the k-th lane. */
+static AVX2_ATTR void sha256_x8_avx2(sha_word32 st[8][8],
+                                     const sha_byte *blk[8])
+{
+    __m256i w[16], s[8], a, b, c, d, e, f, g, h, t1, t2;
+    int j;
+
+    for (j = 0; j < 8; j++) s[j] = _mm256_loadu_si256((__m256i*)st[j]);
+    a = s[0]; b = s[1]; c = s[2]; d = s[3];
+    e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+    for (j = 0; j < 64; j++) {
+        __m256i wj;
+        if (j < 16) {
+            wj = _mm256_set_epi32((int)sha256_load_be32(blk[7]+j*4),
+                                  (int)sha256_load_be32(blk[6]+j*4),
+                                  (int)sha256_load_be32(blk[5]+j*4),
+                                  (int)sha256_load_be32(blk[4]+j*4),
+                                  (int)sha256_load_be32(blk[3]+j*4),
+                                  (int)sha256_load_be32(blk[2]+j*4),
+                                  (int)sha256_load_be32(blk[1]+j*4),
+                                  (int)sha256_load_be32(blk[0]+j*4));
+        } else {
+            __m256i w15 = w[(j+1)&0x0f], w2 = w[(j+14)&0x0f];
+            __m256i s0 = V_XOR3(V_ROTR(w15, 7), V_ROTR(w15, 18),
+                                _mm256_srli_epi32(w15, 3));
+            __m256i s1 = V_XOR3(V_ROTR(w2, 17), V_ROTR(w2, 19),
+                                _mm256_srli_epi32(w2, 10));
+            wj = V_ADD(V_ADD(w[j&0x0f], s0), V_ADD(w[(j+9)&0x0f], s1));
+        }
+        w[j&0x0f] = wj;
+
+        /* T1 = h + Sigma1(e) + Ch(e,f,g) + K[j] + W[j] */
+        t1 = V_ADD(V_ADD(h, V_XOR3(V_ROTR(e, 6), V_ROTR(e, 11),
+                                   V_ROTR(e, 25))),
+                   V_ADD(_mm256_xor_si256(_mm256_and_si256(e, f),
+                                          _mm256_andnot_si256(e, g)),
+                         V_ADD(_mm256_set1_epi32((int)K256[j]), wj)));
+        /* T2 = Sigma0(a) + Maj(a,b,c) */
+        t2 = V_ADD(V_XOR3(V_ROTR(a, 2), V_ROTR(a, 13), V_ROTR(a, 22)),
+                   V_XOR3(_mm256_and_si256(a, b), _mm256_and_si256(a, c),
+                          _mm256_and_si256(b, c)));
+        h = g; g = f; f = e; e = V_ADD(d, t1);
+        d = c; c = b; b = a; a = V_ADD(t1, t2);
+    }
+
+    s[0] = V_ADD(s[0], a); s[1] = V_ADD(s[1], b);
+    s[2] = V_ADD(s[2], c); s[3] = V_ADD(s[3], d);
+    s[4] = V_ADD(s[4], e); s[5] = V_ADD(s[5], f);
+    s[6] = V_ADD(s[6], g); s[7] = V_ADD(s[7], h);
+    for (j = 0; j < 8; j++) _mm256_storeu_si256((__m256i*)st[j], s[j]);
+}
+
+#undef V_ROTR
+#undef V_XOR3
+#undef V_ADD
+
+/* A message being hashed in a lane.  The full blocks are read directly
+   from the message; the last one or two blocks, which carry
+   the padding, are assembled in TAIL. */
+typedef struct {
+    const sha_byte *data;
+    size_t nblocks;             /* remaining full blocks in DATA */
+    int ntail;                  /* number of blocks in TAIL */
+    int itail;                  /* blocks in TAIL already consumed */
+    size_t index;               /* index of the message */
+    sha_byte tail[128];
+} sha256_lane;
+
+static void sha256_lane_start(sha256_lane *l, size_t index,
+                              const sha_byte *data, size_t len)
+{
+    size_t rem = len % 64;
+    sha_word64 bits = (sha_word64)len << 3;
+
+    l->data = data;
+    l->nblocks = len / 64;
+    l->index = index;
+    l->ntail = (rem < 56)? 1 : 2;
+    l->itail = 0;
+    memset(l->tail, 0, sizeof(l->tail));
+    if (rem > 0) memcpy(l->tail, data + len - rem, rem);
+    l->tail[rem] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        l->tail[l->ntail*64 - 1 - i] = (sha_byte)(bits >> (i*8));
+    }
+}
+
+static inline int sha256_lane_done(const sha256_lane *l)
+{
+    return l->nblocks == 0 && l->itail == l->ntail;
+}
+
+/* Returns the next block of the lane.  The lane must not be done. */
+static inline const sha_byte *sha256_lane_next(sha256_lane *l)
+{
+    const sha_byte *b;
+    if (l->nblocks > 0) {
+        b = l->data;
+        l->data += 64;
+        l->nblocks--;
+    } else {
+        b = l->tail + 64*l->itail++;
+    }
+    return b;
+}
+
+static void sha256_lane_output(sha_word32 st[8][8], int k, sha_byte *out,
+                               int digest_len)
+{
+    for (int i = 0; i < digest_len/4; i++) {
+        sha_word32 v = st[i][k];
+        out[i*4]   = (sha_byte)(v >> 24);
+        out[i*4+1] = (sha_byte)(v >> 16);
+        out[i*4+2] = (sha_byte)(v >> 8);
+        out[i*4+3] = (sha_byte)v;
+    }
+}
+
+/* When this few lanes remain busy and no message is waiting, finishing
+   them one by one with the single-message transform is faster than
+   running mostly idle lanes. */
+#define SHA256_X8_MIN_LANES 3
+
+static void sha256_multi_avx2(size_t n, const sha_byte *const data[],
+                              const size_t len[], sha_byte *out,
+                              const sha_word32 *ihv, int digest_len)
+{
+    static const sha_byte idle[64];
+    sha256_lane lane[8];
+    int busy[8];
+    sha_word32 st[8][8];
+    const sha_byte *blk[8];
+    size_t next = 0;
+    int nbusy = 0, k, i;
+
+    for (k = 0; k < 8; k++) {
+        busy[k] = (next < n);
+        if (busy[k]) {
+            sha256_lane_start(&lane[k], next, data[next], len[next]);
+            for (i = 0; i < 8; i++) st[i][k] = ihv[i];
+            next++;
+            nbusy++;
+        }
+    }
+
+    while (nbusy >= SHA256_X8_MIN_LANES || (nbusy > 0 && next < n)) {
+        for (k = 0; k < 8; k++) {
+            blk[k] = busy[k]? sha256_lane_next(&lane[k]) : idle;
+        }
+        sha256_x8_avx2(st, blk);
+        for (k = 0; k < 8; k++) {
+            if (!busy[k] || !sha256_lane_done(&lane[k])) continue;
+            sha256_lane_output(st, k, out + lane[k].index*digest_len,
+                               digest_len);
+            if (next < n) {
+                sha256_lane_start(&lane[k], next, data[next], len[next]);
+                for (i = 0; i < 8; i++) st[i][k] = ihv[i];
+                next++;
+            } else {
+                busy[k] = 0;
+                nbusy--;
+            }
+        }
+    }
+
+    /* Finish the stragglers. */
+    for (k = 0; k < 8; k++) {
+        if (!busy[k]) continue;
+        SHA_CTX ctx;
+        for (i = 0; i < 8; i++) ctx.s256.state[i] = st[i][k];
+        while (!sha256_lane_done(&lane[k])) {
+            SHA256_Blocks(&ctx, sha256_lane_next(&lane[k]), 1);
+        }
+        for (i = 0; i < 8; i++) st[i][k] = ctx.s256.state[i];
+        sha256_lane_output(st, k, out + lane[k].index*digest_len,
+                           digest_len);
+    }
+}
+
+#undef SHA256_X8_MIN_LANES
@@ -7,6 +7,7 @@
 (use srfi-42)
 (use file.util)
 (use util.match)
+(use gauche.uvector)
 
 (use rfc.sha1)
 (test-module 'rfc.sha1)
@@ -99,3 +100,48 @@
 
 (for-each test-from-file (glob "data/*.info"))
 
+
+;; Direct and multi-message digests.  Lengths around the block boundaries
+;; exercise the padding, and the number of messages is chosen so that
+;; the multi-buffer code path has leftovers.
+(let ()
+  (define msgs
+    (list-tabulate 140
+                   (^i (string-ec (: j i)
+                                  (integer->char (+ 97 (modulo (* i j) 26)))))))
+  (define (hex-all digests) (map digest-hexify digests))
+  (define (t name digest digest-string digest-strings)
+    (define expected
+      (hex-all (map (^m (with-input-from-string m digest)) msgs)))
+    (test* #"~|name|-digest-string (u8vector)"
+           (digest-hexify (digest-string "abc"))
+           (digest-hexify (digest-string '#u8(97 98 99))))
+    (test* #"~|name|-digest-string (various lengths)"
+           expected
+           (hex-all (map digest-string msgs)))
+    (test* #"~|name|-digest-strings (list)"
+           expected
+           (hex-all (digest-strings msgs)))
+    (test* #"~|name|-digest-strings (vector)"
+           expected
+           (hex-all (vector->list
+                     (digest-strings
+                      (list->vector (map string->u8vector msgs))))))
+    (test* #"~|name|-digest-strings (decreasing lengths)"
+           (reverse expected)
+           (hex-all (digest-strings (reverse msgs))))
+    (test* #"~|name|-digest-strings (empty)" '() (digest-strings '()))
+    (test* #"~|name|-digest-strings (empty vector)" '#()
+           (digest-strings '#()))
+    (test-error #"~|name|-digest-strings (bad element)" <error>
+                (digest-strings '("abc" abc)))
+    (test-error #"~|name|-digest-strings (improper list)" <error>
+                (digest-strings '("abc" . "def"))))
+  (t "sha1"   sha1-digest   sha1-digest-string   sha1-digest-strings)
+  (t "sha224" sha224-digest sha224-digest-string sha224-digest-strings)
+  (t "sha256" sha256-digest sha256-digest-string sha256-digest-strings)
+  (t "sha384" sha384-digest sha384-digest-string sha384-digest-strings)
+  (t "sha512" sha512-digest sha512-digest-string sha512-digest-strings)
+  (test* "digest-string <sha256> (u8vector)"
+         "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+         (digest-hexify (digest-string <sha256> '#u8(97 98 99)))))
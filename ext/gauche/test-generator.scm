@@ -146,6 +146,24 @@
   (test-generate '(0 1 2 3 4 5 6 7 8 9)
                  (generate
                   (^[yield] (let loop ([i 0]) (yield i) (loop (+ i 1))))))
+  (test-generate '((0 a) (1 b) (2 c))
+                 (let1 g (generate (^[yield] (for-each yield '(a b c))))
+                   (generate
+                    (^[yield]
+                      (let loop ([i 0])
+                        (let1 v (g)
+                          (unless (eof-object? v)
+                            (yield (list i v))
+                            (loop (+ i 1)))))))))
+  (test* "generate (dynamic-wind)" '((0 1) (in out in out in out))
+         (let* ([log '()]
+                [g (generate
+                    (^[yield]
+                      (dynamic-wind
+                        (^[] (push! log 'in))
+                        (^[] (yield 0) (yield 1))
+                        (^[] (push! log 'out)))))])
+           (list (generator->list g) (reverse log))))
   )
 
 (test* "x->generator <hash-table>" '((0 . a) (1 . b) (2 . c))
@@ -446,4 +464,33 @@
                                    (giota 20)
                                    :open #t :repeat #t)))
 
+(test-section "chunk generators")
+
+(test* "gchunks" '(#(0 1 2) #(3 4 5) #(6))
+       (generator->list (gchunks (giota 7) 3)))
+(test* "gchunks (empty)" '() (generator->list (gchunks null-generator 3)))
+(test* "gchunks (size 0)" (test-error) (gchunks (giota 7) 0))
+(test* "vector->chunk-generator (size 0)" (test-error)
+       (vector->chunk-generator '#(a b c) 0))
+(test* "gunchunk" '(0 1 2 3 4 5 6)
+       (generator->list (gunchunk (gchunks (giota 7) 3))))
+(test* "vector->chunk-generator" '(#(b c) #(d))
+       (generator->list (vector->chunk-generator '#(a b c d e) 2 1 4)))
+(test* "port->line-chunk-generator" '(#("a" "b") #("c"))
+       (with-input-from-string "a\nb\nc\n"
+         (^[] (generator->list
+               (port->line-chunk-generator (current-input-port) 2)))))
+(test* "gchunk-map" '(#(0 2 4) #(6 8))
+       (generator->list (gchunk-map (pa$ * 2) (gchunks (giota 5) 3))))
+(test* "gchunk-filter" '(#(1) #(3 5) #(7) #(9))
+       (generator->list (gchunk-filter odd? (gchunks (giota 10) 3))))
+(test* "gchunk-filter (skip empty)" '(#(0) #(9))
+       (generator->list (gchunk-filter (^x (memv x '(0 9)))
+                                       (gchunks (giota 10) 3))))
+(test* "gchunk-fold" 45 (gchunk-fold + 0 (gchunks (giota 10) 4)))
+(test* "gchunk-fold (pipeline)" (fold + 0 (filter even? (map square (iota 1000))))
+       (gchunk-fold + 0 (gchunk-filter even?
+                                       (gchunk-map square
+                                                   (gchunks (giota 1000))))))
+
 (test-end)
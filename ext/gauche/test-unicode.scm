@@ -5,6 +5,7 @@
 (use gauche.test)
 (use util.match)
 (use gauche.sequence)
+(use gauche.uvector)
 (test-start "gauche.unicode")
 
 (use gauche.unicode)
@@ -272,10 +273,70 @@
 (test* "string->utf32 bom" #u8(0 0 #xfe #xff 0 0 0 48 0 0 0 49 0 0 0 50)
        (string->utf32 "012" 'big-endian #t))
 
+;; Longer input, to go through both the per-word path of ASCII runs
+;; and the per-character path, at various alignments.
+(when (eq? (gauche-character-encoding) 'utf-8)
+  (let* ([s (string-append "The quick brown fox "
+                           "\x3bb;\x39b; \x3042;\x3044; \x1f600;"
+                           " jumps over the lazy dog.")]
+         [codes (map char->ucs s)]
+         [u16be (list->u8vector
+                 (append-map (^c (append-map (^w (list (ash w -8)
+                                                       (logand w #xff)))
+                                             (ucs4->utf16 c)))
+                             codes))]
+         [u16le (list->u8vector
+                 (append-map (^c (append-map (^w (list (logand w #xff)
+                                                       (ash w -8)))
+                                             (ucs4->utf16 c)))
+                             codes))]
+         [u32le (list->u8vector
+                 (append-map (^c (list (logand c #xff)
+                                       (logand (ash c -8) #xff)
+                                       (ash c -16)
+                                       0))
+                             codes))])
+    (test* "string->utf16 long" u16be (string->utf16 s 'big))
+    (test* "string->utf16 long" u16le (string->utf16 s 'little))
+    (test* "string->utf32 long" u32le (string->utf32 s 'little))
+    (dotimes [k 9]
+      (test* #"utf16->string long (offset ~k)" (string-copy s k)
+             (utf16->string (string->utf16 s 'little #f k) 'little))
+      (test* #"utf16->string long (start ~k)" (string-copy s k)
+             (utf16->string u16be 'big #t (* k 2)))
+      (test* #"utf32->string long (offset ~k)" (string-copy s k)
+             (utf32->string u32le 'little #t (* k 4)))
+      (test* #"utf8->string long (offset ~k)" (string-copy s k)
+             (utf8->string (string->utf8 s) k)))))
+
+(when (eq? (gauche-character-encoding) 'utf-8)
+  (let1 r (string (ucs->char #xfffd))
+    (test* "utf8->string invalid in long input"
+           #"abcdefgh~|r|ijklmnop~|r|q~|r|"
+           (utf8->string (u8vector-append (string->u8vector "abcdefgh")
+                                          #u8(#xff)
+                                          (string->u8vector "ijklmnop")
+                                          #u8(#xed #xa0 #x80)
+                                          (string->u8vector "q")
+                                          #u8(#xe3 #x81))))
+    (test* "utf16->string lone surrogates" #"a~|r|b~|r|c~|r|"
+           (utf16->string #u8(0 97 #xd8 0 0 98 #xdc 0 0 99 #xd8 0) 'big))
+    (test* "utf16->string surrogate pair" "\x1f600;\x1f600;"
+           (utf16->string #u8(#x3d #xd8 0 #xde #x3d #xd8 0 #xde) 'little))
+    (test* "utf32->string out of range" #"~|r|a~|r|"
+           (utf32->string #u8(0 0 #xd8 0 0 0 0 97 0 #x11 0 0) 'big))))
+
 (test-section "word boundary")
 
+(define (boundary-indices words)
+  (reverse (fold (^[w is] (cons (+ (car is) (string-length w)) is))
+                 '(0) words)))
+
 (define (test-word-breaker sentence expected)
   (test* "string->words" expected (string->words sentence))
+  (test* "string-word-boundaries" (boundary-indices expected)
+         (map (cut string-cursor->index sentence <>)
+              (string-word-boundaries sentence)))
   (test* "codepoints->words"
          (map (^w (map char->ucs w)) expected)
          (codepoints->words (map char->ucs sentence)))
@@ -295,6 +356,29 @@
    '("Gauche" "(" "ゴーシュ" ")" "は" "R5RS" "準" "拠" "の"
      "Scheme" "処" "理" "系")))
 
+(test* "string->words (empty)" '() (string->words ""))
+(test* "string-word-boundaries (empty)" '(0)
+       (map (cut string-cursor->index "" <>) (string-word-boundaries "")))
+(test* "string->words (incomplete)" (test-error)
+       (string->words #*"abc"))
+
+(test-section "grapheme cluster boundary")
+
+(define (test-grapheme-breaker str expected)
+  (test* "string->grapheme-clusters" expected (string->grapheme-clusters str))
+  (test* "string-grapheme-cluster-boundaries" (boundary-indices expected)
+         (map (cut string-cursor->index str <>)
+              (string-grapheme-cluster-boundaries str)))
+  (test* "codepoints->grapheme-clusters"
+         (map (^w (map char->ucs w)) expected)
+         (codepoints->grapheme-clusters (map char->ucs str))))
+
+(test-grapheme-breaker "abc\r\nd" '("a" "b" "c" "\r\n" "d"))
+
+(when (eq? (gauche-character-encoding) 'utf-8)
+  (test-grapheme-breaker "e\x301;a\x308;\x300;x"
+                         '("e\x301;" "a\x308;\x300;" "x")))
+
 (test-section "case conversion")
 
 (define (test-xcase-matrix up down title fold)
@@ -45,10 +45,11 @@
 
           make-word-breaker
           make-word-reader
-          string->words codepoints->words
+          string->words codepoints->words string-word-boundaries
           make-grapheme-cluster-breaker
           make-grapheme-cluster-reader
           string->grapheme-clusters codepoints->grapheme-clusters
+          string-grapheme-cluster-boundaries
 
           string-upcase string-downcase string-titlecase string-foldcase
           codepoints-upcase codepoints-downcase codepoints-titlecase
@@ -382,6 +383,274 @@
 
     utf16->ucs4))
 
+;;=========================================================================
+;; Low level transcoders
+;;
+
+;; These work directly between octet vectors and string bodies, assuming
+;; the native encoding is utf-8; the R7RS procedures below use them only
+;; in that case.  Invalid input is replaced with U+FFFD in the same way
+;; as utf8->ucs4 and utf16->ucs4 with 'replace strictness.
+;;
+;; A run of ASCII characters is processed by the word; we load 8 octets
+;; into uint64_t and see if it has any bit that an ASCII character
+;; doesn't have.  Most text, markup and data in utf-16 is mostly ASCII,
+;; and this makes converting them close to a memory copy.
+
+(inline-stub
+ ;; A mask to see if a word consists of ASCII characters in UTF-16 (unit=2)
+ ;; or UTF-32 (unit=4).  All octets must be zero except the least
+ ;; significant one of each unit, which must be less than #x80.
+ (define-cfn ascii_mask (unit::int bigendian::int) ::uint64_t :static
+   (let* ([m::(.array u_char (8))]
+          [r::uint64_t]
+          [i::int])
+     (for [(set! i 0) (< i 8) (pre++ i)]
+       (set! (aref m i) #xff))
+     (for [(set! i (?: bigendian (- unit 1) 0)) (< i 8) (+= i unit)]
+       (set! (aref m i) #x80))
+     (memcpy (& r) m 8)
+     (return r)))
+
+ (define-cfn load_word (p::(const u_char*)) ::uint64_t :static :inline
+   (let* ([w::uint64_t])
+     (memcpy (& w) p 8)
+     (return w)))
+
+ (define-cfn get16 (p::(const u_char*) bigendian::int) ::uint32_t
+   :static :inline
+   (if bigendian
+     (return (logior (<< (cast uint32_t (aref p 0)) 8) (aref p 1)))
+     (return (logior (aref p 0) (<< (cast uint32_t (aref p 1)) 8)))))
+
+ (define-cfn get32 (p::(const u_char*) bigendian::int) ::uint32_t
+   :static :inline
+   (if bigendian
+     (return (logior (<< (cast uint32_t (aref p 0)) 24)
+                     (<< (cast uint32_t (aref p 1)) 16)
+                     (<< (cast uint32_t (aref p 2)) 8)
+                     (aref p 3)))
+     (return (logior (aref p 0)
+                     (<< (cast uint32_t (aref p 1)) 8)
+                     (<< (cast uint32_t (aref p 2)) 16)
+                     (<< (cast uint32_t (aref p 3)) 24)))))
+
+ (define-cfn put16 (p::u_char* u::uint32_t bigendian::int) ::void
+   :static :inline
+   (if bigendian
+     (set! (aref p 0) (>> u 8) (aref p 1) (logand u #xff))
+     (set! (aref p 0) (logand u #xff) (aref p 1) (>> u 8))))
+
+ (define-cfn put32 (p::u_char* u::uint32_t bigendian::int) ::void
+   :static :inline
+   (if bigendian
+     (set! (aref p 0) (>> u 24) (aref p 1) (logand (>> u 16) #xff)
+           (aref p 2) (logand (>> u 8) #xff) (aref p 3) (logand u #xff))
+     (set! (aref p 0) (logand u #xff) (aref p 1) (logand (>> u 8) #xff)
+           (aref p 2) (logand (>> u 16) #xff) (aref p 3) (>> u 24))))
+
+ ;; Returns the number of octets
+ (define-cfn put_utf8 (p::u_char* u::uint32_t) ::int :static :inline
+   (cond [(< u #x80) (set! (aref p 0) u) (return 1)]
+         [(< u #x800)
+          (set! (aref p 0) (logior #xc0 (>> u 6))
+                (aref p 1) (logior #x80 (logand u #x3f)))
+          (return 2)]
+         [(< u #x10000)
+          (set! (aref p 0) (logior #xe0 (>> u 12))
+                (aref p 1) (logior #x80 (logand (>> u 6) #x3f))
+                (aref p 2) (logior #x80 (logand u #x3f)))
+          (return 3)]
+         [else
+          (set! (aref p 0) (logior #xf0 (>> u 18))
+                (aref p 1) (logior #x80 (logand (>> u 12) #x3f))
+                (aref p 2) (logior #x80 (logand (>> u 6) #x3f))
+                (aref p 3) (logior #x80 (logand u #x3f)))
+          (return 4)]))
+
+ (define-cfn make_string (buf::u_char* end::u_char* len::ScmSize) :static
+   (set! (* end) 0)
+   (return (Scm_MakeString (cast (const char*) buf) (- end buf) len 0)))
+
+ ;; utf-8 with possibly invalid sequences.
+ (define-cfn utf8_to_string (p::(const u_char*) size::ScmSize) :static
+   (let* ([buf::u_char* (SCM_NEW_ATOMIC2 (u_char*) (+ (* size 3) 1))]
+          [q::u_char* buf]
+          [len::ScmSize 0]
+          [i::ScmSize 0]
+          [mask::uint64_t (UINT64_C #x8080808080808080)])
+     (while (< i size)
+       (when (and (<= (+ i 8) size)
+                  (== (logand (load_word (+ p i)) mask) 0))
+         (memcpy q (+ p i) 8)
+         (+= q 8) (+= i 8) (+= len 8)
+         (continue))
+       (let* ([b::uint32_t (aref p (post++ i))]
+              [n::int 0]
+              [u::uint32_t 0])
+         (cond [(< b #x80) (set! u b)]
+               [(< b #xc0) (set! u #xfffd)]
+               [(< b #xe0) (set! n 2 u (logand b #x1f))]
+               [(< b #xf0) (set! n 3 u (logand b #x0f))]
+               [(< b #xf8) (set! n 4 u (logand b #x07))]
+               [(< b #xfc) (set! n 5 u (logand b #x03))]
+               [(< b #xfe) (set! n 6 u (logand b #x01))]
+               [else (set! u #xfffd)])
+         (when (> n 0)
+           (let* ([k::int 1])
+             (for [() (< k n) (pre++ k)]
+               (when (>= i size) (break))
+               (let* ([c::uint32_t (aref p (post++ i))])
+                 ;; NB: A bad octet is consumed, as utf8->ucs4 does.
+                 (unless (== (logand c #xc0) #x80) (break))
+                 (set! u (logior (<< u 6) (logand c #x3f)))))
+             (when (or (< k n)
+                       (< u (?: (== n 2) #x80 (?: (== n 3) #x800 #x10000)))
+                       (and (<= #xd800 u) (< u #xe000))
+                       (>= u #x110000))
+               (set! u #xfffd))))
+         (+= q (put_utf8 q u))
+         (pre++ len)))
+     (return (make_string buf q len))))
+
+ (define-cfn utf16_to_string (p::(const u_char*) size::ScmSize
+                              bigendian::int)
+   :static
+   (let* ([buf::u_char* (SCM_NEW_ATOMIC2 (u_char*) (+ (* (/ size 2) 3) 1))]
+          [q::u_char* buf]
+          [len::ScmSize 0]
+          [i::ScmSize 0]
+          [lo::int (?: bigendian 1 0)]
+          [mask::uint64_t (ascii_mask 2 bigendian)])
+     (while (< (+ i 1) size)
+       (when (and (<= (+ i 8) size)
+                  (== (logand (load_word (+ p i)) mask) 0))
+         (set! (aref q 0) (aref p (+ i lo))
+               (aref q 1) (aref p (+ i 2 lo))
+               (aref q 2) (aref p (+ i 4 lo))
+               (aref q 3) (aref p (+ i 6 lo)))
+         (+= q 4) (+= i 8) (+= len 4)
+         (continue))
+       (let* ([u::uint32_t (get16 (+ p i) bigendian)])
+         (+= i 2)
+         (when (and (<= #xd800 u) (< u #xe000))
+           (if (and (< u #xdc00) (< (+ i 1) size))
+             (let* ([u2::uint32_t (get16 (+ p i) bigendian)])
+               ;; If U2 isn't a low surrogate, it isn't consumed.
+               (if (and (<= #xdc00 u2) (< u2 #xe000))
+                 (begin
+                   (set! u (+ #x10000
+                              (<< (logand u #x3ff) 10)
+                              (logand u2 #x3ff)))
+                   (+= i 2))
+                 (set! u #xfffd)))
+             (set! u #xfffd)))
+         (+= q (put_utf8 q u))
+         (pre++ len)))
+     (return (make_string buf q len))))
+
+ (define-cfn utf32_to_string (p::(const u_char*) size::ScmSize
+                              bigendian::int)
+   :static
+   (let* ([buf::u_char* (SCM_NEW_ATOMIC2 (u_char*) (+ size 1))]
+          [q::u_char* buf]
+          [len::ScmSize 0]
+          [i::ScmSize 0]
+          [lo::int (?: bigendian 3 0)]
+          [mask::uint64_t (ascii_mask 4 bigendian)])
+     (while (< (+ i 3) size)
+       (when (and (<= (+ i 8) size)
+                  (== (logand (load_word (+ p i)) mask) 0))
+         (set! (aref q 0) (aref p (+ i lo))
+               (aref q 1) (aref p (+ i 4 lo)))
+         (+= q 2) (+= i 8) (+= len 2)
+         (continue))
+       (let* ([u::uint32_t (get32 (+ p i) bigendian)])
+         (+= i 4)
+         (when (or (and (<= #xd800 u) (< u #xe000))
+                   (>= u #x110000))
+           (set! u #xfffd))
+         (+= q (put_utf8 q u))
+         (pre++ len)))
+     (return (make_string buf q len))))
+
+ ;; Encoders.  UNIT is 2 for utf-16 and 4 for utf-32.
+ (define-cfn string_to_utf (s::ScmString* start::ScmSmallInt end::ScmSmallInt
+                            unit::int bigendian::int add_bom::int)
+   :static
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY s)]
+          [len::ScmSmallInt (SCM_STRING_BODY_LENGTH b)])
+     (when (SCM_STRING_BODY_INCOMPLETE_P b)
+       (Scm_Error "incomplete string not allowed: %S" s))
+     (SCM_CHECK_START_END start end len)
+     (let* ([sp::(const u_char*)
+             (cast (const u_char*) (Scm_StringBodyPosition b start))]
+            [ep::(const u_char*)
+             (cast (const u_char*) (Scm_StringBodyPosition b end))]
+            [nunits::ScmSize (- end start)]
+            [lo::int (?: bigendian (- unit 1) 0)]
+            [mask::uint64_t (UINT64_C #x8080808080808080)]
+            [r::(const u_char*)])
+       ;; Characters outside of BMP take two units in utf-16.
+       (when (== unit 2)
+         (for [(set! r sp) (< r ep) (pre++ r)]
+           (when (>= (* r) #xf0) (pre++ nunits))))
+       (when add_bom (pre++ nunits))
+       (let* ([v (Scm_MakeUVector SCM_CLASS_U8VECTOR (* nunits unit) NULL)]
+              [q::u_char* (SCM_U8VECTOR_ELEMENTS v)])
+         (when add_bom
+           (if (== unit 2)
+             (put16 q #xfeff bigendian)
+             (put32 q #xfeff bigendian))
+           (+= q unit))
+         (while (< sp ep)
+           (when (and (<= (+ sp 8) ep)
+                      (== (logand (load_word sp) mask) 0))
+             (memset q 0 (* 8 unit))
+             (let* ([k::int 0])
+               (for [() (< k 8) (pre++ k)]
+                 (set! (aref q (+ (* k unit) lo)) (aref sp k))))
+             (+= q (* 8 unit)) (+= sp 8)
+             (continue))
+           (let* ([ch::ScmChar])
+             (SCM_CHAR_GET (cast (const char*) sp) ch)
+             (+= sp (SCM_CHAR_NBYTES ch))
+             (when (or (< ch 0) (>= ch #x110000))
+               (Scm_Error "Input outside of Unicode codepoint range: #x%x"
+                          ch))
+             (cond [(== unit 4) (put32 q ch bigendian) (+= q 4)]
+                   [(and (<= #xd800 ch) (< ch #xe000))
+                    (Scm_Error "Converting codepoint %x to utf-16 \
+                                will lose information" ch)]
+                   [(< ch #x10000) (put16 q ch bigendian) (+= q 2)]
+                   [else
+                    (put16 q (logior #xd800 (>> (- ch #x10000) 10)) bigendian)
+                    (put16 (+ q 2) (logior #xdc00 (logand ch #x3ff))
+                           bigendian)
+                    (+= q 4)])))
+         (return v)))))
+
+ (define-cproc %utf8->string (v::<u8vector> start::<fixnum> end::<fixnum>)
+   (SCM_CHECK_START_END start end (SCM_UVECTOR_SIZE v))
+   (return (utf8_to_string (+ (SCM_U8VECTOR_ELEMENTS v) start) (- end start))))
+ (define-cproc %utf16->string (v::<u8vector> start::<fixnum> end::<fixnum>
+                               bigendian::<boolean>)
+   (SCM_CHECK_START_END start end (SCM_UVECTOR_SIZE v))
+   (return (utf16_to_string (+ (SCM_U8VECTOR_ELEMENTS v) start) (- end start)
+                            bigendian)))
+ (define-cproc %utf32->string (v::<u8vector> start::<fixnum> end::<fixnum>
+                               bigendian::<boolean>)
+   (SCM_CHECK_START_END start end (SCM_UVECTOR_SIZE v))
+   (return (utf32_to_string (+ (SCM_U8VECTOR_ELEMENTS v) start) (- end start)
+                            bigendian)))
+ (define-cproc %string->utf16 (s::<string> start::<fixnum> end::<fixnum>
+                               bigendian::<boolean> add-bom::<boolean>)
+   (return (string_to_utf s start end 2 bigendian add-bom)))
+ (define-cproc %string->utf32 (s::<string> start::<fixnum> end::<fixnum>
+                               bigendian::<boolean> add-bom::<boolean>)
+   (return (string_to_utf s start end 4 bigendian add-bom)))
+ )
+
 ;; R7RS procedures
 
 ;; This module may be precompiled by different platforms, so we dispatch
@@ -395,16 +664,7 @@
   (if (eq? (gauche-character-encoding) 'utf-8)
     (let1 s (u8vector->string bvec start end)
       (if (string-incomplete? s)
-        ;; we have to go through every char
-        (with-output-to-string
-          (^[]
-            (let loop ([in ($ generator->lseq
-                              $ uvector->generator bvec start
-                              $ if (< end 0) (u8vector-length bvec) end)])
-              (receive (ch next) (utf8->ucs4 in 'replace)
-                (unless (eof-object? ch)
-                  (write-char (ucs->char ch))
-                  (loop next))))))
+        (%utf8->string bvec start end)
         s))
     ;; If intenral encoding isn't utf-8, we just let ces-convert handle it.
     ;; (invalid char replacement may not be handled well).
@@ -431,7 +691,7 @@
                   [else end])
     (receive (start endian)
         (if (or ignore-bom? (< (- end start) 2))
-          (values start (or endian 'bid-endian))
+          (values start (or endian 'big-endian))
           (let ([b0 (u8vector-ref bvec start)]
                 [b1 (u8vector-ref bvec (+ start 1))])
             (cond [(and (eqv? b0 #xfe) (eqv? b1 #xff))
@@ -441,13 +701,19 @@
                   [else (values start (or endian 'big-endian))])))
       (unless (even? (- end start))
         (error "number of input octets for utf16 isn't even:" (- end start)))
-      (with-output-to-string
-        (^[] (let loop ([in ($ generator->lseq
-                               $ %u8->u16-generator bvec start end endian)])
-               (receive (u32 next) (utf16->ucs4 in 'replace)
-                 (or (eof-object? u32)
-                     (begin (write-char (ucs->char u32))
-                            (loop next))))))))))
+      (if (eq? (gauche-character-encoding) 'utf-8)
+        (%utf16->string bvec start end (big-endian? endian))
+        (with-output-to-string
+          (^[] (let loop ([in ($ generator->lseq
+                                 $ %u8->u16-generator bvec start end endian)])
+                 (receive (u32 next) (utf16->ucs4 in 'replace)
+                   (or (eof-object? u32)
+                       (begin (write-char (ucs->char u32))
+                              (loop next)))))))))))
+
+;; #f means the default, which is big-endian.
+(define (big-endian? endian)
+  (boolean (or (not endian) (memq endian '(big big-endian)))))
 
 (define (%u8->u16-generator bvec start end endian)
   ;; We don't want to depend on binary.io
@@ -464,6 +730,12 @@
 (define (string->utf16 str :optional (endian 'big-endian) 
                                      (add-bom? #f)
                                      (start 0) end)
+  (if (eq? (gauche-character-encoding) 'utf-8)
+    (%string->utf16 str start (if (undefined? end) -1 end)
+                    (big-endian? endian) add-bom?)
+    (%string->utf16-generic str endian add-bom? start end)))
+
+(define (%string->utf16-generic str endian add-bom? start end)
   (with-builder (<u8vector> add! get)
     (define add16!
       (if (memq endian '(big big-endian))
@@ -483,7 +755,7 @@
                   [else end])
     (receive (start endian)
         (if (or ignore-bom? (< (- end start) 4))
-          (values start (or endian 'bid-endian))
+          (values start (or endian 'big-endian))
           (let ([b0 (u8vector-ref bvec start)]
                 [b1 (u8vector-ref bvec (+ start 1))]
                 [b2 (u8vector-ref bvec (+ start 2))]
@@ -496,12 +768,16 @@
       (unless (zero? (modulo (- end start) 4))
         (error "number of input octets for utf32 isn't multiple of 4"
                (- end start)))
-      (if (zero? (mod start 4))
+      (cond
+       [(eq? (gauche-character-encoding) 'utf-8)
+        (%utf32->string bvec start end (big-endian? endian))]
+       [(zero? (mod start 4))
         (u32vector->string (uvector-alias <u32vector> bvec start end)
-                           0 -1 #f endian)
+                           0 -1 #f endian)]
+       [else
         (map-to <string> ucs->char 
                 ($ generator->lseq
-                   $ %u8->u32-generator bvec start end endian))))))
+                   $ %u8->u32-generator bvec start end endian))]))))
 
 (define (%u8->u32-generator bvec start end endian)
   ;; We don't want to depend on binary.io
@@ -522,6 +798,12 @@
 (define (string->utf32 str :optional (endian 'big-endian)
                                      (add-bom? #f)
                                      (start 0) end)
+  (if (eq? (gauche-character-encoding) 'utf-8)
+    (%string->utf32 str start (if (undefined? end) -1 end)
+                    (big-endian? endian) add-bom?)
+    (%string->utf32-generic str endian add-bom? start end)))
+
+(define (%string->utf32-generic str endian add-bom? start end)
   (let* ([s ((with-module gauche.internal %maybe-substring) str start end)]
          [len (string-length s)]
          [r (make-u8vector (* 4 (if add-bom? (+ len 1) len)))]
@@ -569,39 +851,47 @@
                 (set! ,var ,i))]
              [else (SCM_TYPE_ERROR scode "char or fixnum")]))])
 
+ (define-cfn gb_prop (ch::int) ::int :static
+   (cond [(== ch #x0a) (return GB_LF)]
+         [(== ch #x0d) (return GB_CR)]
+         [(< ch 0) (return GB_Other)]
+         [(< ch #x20000)
+          (let* ([k::u_char (aref break_table (>> ch 8))])
+            (if (== k 255)
+              (return GB_Other)
+              (let* ([b::u_char (aref break_subtable k (logand ch #xff))])
+                (return (>> b 4)))))]
+         [(or (== #xE0001 ch)
+              (and (<= #xE0020 ch) (<= ch #xE007F))) (return GB_Control)]
+         [(and (<= #xE0100 ch) (<= ch #xE01EF)) (return GB_Extend)]
+         [else (return GB_Other)]))
+
+ (define-cfn wb_prop (ch::int) ::int :static
+   (cond [(== ch #x0a) (return WB_LF)]
+         [(== ch #x0d) (return WB_CR)]
+         [(== ch #x22) (return WB_Double_Quote)]
+         [(== ch #x27) (return WB_Single_Quote)]
+         [(< ch 0) (return WB_Other)]
+         [(< ch #x20000)
+          (let* ([k::u_char (aref break_table (>> ch 8))])
+            (if (== k 255)
+              (return WB_Other)
+              (let* ([b::u_char (aref break_subtable k (logand ch #xff))])
+                (return (logand b #x0f)))))]
+         [(or (== #xE0001 ch)
+              (and (<= #xE0020 ch) (<= ch #xE007F))) (return WB_Format)]
+         [(and (<= #xE0100 ch) (<= ch #xE01EF)) (return WB_Extend)]
+         [else (return WB_Other)]))
+
  (define-cproc gb-property (scode) ::<int>
    (let* ([ch::int SCM_CHAR_INVALID])
      (get-arg ch scode)
-     (cond [(== ch #x0a) (return GB_LF)]
-           [(== ch #x0d) (return GB_CR)]
-           [(< ch #x20000)
-            (let* ([k::u_char (aref break_table (>> ch 8))])
-              (if (== k 255)
-                (return GB_Other)
-                (let* ([b::u_char (aref break_subtable k (logand ch #xff))])
-                  (return (>> b 4)))))]
-           [(or (== #xE0001 ch)
-                (and (<= #xE0020 ch) (<= ch #xE007F))) (return GB_Control)]
-           [(and (<= #xE0100 ch) (<= ch #xE01EF)) (return GB_Extend)]
-           [else (return GB_Other)])))
+     (return (gb_prop ch))))
 
  (define-cproc wb-property (scode) ::<int>
    (let* ([ch::int SCM_CHAR_INVALID])
      (get-arg ch scode)
-     (cond [(== ch #x0a) (return WB_LF)]
-           [(== ch #x0d) (return WB_CR)]
-           [(== ch #x22) (return WB_Double_Quote)]
-           [(== ch #x27) (return WB_Single_Quote)]
-           [(< ch #x20000)
-            (let* ([k::u_char (aref break_table (>> ch 8))])
-              (if (== k 255)
-                (return WB_Other)
-                (let* ([b::u_char (aref break_subtable k (logand ch #xff))])
-                  (return (logand b #x0f)))))]
-           [(or (== #xE0001 ch)
-                (and (<= #xE0020 ch) (<= ch #xE007F))) (return WB_Format)]
-           [(and (<= #xE0100 ch) (<= ch #xE01EF)) (return WB_Extend)]
-           [else (return WB_Other)])))
+     (return (wb_prop ch))))
 
  (define-cproc width-property (scode) ::<int>
    (let* ([ch::int SCM_CHAR_INVALID])
@@ -653,22 +943,6 @@
                  (begin (set! lookahead ch) (return (reverse acc)))
                  (loop (cons ch acc)))))))))
 
-;; NB: These may be refactored once we have the generator framework.
-(define (make-string-splitter cluster-reader-maker)
-  (case (gauche-character-encoding)
-    [(utf-8 none)  ;NB: we treat 'none' as latin-1
-     (^[str]
-       (with-input-from-string str
-         (cut generator->list
-              (cluster-reader-maker read-char list->string))))]
-    [else
-     (^[str]
-       (with-input-from-string str
-         (cut generator->list
-              (cluster-reader-maker (gmap char->ucs read-char)
-                                    (^[cs] (map-to <string> ucs->char cs))))))]
-    ))
-
 (define (make-sequence-splitter cluster-reader-maker)
   (^[seq]
     (let1 gen (x->generator seq)
@@ -919,7 +1193,6 @@
   (make-cluster-reader-maker make-word-breaker))
 
 ;; API
-(define string->words (make-string-splitter make-word-reader))
 (define codepoints->words (make-sequence-splitter make-word-reader))
 
 ;; Grapheme Cluster Break Finite Automaton
@@ -1013,11 +1286,144 @@
   (make-cluster-reader-maker make-grapheme-cluster-breaker))
 
 ;; API
-(define string->grapheme-clusters
-  (make-string-splitter make-grapheme-cluster-reader))
 (define codepoints->grapheme-clusters
   (make-sequence-splitter make-grapheme-cluster-reader))
 
+;;=========================================================================
+;; Segmenting strings
+;;
+
+;; Strings are segmented in C, by the same automata as above.  We flatten
+;; each automaton into a u8vector indexed by state * #properties + property.
+;; An entry has the next state in the lower 5 bits, and the action in
+;; the upper 3 bits.
+
+(define (automaton->table fa)
+  (let* ([nprops (vector-length (vector-ref fa 0))]
+         [tab (make-u8vector (* (vector-length fa) nprops) 0)])
+    (dotimes [state (vector-length fa)]
+      (dotimes [prop nprops]
+        (match-let1 (action . next) (vector-ref (vector-ref fa state) prop)
+          (u8vector-set! tab (+ (* state nprops) prop)
+                         (logior (or next 0)
+                                 (ash (case action
+                                        [(#f) TRANS_NOBREAK]
+                                        [(#t) TRANS_BREAK]
+                                        [(wb6) TRANS_WB6]
+                                        [(wb12) TRANS_WB12]
+                                        [(wb7b) TRANS_WB7B])
+                                      5))))))
+    (values tab nprops)))
+
+(inline-stub
+ (declcode
+  (.define TRANS_NOBREAK 0)
+  (.define TRANS_BREAK 1)
+  (.define TRANS_WB6 2)
+  (.define TRANS_WB12 3)
+  (.define TRANS_WB7B 4))
+
+ (define-enum TRANS_NOBREAK)
+ (define-enum TRANS_BREAK)
+ (define-enum TRANS_WB6)
+ (define-enum TRANS_WB12)
+ (define-enum TRANS_WB7B)
+
+ (define-cfn break_prop (ch::ScmChar word::int) ::int :static :inline
+   (let* ([u::int (cast int ch)])
+     (.if (or (defined GAUCHE_CHAR_ENCODING_EUC_JP)
+              (defined GAUCHE_CHAR_ENCODING_SJIS))
+          (set! u (Scm_CharToUcs ch)))
+     (return (?: word (wb_prop u) (gb_prop u)))))
+
+ ;; WB6, WB7b and WB12 look at the next character, skipping Extend and
+ ;; Format (WB4).  Returns TRUE if we break.
+ (define-cfn wb_lookahead (p::(const char*) e::(const char*) action::int)
+   ::int :static
+   (while (< p e)
+     (let* ([ch::ScmChar] [prop::int])
+       (SCM_CHAR_GET p ch)
+       (+= p (SCM_CHAR_NBYTES ch))
+       (set! prop (break_prop ch TRUE))
+       (unless (or (== prop WB_Extend) (== prop WB_Format))
+         (cond [(== action TRANS_WB6)
+                (return (not (or (== prop WB_ALetter)
+                                 (== prop WB_Hebrew_Letter))))]
+               [(== action TRANS_WB12) (return (!= prop WB_Numeric))]
+               [else (return (!= prop WB_Hebrew_Letter))]))))
+   (return TRUE))
+
+ ;; Runs the automaton TAB over the body of S.  Returns a list of string
+ ;; cursors at the boundaries, including both ends; or, if SUBSTRINGS is
+ ;; true, a list of substrings between them.
+ (define-cfn string_breaks (s::ScmString* tab::(const u_char*) nprops::int
+                            word::int substrings::int)
+   :static
+   (let* ([b::(const ScmStringBody*) (SCM_STRING_BODY s)]
+          [p::(const char*) (SCM_STRING_BODY_START b)]
+          [e::(const char*) (+ p (SCM_STRING_BODY_SIZE b))]
+          [prev::(const char*) p]
+          [nchars::ScmSmallInt 0]
+          [state::int 0]
+          [h SCM_NIL]
+          [t SCM_NIL])
+     (when (SCM_STRING_BODY_INCOMPLETE_P b)
+       (Scm_Error "incomplete string not allowed: %S" s))
+     (while (< p e)
+       (let* ([q::(const char*) p]
+              [ch::ScmChar]
+              [entry::int]
+              [action::int]
+              [brk::int])
+         (SCM_CHAR_GET p ch)
+         (+= p (SCM_CHAR_NBYTES ch))
+         (set! entry (aref tab (+ (* state nprops) (break_prop ch word)))
+               state (logand entry #x1f)
+               action (>> entry 5))
+         (cond [(== q prev) (set! brk TRUE)] ; beginning of the string
+               [(== action TRANS_NOBREAK) (set! brk FALSE)]
+               [(== action TRANS_BREAK)   (set! brk TRUE)]
+               [else (set! brk (wb_lookahead p e action))])
+         (when brk
+           (cond [(not substrings)
+                  (SCM_APPEND1 h t (Scm_MakeStringCursorFromPointer s q))]
+                 [(< prev q)
+                  (SCM_APPEND1 h t (Scm_MakeString prev (- q prev) nchars
+                                                   SCM_STRING_COPYING))])
+           (set! prev q nchars 0))
+         (pre++ nchars)))
+     (cond [(not substrings)
+            (SCM_APPEND1 h t (Scm_MakeStringCursorEnd s))]
+           [(< prev e)
+            (SCM_APPEND1 h t (Scm_MakeString prev (- e prev) nchars
+                                             SCM_STRING_COPYING))])
+     (return h)))
+
+ (define-cproc %string-breaks (s::<string> tab::<u8vector> nprops::<fixnum>
+                               word::<boolean> substrings::<boolean>)
+   (return (string_breaks s (cast (const u_char*) (SCM_U8VECTOR_ELEMENTS tab))
+                          nprops word substrings)))
+ )
+
+(define-values (*word-break-table* *word-break-nprops*)
+  (automaton->table *word-break-fa*))
+(define-values (*grapheme-break-table* *grapheme-break-nprops*)
+  (automaton->table *grapheme-break-fa*))
+
+;; API
+(define (string->words str)
+  (%string-breaks str *word-break-table* *word-break-nprops* #t #t))
+(define (string->grapheme-clusters str)
+  (%string-breaks str *grapheme-break-table* *grapheme-break-nprops* #f #t))
+
+;; API
+;; Returns a list of string cursors at the boundaries, including
+;; the beginning and the end of STR.
+(define (string-word-boundaries str)
+  (%string-breaks str *word-break-table* *word-break-nprops* #t #f))
+(define (string-grapheme-cluster-boundaries str)
+  (%string-breaks str *grapheme-break-table* *grapheme-break-nprops* #f #f))
+
 ;;;
 ;;; East asian width
 ;;;
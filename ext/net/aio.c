@@ -0,0 +1,1219 @@
+/*
+ * aio.c - asynchronous file and socket I/O
+ *
+ *   Copyright (c) 2019  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gauche-net.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* <aio-context> queues read, write, accept, connect and fsync requests
+ * and reports their completions.  Requests are accumulated until
+ * aio-submit or aio-wait, so that a batch of them costs one system call.
+ *
+ * There are three backends:
+ *
+ *  io-uring  Linux io_uring(7).  We talk to the kernel directly with
+ *            the raw system calls, so we don't depend on liburing.
+ *            Kernel 5.6 or later is required for the operations we use.
+ *  threads   A small pool of worker threads making blocking calls.
+ *            Used when io_uring isn't available.
+ *  sync      Each request is carried out when it is queued.  Used
+ *            when Gauche is built without threads.
+ *
+ * The objects a request refers to (buffers, sockets) are kept in the
+ * slot table of the context while the request is in flight, since the
+ * kernel or a worker thread may still write into them.  Closing the
+ * context, explicitly or by GC, cancels the requests and waits for them.
+ *
+ * A context isn't thread-safe; use one from a single thread.
+ */
+
+#if !defined(GAUCHE_WINDOWS)
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <poll.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define USE_IO_URING 1
+#endif
+#endif /*HAVE_LINUX_IO_URING_H*/
+#if defined(GAUCHE_USE_PTHREADS)
+#include <signal.h>
+#define USE_AIO_THREADS 1
+#endif /*GAUCHE_USE_PTHREADS*/
+#endif /*!GAUCHE_WINDOWS*/
+
+/* Max # of requests in flight per context */
+#define AIO_MAX_DEPTH   4096
+/* Max # of worker threads per context of the threads backend */
+#define AIO_MAX_THREADS 4
+/* Linux doesn't transfer more than this with one read/write */
+#define AIO_MAX_LEN     0x7ffff000
+
+enum {
+    AIO_READ,
+    AIO_WRITE,
+    AIO_ACCEPT,
+    AIO_CONNECT,
+    AIO_FSYNC
+};
+
+enum {
+    AIO_BACKEND_AUTO,
+    AIO_BACKEND_SYNC,
+    AIO_BACKEND_THREADS,
+    AIO_BACKEND_IO_URING
+};
+
+typedef struct aio_peer_rec {
+    socklen_t len;
+    struct sockaddr_storage addr;
+} aio_peer;
+
+typedef struct aio_request_rec {
+    int op;
+    int fd;
+    int slot;
+    void *ptr;                  /* buffer, or sockaddr to connect */
+    size_t len;
+    off_t offset;               /* -1 for the current position */
+    ScmObj obj;                 /* buffer or socket */
+    ScmObj addr;                /* sockaddr to connect */
+    ScmObj tag;
+    aio_peer *peer;             /* accepted peer */
+    long result;                /* return value, or -errno */
+    struct aio_request_rec *next;
+} aio_request;
+
+struct ScmAioContextRec {
+    SCM_HEADER;
+    int backend;
+    int closed;
+    int depth;
+    int inflight;               /* # of requests not completed yet */
+    aio_request **slots;        /* requests not completed yet */
+    int *freeSlots;
+    int nfree;
+    aio_request *queued;        /* threads: not handed to the pool yet */
+    aio_request *queuedTail;
+    int nqueued;                /* # of requests not handed to the backend */
+    aio_request *done;          /* completed but not reported yet */
+    aio_request *doneTail;
+    void *data;                 /* backend specific */
+};
+
+static void aio_print(ScmObj obj, ScmPort *port,
+                      ScmWriteContext *ctx SCM_UNUSED)
+{
+    Scm_Printf(port, "#<aio-context %S%s %p>",
+               Scm_AioContextBackend(SCM_AIO_CONTEXT(obj)),
+               (SCM_AIO_CONTEXT(obj)->closed? " (closed)" : ""), obj);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_AioContextClass, aio_print);
+
+static ScmObj sym_io_uring = SCM_FALSE;
+static ScmObj sym_threads = SCM_FALSE;
+static ScmObj sym_sync = SCM_FALSE;
+
+ScmObj Scm_AioContextBackend(ScmAioContext *c)
+{
+    switch (c->backend) {
+    case AIO_BACKEND_IO_URING: return sym_io_uring;
+    case AIO_BACKEND_THREADS:  return sym_threads;
+    default:                   return sym_sync;
+    }
+}
+
+int Scm_AioInFlight(ScmAioContext *c)
+{
+    return c->inflight;
+}
+
+#if !defined(GAUCHE_WINDOWS)
+
+/* defined in net.c */
+extern ScmSocket *make_socket(Socket fd, int type);
+
+static void check_open(ScmAioContext *c)
+{
+    if (c->closed) Scm_Error("aio-context is already closed: %S", SCM_OBJ(c));
+}
+
+/* Called by the backends when a request is completed.  Must not
+   allocate, for it may be called with a lock held. */
+static void complete(ScmAioContext *c, aio_request *r)
+{
+    c->slots[r->slot] = NULL;
+    c->freeSlots[c->nfree++] = r->slot;
+    c->inflight--;
+    r->next = NULL;
+    if (c->doneTail) c->doneTail->next = r;
+    else c->done = r;
+    c->doneTail = r;
+}
+
+static aio_request *take_done(ScmAioContext *c)
+{
+    aio_request *r = c->done;
+    if (r) {
+        c->done = r->next;
+        if (c->done == NULL) c->doneTail = NULL;
+        r->next = NULL;
+    }
+    return r;
+}
+
+/* Carries out a request with a blocking system call. */
+static long perform(aio_request *r)
+{
+    long n;
+#define RETRY(expr)  do { n = (expr); } while (n < 0 && errno == EINTR)
+    switch (r->op) {
+    case AIO_READ:
+        if (r->offset < 0) RETRY(read(r->fd, r->ptr, r->len));
+        else RETRY(pread(r->fd, r->ptr, r->len, r->offset));
+        break;
+    case AIO_WRITE:
+        if (r->offset < 0) RETRY(write(r->fd, r->ptr, r->len));
+        else RETRY(pwrite(r->fd, r->ptr, r->len, r->offset));
+        break;
+    case AIO_ACCEPT:
+        r->peer->len = sizeof(r->peer->addr);
+        RETRY(accept(r->fd, (struct sockaddr*)&r->peer->addr, &r->peer->len));
+        break;
+    case AIO_CONNECT:
+        /* connect(2) interrupted by a signal continues asynchronously;
+           we can't just retry. */
+        n = connect(r->fd, (struct sockaddr*)r->ptr, (socklen_t)r->len);
+        break;
+    case AIO_FSYNC:
+        RETRY(fsync(r->fd));
+        break;
+    default:
+        errno = EINVAL;
+        n = -1;
+    }
+#undef RETRY
+    return (n < 0) ? -(long)errno : n;
+}
+
+/*------------------------------------------------------------
+ * io_uring backend
+ */
+
+#if defined(USE_IO_URING)
+
+typedef struct aio_ring_rec {
+    int fd;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+} aio_ring;
+
+static long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int ring_enter(aio_ring *ring, unsigned to_submit,
+                      unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring->fd, to_submit,
+                        min_complete, flags, NULL, 0);
+}
+
+static void ring_teardown(aio_ring *ring)
+{
+    if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing) {
+        munmap(ring->cqRing, ring->cqRingSize);
+    }
+    if (ring->sqRing != MAP_FAILED) munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+}
+
+/* Returns NULL with errno set if io_uring isn't usable. */
+static aio_ring *ring_setup(unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return NULL;
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        /* Before 5.6, which lacks some of the operations we use. */
+        close(fd);
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    aio_ring *ring = SCM_NEW_ATOMIC(aio_ring);
+    ring->fd = fd;
+    ring->sqRing = ring->cqRing = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes
+        + params.cq_entries*sizeof(struct io_uring_cqe);
+    ring->sqesSize = params.sq_entries*sizeof(struct io_uring_sqe);
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP);
+    if (single) {
+        if (ring->cqRingSize > ring->sqRingSize) {
+            ring->sqRingSize = ring->cqRingSize;
+        }
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ|PROT_WRITE,
+                        MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) goto fail;
+    if (single) {
+        ring->cqRing = ring->sqRing;
+    } else {
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ|PROT_WRITE,
+                            MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) goto fail;
+    }
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ|PROT_WRITE,
+                      MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    char *sq = (char*)ring->sqRing;
+    char *cq = (char*)ring->cqRing;
+    ring->sqHead  = (unsigned*)(sq + params.sq_off.head);
+    ring->sqTail  = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqMask  = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned*)(sq + params.sq_off.array);
+    ring->cqHead  = (unsigned*)(cq + params.cq_off.head);
+    ring->cqTail  = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqMask  = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes    = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return ring;
+
+  fail:
+    {
+        int e = errno;
+        ring_teardown(ring);
+        errno = e;
+    }
+    return NULL;
+}
+
+/* Returns a cleared SQE.  There's always room, since the number of
+   requests in flight doesn't exceed the depth, which is the number
+   of SQ entries we asked for. */
+static struct io_uring_sqe *ring_get_sqe(aio_ring *ring, uint64_t user_data)
+{
+    unsigned tail = *ring->sqTail;
+    unsigned idx = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = user_data;
+    ring->sqArray[idx] = idx;
+    __atomic_store_n(ring->sqTail, tail+1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static void ring_prep(ScmAioContext *c, aio_request *r)
+{
+    aio_ring *ring = (aio_ring*)c->data;
+    struct io_uring_sqe *sqe = ring_get_sqe(ring, (uint64_t)r->slot + 1);
+    sqe->fd = r->fd;
+    switch (r->op) {
+    case AIO_READ:
+    case AIO_WRITE:
+        sqe->opcode = (r->op == AIO_READ)? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->addr = (uint64_t)(uintptr_t)r->ptr;
+        sqe->len = (uint32_t)r->len;
+        sqe->off = (uint64_t)r->offset;
+        break;
+    case AIO_ACCEPT:
+        r->peer->len = sizeof(r->peer->addr);
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->addr = (uint64_t)(uintptr_t)&r->peer->addr;
+        sqe->addr2 = (uint64_t)(uintptr_t)&r->peer->len;
+        break;
+    case AIO_CONNECT:
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->addr = (uint64_t)(uintptr_t)r->ptr;
+        sqe->off = (uint64_t)r->len; /* addrlen */
+        break;
+    case AIO_FSYNC:
+        sqe->opcode = IORING_OP_FSYNC;
+        break;
+    }
+    c->nqueued++;
+}
+
+static int ring_flush(ScmAioContext *c)
+{
+    aio_ring *ring = (aio_ring*)c->data;
+    int total = 0;
+    while (c->nqueued > 0) {
+        int r;
+        SCM_SYSCALL(r, ring_enter(ring, c->nqueued, 0, 0));
+        if (r < 0) Scm_SysError("io_uring_enter failed");
+        if (r == 0) break;
+        c->nqueued -= r;
+        total += r;
+    }
+    return total;
+}
+
+static int ring_harvest(ScmAioContext *c)
+{
+    aio_ring *ring = (aio_ring*)c->data;
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    int n = 0;
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        uint64_t ud = cqe->user_data;
+        /* user_data 0 is for cancellation requests */
+        if (ud == 0 || ud > (uint64_t)c->depth) continue;
+        aio_request *r = c->slots[ud-1];
+        if (r == NULL) continue;
+        r->result = cqe->res;
+        complete(c, r);
+        n++;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+static void ring_wait(ScmAioContext *c, int min, int ms)
+{
+    aio_ring *ring = (aio_ring*)c->data;
+    int got = ring_harvest(c);
+    long deadline = (ms > 0)? now_ms() + ms : 0;
+    while (got < min && ms != 0) {
+        int r;
+        if (ms < 0) {
+            SCM_SYSCALL(r, ring_enter(ring, 0, min - got,
+                                      IORING_ENTER_GETEVENTS));
+            if (r < 0) Scm_SysError("io_uring_enter failed");
+        } else {
+            /* The ring fd becomes readable when CQEs are posted. */
+            long rest = deadline - now_ms();
+            struct pollfd pfd;
+            if (rest <= 0) break;
+            pfd.fd = ring->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            SCM_SYSCALL(r, poll(&pfd, 1, (int)rest));
+            if (r < 0) Scm_SysError("poll failed");
+        }
+        got += ring_harvest(c);
+    }
+}
+
+/* Cancels all requests and waits for them.  This is also called from
+   the finalizer, so we don't raise an error. */
+static void ring_close(ScmAioContext *c)
+{
+    aio_ring *ring = (aio_ring*)c->data;
+    while (c->nqueued > 0) {
+        int r = ring_enter(ring, c->nqueued, 0, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        c->nqueued -= r;
+    }
+    int ncancel = 0;
+    for (int i=0; i<c->depth; i++) {
+        if (c->slots[i] == NULL) continue;
+        struct io_uring_sqe *sqe = ring_get_sqe(ring, 0);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)i + 1;
+        ncancel++;
+    }
+    while (ncancel > 0) {
+        int r = ring_enter(ring, ncancel, 0, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        ncancel -= r;
+    }
+    ring_harvest(c);
+    while (c->inflight > 0) {
+        int r = ring_enter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+        if (r < 0 && errno != EINTR) break;
+        ring_harvest(c);
+    }
+    ring_teardown(ring);
+}
+
+#endif /*USE_IO_URING*/
+
+/*------------------------------------------------------------
+ * Thread pool backend
+ */
+
+#if defined(USE_AIO_THREADS)
+
+typedef struct aio_pool_rec {
+    ScmInternalMutex mutex;
+    ScmInternalCond jobs;       /* a job is queued, or the pool is closed */
+    ScmInternalCond finished;   /* a job is finished */
+    aio_request *queue;
+    aio_request *queueTail;
+    aio_request *done;
+    aio_request *doneTail;
+    int active;                 /* # of jobs the workers are performing */
+    int closed;
+} aio_pool;
+
+/* The workers only see the pool, so that the context can be collected
+   while they're waiting.  The requests they are working on are kept
+   alive by their stacks; pool_close waits for them anyway, for they
+   use the fds and buffers of the requests. */
+static void *pool_worker(void *data)
+{
+    aio_pool *pool = (aio_pool*)data;
+    (void)SCM_INTERNAL_MUTEX_LOCK(pool->mutex);
+    for (;;) {
+        while (pool->queue == NULL && !pool->closed) {
+            (void)SCM_INTERNAL_COND_WAIT(pool->jobs, pool->mutex);
+        }
+        aio_request *r = pool->queue;
+        if (r == NULL) break;
+        pool->queue = r->next;
+        if (pool->queue == NULL) pool->queueTail = NULL;
+        r->next = NULL;
+        pool->active++;
+        (void)SCM_INTERNAL_MUTEX_UNLOCK(pool->mutex);
+        r->result = perform(r);
+        (void)SCM_INTERNAL_MUTEX_LOCK(pool->mutex);
+        pool->active--;
+        if (pool->doneTail) pool->doneTail->next = r;
+        else pool->done = r;
+        pool->doneTail = r;
+        (void)SCM_INTERNAL_COND_BROADCAST(pool->finished);
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(pool->mutex);
+    return NULL;
+}
+
+static aio_pool *pool_new(int nthreads)
+{
+    aio_pool *pool = SCM_NEW(aio_pool);
+    SCM_INTERNAL_MUTEX_INIT(pool->mutex);
+    SCM_INTERNAL_COND_INIT(pool->jobs);
+    SCM_INTERNAL_COND_INIT(pool->finished);
+    pool->queue = pool->queueTail = NULL;
+    pool->done = pool->doneTail = NULL;
+    pool->active = 0;
+    pool->closed = FALSE;
+
+    /* Workers don't handle signals, like other threads (see threads.c). */
+    pthread_attr_t attr;
+    sigset_t set, omask;
+    int started = 0;
+    sigfillset(&set);
+#if defined(GAUCHE_PTHREAD_SIGNAL)
+    sigdelset(&set, GAUCHE_PTHREAD_SIGNAL);
+#endif /*GAUCHE_PTHREAD_SIGNAL*/
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_sigmask(SIG_SETMASK, &set, &omask);
+    for (int i=0; i<nthreads; i++) {
+        pthread_t t;
+        if (pthread_create(&t, &attr, pool_worker, pool) == 0) started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &omask, NULL);
+    pthread_attr_destroy(&attr);
+    return started > 0 ? pool : NULL;
+}
+
+static int pool_flush(ScmAioContext *c)
+{
+    aio_pool *pool = (aio_pool*)c->data;
+    int n = c->nqueued;
+    if (n == 0) return 0;
+    (void)SCM_INTERNAL_MUTEX_LOCK(pool->mutex);
+    if (pool->queueTail) pool->queueTail->next = c->queued;
+    else pool->queue = c->queued;
+    pool->queueTail = c->queuedTail;
+    (void)SCM_INTERNAL_COND_BROADCAST(pool->jobs);
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(pool->mutex);
+    c->queued = c->queuedTail = NULL;
+    c->nqueued = 0;
+    return n;
+}
+
+/* Must be called with the pool's mutex. */
+static int pool_harvest(ScmAioContext *c)
+{
+    aio_pool *pool = (aio_pool*)c->data;
+    int n = 0;
+    while (pool->done) {
+        aio_request *r = pool->done;
+        pool->done = r->next;
+        complete(c, r);
+        n++;
+    }
+    pool->doneTail = NULL;
+    return n;
+}
+
+static void pool_wait(ScmAioContext *c, int min, int ms)
+{
+    aio_pool *pool = (aio_pool*)c->data;
+    struct timespec deadline;
+    int got = 0;
+    if (ms > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += ms / 1000;
+        deadline.tv_nsec += (long)(ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+    (void)SCM_INTERNAL_MUTEX_LOCK(pool->mutex);
+    for (;;) {
+        got += pool_harvest(c);
+        if (got >= min || ms == 0) break;
+        if (ms < 0) {
+            (void)SCM_INTERNAL_COND_WAIT(pool->finished, pool->mutex);
+        } else {
+            int r = SCM_INTERNAL_COND_TIMEDWAIT(pool->finished, pool->mutex,
+                                                &deadline);
+            if (r == SCM_INTERNAL_COND_TIMEDOUT) {
+                pool_harvest(c);
+                break;
+            }
+        }
+    }
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(pool->mutex);
+}
+
+/* Drops the jobs the workers haven't picked up, and waits for the ones
+   being performed.  A blocking call can't be cancelled, so a read on
+   a socket makes us wait until the data arrives or the peer closes. */
+static void pool_close(ScmAioContext *c)
+{
+    aio_pool *pool = (aio_pool*)c->data;
+    (void)SCM_INTERNAL_MUTEX_LOCK(pool->mutex);
+    pool->closed = TRUE;
+    pool->queue = pool->queueTail = NULL;
+    (void)SCM_INTERNAL_COND_BROADCAST(pool->jobs);
+    while (pool->active > 0) {
+        (void)SCM_INTERNAL_COND_WAIT(pool->finished, pool->mutex);
+    }
+    pool->done = pool->doneTail = NULL;
+    (void)SCM_INTERNAL_MUTEX_UNLOCK(pool->mutex);
+}
+
+#endif /*USE_AIO_THREADS*/
+
+/*------------------------------------------------------------
+ * Dispatching to the backends
+ */
+
+static void aio_enqueue(ScmAioContext *c, aio_request *r)
+{
+    switch (c->backend) {
+#if defined(USE_IO_URING)
+    case AIO_BACKEND_IO_URING:
+        ring_prep(c, r);
+        break;
+#endif /*USE_IO_URING*/
+#if defined(USE_AIO_THREADS)
+    case AIO_BACKEND_THREADS:
+        r->next = NULL;
+        if (c->queuedTail) c->queuedTail->next = r;
+        else c->queued = r;
+        c->queuedTail = r;
+        c->nqueued++;
+        break;
+#endif /*USE_AIO_THREADS*/
+    default:
+        r->result = perform(r);
+        complete(c, r);
+    }
+}
+
+static int aio_flush(ScmAioContext *c)
+{
+    switch (c->backend) {
+#if defined(USE_IO_URING)
+    case AIO_BACKEND_IO_URING: return ring_flush(c);
+#endif /*USE_IO_URING*/
+#if defined(USE_AIO_THREADS)
+    case AIO_BACKEND_THREADS:  return pool_flush(c);
+#endif /*USE_AIO_THREADS*/
+    default: return 0;
+    }
+}
+
+/* Submits the queued requests, and waits until MIN requests are
+   completed or MS milliseconds passes (MS < 0 to wait indefinitely).
+   The completed requests are appended to c->done. */
+static void aio_reap(ScmAioContext *c, int min, int ms)
+{
+    aio_flush(c);
+    if (min > c->inflight) min = c->inflight;
+    switch (c->backend) {
+#if defined(USE_IO_URING)
+    case AIO_BACKEND_IO_URING: ring_wait(c, min, ms); break;
+#endif /*USE_IO_URING*/
+#if defined(USE_AIO_THREADS)
+    case AIO_BACKEND_THREADS:  pool_wait(c, min, ms); break;
+#endif /*USE_AIO_THREADS*/
+    default: break;             /* sync requests are already done */
+    }
+}
+
+static void aio_close(ScmAioContext *c)
+{
+    if (c->closed) return;
+    c->closed = TRUE;
+    switch (c->backend) {
+#if defined(USE_IO_URING)
+    case AIO_BACKEND_IO_URING: ring_close(c); break;
+#endif /*USE_IO_URING*/
+#if defined(USE_AIO_THREADS)
+    case AIO_BACKEND_THREADS:  pool_close(c); break;
+#endif /*USE_AIO_THREADS*/
+    default: break;
+    }
+    c->data = NULL;
+    c->queued = c->queuedTail = NULL;
+    c->done = c->doneTail = NULL;
+    for (int i=0; i<c->depth; i++) c->slots[i] = NULL;
+    c->inflight = c->nqueued = 0;
+}
+
+static void aio_finalize(ScmObj obj, void *data SCM_UNUSED)
+{
+    aio_close(SCM_AIO_CONTEXT(obj));
+}
+
+/*------------------------------------------------------------
+ * Scheme interface
+ */
+
+ScmObj Scm_MakeAioContext(int depth, ScmObj backend)
+{
+    int want;
+    if (SCM_FALSEP(backend))              want = AIO_BACKEND_AUTO;
+    else if (SCM_EQ(backend, sym_io_uring)) want = AIO_BACKEND_IO_URING;
+    else if (SCM_EQ(backend, sym_threads))  want = AIO_BACKEND_THREADS;
+    else if (SCM_EQ(backend, sym_sync))     want = AIO_BACKEND_SYNC;
+    else {
+        Scm_Error("aio backend must be one of #f, io-uring, threads "
+                  "or sync, but got: %S", backend);
+        want = AIO_BACKEND_AUTO; /* dummy */
+    }
+    if (depth <= 0 || depth > AIO_MAX_DEPTH) {
+        Scm_Error("aio-context depth out of range: %d", depth);
+    }
+
+    ScmAioContext *c = SCM_NEW(ScmAioContext);
+    SCM_SET_CLASS(c, SCM_CLASS_AIO_CONTEXT);
+    c->backend = AIO_BACKEND_SYNC;
+    c->closed = FALSE;
+    c->depth = depth;
+    c->inflight = 0;
+    c->slots = SCM_NEW_ARRAY(aio_request*, depth);
+    c->freeSlots = SCM_NEW_ATOMIC_ARRAY(int, depth);
+    for (int i=0; i<depth; i++) {
+        c->slots[i] = NULL;
+        c->freeSlots[i] = depth - i - 1;
+    }
+    c->nfree = depth;
+    c->queued = c->queuedTail = NULL;
+    c->nqueued = 0;
+    c->done = c->doneTail = NULL;
+    c->data = NULL;
+
+#if defined(USE_IO_URING)
+    if (want == AIO_BACKEND_AUTO || want == AIO_BACKEND_IO_URING) {
+        aio_ring *ring = ring_setup((unsigned)depth);
+        if (ring) {
+            c->backend = AIO_BACKEND_IO_URING;
+            c->data = ring;
+        } else if (want == AIO_BACKEND_IO_URING) {
+            Scm_SysError("io_uring isn't available");
+        }
+    }
+#endif /*USE_IO_URING*/
+    if (c->data == NULL
+        && (want == AIO_BACKEND_AUTO || want == AIO_BACKEND_THREADS)) {
+#if defined(USE_AIO_THREADS)
+        aio_pool *pool = pool_new(depth < AIO_MAX_THREADS ? depth
+                                  : AIO_MAX_THREADS);
+        if (pool) {
+            c->backend = AIO_BACKEND_THREADS;
+            c->data = pool;
+        } else if (want == AIO_BACKEND_THREADS) {
+            Scm_Error("couldn't start aio worker threads");
+        }
+#else  /*!USE_AIO_THREADS*/
+        if (want == AIO_BACKEND_THREADS) {
+            Scm_Error("threads aio backend isn't available");
+        }
+#endif /*!USE_AIO_THREADS*/
+    }
+    if (want == AIO_BACKEND_IO_URING && c->backend != AIO_BACKEND_IO_URING) {
+        Scm_Error("io_uring isn't supported on this platform");
+    }
+    Scm_RegisterFinalizer(SCM_OBJ(c), aio_finalize, NULL);
+    return SCM_OBJ(c);
+}
+
+static int target_fd(ScmObj target)
+{
+    if (SCM_SOCKETP(target)) {
+        Socket fd = SCM_SOCKET(target)->fd;
+        if (SOCKET_CLOSED(fd)) {
+            Scm_Error("attempt to do I/O on a closed socket: %S", target);
+        }
+        return (int)fd;
+    }
+    return Scm_GetPortFd(target, TRUE);
+}
+
+/* Allocates a request and its slot.  If the context is full, waits
+   for a request to complete; its completion is reported by the next
+   aio-wait. */
+static aio_request *new_request(ScmAioContext *c, int op, int fd, ScmObj tag)
+{
+    check_open(c);
+    if (c->nfree == 0) aio_reap(c, 1, -1);
+    aio_request *r = SCM_NEW(aio_request);
+    r->op = op;
+    r->fd = fd;
+    r->ptr = NULL;
+    r->len = 0;
+    r->offset = -1;
+    r->obj = r->addr = SCM_FALSE;
+    r->tag = tag;
+    r->peer = NULL;
+    r->result = 0;
+    r->next = NULL;
+    r->slot = c->freeSlots[--c->nfree];
+    c->slots[r->slot] = r;
+    c->inflight++;
+    return r;
+}
+
+static ScmObj aio_rw(ScmAioContext *c, int op, ScmObj target,
+                     ScmUVector *buf, off_t offset, ScmObj tag)
+{
+    int fd = target_fd(target);
+    ScmSize len = Scm_UVectorSizeInBytes(buf);
+    if (op == AIO_READ) SCM_UVECTOR_CHECK_MUTABLE(buf);
+    aio_request *r = new_request(c, op, fd, tag);
+    r->ptr = SCM_UVECTOR_ELEMENTS(buf);
+    r->len = (len > AIO_MAX_LEN)? AIO_MAX_LEN : (size_t)len;
+    r->offset = (offset < 0)? -1 : offset;
+    r->obj = SCM_OBJ(buf);
+    aio_enqueue(c, r);
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_AioRead(ScmAioContext *c, ScmObj target, ScmUVector *buf,
+                   off_t offset, ScmObj tag)
+{
+    return aio_rw(c, AIO_READ, target, buf, offset, tag);
+}
+
+ScmObj Scm_AioWrite(ScmAioContext *c, ScmObj target, ScmUVector *buf,
+                    off_t offset, ScmObj tag)
+{
+    return aio_rw(c, AIO_WRITE, target, buf, offset, tag);
+}
+
+ScmObj Scm_AioAccept(ScmAioContext *c, ScmSocket *sock, ScmObj tag)
+{
+    aio_request *r = new_request(c, AIO_ACCEPT, target_fd(SCM_OBJ(sock)), tag);
+    r->peer = SCM_NEW_ATOMIC(aio_peer);
+    r->obj = SCM_OBJ(sock);
+    aio_enqueue(c, r);
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_AioConnect(ScmAioContext *c, ScmSocket *sock, ScmSockAddr *addr,
+                      ScmObj tag)
+{
+    aio_request *r = new_request(c, AIO_CONNECT, target_fd(SCM_OBJ(sock)),
+                                 tag);
+    r->ptr = &addr->addr;
+    r->len = addr->addrlen;
+    r->obj = SCM_OBJ(sock);
+    r->addr = SCM_OBJ(addr);
+    aio_enqueue(c, r);
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_AioFsync(ScmAioContext *c, ScmObj target, ScmObj tag)
+{
+    aio_request *r = new_request(c, AIO_FSYNC, target_fd(target), tag);
+    aio_enqueue(c, r);
+    return SCM_UNDEFINED;
+}
+
+int Scm_AioSubmit(ScmAioContext *c)
+{
+    check_open(c);
+    return aio_flush(c);
+}
+
+static ScmObj request_result(aio_request *r)
+{
+    if (r->result < 0) return Scm_MakeInteger(r->result);
+    switch (r->op) {
+    case AIO_ACCEPT: {
+        ScmSocket *s = make_socket((Socket)r->result,
+                                   SCM_SOCKET(r->obj)->type);
+        s->address = SCM_SOCKADDR(Scm_MakeSockAddr(NULL,
+                                                   (struct sockaddr*)&r->peer->addr,
+                                                   r->peer->len));
+        s->status = SCM_SOCKET_STATUS_CONNECTED;
+        return SCM_OBJ(s);
+    }
+    case AIO_CONNECT: {
+        ScmSocket *s = SCM_SOCKET(r->obj);
+        s->address = SCM_SOCKADDR(r->addr);
+        s->status = SCM_SOCKET_STATUS_CONNECTED;
+        return SCM_OBJ(s);
+    }
+    default:
+        return Scm_MakeInteger(r->result);
+    }
+}
+
+ScmObj Scm_AioWait(ScmAioContext *c, int min, ScmObj timeout)
+{
+    int ms = Scm__NetTimeoutMs(timeout), ndone = 0;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    aio_request *r;
+    check_open(c);
+    for (r = c->done; r; r = r->next) ndone++;
+    aio_reap(c, (min > ndone)? min - ndone : 0, ms);
+    while ((r = take_done(c)) != NULL) {
+        SCM_APPEND1(h, t, Scm_Cons(r->tag, request_result(r)));
+    }
+    return h;
+}
+
+ScmObj Scm_AioContextClose(ScmAioContext *c)
+{
+    aio_close(c);
+    return SCM_UNDEFINED;
+}
+
+/*------------------------------------------------------------
+ * Read-ahead input port
+ *
+ *   Keeps DEPTH reads of BLOCKSIZE bytes in flight, at consecutive
+ *   offsets of a regular file, so the kernel can work on the next
+ *   blocks while we consume the current one.  The filler copies the
+ *   data from the completed block into the port buffer, and reuses
+ *   the block for the read after the ones in flight.  For non-seekable
+ *   files we read one block at a time from the current position.
+ */
+
+enum {
+    BLOCK_READING,
+    BLOCK_READY
+};
+
+typedef struct aio_block_rec {
+    char *buf;
+    off_t offset;               /* file offset of buf[0] */
+    ScmSize len;                /* requested bytes */
+    ScmSize size;               /* bytes read */
+    ScmSize pos;                /* bytes consumed */
+    long result;
+    int state;
+} aio_block;
+
+typedef struct aio_port_rec {
+    ScmAioContext *ctx;
+    int fd;
+    int stream;                 /* non-seekable */
+    int nblocks;
+    ScmSize blockSize;
+    aio_block *blocks;
+    int cur;                    /* the block to be consumed next */
+    off_t next;                 /* file offset of the next block to read */
+    int eof;
+} aio_port;
+
+#define AIO_PORT_DATA(p)  ((aio_port*)(p)->src.buf.data)
+
+static void submit_block(aio_port *a, int k, off_t offset, ScmSize len)
+{
+    aio_block *b = &a->blocks[k];
+    aio_request *r = new_request(a->ctx, AIO_READ, a->fd, SCM_MAKE_INT(k));
+    b->offset = offset;
+    b->len = len;
+    b->size = b->pos = 0;
+    b->result = 0;
+    b->state = BLOCK_READING;
+    r->ptr = b->buf;
+    r->len = (size_t)len;
+    r->offset = a->stream ? -1 : offset;
+    aio_enqueue(a->ctx, r);
+}
+
+static void wait_blocks(aio_port *a)
+{
+    aio_request *r;
+    aio_reap(a->ctx, 1, -1);
+    while ((r = take_done(a->ctx)) != NULL) {
+        aio_block *b = &a->blocks[SCM_INT_VALUE(r->tag)];
+        b->result = r->result;
+        b->size = (r->result > 0)? r->result : 0;
+        b->state = BLOCK_READY;
+    }
+}
+
+static ScmSize aioport_filler(ScmPort *p, ScmSize cnt)
+{
+    aio_port *a = AIO_PORT_DATA(p);
+    while (!a->eof) {
+        aio_block *b = &a->blocks[a->cur];
+        if (b->state == BLOCK_READING) {
+            wait_blocks(a);
+            continue;
+        }
+        if (b->result < 0) {
+            errno = (int)-b->result;
+            Scm_SysError("read failed on %S", SCM_OBJ(p));
+        }
+        if (b->result == 0) {
+            a->eof = TRUE;
+            break;
+        }
+        if (b->pos < b->size) {
+            ScmSize n = b->size - b->pos;
+            if (n > cnt) n = cnt;
+            memcpy(p->src.buf.end, b->buf + b->pos, n);
+            b->pos += n;
+            return n;
+        }
+        /* The block is consumed.  Reuse it. */
+        if (!a->stream && b->size < b->len) {
+            /* Short read; read the rest of the range. */
+            submit_block(a, a->cur, b->offset + b->size, b->len - b->size);
+        } else {
+            submit_block(a, a->cur, a->next, a->blockSize);
+            a->next += a->blockSize;
+            a->cur = (a->cur + 1) % a->nblocks;
+        }
+        aio_flush(a->ctx);
+    }
+    return 0;
+}
+
+static void aioport_closer(ScmPort *p)
+{
+    aio_port *a = AIO_PORT_DATA(p);
+    aio_close(a->ctx);          /* waits for the reads in flight */
+    if (a->fd >= 0) {
+        close(a->fd);
+        a->fd = -1;
+    }
+}
+
+static int aioport_filenum(ScmPort *p)
+{
+    return AIO_PORT_DATA(p)->fd;
+}
+
+ScmObj Scm_OpenAioInputFile(ScmString *path, int depth, ScmSize blockSize,
+                            ScmObj backend)
+{
+    if (depth <= 0 || depth > AIO_MAX_DEPTH) {
+        Scm_Error("depth out of range: %d", depth);
+    }
+    if (blockSize <= 0 || blockSize > AIO_MAX_LEN) {
+        Scm_Error("block size out of range: %ld", blockSize);
+    }
+    int fd, r;
+    struct stat st;
+    SCM_SYSCALL(fd, open(Scm_GetStringConst(path), O_RDONLY));
+    if (fd < 0) Scm_SysError("couldn't open input file: %S", SCM_OBJ(path));
+    SCM_SYSCALL(r, fstat(fd, &st));
+    if (r < 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        Scm_SysError("fstat failed: %S", SCM_OBJ(path));
+    }
+
+    aio_port *a = SCM_NEW(aio_port);
+    a->fd = fd;
+    a->stream = !S_ISREG(st.st_mode);
+    a->nblocks = a->stream ? 1 : depth;
+    a->blockSize = blockSize;
+    a->blocks = SCM_NEW_ARRAY(aio_block, a->nblocks);
+    for (int i=0; i<a->nblocks; i++) {
+        a->blocks[i].buf = SCM_NEW_ATOMIC2(char*, blockSize);
+    }
+    a->cur = 0;
+    a->next = 0;
+    a->eof = FALSE;
+    ScmObj ctx = SCM_FALSE;
+    SCM_UNWIND_PROTECT {
+        ctx = Scm_MakeAioContext(a->nblocks, backend);
+    } SCM_WHEN_ERROR {
+        close(fd);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    a->ctx = SCM_AIO_CONTEXT(ctx);
+    for (int i=0; i<a->nblocks; i++) {
+        submit_block(a, i, a->next, blockSize);
+        a->next += blockSize;
+    }
+    aio_flush(a->ctx);
+
+    ScmPortBuffer bufrec;
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char*, blockSize);
+    bufrec.size = blockSize;
+    bufrec.filler = aioport_filler;
+    bufrec.flusher = NULL;
+    bufrec.closer = aioport_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = aioport_filenum;
+    bufrec.seeker = NULL;
+    bufrec.data = a;
+    return Scm_MakeBufferedPort(SCM_CLASS_PORT, SCM_OBJ(path),
+                                SCM_PORT_INPUT, TRUE, &bufrec);
+}
+
+#else  /*GAUCHE_WINDOWS*/
+
+static void aio_unsupported(void)
+{
+    Scm_Error("aio-context is not supported on this platform.");
+}
+
+ScmObj Scm_MakeAioContext(int depth SCM_UNUSED, ScmObj backend SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_AioRead(ScmAioContext *c SCM_UNUSED, ScmObj target SCM_UNUSED,
+                   ScmUVector *buf SCM_UNUSED, off_t offset SCM_UNUSED,
+                   ScmObj tag SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_AioWrite(ScmAioContext *c SCM_UNUSED, ScmObj target SCM_UNUSED,
+                    ScmUVector *buf SCM_UNUSED, off_t offset SCM_UNUSED,
+                    ScmObj tag SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_AioAccept(ScmAioContext *c SCM_UNUSED, ScmSocket *sock SCM_UNUSED,
+                     ScmObj tag SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_AioConnect(ScmAioContext *c SCM_UNUSED, ScmSocket *sock SCM_UNUSED,
+                      ScmSockAddr *addr SCM_UNUSED, ScmObj tag SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_AioFsync(ScmAioContext *c SCM_UNUSED, ScmObj target SCM_UNUSED,
+                    ScmObj tag SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+int Scm_AioSubmit(ScmAioContext *c SCM_UNUSED)
+{
+    aio_unsupported();
+    return 0;                   /* dummy */
+}
+
+ScmObj Scm_AioWait(ScmAioContext *c SCM_UNUSED, int min SCM_UNUSED,
+                   ScmObj timeout SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_AioContextClose(ScmAioContext *c SCM_UNUSED)
+{
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_OpenAioInputFile(ScmString *path SCM_UNUSED, int depth SCM_UNUSED,
+                            ScmSize blockSize SCM_UNUSED,
+                            ScmObj backend SCM_UNUSED)
+{
+    aio_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+#endif /*GAUCHE_WINDOWS*/
+
+/*==================================================================
+ * initialization stuff
+ */
+
+void Scm_Init_NetAio(ScmModule *mod)
+{
+    sym_io_uring = SCM_INTERN("io-uring");
+    sym_threads = SCM_INTERN("threads");
+    sym_sync = SCM_INTERN("sync");
+    Scm_InitStaticClass(&Scm_AioContextClass, "<aio-context>", mod, NULL, 0);
+}
@@ -268,6 +268,8 @@ extern ScmObj Scm_SocketGetPeerName(ScmSocket *s);
 extern ScmObj Scm_SocketSend(ScmSocket *s, ScmObj msg, int flags);
 extern ScmObj Scm_SocketSendTo(ScmSocket *s, ScmObj msg, ScmSockAddr *to, int flags);
 extern ScmObj Scm_SocketSendMsg(ScmSocket *s, ScmObj msg, int flags);
+extern ScmObj Scm_SocketSendFile(ScmSocket *s, ScmObj file, off_t offset,
+                                  ScmSize size);
 extern ScmObj Scm_SocketRecv(ScmSocket *s, int bytes, int flags);
 extern ScmObj Scm_SocketRecvX(ScmSocket *s, ScmUVector *buf, int flags);
 extern ScmObj Scm_SocketRecvFrom(ScmSocket *s, int bytes, int flags);
@@ -284,6 +286,61 @@ extern ScmObj Scm_SocketGetOpt(ScmSocket *s, int level,
                                int option, int resulttype);
 extern ScmObj Scm_SocketIoctl(ScmSocket *s, u_long requiest, ScmObj data);
 
+/*==================================================================
+ * Fd poller
+ */
+
+typedef struct ScmFdPollerRec ScmFdPoller;
+
+SCM_CLASS_DECL(Scm_FdPollerClass);
+#define SCM_CLASS_FD_POLLER   (&Scm_FdPollerClass)
+#define SCM_FD_POLLER(obj)    ((ScmFdPoller*)obj)
+#define SCM_FD_POLLER_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_FD_POLLER)
+
+enum {
+    SCM_FD_POLLER_READ = (1L<<0),
+    SCM_FD_POLLER_WRITE = (1L<<1)
+};
+
+extern ScmObj Scm_MakeFdPoller(void);
+extern ScmObj Scm_FdPollerAdd(ScmFdPoller *p, int fd, ScmObj flags);
+extern ScmObj Scm_FdPollerDelete(ScmFdPoller *p, int fd);
+extern ScmObj Scm_FdPollerWait(ScmFdPoller *p, ScmObj timeout);
+extern ScmObj Scm_FdPollerWakeup(ScmFdPoller *p);
+extern ScmObj Scm_FdPollerClose(ScmFdPoller *p);
+
+/* Timeout argument of fd-poller-wait and aio-wait, in milliseconds */
+extern int Scm__NetTimeoutMs(ScmObj timeout);
+
+/*==================================================================
+ * Async I/O context
+ */
+
+typedef struct ScmAioContextRec ScmAioContext;
+
+SCM_CLASS_DECL(Scm_AioContextClass);
+#define SCM_CLASS_AIO_CONTEXT   (&Scm_AioContextClass)
+#define SCM_AIO_CONTEXT(obj)    ((ScmAioContext*)obj)
+#define SCM_AIO_CONTEXT_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_AIO_CONTEXT)
+
+extern ScmObj Scm_MakeAioContext(int depth, ScmObj backend);
+extern ScmObj Scm_AioContextBackend(ScmAioContext *c);
+extern int    Scm_AioInFlight(ScmAioContext *c);
+extern ScmObj Scm_AioRead(ScmAioContext *c, ScmObj target, ScmUVector *buf,
+                          off_t offset, ScmObj tag);
+extern ScmObj Scm_AioWrite(ScmAioContext *c, ScmObj target, ScmUVector *buf,
+                           off_t offset, ScmObj tag);
+extern ScmObj Scm_AioAccept(ScmAioContext *c, ScmSocket *sock, ScmObj tag);
+extern ScmObj Scm_AioConnect(ScmAioContext *c, ScmSocket *sock,
+                             ScmSockAddr *addr, ScmObj tag);
+extern ScmObj Scm_AioFsync(ScmAioContext *c, ScmObj target, ScmObj tag);
+extern int    Scm_AioSubmit(ScmAioContext *c);
+extern ScmObj Scm_AioWait(ScmAioContext *c, int min, ScmObj timeout);
+extern ScmObj Scm_AioContextClose(ScmAioContext *c);
+
+extern ScmObj Scm_OpenAioInputFile(ScmString *path, int depth,
+                                   ScmSize blockSize, ScmObj backend);
+
 /*==================================================================
  * Netdb interface
  */
@@ -320,7 +320,14 @@ ScmObj Scm_SocketConnect(ScmSocket *sock, ScmSockAddr *addr)
     CLOSE_CHECK(sock->fd, "connect to", sock);
     SCM_SYSCALL(r, connect(sock->fd, &addr->addr, addr->addrlen));
     if (r < 0) {
-        Scm_SysError("connect failed to %S", addr);
+#if !defined(GAUCHE_WINDOWS)
+        /* A non-blocking socket can't connect immediately.  The caller
+           should wait for the socket to be writable, then call connect
+           again to finish it; that one gets EISCONN. */
+        if (errno == EINPROGRESS || errno == EALREADY) return SCM_FALSE;
+        if (!(errno == EISCONN && sock->status == SCM_SOCKET_STATUS_NONE))
+#endif /*!GAUCHE_WINDOWS*/
+            Scm_SysError("connect failed to %S", addr);
     }
     sock->address = addr;
     sock->status = SCM_SOCKET_STATUS_CONNECTED;
@@ -412,6 +419,100 @@ ScmObj Scm_SocketSendMsg(ScmSocket *sock, ScmObj msg, int flags)
 #endif /*GAUCHE_WINDOWS*/
 }
 
+#if !GAUCHE_WINDOWS
+/* The fallback of Scm_SocketSendFile, when the kernel can't do it. */
+static ScmSize send_file_buffered(int sockfd, int fd, off_t offset,
+                                  ScmSize size)
+{
+    char buf[8192];
+    ScmSize total = 0;
+    while (size < 0 || total < size) {
+        ScmSize n = sizeof(buf);
+        if (size >= 0 && size - total < n) n = size - total;
+        ssize_t nr;
+        SCM_SYSCALL(nr, pread(fd, buf, n, offset + total));
+        if (nr < 0) Scm_SysError("read failed on fd %d", fd);
+        if (nr == 0) break;
+        for (ssize_t k = 0; k < nr;) {
+            ssize_t ns;
+            SCM_SYSCALL(ns, send(sockfd, buf + k, nr - k, 0));
+            if (ns < 0) Scm_SysError("send(2) failed");
+            k += ns;
+        }
+        total += nr;
+    }
+    return total;
+}
+
+static ScmSize send_file_fd(ScmSocket *sock, int fd, off_t offset,
+                            ScmSize size)
+{
+    /* What is written to the socket port must go out first. */
+    if (sock->outPort) Scm_Flush(sock->outPort);
+    int stopped = FALSE;
+    ScmSize total = Scm_SysTransferFd(sock->fd, fd, &offset, size, &stopped);
+    if (stopped) {
+        total += send_file_buffered(sock->fd, fd, offset,
+                                    (size < 0) ? -1 : size - total);
+    }
+    return total;
+}
+
+/* Like send_file_fd, but closes FD afterwards. */
+static ScmSize send_file_owned_fd(ScmSocket *sock, int fd, off_t offset,
+                                  ScmSize size)
+{
+    ScmSize total = 0;
+    SCM_UNWIND_PROTECT {
+        total = send_file_fd(sock, fd, offset, size);
+    } SCM_WHEN_ERROR {
+        close(fd);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    close(fd);
+    return total;
+}
+#endif /*!GAUCHE_WINDOWS*/
+
+/* Sends SIZE bytes (up to the end if SIZE is negative) from OFFSET of
+   FILE to SOCK, where FILE is a pathname, an input port or a file
+   descriptor of a seekable file.  The file position of FILE isn't changed.
+   If possible, the data is moved within the kernel (sendfile(2) or
+   splice(2); see Scm_SysTransferFd).  Returns the number of bytes sent. */
+ScmObj Scm_SocketSendFile(ScmSocket *sock, ScmObj file, off_t offset,
+                          ScmSize size)
+{
+#if !GAUCHE_WINDOWS
+    CLOSE_CHECK(sock->fd, "send to", sock);
+    if (offset < 0) {
+        Scm_Error("offset must be nonnegative, but got %S",
+                  Scm_OffsetToInteger(offset));
+    }
+    if (SCM_STRINGP(file)) {
+        int fd;
+        SCM_SYSCALL(fd, open(Scm_GetStringConst(SCM_STRING(file)), O_RDONLY));
+        if (fd < 0) Scm_SysError("couldn't open %S", file);
+        return Scm_MakeInteger(send_file_owned_fd(sock, fd, offset, size));
+    } else if (SCM_IPORTP(file)) {
+        int fd = Scm_PortFileNo(SCM_PORT(file));
+        if (fd < 0) Scm_Error("port isn't associated to fd: %S", file);
+        return Scm_MakeInteger(send_file_fd(sock, fd, offset, size));
+    } else if (SCM_INTP(file) && SCM_INT_VALUE(file) >= 0) {
+        int fd = (int)SCM_INT_VALUE(file);
+        return Scm_MakeInteger(send_file_fd(sock, fd, offset, size));
+    }
+    Scm_TypeError("file", "pathname, input port or file descriptor", file);
+    return SCM_UNDEFINED;       /* dummy */
+#else  /*GAUCHE_WINDOWS*/
+    (void)sock;   /* suppress unused var warning */
+    (void)file;   /* suppress unused var warning */
+    (void)offset; /* suppress unused var warning */
+    (void)size;   /* suppress unused var warning */
+    Scm_Error("socket-sendfile is not implemented on this platform.");
+    return SCM_UNDEFINED;       /* dummy */
+#endif /*GAUCHE_WINDOWS*/
+}
+
 ScmObj Scm_SocketRecv(ScmSocket *sock, int bytes, int flags)
 {
     int r;
@@ -845,6 +946,8 @@ const char *inet_ntop(int af, const void *src, char *dst, socklen_t size)
 
 extern void Scm_Init_NetAddr(ScmModule *mod);
 extern void Scm_Init_NetDB(ScmModule *mod);
+extern void Scm_Init_NetPoller(ScmModule *mod);
+extern void Scm_Init_NetAio(ScmModule *mod);
 extern void Scm_Init_netlib(ScmModule *mod);
 extern void Scm_Init_netaux(void);
 
@@ -858,6 +961,8 @@ SCM_EXTENSION_ENTRY void Scm_Init_gauche__net(void)
     Scm_InitStaticClass(&Scm_SocketClass, "<socket>", mod, NULL, 0);
     Scm_Init_NetAddr(mod);
     Scm_Init_NetDB(mod);
+    Scm_Init_NetPoller(mod);
+    Scm_Init_NetAio(mod);
     Scm_Init_netlib(mod);
     Scm_Init_netaux();
 }
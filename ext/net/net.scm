@@ -47,7 +47,7 @@
           socket-shutdown socket-close socket-bind socket-connect socket-fd
           socket-listen socket-accept socket-setsockopt socket-getsockopt
           socket-getsockname socket-getpeername socket-ioctl
-          socket-send socket-sendto socket-sendmsg socket-buildmsg
+          socket-send socket-sendto socket-sendmsg socket-sendfile socket-buildmsg
           socket-recv socket-recv! socket-recvfrom socket-recvfrom!
           <sockaddr> <sockaddr-in> <sockaddr-un> make-sockaddrs
           sockaddr-name sockaddr-family sockaddr-addr sockaddr-port
@@ -59,6 +59,11 @@
           sys-htonl sys-htons sys-ntohl sys-ntohs
           inet-checksum
           inet-string->address inet-string->address! inet-address->string
+          <fd-poller> make-fd-poller fd-poller-add! fd-poller-delete!
+          fd-poller-wait fd-poller-wakeup fd-poller-close
+          <aio-context> make-aio-context aio-context-backend aio-in-flight
+          aio-read! aio-write! aio-accept! aio-connect! aio-fsync!
+          aio-submit aio-wait aio-context-close open-aio-input-file
 
           ;; connection protocol
           connection-self-address connection-peer-address
@@ -86,8 +91,8 @@
  IP_TTL IP_HDRINCL IP_RECVERR IP_MTU_DISCOVER IP_MTU
  IP_ROUTER_ALERT IP_MULTICAST_TTL IP_MULTICAST_LOOP
  IP_ADD_MEMBERSHIP IP_DROP_MEMBERSHIP IP_MULTICAST_IF
- MSG_CTRUNC MSG_DONTROUTE MSG_EOR MSG_OOB MSG_PEEK MSG_TRUNC
- MSG_WAITALL)
+ MSG_CTRUNC MSG_DONTROUTE MSG_DONTWAIT MSG_EOR MSG_OOB MSG_PEEK
+ MSG_TRUNC MSG_WAITALL)
 
 ;; Netdevice control.  OS specific.
 (export-if-defined
@@ -44,6 +44,12 @@
    "Scm_SockAddrP" "SCM_SOCKADDR")
 
  (define-type <socket> "ScmSocket*")
+
+ (define-type <fd-poller> "ScmFdPoller*" "fd poller"
+   "SCM_FD_POLLER_P" "SCM_FD_POLLER")
+
+ (define-type <aio-context> "ScmAioContext*" "aio context"
+   "SCM_AIO_CONTEXT_P" "SCM_AIO_CONTEXT")
  )
 
 ;;----------------------------------------------------------
@@ -146,6 +152,7 @@
 
 (define-enum-conditionally MSG_CTRUNC)
 (define-enum-conditionally MSG_DONTROUTE)
+(define-enum-conditionally MSG_DONTWAIT)
 (define-enum-conditionally MSG_EOR)
 (define-enum-conditionally MSG_OOB)
 (define-enum-conditionally MSG_PEEK)
@@ -253,6 +260,11 @@
 (define-cproc socket-sendmsg (sock::<socket> msg :optional (flags::<fixnum> 0))
   Scm_SocketSendMsg)
 
+(define-cproc socket-sendfile (sock::<socket> file
+                               :optional (offset 0) (size -1))
+  (return (Scm_SocketSendFile sock file (Scm_IntegerToOffset offset)
+                              (Scm_GetIntegerClamp size SCM_CLAMP_BOTH NULL))))
+
 (define-cproc socket-recv (sock::<socket> bytes::<fixnum>
                            :optional (flags::<fixnum> 0))
   Scm_SocketRecv)
@@ -386,6 +398,66 @@
 (define-enum-conditionally IFF_AUTOMEDIA)
 (define-enum-conditionally IFF_DYNAMIC)
 
+;;----------------------------------------------------------
+;; fd poller
+
+(define-cproc make-fd-poller () Scm_MakeFdPoller)
+
+(define-cproc fd-poller-add! (p::<fd-poller> port-or-fd flags)
+  (return (Scm_FdPollerAdd p (Scm_GetPortFd port-or-fd TRUE) flags)))
+
+(define-cproc fd-poller-delete! (p::<fd-poller> port-or-fd)
+  (return (Scm_FdPollerDelete p (Scm_GetPortFd port-or-fd TRUE))))
+
+(define-cproc fd-poller-wait (p::<fd-poller> :optional (timeout #f))
+  Scm_FdPollerWait)
+
+(define-cproc fd-poller-wakeup (p::<fd-poller>) Scm_FdPollerWakeup)
+
+(define-cproc fd-poller-close (p::<fd-poller>) Scm_FdPollerClose)
+
+;;----------------------------------------------------------
+;; async I/O
+
+(define-cproc make-aio-context (:optional (depth::<fixnum> 64) (backend #f))
+  Scm_MakeAioContext)
+
+(define-cproc aio-context-backend (c::<aio-context>) Scm_AioContextBackend)
+
+(define-cproc aio-in-flight (c::<aio-context>) ::<int> Scm_AioInFlight)
+
+(define-cproc aio-read! (c::<aio-context> target buf::<uvector>
+                         :optional (offset -1) (tag #f))
+  (return (Scm_AioRead c target buf (Scm_IntegerToOffset offset) tag)))
+
+(define-cproc aio-write! (c::<aio-context> target buf::<uvector>
+                          :optional (offset -1) (tag #f))
+  (return (Scm_AioWrite c target buf (Scm_IntegerToOffset offset) tag)))
+
+(define-cproc aio-accept! (c::<aio-context> sock::<socket> :optional (tag #f))
+  Scm_AioAccept)
+
+(define-cproc aio-connect! (c::<aio-context> sock::<socket>
+                            addr::<socket-address> :optional (tag #f))
+  Scm_AioConnect)
+
+(define-cproc aio-fsync! (c::<aio-context> target :optional (tag #f))
+  Scm_AioFsync)
+
+(define-cproc aio-submit (c::<aio-context>) ::<int> Scm_AioSubmit)
+
+(define-cproc aio-wait (c::<aio-context> :optional (min::<fixnum> 1)
+                                                   (timeout #f))
+  Scm_AioWait)
+
+(define-cproc aio-context-close (c::<aio-context>) Scm_AioContextClose)
+
+(define-cproc open-aio-input-file (path::<string>
+                                   :key (depth::<fixnum> 4)
+                                        (block-size::<fixnum> 65536)
+                                        (backend #f))
+  (return (Scm_OpenAioInputFile path depth block-size backend)))
+
 ;;----------------------------------------------------------
 ;; netdb routines
 
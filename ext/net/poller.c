@@ -0,0 +1,479 @@
+/*
+ * poller.c - file descriptor readiness notification
+ *
+ *   Copyright (c) 2019  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "gauche-net.h"
+#include <fcntl.h>
+
+/* <fd-poller> watches a set of file descriptors, like sys-select,
+ * but it doesn't have the FD_SETSIZE limit, and the cost of waiting
+ * doesn't grow with the number of watched fds when epoll(7) is
+ * available.  We use poll(2) otherwise.
+ *
+ * Registration is one-shot: once an fd is reported, it is dropped
+ * from the interest set until it is added again.  It is what the
+ * fiber scheduler (control.fiber) wants---a parked fiber waits for
+ * a single event---and it saves us from keeping track of registered
+ * fds in the epoll backend.
+ *
+ * Each poller has a self-pipe, so that other threads can wake up
+ * the thread waiting in fd-poller-wait.
+ */
+
+#if !defined(GAUCHE_WINDOWS)
+#if defined(HAVE_SYS_EPOLL_H)
+#include <sys/epoll.h>
+#define USE_EPOLL 1
+#else  /*!HAVE_SYS_EPOLL_H*/
+#include <poll.h>
+#endif /*!HAVE_SYS_EPOLL_H*/
+#endif /*!GAUCHE_WINDOWS*/
+
+/* Max # of events we handle with one fd-poller-wait */
+#define MAX_EVENTS 256
+
+struct ScmFdPollerRec {
+    SCM_HEADER;
+    int closed;
+#if !defined(GAUCHE_WINDOWS)
+    int wakeup[2];              /* self-pipe */
+#if defined(USE_EPOLL)
+    int epfd;
+#else  /*!USE_EPOLL*/
+    ScmInternalMutex mutex;     /* protects the following */
+    struct pollfd *fds;         /* fds[0] is for wakeup[0] */
+    int nfds;
+    int size;
+#endif /*!USE_EPOLL*/
+#endif /*!GAUCHE_WINDOWS*/
+};
+
+static void poller_print(ScmObj obj, ScmPort *port,
+                         ScmWriteContext *ctx SCM_UNUSED)
+{
+    Scm_Printf(port, "#<fd-poller%s %p>",
+               (SCM_FD_POLLER(obj)->closed? " (closed)" : ""), obj);
+}
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_FdPollerClass, poller_print);
+
+/* Flag lists returned by fd-poller-wait, indexed by the mask */
+static ScmObj flag_lists[4];
+static ScmObj sym_r = SCM_FALSE;
+static ScmObj sym_w = SCM_FALSE;
+
+#if !defined(GAUCHE_WINDOWS)
+
+static void poller_close(ScmFdPoller *p)
+{
+    if (p->closed) return;
+    p->closed = TRUE;
+    close(p->wakeup[0]);
+    close(p->wakeup[1]);
+#if defined(USE_EPOLL)
+    close(p->epfd);
+#else  /*!USE_EPOLL*/
+    p->fds = NULL;
+#endif /*!USE_EPOLL*/
+}
+
+static void poller_finalize(ScmObj obj, void *data SCM_UNUSED)
+{
+    poller_close(SCM_FD_POLLER(obj));
+}
+
+static void set_cloexec(int fd)
+{
+    int r;
+    SCM_SYSCALL(r, fcntl(fd, F_SETFD, FD_CLOEXEC));
+}
+
+static int flags_to_mask(ScmObj flags)
+{
+    int mask = 0;
+    ScmObj cp;
+    SCM_FOR_EACH(cp, flags) {
+        if (SCM_EQ(SCM_CAR(cp), sym_r)) mask |= SCM_FD_POLLER_READ;
+        else if (SCM_EQ(SCM_CAR(cp), sym_w)) mask |= SCM_FD_POLLER_WRITE;
+        else goto bad;
+    }
+    if (mask == 0 || !SCM_NULLP(cp)) goto bad;
+    return mask;
+  bad:
+    Scm_Error("fd-poller flags must be a non-empty list of r and/or w, "
+              "but got: %S", flags);
+    return 0;                   /* dummy */
+}
+
+/* Timeout is #f, microseconds, or (seconds microseconds), as
+   sys-select.  Returns milliseconds, rounded up, or -1 for #f.
+   Also used by aio-wait. */
+int Scm__NetTimeoutMs(ScmObj timeout)
+{
+    if (SCM_FALSEP(timeout)) return -1;
+    if (SCM_REALP(timeout)) {
+        double usec = Scm_GetDouble(timeout);
+        if (usec < 0) goto bad;
+        if (usec > (double)INT_MAX * 1000.0) return INT_MAX;
+        return (int)((usec + 999.0) / 1000.0);
+    }
+    if (SCM_PAIRP(timeout) && SCM_PAIRP(SCM_CDR(timeout))) {
+        ScmObj sec = SCM_CAR(timeout);
+        ScmObj usec = SCM_CADR(timeout);
+        if (!Scm_IntegerP(sec) || !Scm_IntegerP(usec)) goto bad;
+        long isec = Scm_GetInteger(sec);
+        long iusec = Scm_GetInteger(usec);
+        if (isec < 0 || iusec < 0) goto bad;
+        if (isec >= INT_MAX/1000) return INT_MAX;
+        return (int)(isec * 1000 + (iusec + 999) / 1000);
+    }
+  bad:
+    Scm_Error("timeout needs to be #f, a real number (in microseconds) "
+              "or a list of two integers (seconds and microseconds), "
+              "but got %S", timeout);
+    return 0;                   /* dummy */
+}
+
+static void check_open(ScmFdPoller *p)
+{
+    if (p->closed) Scm_Error("fd-poller is already closed: %S", SCM_OBJ(p));
+}
+
+static void drain_wakeup(ScmFdPoller *p)
+{
+    char buf[64];
+    while (read(p->wakeup[0], buf, sizeof(buf)) > 0)
+        ;
+}
+
+ScmObj Scm_MakeFdPoller(void)
+{
+    ScmFdPoller *p = SCM_NEW(ScmFdPoller);
+    int r;
+    SCM_SET_CLASS(p, SCM_CLASS_FD_POLLER);
+    p->closed = FALSE;
+
+    SCM_SYSCALL(r, pipe(p->wakeup));
+    if (r < 0) Scm_SysError("pipe failed");
+    set_cloexec(p->wakeup[0]);
+    set_cloexec(p->wakeup[1]);
+    SCM_SYSCALL(r, fcntl(p->wakeup[0], F_SETFL, O_NONBLOCK));
+    SCM_SYSCALL(r, fcntl(p->wakeup[1], F_SETFL, O_NONBLOCK));
+
+#if defined(USE_EPOLL)
+    SCM_SYSCALL(p->epfd, epoll_create1(EPOLL_CLOEXEC));
+    if (p->epfd < 0) {
+        int e = errno;
+        close(p->wakeup[0]);
+        close(p->wakeup[1]);
+        errno = e;
+        Scm_SysError("epoll_create1 failed");
+    }
+    /* The wakeup pipe stays registered, level-triggered. */
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = (uint32_t)p->wakeup[0];
+    SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_ADD, p->wakeup[0], &ev));
+    if (r < 0) {
+        int e = errno;
+        poller_close(p);
+        errno = e;
+        Scm_SysError("epoll_ctl failed");
+    }
+#else  /*!USE_EPOLL*/
+    SCM_INTERNAL_MUTEX_INIT(p->mutex);
+    p->size = 16;
+    p->fds = SCM_NEW_ATOMIC_ARRAY(struct pollfd, p->size);
+    p->fds[0].fd = p->wakeup[0];
+    p->fds[0].events = POLLIN;
+    p->nfds = 1;
+#endif /*!USE_EPOLL*/
+    Scm_RegisterFinalizer(SCM_OBJ(p), poller_finalize, NULL);
+    return SCM_OBJ(p);
+}
+
+#if defined(USE_EPOLL)
+
+static uint32_t epoll_events(int mask)
+{
+    uint32_t e = EPOLLONESHOT;
+    if (mask & SCM_FD_POLLER_READ)  e |= EPOLLIN;
+    if (mask & SCM_FD_POLLER_WRITE) e |= EPOLLOUT;
+    return e;
+}
+
+ScmObj Scm_FdPollerAdd(ScmFdPoller *p, int fd, ScmObj flags)
+{
+    int mask = flags_to_mask(flags), r;
+    struct epoll_event ev;
+    check_open(p);
+    ev.events = epoll_events(mask);
+    /* We keep the interest mask along with the fd, so that we can
+       tell which side was interested in when we get EPOLLERR/EPOLLHUP. */
+    ev.data.u64 = (uint32_t)fd | ((uint64_t)mask << 32);
+    /* Re-arming is the common case for long-lived connections. */
+    SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_MOD, fd, &ev));
+    if (r < 0 && errno == ENOENT) {
+        SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_ADD, fd, &ev));
+    }
+    if (r < 0) Scm_SysError("fd-poller-add! failed on fd %d", fd);
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_FdPollerDelete(ScmFdPoller *p, int fd)
+{
+    int r;
+    struct epoll_event ev;      /* for kernels before 2.6.9 */
+    check_open(p);
+    SCM_SYSCALL(r, epoll_ctl(p->epfd, EPOLL_CTL_DEL, fd, &ev));
+    if (r < 0 && errno != ENOENT && errno != EBADF) {
+        Scm_SysError("fd-poller-delete! failed on fd %d", fd);
+    }
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_FdPollerWait(ScmFdPoller *p, ScmObj timeout)
+{
+    struct epoll_event evs[MAX_EVENTS];
+    int ms = Scm__NetTimeoutMs(timeout), n;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    check_open(p);
+
+    SCM_SYSCALL(n, epoll_wait(p->epfd, evs, MAX_EVENTS, ms));
+    if (n < 0) Scm_SysError("epoll_wait failed");
+    for (int i=0; i<n; i++) {
+        int fd = (int)(uint32_t)evs[i].data.u64;
+        int mask = (int)(evs[i].data.u64 >> 32);
+        int got = 0;
+        if (fd == p->wakeup[0] && mask == 0) {
+            drain_wakeup(p);
+            continue;
+        }
+        if (evs[i].events & (EPOLLERR|EPOLLHUP)) got = mask;
+        if (evs[i].events & EPOLLIN)  got |= SCM_FD_POLLER_READ;
+        if (evs[i].events & EPOLLOUT) got |= SCM_FD_POLLER_WRITE;
+        got &= mask;
+        if (got) {
+            SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(fd), flag_lists[got]));
+        }
+    }
+    return h;
+}
+
+#else  /*!USE_EPOLL*/
+
+/* Returns the index in p->fds, or -1.  Must be called with p->mutex. */
+static int pollfd_index(ScmFdPoller *p, int fd)
+{
+    for (int i=1; i<p->nfds; i++) {
+        if (p->fds[i].fd == fd) return i;
+    }
+    return -1;
+}
+
+static void pollfd_remove(ScmFdPoller *p, int i)
+{
+    p->fds[i] = p->fds[--p->nfds];
+}
+
+static short poll_events(int mask)
+{
+    short e = 0;
+    if (mask & SCM_FD_POLLER_READ)  e |= POLLIN;
+    if (mask & SCM_FD_POLLER_WRITE) e |= POLLOUT;
+    return e;
+}
+
+ScmObj Scm_FdPollerAdd(ScmFdPoller *p, int fd, ScmObj flags)
+{
+    int mask = flags_to_mask(flags);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(p->mutex);
+    if (!p->closed) {
+        int i = pollfd_index(p, fd);
+        if (i < 0) {
+            if (p->nfds == p->size) {
+                struct pollfd *nfds =
+                    SCM_NEW_ATOMIC_ARRAY(struct pollfd, p->size*2);
+                memcpy(nfds, p->fds, sizeof(struct pollfd)*p->nfds);
+                p->fds = nfds;
+                p->size *= 2;
+            }
+            i = p->nfds++;
+            p->fds[i].fd = fd;
+        }
+        p->fds[i].events = poll_events(mask);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    check_open(p);
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_FdPollerDelete(ScmFdPoller *p, int fd)
+{
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(p->mutex);
+    if (!p->closed) {
+        int i = pollfd_index(p, fd);
+        if (i >= 0) pollfd_remove(p, i);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    check_open(p);
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_FdPollerWait(ScmFdPoller *p, ScmObj timeout)
+{
+    int ms = Scm__NetTimeoutMs(timeout), n, nfds = 0;
+    struct pollfd *fds = NULL;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+
+    /* We poll on a copy, so that other threads can add fds meanwhile.
+       They should call fd-poller-wakeup to have them watched. */
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(p->mutex);
+    if (!p->closed) {
+        nfds = p->nfds;
+        fds = SCM_NEW_ATOMIC_ARRAY(struct pollfd, nfds);
+        memcpy(fds, p->fds, sizeof(struct pollfd)*nfds);
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    check_open(p);
+
+    SCM_SYSCALL(n, poll(fds, nfds, ms));
+    if (n < 0) Scm_SysError("poll failed");
+    if (n == 0) return SCM_NIL;
+
+    if (fds[0].revents) drain_wakeup(p);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(p->mutex);
+    for (int i=1; i<nfds && !p->closed; i++) {
+        if (fds[i].revents == 0) continue;
+        int mask = 0, got = 0;
+        if (fds[i].events & POLLIN)  mask |= SCM_FD_POLLER_READ;
+        if (fds[i].events & POLLOUT) mask |= SCM_FD_POLLER_WRITE;
+        if (fds[i].revents & (POLLERR|POLLHUP|POLLNVAL)) got = mask;
+        if (fds[i].revents & POLLIN)  got |= SCM_FD_POLLER_READ;
+        if (fds[i].revents & POLLOUT) got |= SCM_FD_POLLER_WRITE;
+        got &= mask;
+        if (got == 0) continue;
+        /* one-shot */
+        int k = pollfd_index(p, fds[i].fd);
+        if (k >= 0) pollfd_remove(p, k);
+        SCM_APPEND1(h, t, Scm_Cons(SCM_MAKE_INT(fds[i].fd), flag_lists[got]));
+    }
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+    return h;
+}
+
+#endif /*!USE_EPOLL*/
+
+ScmObj Scm_FdPollerWakeup(ScmFdPoller *p)
+{
+    check_open(p);
+    /* If the pipe is full, there's already a pending wakeup. */
+    char c = 0;
+    int r;
+    SCM_SYSCALL(r, write(p->wakeup[1], &c, 1));
+    if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        Scm_SysError("fd-poller-wakeup failed");
+    }
+    return SCM_UNDEFINED;
+}
+
+ScmObj Scm_FdPollerClose(ScmFdPoller *p)
+{
+#if defined(USE_EPOLL)
+    poller_close(p);
+#else  /*!USE_EPOLL*/
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(p->mutex);
+    poller_close(p);
+    SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
+#endif /*!USE_EPOLL*/
+    return SCM_UNDEFINED;
+}
+
+#else  /*GAUCHE_WINDOWS*/
+
+static void poller_unsupported(void)
+{
+    Scm_Error("fd-poller is not supported on this platform.");
+}
+
+ScmObj Scm_MakeFdPoller(void)
+{
+    poller_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_FdPollerAdd(ScmFdPoller *p SCM_UNUSED, int fd SCM_UNUSED,
+                       ScmObj flags SCM_UNUSED)
+{
+    poller_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_FdPollerDelete(ScmFdPoller *p SCM_UNUSED, int fd SCM_UNUSED)
+{
+    poller_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_FdPollerWait(ScmFdPoller *p SCM_UNUSED, ScmObj timeout SCM_UNUSED)
+{
+    poller_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_FdPollerWakeup(ScmFdPoller *p SCM_UNUSED)
+{
+    poller_unsupported();
+    return SCM_UNDEFINED;       /* dummy */
+}
+
+ScmObj Scm_FdPollerClose(ScmFdPoller *p SCM_UNUSED)
+{
+    return SCM_UNDEFINED;
+}
+
+#endif /*GAUCHE_WINDOWS*/
+
+/*==================================================================
+ * initialization stuff
+ */
+
+void Scm_Init_NetPoller(ScmModule *mod)
+{
+    sym_r = SCM_INTERN("r");
+    sym_w = SCM_INTERN("w");
+    flag_lists[0] = SCM_NIL;
+    flag_lists[SCM_FD_POLLER_READ] = SCM_LIST1(sym_r);
+    flag_lists[SCM_FD_POLLER_WRITE] = SCM_LIST1(sym_w);
+    flag_lists[SCM_FD_POLLER_READ|SCM_FD_POLLER_WRITE] = SCM_LIST2(sym_r, sym_w);
+    Scm_InitStaticClass(&Scm_FdPollerClass, "<fd-poller>", mod, NULL, 0);
+}
@@ -275,6 +275,151 @@
 (test* "inet-checksum" (logand (lognot #xf201) #xffff)
        (inet-checksum '#u8(#x00 #x01 #xf2) 3))
 
+;;-----------------------------------------------------------------
+(test-section "fd poller")
+
+(cond-expand
+ [gauche.os.windows]
+ [else
+  (receive (in out) (sys-pipe)
+    (let1 p (make-fd-poller)
+      (test* "make-fd-poller" #t (is-a? p <fd-poller>))
+      (test* "fd-poller-wait (timeout)" '()
+             (begin (fd-poller-add! p in '(r))
+                    (fd-poller-wait p 10000)))
+      (test* "fd-poller-wait (writable)" `((,(port-file-number out) w))
+             (begin (fd-poller-add! p out '(w))
+                    (fd-poller-wait p 0)))
+      (test* "fd-poller-wait (readable)" `((,(port-file-number in) r))
+             (begin (write-char #\a out) (flush out)
+                    (fd-poller-wait p 0)))
+      (test* "fd-poller-wait (one-shot)" '()
+             (fd-poller-wait p 0))
+      (test* "fd-poller-add! (re-arm)" `((,(port-file-number in) r))
+             (begin (fd-poller-add! p (port-file-number in) '(r))
+                    (fd-poller-wait p '(0 0))))
+      (test* "fd-poller-delete!" '()
+             (begin (fd-poller-add! p in '(r))
+                    (fd-poller-delete! p in)
+                    (fd-poller-wait p 0)))
+      (test* "fd-poller-wakeup" '()
+             (begin (fd-poller-wakeup p)
+                    (fd-poller-wakeup p)
+                    (fd-poller-wait p #f)))
+      (test* "fd-poller-close" (test-error)
+             (begin (fd-poller-close p)
+                    (fd-poller-close p) ; idempotent
+                    (fd-poller-wait p 0)))
+      (close-port in)
+      (close-port out)))])
+;;-----------------------------------------------------------------
+(test-section "aio")
+
+(cond-expand
+ [gauche.os.windows]
+ [else
+  ;; Collects N completions.
+  (define (aio-collect ctx n)
+    (let loop ([r '()])
+      (if (>= (length r) n)
+        r
+        (loop (append r (aio-wait ctx (- n (length r))))))))
+
+  (define (aio-tests ctx)
+    (define (t name expected thunk)
+      (test* #"~name (~(aio-context-backend ctx))" expected (thunk)))
+    (sys-unlink "aio.o")
+    (let ([out (open-output-file "aio.o")]
+          [b1 (make-u8vector 4 0)]
+          [b2 (make-u8vector 4 0)])
+      (t "aio-write!" '(4 4 0)
+         (^[] (aio-write! ctx out '#u8(5 6 7 8) 4 'w2)
+              (aio-write! ctx out '#u8(1 2 3 4) 0 'w1)
+              (let1 r (aio-collect ctx 2)
+                (aio-fsync! ctx out 'f)
+                (append (map (cut assq-ref r <>) '(w1 w2))
+                        (map cdr (aio-collect ctx 1))))))
+      (t "aio-read!" '(4 2 #u8(5 6 7 8) #u8(7 8 0 0) 0)
+         (^[] (call-with-input-file "aio.o"
+                (^[in]
+                  (aio-read! ctx in b1 4 'r1)
+                  (aio-read! ctx (port-file-number in) b2 6 'r2)
+                  (aio-submit ctx)
+                  (let1 r (aio-collect ctx 2)
+                    (list (assq-ref r 'r1) (assq-ref r 'r2) b1 b2
+                          (aio-in-flight ctx)))))))
+      (t "aio-read! (error)" #t
+         (^[] (aio-read! ctx out b1 0 'e)
+              (negative? (cdar (aio-collect ctx 1)))))
+      (t "aio-read! (immutable)" (test-error)
+         (^[] (aio-read! ctx out '#u8(0 0) 0)))
+      (close-port out))
+    (let* ([serv (make-server-socket (make <sockaddr-in> :host :loopback
+                                           :port 0)
+                                     :reuse-addr? #t)]
+           [clnt (make-socket PF_INET SOCK_STREAM)]
+           [acc #f]
+           [buf (make-u8vector 3 0)])
+      (t "aio-connect!/aio-accept!" '(#t #t)
+         (^[] (aio-connect! ctx clnt (socket-address serv) 'c)
+              (aio-accept! ctx serv 'a)
+              (let1 r (aio-collect ctx 2)
+                (set! acc (assq-ref r 'a))
+                (list (eq? (assq-ref r 'c) clnt)
+                      (is-a? (assq-ref r 'a) <socket>)))))
+      (t "aio-write!/aio-read! (socket)" '(3 3 #u8(1 2 3))
+         (^[] (aio-write! ctx clnt '#u8(1 2 3) -1 'w)
+              (let1 r (aio-collect ctx 1)
+                (aio-read! ctx acc buf -1 'r)
+                (list (assq-ref r 'w) (cdar (aio-collect ctx 1)) buf))))
+      (socket-close clnt)
+      (when acc (socket-close acc))
+      (socket-close serv))
+    (t "aio-context-close" (test-error)
+       (^[] (aio-context-close ctx)
+            (aio-context-close ctx)     ; idempotent
+            (aio-wait ctx 0)))
+    (sys-unlink "aio.o"))
+
+  (dolist [backend '(#f threads sync)]
+    (and-let1 ctx (guard (e [else #f]) (make-aio-context 8 backend))
+      (aio-tests ctx)))
+
+  (test* "make-aio-context (bad backend)" (test-error)
+         (make-aio-context 8 'foo))
+
+  (let1 lines (map number->string (iota 5000))
+    (with-output-to-file "aio.o" (^[] (for-each print lines)))
+    (test* "open-aio-input-file" lines
+           (call-with-port (open-aio-input-file "aio.o" :depth 3
+                                                :block-size 1000)
+                           port->string-list))
+    (test* "open-aio-input-file (large block)" lines
+           (call-with-port (open-aio-input-file "aio.o") port->string-list))
+    (test* "open-aio-input-file (file number)" #t
+           (call-with-port (open-aio-input-file "aio.o")
+                           (^p (integer? (port-file-number p)))))
+    ;; Closing the port while the reads are in flight must wait for them
+    ;; before the fd is closed and reused.
+    (dolist [backend '(#f threads sync)]
+      (and-let1 p (guard (e [else #f])
+                    (open-aio-input-file "aio.o" :depth 16 :block-size 100
+                                         :backend backend))
+        (test* #"open-aio-input-file (close in flight, ~backend)"
+               `(,(car lines) ,lines)
+               (let1 l (read-line p)
+                 (close-port p)
+                 (dotimes [_ 20]
+                   (close-port (open-aio-input-file "aio.o" :depth 16
+                                                    :block-size 100
+                                                    :backend backend)))
+                 (list l (call-with-input-file "aio.o"
+                           port->string-list))))))
+    (sys-unlink "aio.o"))
+  (test* "open-aio-input-file (nonexistent)" (test-error <system-error>)
+         (open-aio-input-file "aio-nonexistent.o"))
+  ])
+
 ;;-----------------------------------------------------------------
 (test-section "socket")
 
@@ -484,6 +629,40 @@
                  (socket-close clnt)
                  (socket-close serv))))
 
+(cond-expand
+ [gauche.os.windows]
+ [else
+  (let ([data (with-output-to-string
+                (^[] (dotimes [i 1000] (print "line " i))))]
+        [serv (make-server-socket (make <sockaddr-in> :host :loopback :port 0)
+                                  :reuse-addr? #t)])
+    (with-output-to-file "sendfile.o" (cut display data))
+    (test* "socket-sendfile and copy-port to socket"
+           `(,(string-length data) 14 "line 1" ,(string-length data)
+             ,(string-append "head\n" data "line 1\nline 2\n" data))
+           (let* ([clnt (make-client-socket (socket-address serv))]
+                  [acc (socket-accept serv)]
+                  [out (socket-output-port clnt)])
+             (display "head\n" out)       ;must be sent first
+             (let* ([n1 (socket-sendfile clnt "sendfile.o")]
+                    [n2 (call-with-input-file "sendfile.o"
+                          (^p (read-line p)
+                              (list (socket-sendfile clnt p 7 14)
+                                    (read-line p))))]
+                    [n3 (call-with-input-file "sendfile.o"
+                          (cut copy-port <> out))])
+               (socket-shutdown clnt SHUT_WR)
+               (begin0 (list n1 (car n2) (cadr n2) n3
+                             (port->string (socket-input-port acc)))
+                 (socket-close acc)
+                 (socket-close clnt)))))
+    (test* "socket-sendfile (bad file)" (test-error)
+           (let1 clnt (make-client-socket (socket-address serv))
+             (unwind-protect (socket-sendfile clnt 'foo)
+               (socket-close clnt))))
+    (socket-close serv)
+    (sys-unlink "sendfile.o"))])
+
 (test* "udp server socket" #t
        (begin
          (with-output-to-file "testserv.o"
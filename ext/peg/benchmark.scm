@@ -1,7 +1,19 @@
+;; Run this in ext/peg directory.
+;; Parses the postal code data with a CSV grammar, comparing several
+;; variations, and text.csv as a reference.
+;;
+;;   generic   - The primitives are written with $satisfy, as they used
+;;               to be before the native versions were introduced.
+;;   native    - The grammar as is.
+;;   port      - Same as native, but reads from a port (lazy sequence).
+;;   backtrack - Each record is tried twice at the same position because
+;;               of the alternative line terminators.
+;;   memoize   - Same as backtrack, with $memoize on the record.
+
 (use parser.peg)
 (use gauche.charconv)
+(use gauche.time)
 (use srfi-13)
-(use srfi-42)
 
 (define data
   (let1 s (call-with-input-file "data/13tokyo.csv"
@@ -9,47 +21,59 @@
             :encoding 'utf8)
     (string-concatenate (make-list 10 s))))
 
-(define csv-parser
-  (let ()
-    (define ws     ($skip-many ($one-of #[ \t])))
-    (define comma  ($seq ws ($char #\,) ws))
-    (define dquote ($char #\"))
-    (define double-dquote ($do [($string "\"\"")] ($return #\")))
-    (define quoted-body ($many ($or ($one-of #[^\"]) double-dquote)))
-    (define quoted ($between dquote quoted-body dquote))
-    (define unquoted ($sep-by ($many1 ($one-of #[^ \t\r\n,]))
-                              ($many_ ($one-of #[ \t]))))
-    (define field  ($or quoted unquoted))
-    (define record ($sep-by ($->rope field) comma 1))
-    ($sep-by record newline)))
-
-;(profiler-start)
-(time (peg-parse-string csv-parser data))
-;(profiler-stop)
-
-;(profiler-show)
-
-#|
-(add-load-path ".")
-(use peg-orig)
-
-(define csv-parser
-  (let* ((spaces ($many ($one-of #[ \t])))
-         (comma ($seq spaces ($char #\,) spaces))
-         (dquote ($char #\"))
-         (double-dquote ($do (($string "\"\"")) ($return #\")))
-         (quoted-body ($many ($or ($one-of #[^\"]) double-dquote)))
-         (quoted ($between dquote quoted-body dquote))
-         (unquoted ($alternate ($one-of #[^ \t\n,]) spaces))
-         (field ($or quoted unquoted))
-         (record ($sep-by ($->rope field) comma 1)))
-    ($sep-by record newline)))
-
-(time (parse-string csv-parser data))
-|#
+(define (generic-one-of cs)
+  ($satisfy (^x (and (char? x) (char-set-contains? cs x))) cs))
+
+(define (generic-string str)
+  (let1 lis (string->list str)
+    (^[s0]
+      (let loop ([s s0] [lis lis])
+        (cond [(null? lis) (return-result str s)]
+              [(and (pair? s) (eqv? (car s) (car lis)))
+               (loop (cdr s) (cdr lis))]
+              [else (return-failure/expect str s0)])))))
+
+(define (make-record one-of string)
+  (let* ([ws     ($many_ (one-of #[ \t]))]
+         [comma  ($seq ws ($char #\,) ws)]
+         [dquote ($char #\")]
+         [double-dquote ($seq (string "\"\"") ($return #\"))]
+         [quoted-body ($many ($or (one-of #[^\"]) double-dquote))]
+         [quoted ($between dquote quoted-body dquote)]
+         [unquoted ($sep-by ($many1 (one-of #[^ \t\r\n,]))
+                            ($many_ (one-of #[ \t])))]
+         [field  ($or quoted unquoted)])
+    ($sep-by ($->rope field) comma 1)))
+
+(define (make-csv-parser one-of string)
+  ($sep-by (make-record one-of string) ($char #\newline)))
+
+(define (make-backtrack-parser memoize)
+  (let1 record (memoize (make-record $one-of $string))
+    ($many ($or ($try ($seq0 record ($string "\r\n")))
+                ($seq0 record ($char #\newline))))))
+
+(define (run tag thunk)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter (thunk))
+    (format #t "~12a: ~8,3f sec\n" tag (time-counter-value counter))))
+
+(print #"~(string-length data) characters")
+(run "generic"
+     (^[] (peg-parse-string (make-csv-parser generic-one-of generic-string)
+                            data)))
+(run "native"
+     (^[] (peg-parse-string (make-csv-parser $one-of $string) data)))
+(run "port"
+     (^[] (call-with-input-string data
+            (cut peg-parse-port (make-csv-parser $one-of $string) <>))))
+(run "backtrack"
+     (^[] (peg-parse-string (make-backtrack-parser identity) data)))
+(run "memoize"
+     (^[] (peg-parse-string (make-backtrack-parser $memoize) data)))
 
 ;;;============================================================
 (use text.csv)
 (define reader (make-csv-reader #\,))
 
-(time (port->list reader (open-input-string data)))
+(run "text.csv" (^[] (port->list reader (open-input-string data))))
@@ -62,7 +62,7 @@
           $optional
           $sep-by $end-by $sep-end-by
           $chain-left $chain-right
-          $lazy $parameterize
+          $lazy $parameterize $memoize
 
           $any $eos $.
           
@@ -264,10 +264,21 @@
                                 [else (loop (+ c 1) (cdr s))]))
                         s1))
 
+;; Packrat memoization.
+;; %memo-table holds an eq-hash table during a run of the driver.  It maps
+;; an input position (the pair) to an alist of (parser . #(r v s)).
+;; Without the table, $memoize'd parser is the same as the original one.
+(define %memo-table (make-parameter #f))
+
+(define-syntax %with-memo-table
+  (syntax-rules ()
+    [(_ body ...)
+     (parameterize ([%memo-table (make-hash-table 'eq?)]) body ...)]))
+
 ;; API
 ;;   Default driver.  Returns parsed value and next stream
 (define (peg-run-parser parser s)
-  (receive (r v s1) (parser s)
+  (receive (r v s1) (%with-memo-table (parser s))
     (if (parse-success? r)
       (values (rope-finalize v) s1)
       (raise (construct-peg-parser-error r v s s1)))))
@@ -290,7 +301,9 @@
 ;;   x->generator, but should we?
 (define (peg-parse-string parser str :optional (cont #f))
   (check-arg string? str)
-  (receive (r rest) (peg-run-parser parser (x->lseq str))
+  ;; A string is small enough to be converted to a list at once, which
+  ;; is faster than forcing lazy pairs one by one.
+  (receive (r rest) (peg-run-parser parser (string->list str))
     (if cont 
       (cont r rest)
       r)))
@@ -308,7 +321,7 @@
   (let1 s (%->lseq src)
     (^[] (if (null? s)
            (eof-object)
-           (receive (r v s1) (parser s)
+           (receive (r v s1) (%with-memo-table (parser s))
              (cond [(not (parse-success? r))
                     (raise (construct-peg-parser-error r v s s1))]
                    [(eof-object? v) (set! s '()) v]
@@ -366,6 +379,96 @@
 ;; upper bound by #f.
 (define-inline (>=? count max) (and max (>= count max)))
 
+;;;============================================================
+;;; Native primitives
+;;;
+
+;; Some primitive parsers are so commonly used that it pays to implement
+;; them in C.  They follow the same protocol as the Scheme parsers;
+;; the parser is a subr that takes the input and returns three values.
+;; Since SCM_PAIRP forces a lazy pair, they work on lazy sequences as well.
+;;
+;; %charset-parser CS - Matches one char in CS.  Used by $one-of.
+;; %charset-many-parser CS MIN MAX COLLECT? - Matches a run of chars in CS,
+;;    just like ($many ($one-of CS) MIN MAX).  If COLLECT? is #f, returns
+;;    #t instead of the list of matched chars, as $many_ does.
+;;    MAX is -1 for unlimited.
+;; %string-parser STR - Matches STR.  Used by $string.
+;;
+;; %charset-parser-charset P - If P is a parser created by %charset-parser,
+;;    returns its charset.  Otherwise returns #f.  $many uses this to
+;;    replace the loop with %charset-many-parser.
+
+(inline-stub
+ (define-cfn charset_parser (args::ScmObj* nargs::int data::void*) :static
+   (cast void nargs)
+   (let* ([cs (SCM_OBJ data)]
+          [s (aref args 0)])
+     (if (and (SCM_PAIRP s)
+              (SCM_CHARP (SCM_CAR s))
+              (Scm_CharSetContains (SCM_CHAR_SET cs)
+                                   (SCM_CHAR_VALUE (SCM_CAR s))))
+       (return (values SCM_FALSE (SCM_CAR s) (SCM_CDR s)))
+       (return (values 'fail-expect cs s)))))
+
+ (define-cfn charset_many_parser (args::ScmObj* nargs::int data::void*)
+   :static
+   (cast void nargs)
+   (let* ([params (SCM_OBJ data)]
+          [cs::ScmCharSet* (SCM_CHAR_SET (SCM_VECTOR_ELEMENT params 0))]
+          [lo::ScmSmallInt (SCM_INT_VALUE (SCM_VECTOR_ELEMENT params 1))]
+          [hi::ScmSmallInt (SCM_INT_VALUE (SCM_VECTOR_ELEMENT params 2))]
+          [collect::int (not (SCM_FALSEP (SCM_VECTOR_ELEMENT params 3)))]
+          [s (aref args 0)]
+          [h SCM_NIL] [t SCM_NIL]
+          [count::ScmSmallInt 0])
+     (while (and (or (< hi 0) (< count hi))
+                 (SCM_PAIRP s)
+                 (SCM_CHARP (SCM_CAR s))
+                 (Scm_CharSetContains cs (SCM_CHAR_VALUE (SCM_CAR s))))
+       (when collect (SCM_APPEND1 h t (SCM_CAR s)))
+       (set! s (SCM_CDR s))
+       (pre++ count))
+     (cond [(< count lo) (return (values 'fail-expect (SCM_OBJ cs) s))]
+           [collect      (return (values SCM_FALSE h s))]
+           [else         (return (values SCM_FALSE SCM_TRUE s))])))
+
+ ;; DATA is (STR . CHARS)
+ (define-cfn string_parser (args::ScmObj* nargs::int data::void*) :static
+   (cast void nargs)
+   (let* ([str (SCM_CAR (SCM_OBJ data))]
+          [s0 (aref args 0)]
+          [s s0])
+     (dolist [c (SCM_CDR (SCM_OBJ data))]
+       (unless (and (SCM_PAIRP s) (SCM_EQ (SCM_CAR s) c))
+         (return (values 'fail-expect str s0)))
+       (set! s (SCM_CDR s)))
+     (return (values SCM_FALSE str s))))
+
+ (define-cproc %charset-parser (cs::<char-set>)
+   (return (Scm_MakeSubr charset_parser cs 1 0 '"$one-of")))
+
+ (define-cproc %charset-parser-charset (p)
+   (if (and (SCM_SUBRP p) (== (SCM_SUBR_FUNC p) charset_parser))
+     (return (SCM_OBJ (SCM_SUBR_DATA p)))
+     (return SCM_FALSE)))
+
+ (define-cproc %charset-many-parser (cs::<char-set> lo::<fixnum> hi::<fixnum>
+                                     collect::<boolean>)
+   (let* ([params (Scm_MakeVector 4 SCM_FALSE)])
+     (set! (SCM_VECTOR_ELEMENT params 0) (SCM_OBJ cs)
+           (SCM_VECTOR_ELEMENT params 1) (SCM_MAKE_INT lo)
+           (SCM_VECTOR_ELEMENT params 2) (SCM_MAKE_INT hi)
+           (SCM_VECTOR_ELEMENT params 3) (SCM_MAKE_BOOL collect))
+     (return (Scm_MakeSubr charset_many_parser params 1 0
+                           (?: collect '"$many" '"$many_")))))
+
+ (define-cproc %string-parser (str::<string>)
+   (return (Scm_MakeSubr string_parser
+                         (Scm_Cons (SCM_OBJ str) (Scm_StringToList str))
+                         1 0 '"$string")))
+ )
+
 ;;;============================================================
 ;;; Combinators
 ;;;
@@ -583,6 +686,23 @@
      (let ((p (delay parse)))
        (lambda (s) ((force p) s)))]))
 
+;; API
+;; $memoize parser
+;;   Returns a parser that behaves like PARSER, but remembers the result
+;;   for each input position during a run of the driver (packrat parsing).
+;;   Useful for a nonterminal that is tried many times at the same
+;;   position because of backtracking.  When the parser is called outside
+;;   of the drivers, no memoization is done.
+(define ($memoize parse)
+  (^s (if-let1 tab (%memo-table)
+        (if-let1 m (assq parse (hash-table-get tab s '()))
+          (let1 e (cdr m)
+            (values (vector-ref e 0) (vector-ref e 1) (vector-ref e 2)))
+          (receive (r v s1) (parse s)
+            (hash-table-push! tab s (cons parse (vector r v s1)))
+            (values r v s1)))
+        (parse s))))
+
 ;; alternative $lazy possibility (need benchmark!)
 ;(define-syntax $lazy
 ;  (syntax-rules ()
@@ -601,29 +721,34 @@
 ;; $many_ p :optional min max
 ;; $many1 p :optional max
 ;; $many1_ p :optional max
+;;   If PARSE is ($one-of charset), we use the native loop.
 (define-inline ($many parse :optional (min 0) (max #f))
   (%check-min-max min max)
-  (lambda (s)
-    (let loop ([vs '()] [s s] [count 0])
-      (if (>=? count max)
-        (return-result (reverse! vs) s)
-        (receive (r v s1) (parse s)
-          (cond [(parse-success? r) (loop (cons v vs) s1 (+ count 1))]
-                [(and (eq? s s1) (<= min count))
-                 (return-result (reverse! vs) s1)]
-                [else (return-failure r v s1)]))))))
+  (if-let1 cs (%charset-parser-charset parse)
+    (%charset-many-parser cs min (or max -1) #t)
+    (lambda (s)
+      (let loop ([vs '()] [s s] [count 0])
+        (if (>=? count max)
+          (return-result (reverse! vs) s)
+          (receive (r v s1) (parse s)
+            (cond [(parse-success? r) (loop (cons v vs) s1 (+ count 1))]
+                  [(and (eq? s s1) (<= min count))
+                   (return-result (reverse! vs) s1)]
+                  [else (return-failure r v s1)])))))))
 
 (define-inline ($many_ parse :optional (min 0) (max #f))
   (%check-min-max min max)
-  (lambda (s)
-    (let loop ([s s] [count 0])
-      (if (>=? count max)
-        (return-result #t s)
-        (receive (r v s1) (parse s)
-          (cond [(parse-success? r) (loop s1 (+ count 1))]
-                [(and (eq? s s1) (<= min count))
-                 (return-result #t s1)]
-                [else (return-failure r v s1)]))))))
+  (if-let1 cs (%charset-parser-charset parse)
+    (%charset-many-parser cs min (or max -1) #f)
+    (lambda (s)
+      (let loop ([s s] [count 0])
+        (if (>=? count max)
+          (return-result #t s)
+          (receive (r v s1) (parse s)
+            (cond [(parse-success? r) (loop s1 (+ count 1))]
+                  [(and (eq? s s1) (<= min count))
+                   (return-result #t s1)]
+                  [else (return-failure r v s1)])))))))
 
 (define-inline ($many1 parse :optional (max #f)) ($many parse 1 max))
 (define-inline ($many1_ parse :optional (max #f)) ($many_ parse 1 max))
@@ -831,20 +956,7 @@
 ;; NB: On success, we know the matched input is the same as STR,
 ;; so we don't need to bother to collect matched chars.
 (define-inline ($string str)
-  (if (= (string-length str) 1)
-    (let1 ch (string-ref str 0)
-      (^s
-        (if (and (pair? s) (eqv? (car s) ch))
-          (return-result str (cdr s))
-          (return-failure/expect str s))))
-    (let1 lis (string->list str)
-      (^[s0]
-        (let loop ([s s0] [lis lis])
-          (if (null? lis)
-            (return-result str s)
-            (if (and (pair? s) (eqv? (car s) (car lis)))
-              (loop (cdr s) (cdr lis))
-              (return-failure/expect str s0))))))))
+  (%string-parser str))
 
 (define ($string-ci str)
   (let1 lis (string->list str)
@@ -869,8 +981,7 @@
 
 (define ($one-of charset)
   (assume-type charset <char-set>)
-  ($satisfy (^x (and (char? x) (char-set-contains? charset x)))
-            charset))
+  (%charset-parser charset))
 
 (define ($symbol sym) 
   (assume-type sym <symbol>)
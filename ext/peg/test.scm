@@ -295,6 +295,29 @@
 (test-succ "$many" '("a" "a")
            ($many ($string "a") 1 2) "aaaaa")
 
+;; $many of $one-of uses the native loop
+(test-succ "$many (charset)" '(#\a #\b #\a)
+           ($many ($one-of #[ab])) "abac")
+(test-succ "$many (charset)" '()
+           ($many ($one-of #[ab])) "cab")
+(test-succ "$many (charset)" '(#\a #\b)
+           ($many ($one-of #[ab]) 1 2) "abab")
+(test-fail "$many (charset)" '(2 #[ab])
+           ($many ($one-of #[ab]) 3) "abc")
+(test-succ "$many (charset)" "ab12"
+           ($seq0 ($->string ($many ($none-of #[\s])))
+                  ($many_ ($one-of #[\s]))
+                  ($eos))
+           "ab12  ")
+(test* "$many (charset, lazy input)" '((#\a #\a) (#\b))
+       (values-ref (peg-run-parser
+                    ($seq0 ($lift list
+                                  ($many ($one-of #[a]))
+                                  ($many ($one-of #[b])))
+                           ($eos))
+                    (generator->lseq (string->generator "aab")))
+                   0))
+
 ;; $many_
 (test-succ "$many_" #\a
            ($seq ($many_ ($string "a") 1 2) ($one-of #[a-z])) "aaaaa")
@@ -443,6 +466,25 @@
 ;;;============================================================
 ;;; Backtrack control
 ;;;
+;; $memoize
+(let* ([count 0]
+       [word ($->string ($many1 ($one-of #[a-z])))]
+       [word/count ($seq ($lift (^_ (inc! count)) ($return #f)) word)]
+       [memo ($memoize word/count)])
+  (test* "$memoize" '("foo" 3)
+         (let1 r (peg-parse-string ($or ($try ($seq word/count ($string "!")))
+                                        ($try ($seq word/count ($string "?")))
+                                        word/count)
+                                   "foo")
+           (list r count)))
+  (set! count 0)
+  (test* "$memoize" '("foo" 1)
+         (let1 r (peg-parse-string ($or ($try ($seq memo ($string "!")))
+                                        ($try ($seq memo ($string "?")))
+                                        memo)
+                                   "foo")
+           (list r count))))
+
 (test-section "backtrack control")
 
 (test-succ "$or and $try" "abc"
@@ -1010,5 +1052,77 @@
 (test* "read/write invariance"
        '#(48.529166)
        (parse-json-string (construct-json-string '#(48.529166))))
-       
+
+(test* "parse-json leaves the rest of the port"
+       '(#(1 2) " tail")
+       (call-with-input-string "[1, 2] tail"
+         (^p (let1 v (parse-json p) (list v (read-string 10 p))))))
+
+(test* "big numbers" '#(123456789012345678901234567890 -1234567890123456789
+                        1e300 0)
+       (parse-json-string
+        "[123456789012345678901234567890, -1234567890123456789, 1e300, -0]"))
+
+(cond-expand
+ [gauche.ces.utf8
+  (test* "non-ascii characters" '(("\u00e9t\u00e9" . "\u3042\u3044"))
+         (parse-json-string "{\"\u00e9t\u00e9\": \"\u3042\u3044\"}"))
+  (test* "writing non-ascii characters" "[\"\\u00e9\\ud867\\ude3d\"]"
+         (construct-json-string '#("\u00e9\x29e3d;")))]
+ [else])
+
+(test* "deep nesting" 10000
+       (let loop ([v (parse-json-string
+                      (string-append (make-string 10000 #\[)
+                                     (make-string 10000 #\])))]
+                  [n 0])
+         (if (= (vector-length v) 0)
+           (+ n 1)
+           (loop (vector-ref v 0) (+ n 1)))))
+
+(let ()
+  (define (t str)
+    (test* #"parse error ~str" (test-error <json-parse-error>)
+           (parse-json-string str)))
+  (t "[1,]")
+  (t "[1 2]")
+  (t "{\"a\" 1}")
+  (t "{\"a\": 1,}")
+  (t "[-]")
+  (t "[1.]")
+  (t "[tru]")
+  (t "[\"abc]")
+  (t "[\"\\x\"]"))
+
+(test* "parse error position" 4
+       (guard (e [(<json-parse-error> e) (~ e'position)])
+         (parse-json-string "[1,]")))
+
+(test* "json-event-generator"
+       '(start-object (key . "a") start-array (value . 1) (value . true)
+         end-array (key . "b") (value . "x") end-object
+         start-array end-array)
+       (generator->list
+        (json-event-generator "{\"a\": [1, true], \"b\": \"x\"} []")))
+
+(test* "json-event-generator with special handler"
+       '(start-array (value . #f) (value . null) end-array)
+       (parameterize ([json-special-handler (^y (if (eq? y 'false) #f y))])
+         (generator->list
+          (call-with-input-string "[false, null]" json-event-generator))))
+
+(test* "writing specials and numbers"
+       "[false,true,null,false,true,1.5,0.5,-12345678901234567890]"
+       (construct-json-string
+        `#(#f #t null false true 1.5 1/2 -12345678901234567890)))
+
+(test* "writing strings" "[\"a\\\"\\\\\\n\\u0001\\u007f\"]"
+       (construct-json-string '#("a\"\\\n\x01;\x7f;")))
+
+(test* "writing symbol keys" "{\"a\":1,\"2\":{}}"
+       (construct-json-string '((a . 1) (2 . ()))))
+
+(test* "writer error (inf)" (test-error <json-construct-error>)
+       (construct-json-string `#(,(/. 1 0))))
+
 (test-end)
@@ -0,0 +1,781 @@
+/*
+ * json.c - native JSON reader and writer
+ *
+ *   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "json.h"
+
+static ScmObj sym_true;
+static ScmObj sym_false;
+static ScmObj sym_null;
+static ScmObj sym_start_object;
+static ScmObj sym_end_object;
+static ScmObj sym_start_array;
+static ScmObj sym_end_array;
+static ScmObj sym_key;
+static ScmObj sym_value;
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_JsonReaderClass, NULL);
+
+/*==================================================================
+ * Reader
+ */
+
+/* Parser states.  Each state tells what we expect next. */
+enum {
+    ST_TOP,                     /* a top-level value or EOF */
+    ST_VALUE,                   /* a value (after ':' or ',' in array) */
+    ST_VALUE_OR_END,            /* a value or ']' (after '[') */
+    ST_KEY,                     /* a key (after ',' in object) */
+    ST_KEY_OR_END,              /* a key or '}' (after '{') */
+    ST_COLON,                   /* ':' (after key) */
+    ST_COMMA_OR_END,            /* ',', ']' or '}' (after value in
+                                   container) */
+    ST_ERROR                    /* an error has been reported */
+};
+
+/* Events */
+enum {
+    EV_EOF,
+    EV_START_OBJECT,
+    EV_END_OBJECT,
+    EV_START_ARRAY,
+    EV_END_ARRAY,
+    EV_KEY,
+    EV_VALUE
+};
+
+#define INITIAL_STACK_SIZE   32
+#define INITIAL_BUFFER_SIZE  256
+#define INITIAL_FRAMES_SIZE  (3*16)
+
+ScmObj Scm_MakeJsonReader(ScmObj src, ScmObj errproc)
+{
+    ScmJsonReader *r = SCM_NEW(ScmJsonReader);
+    SCM_SET_CLASS(r, SCM_CLASS_JSON_READER);
+    r->src = src;
+    if (SCM_STRINGP(src)) {
+        const ScmStringBody *b = SCM_STRING_BODY(src);
+        r->port = NULL;
+        r->cur = (const unsigned char*)SCM_STRING_BODY_START(b);
+        r->end = r->cur + SCM_STRING_BODY_SIZE(b);
+    } else if (SCM_IPORTP(src)) {
+        r->port = SCM_PORT(src);
+        r->cur = r->end = NULL;
+    } else {
+        Scm_TypeError("src", "string or input port", src);
+    }
+    r->pos = 0;
+    r->errproc = errproc;
+    r->state = ST_TOP;
+    r->stack = SCM_NEW_ATOMIC2(char*, INITIAL_STACK_SIZE);
+    r->stackSize = INITIAL_STACK_SIZE;
+    r->depth = 0;
+    r->buf = SCM_NEW_ATOMIC2(char*, INITIAL_BUFFER_SIZE);
+    r->bufSize = INITIAL_BUFFER_SIZE;
+    r->frames = NULL;
+    r->framesSize = 0;
+    return SCM_OBJ(r);
+}
+
+static void reader_error(ScmJsonReader *r, const char *msg, ...)
+{
+    va_list ap;
+    va_start(ap, msg);
+    ScmObj m = Scm_Vsprintf(msg, ap, TRUE);
+    va_end(ap);
+    r->state = ST_ERROR;
+    if (!SCM_FALSEP(r->errproc)) {
+        Scm_ApplyRec2(r->errproc, Scm_MakeInteger(r->pos), m);
+    }
+    /* errproc shouldn't return, but just in case. */
+    Scm_Error("%A at position %ld", m, (long)r->pos);
+}
+
+static inline int rd_getb(ScmJsonReader *r)
+{
+    if (r->port) {
+        int b = Scm_Getb(r->port);
+        if (b != EOF) r->pos++;
+        return b;
+    }
+    if (r->cur < r->end) {
+        r->pos++;
+        return *r->cur++;
+    }
+    return EOF;
+}
+
+static inline int rd_peekb(ScmJsonReader *r)
+{
+    if (r->port) return Scm_Peekb(r->port);
+    return (r->cur < r->end)? *r->cur : EOF;
+}
+
+static inline int is_ws(int b)
+{
+    return (b == ' ' || b == '\t' || b == '\n' || b == '\r');
+}
+
+/* Returns the next non-whitespace byte, consuming it. */
+static inline int rd_skip_ws(ScmJsonReader *r)
+{
+    int b;
+    if (!r->port) {
+        while (r->cur < r->end && is_ws(*r->cur)) {
+            r->cur++; r->pos++;
+        }
+    }
+    do { b = rd_getb(r); } while (is_ws(b));
+    return b;
+}
+
+/* Scratch buffer */
+static inline void buf_ensure(ScmJsonReader *r, ScmSize len, ScmSize more)
+{
+    if (len + more > r->bufSize) {
+        ScmSize newsize = r->bufSize * 2;
+        while (newsize < len + more) newsize *= 2;
+        char *nbuf = SCM_NEW_ATOMIC2(char*, newsize);
+        memcpy(nbuf, r->buf, len);
+        r->buf = nbuf;
+        r->bufSize = newsize;
+    }
+}
+
+static void push_container(ScmJsonReader *r, char c)
+{
+    if (r->depth >= r->stackSize) {
+        ScmSize newsize = r->stackSize * 2;
+        char *nstack = SCM_NEW_ATOMIC2(char*, newsize);
+        memcpy(nstack, r->stack, r->depth);
+        r->stack = nstack;
+        r->stackSize = newsize;
+    }
+    r->stack[r->depth++] = c;
+}
+
+/* Called after a value is completed. */
+static inline void value_done(ScmJsonReader *r)
+{
+    r->state = (r->depth == 0)? ST_TOP : ST_COMMA_OR_END;
+}
+
+static int read_hex4(ScmJsonReader *r)
+{
+    int v = 0;
+    for (int i=0; i<4; i++) {
+        int b = rd_getb(r);
+        if (b >= '0' && b <= '9')      v = v*16 + (b - '0');
+        else if (b >= 'a' && b <= 'f') v = v*16 + (b - 'a' + 10);
+        else if (b >= 'A' && b <= 'F') v = v*16 + (b - 'A' + 10);
+        else reader_error(r, "bad \\u escape in string");
+    }
+    return v;
+}
+
+/* Reads \uXXXX (after '\u') and puts the character into the scratch
+   buffer at LEN.  Returns the new length. */
+static ScmSize read_unicode_escape(ScmJsonReader *r, ScmSize len)
+{
+    int ucs = read_hex4(r);
+    if (ucs >= 0xd800 && ucs <= 0xdbff) {
+        if (rd_getb(r) != '\\' || rd_getb(r) != 'u') {
+            reader_error(r, "unpaired surrogate: \\u%04x", ucs);
+        }
+        int lo = read_hex4(r);
+        if (lo < 0xdc00 || lo > 0xdfff) {
+            reader_error(r, "unpaired surrogate: \\u%04x", ucs);
+        }
+        ucs = 0x10000 + ((ucs - 0xd800) << 10) + (lo - 0xdc00);
+    } else if (ucs >= 0xdc00 && ucs <= 0xdfff) {
+        reader_error(r, "unpaired surrogate: \\u%04x", ucs);
+    }
+    ScmChar ch = Scm_UcsToChar(ucs);
+    if (ch == SCM_CHAR_INVALID) {
+        reader_error(r, "character \\u%04x can't be represented", ucs);
+    }
+    buf_ensure(r, len, SCM_CHAR_NBYTES(ch));
+    SCM_CHAR_PUT(r->buf + len, ch);
+    return len + SCM_CHAR_NBYTES(ch);
+}
+
+/* Reads a string after the opening '"'. */
+static ScmObj read_string(ScmJsonReader *r)
+{
+    ScmSize len = 0;
+
+    if (!r->port) {
+        /* Fast path: if the string has no escapes, we can make a string
+           directly from the source. */
+        const unsigned char *p = r->cur;
+        while (p < r->end && *p != '"' && *p != '\\') {
+            if (*p >= 0x80) p += SCM_CHAR_NFOLLOWS(*p);
+            p++;
+        }
+        if (p < r->end && *p == '"') {
+            ScmObj s = Scm_MakeString((const char*)r->cur, p - r->cur, -1,
+                                      SCM_STRING_COPYING);
+            r->pos += p - r->cur + 1;
+            r->cur = p + 1;
+            return s;
+        }
+        /* We have escapes.  Copy up to the first one and fall through. */
+        if (p > r->end) p = r->end;
+        len = p - r->cur;
+        buf_ensure(r, 0, len);
+        memcpy(r->buf, r->cur, len);
+        r->pos += len;
+        r->cur = p;
+    }
+
+    for (;;) {
+        int b = rd_getb(r);
+        switch (b) {
+        case EOF:
+            reader_error(r, "unterminated string");
+            break;
+        case '"':
+            return Scm_MakeString(r->buf, len, -1, SCM_STRING_COPYING);
+        case '\\':
+            b = rd_getb(r);
+            switch (b) {
+            case '"': case '\\': case '/': break;
+            case 'b': b = 0x08; break;
+            case 'f': b = 0x0c; break;
+            case 'n': b = 0x0a; break;
+            case 'r': b = 0x0d; break;
+            case 't': b = 0x09; break;
+            case 'u':
+                len = read_unicode_escape(r, len);
+                continue;
+            default:
+                reader_error(r, "bad escape sequence in string");
+            }
+            buf_ensure(r, len, 1);
+            r->buf[len++] = (char)b;
+            break;
+        default:
+            if (b >= 0x80) {
+                int n = SCM_CHAR_NFOLLOWS(b);
+                buf_ensure(r, len, n+1);
+                r->buf[len++] = (char)b;
+                for (int i=0; i<n; i++) {
+                    if ((b = rd_getb(r)) == EOF) {
+                        reader_error(r, "unterminated string");
+                    }
+                    r->buf[len++] = (char)b;
+                }
+            } else {
+                buf_ensure(r, len, 1);
+                r->buf[len++] = (char)b;
+            }
+        }
+    }
+}
+
+static inline int is_digit(int b)
+{
+    return b >= '0' && b <= '9';
+}
+
+/* Reads a number whose first byte is B.  The grammar is the same as
+   the one rfc.json has been accepting, that is, JSON numbers
+   with an optional '+' sign. */
+static ScmObj read_number(ScmJsonReader *r, int b)
+{
+    ScmSize len = 0;
+    int ndigits = 0, integral = TRUE;
+
+#define NUMPUT(c) \
+    do { buf_ensure(r, len, 1); r->buf[len++] = (char)(c); } while (0)
+#define DIGITS()                                          \
+    do {                                                  \
+        int n_ = 0;                                       \
+        while (is_digit(rd_peekb(r))) {                   \
+            NUMPUT(rd_getb(r)); n_++;                     \
+        }                                                 \
+        if (n_ == 0) reader_error(r, "bad number");       \
+        ndigits += n_;                                    \
+    } while (0)
+
+    NUMPUT(b);
+    if (is_digit(b)) ndigits++;
+    while (is_digit(rd_peekb(r))) { NUMPUT(rd_getb(r)); ndigits++; }
+    if (ndigits == 0) reader_error(r, "bad number");
+    if (rd_peekb(r) == '.') {
+        NUMPUT(rd_getb(r));
+        integral = FALSE;
+        DIGITS();
+    }
+    if (rd_peekb(r) == 'e' || rd_peekb(r) == 'E') {
+        NUMPUT(rd_getb(r));
+        integral = FALSE;
+        if (rd_peekb(r) == '+' || rd_peekb(r) == '-') NUMPUT(rd_getb(r));
+        DIGITS();
+    }
+#undef DIGITS
+#undef NUMPUT
+
+    if (integral && ndigits <= 18) {
+        /* fits in int64 */
+        int64_t v = 0;
+        const char *p = r->buf;
+        int neg = FALSE;
+        if (*p == '-') { neg = TRUE; p++; }
+        else if (*p == '+') p++;
+        for (; p < r->buf + len; p++) v = v*10 + (*p - '0');
+        return Scm_MakeInteger64(neg? -v : v);
+    } else {
+        ScmObj s = Scm_MakeString(r->buf, len, len, SCM_STRING_COPYING);
+        ScmObj n = Scm_StringToNumber(SCM_STRING(s), 10, 0);
+        if (SCM_FALSEP(n)) reader_error(r, "bad number: %A", s);
+        return n;
+    }
+}
+
+/* Reads the rest of the literal true, false or null. */
+static ScmObj read_literal(ScmJsonReader *r, int b)
+{
+    const char *rest;
+    ScmObj sym;
+    switch (b) {
+    case 't': rest = "rue";  sym = sym_true;  break;
+    case 'f': rest = "alse"; sym = sym_false; break;
+    default:  rest = "ull";  sym = sym_null;  break;
+    }
+    for (; *rest; rest++) {
+        if (rd_getb(r) != *rest) reader_error(r, "bad literal");
+    }
+    return sym;
+}
+
+static ScmObj special(ScmObj sym, ScmObj specialHandler)
+{
+    if (SCM_FALSEP(specialHandler)) return sym;
+    return Scm_ApplyRec1(specialHandler, sym);
+}
+
+/* Reads the next event.  For EV_KEY and EV_VALUE, the key or value
+   is stored in *val. */
+static int next_event(ScmJsonReader *r, ScmObj *val, ScmObj specialHandler)
+{
+    if (r->state == ST_ERROR) {
+        Scm_Error("JSON reader is in error state");
+    }
+    for (;;) {
+        int b = rd_skip_ws(r);
+        int st = r->state;
+
+        if (b == EOF) {
+            if (st == ST_TOP) return EV_EOF;
+            reader_error(r, "unexpected end of input");
+        }
+
+        switch (st) {
+        case ST_TOP:
+        case ST_VALUE:
+        case ST_VALUE_OR_END:
+            switch (b) {
+            case '{':
+                push_container(r, '{');
+                r->state = ST_KEY_OR_END;
+                return EV_START_OBJECT;
+            case '[':
+                push_container(r, '[');
+                r->state = ST_VALUE_OR_END;
+                return EV_START_ARRAY;
+            case ']':
+                if (st != ST_VALUE_OR_END) goto unexpected;
+                r->depth--;
+                value_done(r);
+                return EV_END_ARRAY;
+            case '"':
+                *val = read_string(r);
+                value_done(r);
+                return EV_VALUE;
+            case 't': case 'f': case 'n':
+                *val = special(read_literal(r, b), specialHandler);
+                value_done(r);
+                return EV_VALUE;
+            case '-': case '+':
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                *val = read_number(r, b);
+                value_done(r);
+                return EV_VALUE;
+            default:
+                goto unexpected;
+            }
+        case ST_KEY:
+        case ST_KEY_OR_END:
+            if (b == '"') {
+                *val = read_string(r);
+                r->state = ST_COLON;
+                return EV_KEY;
+            }
+            if (b == '}' && st == ST_KEY_OR_END) {
+                r->depth--;
+                value_done(r);
+                return EV_END_OBJECT;
+            }
+            goto unexpected;
+        case ST_COLON:
+            if (b != ':') goto unexpected;
+            r->state = ST_VALUE;
+            continue;
+        case ST_COMMA_OR_END:
+            {
+                char c = r->stack[r->depth-1];
+                if (b == ',') {
+                    r->state = (c == '{')? ST_KEY : ST_VALUE;
+                    continue;
+                }
+                if (b == ']' && c == '[') {
+                    r->depth--;
+                    value_done(r);
+                    return EV_END_ARRAY;
+                }
+                if (b == '}' && c == '{') {
+                    r->depth--;
+                    value_done(r);
+                    return EV_END_OBJECT;
+                }
+                goto unexpected;
+            }
+        }
+      unexpected:
+        if (b < 0x80) reader_error(r, "unexpected character: %C", b);
+        else          reader_error(r, "unexpected byte: #x%02x", b);
+    }
+}
+
+ScmObj Scm_JsonReadEvent(ScmJsonReader *r, ScmObj specialHandler)
+{
+    ScmObj val = SCM_UNDEFINED;
+    switch (next_event(r, &val, specialHandler)) {
+    case EV_EOF:          return SCM_EOF;
+    case EV_START_OBJECT: return sym_start_object;
+    case EV_END_OBJECT:   return sym_end_object;
+    case EV_START_ARRAY:  return sym_start_array;
+    case EV_END_ARRAY:    return sym_end_array;
+    case EV_KEY:          return Scm_Cons(sym_key, val);
+    default:              return Scm_Cons(sym_value, val);
+    }
+}
+
+/* Reads one whole value.  We keep a stack of frames instead of recursion,
+   so that a deeply nested input won't overflow the C stack.  Each frame
+   consists of the head and the tail of the list of elements, and
+   the pending key (SCM_UNBOUND for arrays). */
+ScmObj Scm_JsonReadValue(ScmJsonReader *r, ScmObj arrayHandler,
+                         ScmObj objectHandler, ScmObj specialHandler)
+{
+    ScmSize nframes = 0;        /* # of ScmObj's used in r->frames */
+
+    if (r->state != ST_TOP && r->state != ST_ERROR) {
+        Scm_Error("JSON reader is in the middle of a value");
+    }
+
+    for (;;) {
+        ScmObj v = SCM_UNDEFINED;
+        ScmObj *f;
+
+        switch (next_event(r, &v, specialHandler)) {
+        case EV_EOF:
+            return SCM_EOF;
+        case EV_START_OBJECT:
+        case EV_START_ARRAY:
+            if (nframes + 3 > r->framesSize) {
+                ScmSize newsize = r->framesSize? r->framesSize*2
+                    : INITIAL_FRAMES_SIZE;
+                ScmObj *nf = SCM_NEW_ARRAY(ScmObj, newsize);
+                if (nframes > 0) memcpy(nf, r->frames, nframes*sizeof(ScmObj));
+                r->frames = nf;
+                r->framesSize = newsize;
+            }
+            f = r->frames + nframes;
+            f[0] = f[1] = SCM_NIL;
+            f[2] = (r->stack[r->depth-1] == '{')? SCM_FALSE : SCM_UNBOUND;
+            nframes += 3;
+            continue;
+        case EV_KEY:
+            r->frames[nframes-1] = v;
+            continue;
+        case EV_END_ARRAY:
+            nframes -= 3;
+            v = r->frames[nframes];
+            if (SCM_FALSEP(arrayHandler)) v = Scm_ListToVector(v, 0, -1);
+            else v = Scm_ApplyRec1(arrayHandler, v);
+            break;
+        case EV_END_OBJECT:
+            nframes -= 3;
+            v = r->frames[nframes];
+            if (!SCM_FALSEP(objectHandler)) {
+                v = Scm_ApplyRec1(objectHandler, v);
+            }
+            break;
+        default:                /* EV_VALUE */
+            break;
+        }
+
+        /* We've got a complete value V. */
+        if (nframes == 0) {
+            /* clear references so that they can be collected */
+            if (r->frames) memset(r->frames, 0, r->framesSize*sizeof(ScmObj));
+            return v;
+        }
+        f = r->frames + nframes - 3;
+        if (!SCM_UNBOUNDP(f[2])) v = Scm_Cons(f[2], v);
+        SCM_APPEND1(f[0], f[1], v);
+    }
+}
+
+/*==================================================================
+ * Writer
+ */
+
+#define WRITER_BUFFER_SIZE 8192
+
+typedef struct json_writer_rec {
+    ScmPort *port;
+    ScmObj fallback;            /* called for objects we can't handle */
+    ScmObj keyproc;             /* converts non-string keys to strings */
+    int len;
+    char buf[WRITER_BUFFER_SIZE];
+} json_writer;
+
+static void w_flush(json_writer *w)
+{
+    if (w->len > 0) {
+        Scm_Putz(w->buf, w->len, w->port);
+        w->len = 0;
+    }
+}
+
+static inline void w_putz(json_writer *w, const char *s, ScmSize len)
+{
+    if (w->len + len > WRITER_BUFFER_SIZE) {
+        w_flush(w);
+        if (len > WRITER_BUFFER_SIZE) {
+            Scm_Putz(s, len, w->port);
+            return;
+        }
+    }
+    memcpy(w->buf + w->len, s, len);
+    w->len += (int)len;
+}
+
+static inline void w_putc(json_writer *w, char c)
+{
+    if (w->len >= WRITER_BUFFER_SIZE) w_flush(w);
+    w->buf[w->len++] = c;
+}
+
+static void w_escape(json_writer *w, int code)
+{
+    static const char hex[] = "0123456789abcdef";
+    char e[6] = { '\\', 'u',
+                  hex[(code>>12)&0xf], hex[(code>>8)&0xf],
+                  hex[(code>>4)&0xf], hex[code&0xf] };
+    w_putz(w, e, 6);
+}
+
+static void w_string(json_writer *w, ScmString *str)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    const unsigned char *p = (const unsigned char*)SCM_STRING_BODY_START(b);
+    const unsigned char *end = p + SCM_STRING_BODY_SIZE(b);
+
+    w_putc(w, '"');
+    while (p < end) {
+        /* copy the run of characters that don't need escaping */
+        const unsigned char *q = p;
+        while (q < end && *q >= 0x20 && *q < 0x7f && *q != '"' && *q != '\\') {
+            q++;
+        }
+        if (q > p) { w_putz(w, (const char*)p, q - p); p = q; }
+        if (p >= end) break;
+
+        int c = *p;
+        switch (c) {
+        case '"':  w_putz(w, "\\\"", 2); p++; continue;
+        case '\\': w_putz(w, "\\\\", 2); p++; continue;
+        case 0x08: w_putz(w, "\\b", 2); p++; continue;
+        case 0x0c: w_putz(w, "\\f", 2); p++; continue;
+        case 0x0a: w_putz(w, "\\n", 2); p++; continue;
+        case 0x0d: w_putz(w, "\\r", 2); p++; continue;
+        case 0x09: w_putz(w, "\\t", 2); p++; continue;
+        }
+        if (c < 0x80) {
+            w_escape(w, c);     /* other control characters and DEL */
+            p++;
+        } else {
+            ScmChar ch;
+            SCM_CHAR_GET(p, ch);
+            p += SCM_CHAR_NBYTES(ch);
+            int ucs = Scm_CharToUcs(ch);
+            if (ucs >= 0x10000) {
+                ucs -= 0x10000;
+                w_escape(w, 0xd800 + (ucs >> 10));
+                w_escape(w, 0xdc00 + (ucs & 0x3ff));
+            } else {
+                w_escape(w, ucs);
+            }
+        }
+    }
+    w_putc(w, '"');
+}
+
+static void w_fallback(json_writer *w, ScmObj obj)
+{
+    w_flush(w);
+    Scm_ApplyRec1(w->fallback, obj);
+}
+
+static void w_value(json_writer *w, ScmObj obj);
+
+static void w_object(json_writer *w, ScmObj obj)
+{
+    ScmObj cp;
+
+    /* Check first, so that the fallback can report an error before
+       we emit anything. */
+    SCM_FOR_EACH(cp, obj) {
+        if (!SCM_PAIRP(SCM_CAR(cp))) { w_fallback(w, obj); return; }
+    }
+
+    w_putc(w, '{');
+    SCM_FOR_EACH(cp, obj) {
+        ScmObj key = SCM_CAAR(cp);
+        if (cp != obj) w_putc(w, ',');
+        if (SCM_SYMBOLP(key) && !SCM_KEYWORDP(key)) {
+            key = SCM_OBJ(SCM_SYMBOL_NAME(key));
+        } else if (!SCM_STRINGP(key)) {
+            key = Scm_ApplyRec1(w->keyproc, key);
+        }
+        if (!SCM_STRINGP(key)) {
+            Scm_Error("key must be converted to a string, but got: %S", key);
+        }
+        w_string(w, SCM_STRING(key));
+        w_putc(w, ':');
+        w_value(w, SCM_CDAR(cp));
+    }
+    w_putc(w, '}');
+}
+
+static void w_array(json_writer *w, ScmObj vec)
+{
+    ScmSize n = SCM_VECTOR_SIZE(vec);
+    w_putc(w, '[');
+    for (ScmSize i=0; i<n; i++) {
+        if (i > 0) w_putc(w, ',');
+        w_value(w, SCM_VECTOR_ELEMENT(vec, i));
+    }
+    w_putc(w, ']');
+}
+
+static void w_number(json_writer *w, ScmObj num)
+{
+    if (SCM_INTP(num)) {
+        char b[32];
+        int n = snprintf(b, sizeof(b), "%ld", SCM_INT_VALUE(num));
+        w_putz(w, b, n);
+    } else {
+        ScmObj s = Scm_NumberToString(num, 10, 0);
+        const ScmStringBody *b = SCM_STRING_BODY(s);
+        w_putz(w, SCM_STRING_BODY_START(b), SCM_STRING_BODY_SIZE(b));
+    }
+}
+
+static void w_value(json_writer *w, ScmObj obj)
+{
+    if (SCM_FALSEP(obj) || SCM_EQ(obj, sym_false)) {
+        w_putz(w, "false", 5);
+    } else if (SCM_TRUEP(obj) || SCM_EQ(obj, sym_true)) {
+        w_putz(w, "true", 4);
+    } else if (SCM_EQ(obj, sym_null)) {
+        w_putz(w, "null", 4);
+    } else if (SCM_NULLP(obj) || (SCM_PAIRP(obj) && Scm_Length(obj) >= 0)) {
+        w_object(w, obj);
+    } else if (SCM_STRINGP(obj)) {
+        w_string(w, SCM_STRING(obj));
+    } else if (SCM_INTEGERP(obj)
+               || (SCM_FLONUMP(obj) && isfinite(SCM_FLONUM_VALUE(obj)))) {
+        w_number(w, obj);
+    } else if (SCM_VECTORP(obj)) {
+        w_array(w, obj);
+    } else {
+        w_fallback(w, obj);
+    }
+}
+
+void Scm_JsonWrite(ScmObj obj, ScmPort *port, ScmObj fallback, ScmObj keyproc)
+{
+    /* The buffer is large; allocate it instead of putting it on the
+       C stack, since we may be called recursively via the fallback. */
+    json_writer *w = SCM_NEW(json_writer);
+    w->port = port;
+    w->fallback = fallback;
+    w->keyproc = keyproc;
+    w->len = 0;
+    w_value(w, obj);
+    w_flush(w);
+}
+
+/*==================================================================
+ * Initialization
+ */
+
+extern void Scm_Init_jsonaux(void);
+
+SCM_EXTENSION_ENTRY void Scm_Init_rfc__json(void)
+{
+    SCM_INIT_EXTENSION(rfc__json);
+    ScmModule *mod = SCM_FIND_MODULE("rfc.json", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_JsonReaderClass, "<json-reader>", mod, NULL, 0);
+
+    sym_true  = SCM_INTERN("true");
+    sym_false = SCM_INTERN("false");
+    sym_null  = SCM_INTERN("null");
+    sym_start_object = SCM_INTERN("start-object");
+    sym_end_object   = SCM_INTERN("end-object");
+    sym_start_array  = SCM_INTERN("start-array");
+    sym_end_array    = SCM_INTERN("end-array");
+    sym_key   = SCM_INTERN("key");
+    sym_value = SCM_INTERN("value");
+
+    Scm_Init_jsonaux();
+}
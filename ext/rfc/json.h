@@ -0,0 +1,79 @@
+/*
+ * json.h - native JSON reader and writer
+ *
+ *   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_RFC_JSON_H
+#define GAUCHE_RFC_JSON_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* A JSON reader reads either from a string body directly, or from
+   an input port byte by byte, so that it never reads past the end of
+   a JSON value.  It keeps the nesting state, so the document can be
+   read either as a whole value or as a sequence of events. */
+typedef struct ScmJsonReaderRec {
+    SCM_HEADER;
+    ScmObj src;                 /* the source string or port */
+    ScmPort *port;              /* non-NULL if reading from a port */
+    const unsigned char *cur;   /* for string source */
+    const unsigned char *end;
+    ScmSize pos;                /* # of bytes read so far */
+    ScmObj errproc;             /* called with position and message */
+    int state;                  /* parser state; see json.c */
+    char *stack;                /* nesting containers ('[' or '{') */
+    ScmSize depth;
+    ScmSize stackSize;
+    char *buf;                  /* scratch buffer for tokens */
+    ScmSize bufSize;
+    ScmObj *frames;             /* used by Scm_JsonReadValue */
+    ScmSize framesSize;
+} ScmJsonReader;
+
+SCM_CLASS_DECL(Scm_JsonReaderClass);
+#define SCM_CLASS_JSON_READER   (&Scm_JsonReaderClass)
+#define SCM_JSON_READER(obj)    ((ScmJsonReader*)(obj))
+#define SCM_JSON_READER_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_JSON_READER)
+
+SCM_EXTERN ScmObj Scm_MakeJsonReader(ScmObj src, ScmObj errproc);
+SCM_EXTERN ScmObj Scm_JsonReadValue(ScmJsonReader *r, ScmObj arrayHandler,
+                                    ScmObj objectHandler,
+                                    ScmObj specialHandler);
+SCM_EXTERN ScmObj Scm_JsonReadEvent(ScmJsonReader *r, ScmObj specialHandler);
+
+SCM_EXTERN void   Scm_JsonWrite(ScmObj obj, ScmPort *port,
+                                ScmObj fallback, ScmObj keyproc);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_RFC_JSON_H*/
@@ -33,14 +33,14 @@
 
 ;;; http://www.ietf.org/rfc/rfc7159.txt
 
-;; NOTE: This module depends on parser.peg, whose API is not officially
-;; fixed.  Hence do not take this code as an example of parser.peg;
-;; this will likely to be rewritten once parser.peg's API is changed.
+;; The reader and the writer are written in C (json.c).  The parser.peg
+;; version of the parser is kept as json-parser, for it can be combined
+;; with other parsers.  NB: parser.peg's API is not officially fixed.
+;; Hence do not take json-parser as an example of parser.peg.
 
 (define-module rfc.json
   (use gauche.parameter)
   (use gauche.sequence)
-  (use gauche.generator)
   (use parser.peg)
   (use gauche.unicode)
   (use srfi-13)
@@ -49,6 +49,7 @@
   (export <json-parse-error> <json-construct-error>
           parse-json parse-json-string
           parse-json*
+          json-event-generator
           construct-json construct-json-string
 
           json-array-handler json-object-handler json-special-handler
@@ -57,6 +58,8 @@
           ))
 (select-module rfc.json)
 
+(dynamic-load "rfc--json")
+
 ;; NB: We have <json-parse-error> independent from <parse-error> for
 ;; now, since parser.peg's interface may be changed later.
 (define-condition-type <json-parse-error> <error> #f
@@ -70,12 +73,58 @@
 (define json-object-handler  (make-parameter identity))
 (define json-special-handler (make-parameter identity))
 
+;; The native reader takes #f as a handler to use the built-in default,
+;; which saves calling back to Scheme for every array and object.
+(define (native-handler param default)
+  (let1 h (param)
+    (if (eq? h default) #f h)))
+
 (define (build-array elts) ((json-array-handler) elts))
 (define (build-object pairs) ((json-object-handler) pairs))
 (define (build-special symbol) ((json-special-handler) symbol))
 
 ;;;============================================================
-;;; Parser
+;;; Native reader
+;;;
+
+(define (read-error pos msg)
+  (error <json-parse-error> :position pos :objects #f msg))
+
+(define (make-reader src) (%make-json-reader src read-error))
+
+(define (read-value reader)
+  (%json-read-value reader
+                    (native-handler json-array-handler list->vector)
+                    (native-handler json-object-handler identity)
+                    (native-handler json-special-handler identity)))
+
+;; entry point
+(define (parse-json :optional (port (current-input-port)))
+  (read-value (make-reader port)))
+
+(define (parse-json-string str)
+  (read-value (make-reader str)))
+
+(define (parse-json* :optional (port (current-input-port)))
+  (let1 reader (make-reader port)
+    (let loop ([r '()])
+      (let1 v (read-value reader)
+        (if (eof-object? v)
+          (reverse! r)
+          (loop (cons v r)))))))
+
+;; Returns a generator of parse events, without building the whole
+;; value.  Each event is one of the symbols start-object, end-object,
+;; start-array and end-array, or a pair (key . string) or
+;; (value . value), where value is a string, a number, or a special
+;; value returned by json-special-handler.
+(define (json-event-generator :optional (src (current-input-port)))
+  (let ([reader (make-reader src)]
+        [special (native-handler json-special-handler identity)])
+    (^[] (%json-read-event reader special))))
+
+;;;============================================================
+;;; PEG parser
 ;;;
 (define %ws ($many_ ($. #[ \t\r\n])))
 
@@ -171,39 +220,21 @@
 
 (define json-parser ($seq %ws ($or ($eos) %value)))
 
-;; entry point
-(define (parse-json :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (peg-parse-port json-parser port)))
-
-(define (parse-json-string str)
-  (call-with-input-string str (cut parse-json <>)))
-
-(define (parse-json* :optional (port (current-input-port)))
-  (guard (e [(<parse-error> e)
-             ;; not to expose parser.peg's <parse-error>.
-             (error <json-parse-error>
-                    :position (~ e'position) :objects (~ e'objects)
-                    :message (~ e'message))])
-    (generator->list (peg-parser->generator json-parser port))))
-
 ;;;============================================================
 ;;; Writer
 ;;;
 
+;; The native writer handles specials, alists, strings, integers, finite
+;; flonums and vectors by itself, and calls print-fallback for other
+;; objects.
 (define (print-value obj)
-  (cond [(or (eq? obj 'false) (eq? obj #f)) (display "false")]
-        [(or (eq? obj 'true) (eq? obj #t))  (display "true")]
-        [(eq? obj 'null)  (display "null")]
-        [(list? obj)      (print-object obj)]
-        [(string? obj)    (print-string obj)]
+  (%json-write obj (current-output-port) print-fallback x->string))
+
+(define (print-fallback obj)
+  (cond [(list? obj)      (print-object obj)] ; only when it's a bad alist
         [(number? obj)    (print-number obj)]
         [(is-a? obj <dictionary>) (print-object obj)]
-        [(is-a? obj <sequence>)   (print-array obj)]
+        [(and (is-a? obj <sequence>) (not (string? obj))) (print-array obj)]
         [else (error <json-construct-error> :object obj
                      "can't convert Scheme object to json:" obj)]))
 
@@ -215,7 +246,7 @@
                    "construct-json needs an assoc list or dictionary, \
                     but got:" obj))
           (display comma)
-          (print-string (x->string (car attr)))
+          (print-value (x->string (car attr)))
           (display ":")
           (print-value (cdr attr))
           ",")
@@ -238,30 +269,12 @@
          (write (exact->inexact num))]
         [else (write num)]))
 
-(define (print-string str)
-  (define specials
-    '((#\" . #\") (#\\ . #\\) (#\x08 . #\b) (#\page . #\f)
-      (#\newline . #\n) (#\return . #\r) (#\tab . #\t)))
-  (define (hexescape code) (format #t "\\u~4,'0x" code))
-  (define (print-char c)
-    (cond [(assv c specials) => (^p (write-char #\\) (write-char (cdr p)))]
-          [(and (char-set-contains? char-set:ascii c)
-                (not (eq? (char-general-category c) 'Cc)))
-           (write-char c)]
-          [else
-           (let1 code (char->ucs c)
-             (if (>= code #x10000)
-               (for-each hexescape (ucs4->utf16 code))
-               (hexescape code)))]))
-  (display "\"")
-  (string-for-each print-char str)
-  (display "\""))
-
 (define (construct-json x :optional (oport (current-output-port)))
   (with-output-to-port oport
     (^()
-      (cond [(or (list? x) (is-a? x <dictionary>)) (print-object x)]
-            [(and (is-a? x <sequence>) (not (string? x))) (print-array x)]
+      (cond [(or (list? x) (is-a? x <dictionary>)
+                 (and (is-a? x <sequence>) (not (string? x))))
+             (print-value x)]
             [else (error <json-construct-error> :object x
                          "construct-json expects a list or a vector, \
                           but got" x)]))))
@@ -0,0 +1,66 @@
+;;;
+;;; jsonaux.scm - native JSON reader and writer
+;;;
+;;;   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+
+;; This is compiled into rfc--json.so, which is loaded by rfc.json.
+
+(select-module rfc.json)
+
+(inline-stub
+ (declcode
+  (.include "json.h"))
+
+ (define-type <json-reader> "ScmJsonReader*" "json reader"
+   "SCM_JSON_READER_P" "SCM_JSON_READER")
+
+ ;; SRC is a string or an input port.  ERRPROC is called with the position
+ ;; and the message on a parse error; it must not return.
+ (define-cproc %make-json-reader (src errproc) Scm_MakeJsonReader)
+
+ ;; Handlers may be #f to use the default behavior, that is,
+ ;; arrays become vectors, objects become alists and specials become
+ ;; symbols.
+ (define-cproc %json-read-value (r::<json-reader> array-handler
+                                                  object-handler
+                                                  special-handler)
+   Scm_JsonReadValue)
+
+ (define-cproc %json-read-event (r::<json-reader> special-handler)
+   Scm_JsonReadEvent)
+
+ ;; FALLBACK is called with an object the native writer doesn't handle.
+ ;; KEYPROC converts an object key other than strings and symbols to
+ ;; a string.
+ (define-cproc %json-write (obj port::<output-port> fallback keyproc)
+   ::<void> Scm_JsonWrite)
+ )
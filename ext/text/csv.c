@@ -0,0 +1,466 @@
+/*
+ * csv.c - native CSV tokenizer
+ *
+ *   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <gauche.h>
+#include <gauche/extend.h>
+#include "csv.h"
+
+SCM_DEFINE_BUILTIN_CLASS_SIMPLE(Scm_CsvTokenizerClass, NULL);
+
+/* Byte classes.  The order matters; see scan(). */
+enum {
+    C_DATA,
+    C_QUOTE,
+    C_SPACE,                    /* ASCII whitespace except newline */
+    C_SEP,
+    C_NL,
+    C_MB                        /* non-ASCII byte */
+};
+
+ScmObj Scm_MakeCsvTokenizer(ScmChar separator, ScmChar quote, int vectorp)
+{
+    if (separator >= 0x80 || separator == '\n') {
+        Scm_Error("unsupported separator for the native tokenizer: %C",
+                  separator);
+    }
+    if (quote >= 0x80 || quote == '\n' || quote == separator) {
+        Scm_Error("unsupported quote character for the native tokenizer: %C",
+                  quote);
+    }
+
+    ScmCsvTokenizer *t = SCM_NEW(ScmCsvTokenizer);
+    SCM_SET_CLASS(t, SCM_CLASS_CSV_TOKENIZER);
+    t->separator = separator;
+    t->quote = quote;
+    t->vectorp = vectorp;
+    for (int i=0; i<256; i++) t->cls[i] = (i < 0x80)? C_DATA : C_MB;
+    t->cls[' '] = t->cls['\t'] = t->cls['\v'] = t->cls['\f'] = C_SPACE;
+    t->cls['\r'] = C_SPACE;
+    t->cls['\n'] = C_NL;
+    /* The separator takes precedence over the quote, as in the Scheme
+       version. */
+    t->cls[quote] = C_QUOTE;
+    t->cls[separator] = C_SEP;
+    return SCM_OBJ(t);
+}
+
+/*==================================================================
+ * Tokenizer
+ */
+
+/* The rules are the same as csv-reader in csv.scm: Whitespaces around
+   unquoted fields are trimmed, a quoted field may contain separators
+   and newlines, a doubled quote in a quoted field stands for a quote
+   character, and anything between the closing quote and the next
+   separator is ignored. */
+enum {
+    S_START,                    /* beginning of a field */
+    S_UNQUOTED,                 /* in an unquoted field */
+    S_QUOTED,                   /* in a quoted field */
+    S_QUOTE_SEEN,               /* after a quote in a quoted field */
+    S_QTAIL                     /* after the closing quote */
+};
+
+#define INLINE_BUFFER_SIZE  256
+#define INLINE_FIELDS       32
+
+/* The state of reading a row.  It lives on the C stack, and the
+   inline buffers suffice for most rows. */
+typedef struct row_state_rec {
+    ScmCsvTokenizer *t;
+    int state;
+    int pending;                /* # of remaining bytes of a multibyte
+                                   character */
+    int skip;                   /* if TRUE, we only find the boundaries
+                                   and don't create fields */
+    char *buf;                  /* the current field */
+    ScmSize len;
+    ScmSize size;
+    ScmSize lastlen;            /* length up to the last non-whitespace
+                                   character of an unquoted field */
+    ScmSize mbstart;            /* start of the pending multibyte char */
+    ScmObj *fields;             /* fields of the current row */
+    ScmSize nfields;
+    ScmSize fieldsSize;
+    char ibuf[INLINE_BUFFER_SIZE];
+    ScmObj ifields[INLINE_FIELDS];
+} row_state;
+
+static void init_row(row_state *st, ScmCsvTokenizer *t, int skip)
+{
+    st->t = t;
+    st->state = S_START;
+    st->pending = 0;
+    st->skip = skip;
+    st->buf = st->ibuf;
+    st->len = st->lastlen = st->mbstart = 0;
+    st->size = INLINE_BUFFER_SIZE;
+    st->fields = st->ifields;
+    st->nfields = 0;
+    st->fieldsSize = INLINE_FIELDS;
+}
+
+static inline void new_row(row_state *st)
+{
+    st->state = S_START;
+    st->pending = 0;
+    st->len = st->lastlen = 0;
+    st->nfields = 0;
+}
+
+static void buf_ensure(row_state *st, ScmSize more)
+{
+    if (st->len + more > st->size) {
+        ScmSize newsize = st->size * 2;
+        while (newsize < st->len + more) newsize *= 2;
+        char *nb = SCM_NEW_ATOMIC2(char*, newsize);
+        memcpy(nb, st->buf, st->len);
+        st->buf = nb;
+        st->size = newsize;
+    }
+}
+
+static inline void field_put(row_state *st, const unsigned char *p,
+                             ScmSize n)
+{
+    if (st->skip || n == 0) return;
+    buf_ensure(st, n);
+    memcpy(st->buf + st->len, p, n);
+    st->len += n;
+}
+
+/* Bytes of a multibyte character are always stored, even in skip mode,
+   since we need to decode it to see if it is a whitespace. */
+static inline void mb_put(row_state *st, unsigned char b)
+{
+    buf_ensure(st, 1);
+    st->buf[st->len++] = b;
+}
+
+static void push_field(row_state *st)
+{
+    if (!st->skip) {
+        ScmObj s = Scm_MakeString(st->buf, st->len, -1, SCM_STRING_COPYING);
+        if (st->nfields >= st->fieldsSize) {
+            ScmSize newsize = st->fieldsSize * 2;
+            ScmObj *nf = SCM_NEW_ARRAY(ScmObj, newsize);
+            memcpy(nf, st->fields, st->nfields * sizeof(ScmObj));
+            st->fields = nf;
+            st->fieldsSize = newsize;
+        }
+        st->fields[st->nfields++] = s;
+    }
+    st->len = st->lastlen = 0;
+}
+
+static inline void push_unquoted(row_state *st)
+{
+    if (!st->skip) st->len = st->lastlen; /* trim trailing whitespaces */
+    push_field(st);
+}
+
+/* Called when we have all the bytes of a non-ASCII character. */
+static void mb_done(row_state *st)
+{
+    ScmChar ch;
+    SCM_CHAR_GET(st->buf + st->mbstart, ch);
+    int ws = SCM_CHAR_EXTRA_WHITESPACE(ch);
+
+    switch (st->state) {
+    case S_START:
+        if (ws) {
+            st->len = st->mbstart;  /* skip leading whitespace */
+        } else {
+            st->state = S_UNQUOTED;
+            st->lastlen = st->len;
+        }
+        break;
+    case S_UNQUOTED:
+        if (!ws) st->lastlen = st->len;
+        break;
+    }
+}
+
+static inline void mb_start(row_state *st, unsigned char b)
+{
+    st->mbstart = st->len;
+    mb_put(st, b);
+    st->pending = SCM_CHAR_NFOLLOWS(b);
+    if (st->pending == 0) mb_done(st);
+}
+
+/* Scans bytes in [s, e) as a part of the current row, and returns the
+   number of bytes consumed.  If the row is terminated by a newline,
+   it is consumed and *done is set. */
+static ScmSize scan(row_state *st, const unsigned char *s,
+                    const unsigned char *e, int *done)
+{
+    const unsigned char *cls = st->t->cls;
+    const unsigned char *p = s;
+
+    while (p < e) {
+        if (st->pending > 0) {
+            if (st->state != S_QTAIL) mb_put(st, *p);
+            p++;
+            if (--st->pending == 0 && st->state != S_QTAIL) mb_done(st);
+            continue;
+        }
+
+        switch (st->state) {
+        case S_START:
+            switch (cls[*p]) {
+            case C_SPACE: p++; continue;
+            case C_QUOTE: p++; st->state = S_QUOTED; continue;
+            case C_SEP:   p++; push_field(st); continue;
+            case C_NL:    p++; push_field(st); *done = TRUE; return p - s;
+            case C_MB:    mb_start(st, *p++); continue;
+            default:      st->state = S_UNQUOTED; continue;
+            }
+        case S_UNQUOTED:
+            {
+                /* Take a run of ASCII data and whitespaces at once. */
+                const unsigned char *q = p, *last = NULL;
+                int c;
+                while (q < e && (c = cls[*q]) <= C_SPACE) {
+                    q++;
+                    if (c != C_SPACE) last = q;
+                }
+                field_put(st, p, q - p);
+                if (last && !st->skip) st->lastlen = st->len - (q - last);
+                p = q;
+                if (p == e) break;
+                switch (cls[*p]) {
+                case C_SEP:
+                    p++;
+                    push_unquoted(st);
+                    st->state = S_START;
+                    continue;
+                case C_NL:
+                    p++;
+                    push_unquoted(st);
+                    *done = TRUE;
+                    return p - s;
+                default:        /* C_MB */
+                    mb_start(st, *p++);
+                    continue;
+                }
+            }
+        case S_QUOTED:
+            {
+                const unsigned char *q;
+#if defined(GAUCHE_CHAR_ENCODING_SJIS)
+                /* A trailing byte of a multibyte character can be
+                   the same as the quote character. */
+                q = p;
+                while (q < e && cls[*q] != C_QUOTE && cls[*q] != C_MB) q++;
+#else
+                q = memchr(p, st->t->quote, e - p);
+                if (q == NULL) q = e;
+#endif
+                field_put(st, p, q - p);
+                p = q;
+                if (p == e) break;
+                if (cls[*p] == C_QUOTE) {
+                    p++;
+                    st->state = S_QUOTE_SEEN;
+                } else {
+                    mb_start(st, *p++);
+                }
+                continue;
+            }
+        case S_QUOTE_SEEN:
+            if (cls[*p] == C_QUOTE) {
+                field_put(st, p, 1);    /* doubled quote */
+                p++;
+                st->state = S_QUOTED;
+            } else {
+                push_field(st);
+                st->state = S_QTAIL;
+            }
+            continue;
+        case S_QTAIL:
+            switch (cls[*p]) {
+            case C_SEP: p++; st->state = S_START; continue;
+            case C_NL:  p++; *done = TRUE; return p - s;
+            case C_MB:  st->pending = SCM_CHAR_NFOLLOWS(*p); p++; continue;
+            default:    p++; continue;
+            }
+        }
+    }
+    return p - s;
+}
+
+/* The input ends without a newline. */
+static void scan_eof(row_state *st)
+{
+    switch (st->state) {
+    case S_START:
+    case S_QUOTE_SEEN:
+        push_field(st);
+        break;
+    case S_UNQUOTED:
+        push_unquoted(st);
+        break;
+    case S_QUOTED:
+        Scm_Error("unterminated quoted field");
+        break;
+    }
+}
+
+static ScmObj make_row(row_state *st)
+{
+    ScmSize n = st->nfields;
+    if (st->t->vectorp) {
+        ScmObj v = Scm_MakeVector(n, SCM_FALSE);
+        for (ScmSize i=0; i<n; i++) SCM_VECTOR_ELEMENT(v, i) = st->fields[i];
+        return v;
+    } else {
+        ScmObj r = SCM_NIL;
+        for (ScmSize i=n-1; i>=0; i--) r = Scm_Cons(st->fields[i], r);
+        return r;
+    }
+}
+
+/*==================================================================
+ * Reading from a port
+ */
+
+/* Scm_ScanBytes hands us the port's buffer, and we take care not to
+   consume bytes beyond the end of the row. */
+typedef struct port_scan_rec {
+    row_state st;
+    ScmSize nbytes;
+} port_scan;
+
+static ScmSize port_scanner(const char *s, const char *e, int *done,
+                            void *data)
+{
+    port_scan *ps = (port_scan*)data;
+    ScmSize n = scan(&ps->st, (const unsigned char*)s,
+                     (const unsigned char*)e, done);
+    ps->nbytes += n;
+    return n;
+}
+
+ScmObj Scm_CsvReadRow(ScmCsvTokenizer *t, ScmPort *p)
+{
+    port_scan ps;
+
+    init_row(&ps.st, t, FALSE);
+    ps.nbytes = 0;
+    if (!Scm_ScanBytes(p, port_scanner, &ps)) {
+        if (ps.nbytes == 0) return SCM_EOF;
+        scan_eof(&ps.st);
+    }
+    return make_row(&ps.st);
+}
+
+/*==================================================================
+ * Reading from a string
+ */
+
+static const unsigned char *string_range(ScmString *str, ScmSize *start,
+                                         ScmSize *end)
+{
+    const ScmStringBody *b = SCM_STRING_BODY(str);
+    ScmSize size = SCM_STRING_BODY_SIZE(b);
+    if (*end < 0 || *end > size) *end = size;
+    if (*start < 0 || *start > *end) {
+        Scm_Error("start offset out of range: %ld", (long)*start);
+    }
+    return (const unsigned char*)SCM_STRING_BODY_START(b);
+}
+
+/* Returns a list of rows in the byte range [start, end) of STR.
+   The range must begin at the beginning of a row. */
+ScmObj Scm_CsvParseString(ScmCsvTokenizer *t, ScmString *str,
+                          ScmSize start, ScmSize end)
+{
+    const unsigned char *s = string_range(str, &start, &end);
+    ScmObj h = SCM_NIL, tail = SCM_NIL;
+    row_state st;
+
+    init_row(&st, t, FALSE);
+    while (start < end) {
+        int done = FALSE;
+        new_row(&st);
+        start += scan(&st, s + start, s + end, &done);
+        if (!done) scan_eof(&st);
+        SCM_APPEND1(h, tail, make_row(&st));
+    }
+    return h;
+}
+
+/* Returns a list of byte offsets of row boundaries that divide STR
+   into about NCHUNKS chunks of similar size.  The list begins with 0
+   and ends with the size of STR.  We have to run the tokenizer to
+   find the boundaries, since a newline may appear in a quoted field;
+   but it is much faster than parsing, for we don't create fields. */
+ScmObj Scm_CsvSplitPoints(ScmCsvTokenizer *t, ScmString *str, int nchunks)
+{
+    ScmSize start = 0, size = -1;
+    const unsigned char *s = string_range(str, &start, &size);
+    ScmObj h = SCM_NIL, tail = SCM_NIL;
+    ScmSize pos = 0;
+    row_state st;
+
+    init_row(&st, t, TRUE);
+    SCM_APPEND1(h, tail, SCM_MAKE_INT(0));
+    for (int i=1; i<nchunks && pos < size; i++) {
+        ScmSize target = (ScmSize)((double)size * i / nchunks);
+        while (pos < target) {
+            int done = FALSE;
+            new_row(&st);
+            pos += scan(&st, s + pos, s + size, &done);
+        }
+        if (pos < size) SCM_APPEND1(h, tail, Scm_MakeInteger(pos));
+    }
+    if (size > 0) SCM_APPEND1(h, tail, Scm_MakeInteger(size));
+    return h;
+}
+
+/*==================================================================
+ * Initialization
+ */
+
+extern void Scm_Init_csvaux(void);
+
+SCM_EXTENSION_ENTRY void Scm_Init_text__csv(void)
+{
+    SCM_INIT_EXTENSION(text__csv);
+    ScmModule *mod = SCM_FIND_MODULE("text.csv", SCM_FIND_MODULE_CREATE);
+    Scm_InitStaticClass(&Scm_CsvTokenizerClass, "<csv-tokenizer>", mod,
+                        NULL, 0);
+    Scm_Init_csvaux();
+}
@@ -0,0 +1,67 @@
+/*
+ * csv.h - native CSV tokenizer
+ *
+ *   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GAUCHE_TEXT_CSV_H
+#define GAUCHE_TEXT_CSV_H
+
+#include <gauche.h>
+
+SCM_DECL_BEGIN
+
+/* A tokenizer only holds the configuration; the state of reading a row
+   is kept on the C stack, so that a tokenizer can be shared among
+   threads. */
+typedef struct ScmCsvTokenizerRec {
+    SCM_HEADER;
+    ScmChar separator;
+    ScmChar quote;
+    int vectorp;                /* rows are vectors instead of lists */
+    unsigned char cls[256];     /* byte class table; see csv.c */
+} ScmCsvTokenizer;
+
+SCM_CLASS_DECL(Scm_CsvTokenizerClass);
+#define SCM_CLASS_CSV_TOKENIZER   (&Scm_CsvTokenizerClass)
+#define SCM_CSV_TOKENIZER(obj)    ((ScmCsvTokenizer*)(obj))
+#define SCM_CSV_TOKENIZER_P(obj)  SCM_XTYPEP(obj, SCM_CLASS_CSV_TOKENIZER)
+
+SCM_EXTERN ScmObj Scm_MakeCsvTokenizer(ScmChar separator, ScmChar quote,
+                                       int vectorp);
+SCM_EXTERN ScmObj Scm_CsvReadRow(ScmCsvTokenizer *t, ScmPort *port);
+SCM_EXTERN ScmObj Scm_CsvParseString(ScmCsvTokenizer *t, ScmString *str,
+                                     ScmSize start, ScmSize end);
+SCM_EXTERN ScmObj Scm_CsvSplitPoints(ScmCsvTokenizer *t, ScmString *str,
+                                     int nchunks);
+
+SCM_DECL_END
+
+#endif /*GAUCHE_TEXT_CSV_H*/
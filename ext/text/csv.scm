@@ -38,7 +38,9 @@
   (use srfi-14)
   (use srfi-42)
   (use gauche.sequence)
+  (use gauche.threads)
   (export make-csv-reader
+          csv-file->rows
           make-csv-writer
           make-csv-header-parser
           make-csv-record-parser
@@ -46,14 +48,77 @@
   )
 (select-module text.csv)
 
+(dynamic-load "text--csv")
+
 ;;;
 ;;;Low-level API - convert text into nested lists
 ;;;
 
+;; The native tokenizer handles ASCII separator and quote characters,
+;; which covers practically all cases.  Otherwise we use csv-reader below.
+(define (native-tokenizer sep quo row-type)
+  (and (char? sep) (char? quo)
+       (< (char->integer sep) #x80) (< (char->integer quo) #x80)
+       (not (memv #\newline (list sep quo)))
+       (not (eqv? sep quo))
+       (%make-csv-tokenizer sep quo (eq? row-type 'vector))))
+
+(define (check-row-type row-type)
+  (unless (memq row-type '(list vector))
+    (error "row-type must be either list or vector, but got:" row-type)))
+
 ;; API
-(define (make-csv-reader separator :optional (quote-char #\"))
-  (^[:optional (port (current-input-port))]
-    (csv-reader separator quote-char port)))
+(define (make-csv-reader separator :optional (quote-char #\")
+                         :key (row-type 'list))
+  (check-row-type row-type)
+  (if-let1 t (native-tokenizer separator quote-char row-type)
+    (^[:optional (port (current-input-port))] (%csv-read-row t port))
+    (let1 conv (if (eq? row-type 'vector) list->vector identity)
+      (^[:optional (port (current-input-port))]
+        (let1 row (csv-reader separator quote-char port)
+          (if (eof-object? row) row (conv row)))))))
+
+;; API
+;; Reads all rows in FILE.  If THREADS is more than 1, the file is split
+;; at row boundaries and the chunks are parsed in parallel.  THREADS <= 0
+;; means the number of available processors.
+(define (csv-file->rows file separator :key (quote-char #\")
+                                            (row-type 'list)
+                                            (threads 1)
+                                            (encoding #f))
+  (check-row-type row-type)
+  (let ([t (native-tokenizer separator quote-char row-type)]
+        [nthreads (if (<= threads 0) (sys-available-processors) threads)])
+    (define (open-file)
+      (if encoding
+        (open-input-file file :encoding encoding)
+        (open-input-file file)))
+    (cond
+     [(not t)
+      (let ([reader (make-csv-reader separator quote-char :row-type row-type)]
+            [port (open-file)])
+        (unwind-protect (port->list reader port)
+          (close-input-port port)))]
+     [else
+      (let1 str (let1 port (open-file)
+                  (unwind-protect (port->string port)
+                    (close-input-port port)))
+        (if (or (= nthreads 1) (not (threads-available?)))
+          (%csv-parse-string t str)
+          (parse-in-parallel t str nthreads)))])))
+
+(define (threads-available?)
+  (not (eq? (gauche-thread-type) 'none)))
+
+(define (parse-in-parallel t str nthreads)
+  (define (spawn start end)
+    (thread-start! (make-thread (^[] (%csv-parse-string t str start end)))))
+  (define (join thread)
+    (guard (e [(uncaught-exception? e) (raise (uncaught-exception-reason e))])
+      (thread-join! thread)))
+  (let* ([points (%csv-split-points t str nthreads)]
+         [threads (map spawn points (cdr points))])
+    (append-map! join threads)))
 
 (define (csv-reader sep quo port)
   (define (eor? ch) (or (eqv? ch #\newline) (eof-object? ch)))
@@ -0,0 +1,65 @@
+;;;
+;;; csvaux.scm - native CSV tokenizer
+;;;
+;;;   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+;; This is compiled into text--csv.so, which is loaded by text.csv.
+
+(select-module text.csv)
+
+(inline-stub
+ (declcode
+  (.include "csv.h"))
+
+ (define-type <csv-tokenizer> "ScmCsvTokenizer*" "csv tokenizer"
+   "SCM_CSV_TOKENIZER_P" "SCM_CSV_TOKENIZER")
+
+ ;; SEPARATOR and QUOTE must be ASCII characters other than a newline.
+ (define-cproc %make-csv-tokenizer (separator::<char> quote::<char>
+                                    vector?::<boolean>)
+   Scm_MakeCsvTokenizer)
+
+ ;; Returns a row, or EOF if PORT is at the end.
+ (define-cproc %csv-read-row (t::<csv-tokenizer> port::<input-port>)
+   Scm_CsvReadRow)
+
+ ;; Returns a list of rows in the byte range [START, END) of STR.
+ (define-cproc %csv-parse-string (t::<csv-tokenizer> str::<string>
+                                  :optional (start::<fixnum> 0)
+                                            (end::<fixnum> -1))
+   Scm_CsvParseString)
+
+ ;; Returns a list of byte offsets of row boundaries, dividing STR
+ ;; into about NCHUNKS chunks.
+ (define-cproc %csv-split-points (t::<csv-tokenizer> str::<string>
+                                  nchunks::<int>)
+   Scm_CsvSplitPoints)
+ )
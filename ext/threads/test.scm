@@ -552,6 +552,40 @@
                   (thread-start! t1)
                   (list (thread-join! t0) (thread-join! t1))))))
 
+;;---------------------------------------------------------------------
+(test-section "concurrent module access")
+
+;; Global lookups don't take the module lock.  Make sure they see the
+;; existing bindings while another thread keeps adding bindings (hence
+;; extending the hash tables) and imports.
+(let ([mod (make-module #f)]
+      [names (map (^i (string->symbol (format "mod-test-~d" i))) (iota 100))])
+  (dolist [n names] (eval `(define ,n ',n) mod))
+  (let* ([done #f]
+         [writer (make-thread
+                  (^[]
+                    (dotimes [i 5000]
+                      (eval `(define ,(string->symbol (format "new-~d" i)) ,i)
+                            mod)
+                      (when (zero? (modulo i 500))
+                        (eval '(import gauche.internal) mod)))
+                    (set! done #t)))]
+         [lookup-errors
+          (^[] (count (^n (not (eq? n (global-variable-ref mod n #f))))
+                      names))]
+         [readers (map (^_ (make-thread
+                            (^[]
+                              (let loop ([errors 0])
+                                (if done
+                                  errors
+                                  (loop (+ errors (lookup-errors))))))))
+                       (iota 4))])
+    (for-each thread-start! (cons writer readers))
+    (thread-join! writer)
+    (test* "lookup during definitions" '(0 0 0 0)
+           (map thread-join! readers))
+    (test* "new bindings" 4999 (global-variable-ref mod 'new-4999 #f))))
+
 ;;---------------------------------------------------------------------
 (test-section "synchrnization by queues")
 
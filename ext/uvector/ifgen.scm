@@ -164,7 +164,13 @@
 (define *extra-api-scalar*
   '(@vector-clamp
     @vector-clamp!
-    @vector-range-check))
+    @vector-range-check
+    @vector-sum
+    @vector-min
+    @vector-max
+    @vector-argmin
+    @vector-argmax
+    @vector-norm))
 
 (define *extra-api-multibyte*
   '(@vector-swap-bytes
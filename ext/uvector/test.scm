@@ -905,6 +905,100 @@
 (dotprod-test-f64 #f64(32767 -32767 32767 -32767 32767)
                   #f64(32767 -32767 32767 -32767 32767))
 
+;; f32 and f64 vectors go through bulk kernels; check various lengths
+;; so that both vectorized part and leftovers are exercised.
+(expand-uvec
+ (f32 f64)
+ (dotimes [n 19]
+   (let ([v0 (list->@vector (map (^i (- (* i 1.5) 4)) (iota n)))]
+         [v1 (list->@vector (map (^i (+ (* i 0.25) 1)) (iota n)))])
+     (define (expected op)
+       (@vector->list (list->@vector (map op (@vector->list v0)
+                                          (@vector->list v1)))))
+     (test* (format #f "@vector arithmetic (len=~a)" n)
+            (list (expected +) (expected -) (expected *) (expected /)
+                  (fold (^[a b s] (+ s (* a b))) 0.0
+                        (@vector->list v0) (@vector->list v1)))
+            (list (@vector->list (@vector-add v0 v1))
+                  (@vector->list (@vector-sub v0 v1))
+                  (@vector->list (@vector-mul v0 v1))
+                  (@vector->list (@vector-div v0 v1))
+                  (@vector-dot v0 v1))))))
+
+;; the destination partially overlaps with the source, so the elements
+;; must be processed one by one.
+(test* "f64vector-add! on overlapping alias"
+       #f64(1 3 6 10 15)
+       (let* ([v (f64vector 0 1 2 3 4 5)]
+              [a (uvector-alias <f64vector> v 0 5)]
+              [b (uvector-alias <f64vector> v 1 6)])
+         (f64vector-add! b a)
+         b))
+
+;;-------------------------------------------------------------------
+(test-section "reductions")
+
+(define (reduction-test tag v lis sum norm
+                        vsum vmin vmax vargmin vargmax vnorm)
+  (test* (format #f "~avector-sum ~s" tag v) sum (vsum v))
+  (test* (format #f "~avector-min/max/argmin/argmax ~s" tag v)
+         (if (null? lis)
+           '(none none #f #f)
+           (let ([mi (apply min lis)]
+                 [ma (apply max lis)])
+             (list mi ma
+                   (list-index (cut = mi <>) lis)
+                   (list-index (cut = ma <>) lis))))
+         (list (vmin v 'none) (vmax v 'none) (vargmin v) (vargmax v)))
+  (test* (format #f "~avector-norm ~s" tag v) norm (vnorm v)
+         (^[a b] (< (abs (- a b)) 1e-6))))
+
+(expand-uvec
+ (u8 s8 u16 s16 u32 s32 u64 s64 f16 f32 f64)
+ (define (reduction-test-@ lis sum norm)
+   (reduction-test '@ (list->@vector lis) lis sum norm
+                   @vector-sum @vector-min @vector-max
+                   @vector-argmin @vector-argmax @vector-norm)))
+
+(reduction-test-s8  '() 0 0.0)
+(reduction-test-s8  '(3 -1 4 -1 5 -9 2 6) 9 (sqrt 173.0))
+(reduction-test-s16 '(3 -1 4 -1 5 -9 2 6) 9 (sqrt 173.0))
+(reduction-test-s32 '(3 -1 4 -1 5 -9 2 6) 9 (sqrt 173.0))
+(reduction-test-s64 '(3 -1 4 -1 5 -9 2 6) 9 (sqrt 173.0))
+(reduction-test-u8  '() 0 0.0)
+(reduction-test-u8  '(3 1 4 1 5 9 2 6) 31 (sqrt 173.0))
+(reduction-test-u16 '(3 1 4 1 5 9 2 6) 31 (sqrt 173.0))
+(reduction-test-u32 '(3 1 4 1 5 9 2 6) 31 (sqrt 173.0))
+(reduction-test-u64 '(3 1 4 1 5 9 2 6) 31 (sqrt 173.0))
+(reduction-test-f16 '() 0.0 0.0)
+(reduction-test-f16 '(3.0 -1.0 4.0 -1.0 5.0 -9.0 2.0 6.0 0.5) 9.5 (sqrt 173.25))
+(reduction-test-f32 '() 0.0 0.0)
+(reduction-test-f32 '(3.0 -1.0 4.0 -1.0 5.0 -9.0 2.0 6.0 0.5) 9.5 (sqrt 173.25))
+(reduction-test-f64 '() 0.0 0.0)
+(reduction-test-f64 '(3.0 -1.0 4.0 -1.0 5.0 -9.0 2.0 6.0 0.5) 9.5 (sqrt 173.25))
+
+;; overflow
+(test* "s8vector-sum overflow" 1270 (s8vector-sum (make-s8vector 10 127)))
+(test* "u64vector-sum overflow" (* 3 (- (expt 2 64) 1))
+       (u64vector-sum (make-u64vector 3 (- (expt 2 64) 1))))
+(test* "s64vector-sum overflow" (* -3 (expt 2 63))
+       (s64vector-sum (make-s64vector 3 (- (expt 2 63)))))
+
+;; NaN propagates
+(expand-uvec
+ (f16 f32 f64)
+ (begin
+   (test* "@vector-min with nan" '(#t 5)
+          (let1 v (list->@vector '(1.0 2.0 3.0 4.0 5.0 +nan.0 -1.0 8.0 9.0))
+            (list (nan? (@vector-min v)) (@vector-argmin v))))
+   (test* "@vector-max with nan" '(#t 5)
+          (let1 v (list->@vector '(1.0 2.0 3.0 4.0 5.0 +nan.0 10.0 8.0 9.0))
+            (list (nan? (@vector-max v)) (@vector-argmax v))))
+   (test* "@vector-argmin picks the first one" 2
+          (@vector-argmin (@vector 3.0 1.0 -2.0 5.0 -2.0 7.0 -2.0 8.0 9.0)))
+   (test* "@vector-min empty" (test-error)
+          (@vector-min (@vector)))))
+
 ;;-------------------------------------------------------------------
 (test-section "range-check")
 
@@ -1570,6 +1664,43 @@
               [dst (uvector-alias <u8vector> src)])
          (u8vector-set! dst 0 1)))
 
+;;-------------------------------------------------------------------
+(test-section "map-file->uvector")
+
+(sys-unlink "test.o")
+(call-with-output-file "test.o"
+  (cut write-uvector '#u8(0 1 2 3 4 5 6 7 8 9 10 11) <>))
+
+(test* "map-file->uvector" '#u8(0 1 2 3 4 5 6 7 8 9 10 11)
+       (map-file->uvector <u8vector> "test.o"))
+(test* "map-file->uvector (offset, size)" '#u8(4 5 6 7)
+       (map-file->uvector <u8vector> "test.o" 4 4))
+(test* "map-file->uvector (size beyond EOF)" '#u8(8 9 10 11)
+       (map-file->uvector <u8vector> "test.o" 8 100))
+(test* "map-file->uvector (u32)" 3
+       (u32vector-length (map-file->uvector <u32vector> "test.o")))
+(test* "map-file->uvector (alias)" '#u8(2 3)
+       (uvector-alias <u8vector> (map-file->uvector <u16vector> "test.o" 2 4)
+                      0 2))
+(test* "map-file->uvector (misaligned offset)" (test-error)
+       (map-file->uvector <u32vector> "test.o" 2))
+(test* "map-file->uvector (misaligned size)" (test-error)
+       (map-file->uvector <u32vector> "test.o" 0 6))
+(test* "map-file->uvector (immutable)" (test-error)
+       (u8vector-set! (map-file->uvector <u8vector> "test.o") 0 1))
+(test* "map-file->uvector (port)" '(#u8(6 7 8) 2)
+       (call-with-input-file "test.o"
+         (^p (let1 v (map-file->uvector <u8vector> p 6 3)
+               (read-byte p) (read-byte p)
+               (list v (read-byte p))))
+         :mmap #t))
+(test* "map-file->uvector (non-mmap port)" (test-error)
+       (call-with-input-file "test.o" (cut map-file->uvector <u8vector> <>)))
+(test* "map-file->uvector (nonexistent file)" (test-error <system-error>)
+       (map-file->uvector <u8vector> "test-nonexistent.o"))
+
+(sys-unlink "test.o")
+
 ;;-------------------------------------------------------------------
 ; (use gauche.array)
 (test-section "gauche.array")
@@ -2748,6 +2879,14 @@
          (list (generator->bytevector! vec 2 (circular-generator 0 1 2 3))
                vec)))
 
+(test* "uvector->chunk-generator" '(#u16(1 2 3) #u16(4 5))
+       (generator->list (uvector->chunk-generator '#u16(0 1 2 3 4 5 6) 3 1 6)))
+(test* "gchunk-filter (uvector)" '(#u8(1 3) #u8(5))
+       (generator->list
+        (gchunk-filter odd? (uvector->chunk-generator '#u8(0 1 2 3 4 5) 4))))
+(test* "gchunk-map (uvector)" '(#(0 2 4))
+       (generator->list
+        (gchunk-map (pa$ * 2) (uvector->chunk-generator '#u8(0 1 2)))))
 (test* "generator->uvector" '#u32(0 1 2 3 0 1 2 3 0 1)
        (generator->uvector (circular-generator 0 1 2 3) 10 <u32vector>))
 (test* "generator->uvector!" '(7 #s32(-1 -1 -1 0 1 2 3 0 1 2))
@@ -60,6 +60,7 @@
           s32vector->string u32vector->string
 
           uvector-alias uvector-binary-search uvector-class-element-size
+          map-file->uvector
           uvector-copy uvector-copy! uvector-ref uvector-set! uvector-size
           uvector->list uvector->vector uvector-swap-bytes uvector-swap-bytes!
 
@@ -90,11 +91,18 @@
   (.include "gauche/uvector.h")
   (.include "gauche/priv/vectorP.h")
   (.include "gauche/priv/bytesP.h")
-  (.include "uvectorP.h")))
+  (.include "uvectorP.h"))
+ (initcode (Scm_Init_UVectorKernels)))
 
 ;; uvlib.scm is generated by uvlib.scm.tmpl
 (include "./uvlib.scm")
 
+;; Returns the name of bulk kernel set chosen for the running CPU;
+;; "avx", "sse2" or "scalar".  For benchmarks and troubleshooting.
+(inline-stub
+ (define-cproc %uvector-kernel-name () ::<const-cstring>
+   Scm_UVectorKernelName))
+
 ;;;
 ;;; Generic procedures
 ;;;
@@ -106,6 +114,48 @@
    Scm_UVectorAlias)
  )
 
+;; map-file->uvector
+;; FILE is either a pathname or a memory-mapped input port.  OFFSET and
+;; SIZE are in bytes.  The result is an immutable uvector aliasing the
+;; mapped region; the region is kept in its owner field, so the mapping
+;; lives as long as the uvector (or its aliases) does.
+(inline-stub
+ (define-cproc map-file->uvector (klass::<class> file
+                                  :optional (offset::<fixnum> 0)
+                                            (size::<fixnum> -1))
+   (let* ([esize::int (Scm_UVectorElementSize klass)]
+          [addr::char* NULL]
+          [len::ScmSize 0]
+          [owner::ScmMappedRegion* NULL])
+     (when (< esize 0)
+       (Scm_TypeError "class" "uniform vector class" (SCM_OBJ klass)))
+     (when (or (< offset 0) (!= (% offset esize) 0))
+       (Scm_Error "offset must be a nonnegative multiple of the element \
+                   size %d, but got %ld" esize offset))
+     (cond [(SCM_STRINGP file)
+            (set! owner (Scm_MapFileRegion (Scm_GetStringConst (SCM_STRING file))
+                                           offset size))
+            (when (== owner NULL)
+              (Scm_SysError "couldn't open file: %S" file))
+            (set! addr (-> owner addr)
+                  len (-> owner size))]
+           [(and (SCM_IPORTP file)
+                 (!= (Scm_PortMappedRegion (SCM_PORT file)) NULL))
+            (set! owner (Scm_PortMappedRegion (SCM_PORT file)))
+            (when (> offset (-> owner size)) (set! offset (-> owner size)))
+            (when (or (< size 0) (> (+ offset size) (-> owner size)))
+              (set! size (- (-> owner size) offset)))
+            (set! addr (+ (-> owner addr) offset)
+                  len size)]
+           [else
+            (Scm_TypeError "file" "pathname or memory-mapped input port"
+                           file)])
+     (unless (== (% len esize) 0)
+       (Scm_Error "mapped region size %ld isn't a multiple of the element \
+                   size of %S" len klass))
+     (return (Scm_MakeUVectorFull klass (/ len esize) addr TRUE owner))))
+ )
+
 ;; byte swapping
 (inline-stub
  (define-cise-stmt swap-bytes-common
@@ -209,5 +209,9 @@ enum {
     SWAPB_ARM_BE                /* arm-little-endian <-> big-endian */
 };
 
+/*
+ * Bulk kernels (uvkernel.c)
+ */
+void Scm_Init_UVectorKernels(void);
 
 #endif /* GAUCHE_UVECTOR_P_H */
@@ -314,12 +314,28 @@
 ;; Uvector operation generator
 ;;
 
+;; f32 and f64 vectors have bulk kernels (uvkernel.c) for some operations.
+(define (bulk-kernel? rule)
+  (member (getval rule 't) '("f32" "f64")))
+
+;; (BULKOP d s0 s1) : C expr to run the bulk kernel of element-wise
+;;   operation on uvectors d <- s0 op s1.  Returns FALSE if it isn't
+;;   applicable, in which case the caller should fall back to the
+;;   generic loop.
+(define (bulkop rule opname)
+  (^[d s0 s1]
+    (if (bulk-kernel? rule)
+      (let1 tag (getval rule 't)
+        #"~|tag|_bulk_binop(uvkernels->~|tag|_~|opname|, ~|d|, ~|s0|, ~|s1|)")
+      "FALSE")))
+
 (define (generate-numop)
   (for-each (^[opname Opname Sopname]
               (dolist [rule (make-rules)]
                 (for-each (cute substitute <> `((opname  ,opname)
                                                 (Opname  ,Opname)
                                                 (Sopname ,Sopname)
+                                                (BULKOP  ,(bulkop rule opname))
                                                 ,@rule))
                           *tmpl-numop*)))
             '("add" "sub" "mul")
@@ -329,6 +345,7 @@
     (for-each (cute substitute <> `((opname  "div")
                                     (Opname  "Div")
                                     (Sopname  "Div")
+                                    (BULKOP  ,(bulkop rule "div"))
                                     ,@rule))
               *tmpl-numop*)))
 
@@ -359,7 +376,12 @@
 
 (define (generate-dotop)
   (dolist [rule (make-rules)]
-    (for-each (cute substitute <> rule) *tmpl-dotop*)))
+    (define (BULKDOT x y r)
+      (if (bulk-kernel? rule)
+        #"~(getval rule 't)_bulk_dot(SCM_OBJ(~x), ~y, &~r)"
+        "FALSE"))
+    (for-each (cute substitute <> `((BULKDOT ,BULKDOT) ,@rule))
+              *tmpl-dotop*)))
 
 (define (generate-rangeop)
   (dolist [rule (make-scalar-rules)]
@@ -420,3 +442,29 @@
       (unless (memq tag '(s8 u8))
         (for-each (cute substitute <> `((SWAPB  ,SWAPB) ,@rule))
                   *tmpl-swapb*)))))
+
+(define (generate-reduceop)
+  (dolist [rule (make-scalar-rules)]
+    (let1 tag (string->symbol (getval rule 't))
+      (define (LT a b)
+        (case tag
+          [(s64 u64) #"INT64LT(~|a|, ~|b|)"]
+          [else      #"(~a < ~b)"]))
+      (define (NANP v)
+        (case tag
+          [(f16 f32 f64) #"isnan(~v)"]
+          [else "FALSE"]))
+      (define (BULKSUM x r)
+        (if (bulk-kernel? rule)
+          #"~|tag|_bulk_sum(SCM_OBJ(~x), &~r)"
+          "FALSE"))
+      (define (BULKEXTREMUM x maxp k)
+        (if (bulk-kernel? rule)
+          #"~|tag|_bulk_extremum(SCM_OBJ(~x), ~maxp, &~k)"
+          "FALSE"))
+      (for-each (cute substitute <> `((LT ,LT)
+                                      (NANP ,NANP)
+                                      (BULKSUM ,BULKSUM)
+                                      (BULKEXTREMUM ,BULKEXTREMUM)
+                                      ,@rule))
+                *tmpl-reduceop*))))
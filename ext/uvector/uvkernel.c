@@ -0,0 +1,208 @@
+/*
+ * uvkernel.c - bulk kernels for flonum uniform vectors
+ *
+ *   Copyright (c) 2020  Shiro Kawai  <shiro@acm.org>
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *   1. Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *   3. Neither the name of the authors nor the names of its contributors
+ *      may be used to endorse or promote products derived from this
+ *      software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ *   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ *   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ *   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ *   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file is included from uvector.c.
+ *
+ * The kernels work on raw arrays of float or double.  They are used
+ * when both operands of element-wise arithmetic are uvectors, and for
+ * reductions (sum, dot, min and max).  Each kernel has a portable scalar
+ * version.  On x86 with gcc-compatible compilers we also compile SSE2 and
+ * AVX versions (uvkernel_x86.c), and pick the best one the CPU supports
+ * at initialization.  Define UVECTOR_NO_SIMD to disable them.
+ *
+ * Sums and dot products are accumulated in double, into four interleaved
+ * partial sums (element i goes to the partial sum i%4).  They're added
+ * up as ((s0+s1)+(s2+s3)), then the remaining elements are added in order.
+ * All versions follow this order, so the result doesn't depend on which
+ * kernel set is chosen.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && !defined(UVECTOR_NO_SIMD)
+#define UVKERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct UVKernelsRec {
+    const char *name;
+    void   (*f64_add)(double*, const double*, const double*, ScmSmallInt);
+    void   (*f64_sub)(double*, const double*, const double*, ScmSmallInt);
+    void   (*f64_mul)(double*, const double*, const double*, ScmSmallInt);
+    void   (*f64_div)(double*, const double*, const double*, ScmSmallInt);
+    void   (*f32_add)(float*, const float*, const float*, ScmSmallInt);
+    void   (*f32_sub)(float*, const float*, const float*, ScmSmallInt);
+    void   (*f32_mul)(float*, const float*, const float*, ScmSmallInt);
+    void   (*f32_div)(float*, const float*, const float*, ScmSmallInt);
+    double (*f64_sum)(const double*, ScmSmallInt);
+    double (*f32_sum)(const float*, ScmSmallInt);
+    double (*f64_dot)(const double*, const double*, ScmSmallInt);
+    double (*f32_dot)(const float*, const float*, ScmSmallInt);
+    /* minmax kernels require n > 0.  They store the minimum (maxp==FALSE)
+       or the maximum (maxp==TRUE) to *r and return FALSE, or return TRUE
+       without touching *r if they find NaN. */
+    int    (*f64_minmax)(const double*, ScmSmallInt, int, double*);
+    int    (*f32_minmax)(const float*, ScmSmallInt, int, float*);
+} UVKernels;
+
+/*
+ * Scalar versions
+ */
+
+#define UVK_SCALAR_BINOP(name, type, op)                                \
+    static void name(type *d, const type *x, const type *y,             \
+                     ScmSmallInt n)                                     \
+    {                                                                   \
+        for (ScmSmallInt i=0; i<n; i++) d[i] = x[i] op y[i];            \
+    }
+
+UVK_SCALAR_BINOP(f64_add_scalar, double, +)
+UVK_SCALAR_BINOP(f64_sub_scalar, double, -)
+UVK_SCALAR_BINOP(f64_mul_scalar, double, *)
+UVK_SCALAR_BINOP(f64_div_scalar, double, /)
+UVK_SCALAR_BINOP(f32_add_scalar, float, +)
+UVK_SCALAR_BINOP(f32_sub_scalar, float, -)
+UVK_SCALAR_BINOP(f32_mul_scalar, float, *)
+UVK_SCALAR_BINOP(f32_div_scalar, float, /)
+
+/* TERM(i) is an expression of the i-th term, in double. */
+#define UVK_SCALAR_SUM(TERM)                                            \
+    do {                                                                \
+        double s[4] = {0.0, 0.0, 0.0, 0.0};                             \
+        ScmSmallInt i = 0;                                              \
+        for (; i+4 <= n; i+=4) {                                        \
+            s[0] += TERM(i);   s[1] += TERM(i+1);                       \
+            s[2] += TERM(i+2); s[3] += TERM(i+3);                       \
+        }                                                               \
+        double r = (s[0]+s[1])+(s[2]+s[3]);                             \
+        for (; i < n; i++) r += TERM(i);                                \
+        return r;                                                       \
+    } while (0)
+
+#define UVK_SUM_TERM(i)  ((double)x[i])
+#define UVK_DOT_TERM(i)  ((double)x[i]*(double)y[i])
+
+static double f64_sum_scalar(const double *x, ScmSmallInt n)
+{
+    UVK_SCALAR_SUM(UVK_SUM_TERM);
+}
+
+static double f32_sum_scalar(const float *x, ScmSmallInt n)
+{
+    UVK_SCALAR_SUM(UVK_SUM_TERM);
+}
+
+static double f64_dot_scalar(const double *x, const double *y, ScmSmallInt n)
+{
+    UVK_SCALAR_SUM(UVK_DOT_TERM);
+}
+
+static double f32_dot_scalar(const float *x, const float *y, ScmSmallInt n)
+{
+    UVK_SCALAR_SUM(UVK_DOT_TERM);
+}
+
+#define UVK_SCALAR_MINMAX(name, type)                                   \
+    static int name(const type *x, ScmSmallInt n, int maxp, type *r)    \
+    {                                                                   \
+        type e = x[0];                                                  \
+        for (ScmSmallInt i=0; i<n; i++) {                               \
+            if (isnan(x[i])) return TRUE;                               \
+            if (maxp ? (x[i] > e) : (x[i] < e)) e = x[i];               \
+        }                                                               \
+        *r = e;                                                         \
+        return FALSE;                                                   \
+    }
+
+UVK_SCALAR_MINMAX(f64_minmax_scalar, double)
+UVK_SCALAR_MINMAX(f32_minmax_scalar, float)
+
+#define UVK_KERNEL_TABLE(sfx)                                           \
+    { #sfx,                                                             \
+      f64_add_##sfx, f64_sub_##sfx, f64_mul_##sfx, f64_div_##sfx,       \
+      f32_add_##sfx, f32_sub_##sfx, f32_mul_##sfx, f32_div_##sfx,       \
+      f64_sum_##sfx, f32_sum_##sfx, f64_dot_##sfx, f32_dot_##sfx,       \
+      f64_minmax_##sfx, f32_minmax_##sfx }
+
+static const UVKernels uvkernels_scalar = UVK_KERNEL_TABLE(scalar);
+
+/*
+ * SIMD versions
+ */
+
+#if UVKERNEL_X86
+#define UVK_SSE2 1
+#include "uvkernel_x86.c"
+#undef UVK_SSE2
+
+#define UVK_AVX 1
+#include "uvkernel_x86.c"
+#undef UVK_AVX
+
+static const UVKernels uvkernels_sse2 = UVK_KERNEL_TABLE(sse2);
+static const UVKernels uvkernels_avx  = UVK_KERNEL_TABLE(avx);
+#endif /*UVKERNEL_X86*/
+
+/*
+ * Selection
+ */
+
+/* Set up by Scm_Init_UVectorKernels. */
+static const UVKernels *uvkernels = &uvkernels_scalar;
+
+/* For benchmarks and troubleshooting, the environment variable
+   GAUCHE_UVECTOR_KERNEL can force a less capable kernel set
+   ("scalar", "sse2"). */
+void Scm_Init_UVectorKernels(void)
+{
+    const char *req = Scm_GetEnv("GAUCHE_UVECTOR_KERNEL");
+    if (req != NULL && strcmp(req, "scalar") == 0) {
+        uvkernels = &uvkernels_scalar;
+        return;
+    }
+#if UVKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        uvkernels = &uvkernels_sse2;
+    }
+    if (__builtin_cpu_supports("avx")
+        && !(req != NULL && strcmp(req, "sse2") == 0)) {
+        uvkernels = &uvkernels_avx;
+    }
+#endif /*UVKERNEL_X86*/
+}
+
+const char *Scm_UVectorKernelName(void)
+{
+    return uvkernels->name;
+}
@@ -0,0 +1,246 @@
+/*
+ * This code fragment implements SIMD versions of the kernels in
+ * uvkernel.c.  It is included by uvkernel.c twice, with either
+ * UVK_SSE2 or UVK_AVX defined, to generate both versions.
+ *
+ * The functions are compiled with the target attribute, so that they can
+ * coexist with the generic code; uvkernel.c calls them only after
+ * checking the CPU supports the instruction set.
+ */
+
+#if defined(UVK_SSE2)
+#define UVK_ATTR        __attribute__((target("sse2")))
+#define UVK_NAME(n)     n##_sse2
+#define D_T             __m128d
+#define D_W             2
+#define D_LOAD(p)       _mm_loadu_pd(p)
+#define D_STORE(p, v)   _mm_storeu_pd(p, v)
+#define D_ADD(a, b)     _mm_add_pd(a, b)
+#define D_SUB(a, b)     _mm_sub_pd(a, b)
+#define D_MUL(a, b)     _mm_mul_pd(a, b)
+#define D_DIV(a, b)     _mm_div_pd(a, b)
+#define D_MIN(a, b)     _mm_min_pd(a, b)
+#define D_MAX(a, b)     _mm_max_pd(a, b)
+#define D_ISNAN(a)      _mm_cmpunord_pd(a, a)
+#define D_OR(a, b)      _mm_or_pd(a, b)
+#define D_ANY(a)        _mm_movemask_pd(a)
+#define D_ZERO          _mm_setzero_pd()
+/* load D_W floats, converted to doubles */
+#define DF_LOAD(p)      _mm_cvtps_pd(_mm_castpd_ps(_mm_load_sd((const double*)(p))))
+#define F_T             __m128
+#define F_W             4
+#define F_LOAD(p)       _mm_loadu_ps(p)
+#define F_STORE(p, v)   _mm_storeu_ps(p, v)
+#define F_ADD(a, b)     _mm_add_ps(a, b)
+#define F_SUB(a, b)     _mm_sub_ps(a, b)
+#define F_MUL(a, b)     _mm_mul_ps(a, b)
+#define F_DIV(a, b)     _mm_div_ps(a, b)
+#define F_MIN(a, b)     _mm_min_ps(a, b)
+#define F_MAX(a, b)     _mm_max_ps(a, b)
+#define F_ISNAN(a)      _mm_cmpunord_ps(a, a)
+#define F_OR(a, b)      _mm_or_ps(a, b)
+#define F_ANY(a)        _mm_movemask_ps(a)
+#elif defined(UVK_AVX)
+#define UVK_ATTR        __attribute__((target("avx")))
+#define UVK_NAME(n)     n##_avx
+#define D_T             __m256d
+#define D_W             4
+#define D_LOAD(p)       _mm256_loadu_pd(p)
+#define D_STORE(p, v)   _mm256_storeu_pd(p, v)
+#define D_ADD(a, b)     _mm256_add_pd(a, b)
+#define D_SUB(a, b)     _mm256_sub_pd(a, b)
+#define D_MUL(a, b)     _mm256_mul_pd(a, b)
+#define D_DIV(a, b)     _mm256_div_pd(a, b)
+#define D_MIN(a, b)     _mm256_min_pd(a, b)
+#define D_MAX(a, b)     _mm256_max_pd(a, b)
+#define D_ISNAN(a)      _mm256_cmp_pd(a, a, _CMP_UNORD_Q)
+#define D_OR(a, b)      _mm256_or_pd(a, b)
+#define D_ANY(a)        _mm256_movemask_pd(a)
+#define D_ZERO          _mm256_setzero_pd()
+#define DF_LOAD(p)      _mm256_cvtps_pd(_mm_loadu_ps(p))
+#define F_T             __m256
+#define F_W             8
+#define F_LOAD(p)       _mm256_loadu_ps(p)
+#define F_STORE(p, v)   _mm256_storeu_ps(p, v)
+#define F_ADD(a, b)     _mm256_add_ps(a, b)
+#define F_SUB(a, b)     _mm256_sub_ps(a, b)
+#define F_MUL(a, b)     _mm256_mul_ps(a, b)
+#define F_DIV(a, b)     _mm256_div_ps(a, b)
+#define F_MIN(a, b)     _mm256_min_ps(a, b)
+#define F_MAX(a, b)     _mm256_max_ps(a, b)
+#define F_ISNAN(a)      _mm256_cmp_ps(a, a, _CMP_UNORD_Q)
+#define F_OR(a, b)      _mm256_or_ps(a, b)
+#define F_ANY(a)        _mm256_movemask_ps(a)
+#else
+#error "uvkernel_x86.c included without specifying instruction set"
+#endif
+
+/* Number of double vectors to hold four partial sums. */
+#define D_NACC  (4/D_W)
+
+/*
+ * Element-wise operations
+ */
+
+#define UVK_SIMD_BINOP(name, type, VT, W, LOAD, STORE, VOP, op)         \
+    static UVK_ATTR void UVK_NAME(name)(type *d, const type *x,         \
+                                        const type *y, ScmSmallInt n)   \
+    {                                                                   \
+        ScmSmallInt i = 0;                                              \
+        for (; i+W <= n; i+=W) {                                        \
+            VT vx = LOAD(x+i), vy = LOAD(y+i);                          \
+            STORE(d+i, VOP(vx, vy));                                    \
+        }                                                               \
+        for (; i<n; i++) d[i] = x[i] op y[i];                           \
+    }
+
+UVK_SIMD_BINOP(f64_add, double, D_T, D_W, D_LOAD, D_STORE, D_ADD, +)
+UVK_SIMD_BINOP(f64_sub, double, D_T, D_W, D_LOAD, D_STORE, D_SUB, -)
+UVK_SIMD_BINOP(f64_mul, double, D_T, D_W, D_LOAD, D_STORE, D_MUL, *)
+UVK_SIMD_BINOP(f64_div, double, D_T, D_W, D_LOAD, D_STORE, D_DIV, /)
+UVK_SIMD_BINOP(f32_add, float, F_T, F_W, F_LOAD, F_STORE, F_ADD, +)
+UVK_SIMD_BINOP(f32_sub, float, F_T, F_W, F_LOAD, F_STORE, F_SUB, -)
+UVK_SIMD_BINOP(f32_mul, float, F_T, F_W, F_LOAD, F_STORE, F_MUL, *)
+UVK_SIMD_BINOP(f32_div, float, F_T, F_W, F_LOAD, F_STORE, F_DIV, /)
+
+/*
+ * Sums
+ */
+
+/* Adds up the four partial sums in ACC, in the same order as the
+   scalar version. */
+static UVK_ATTR double UVK_NAME(lanesum)(D_T *acc)
+{
+    double s[4];
+    for (int k=0; k<D_NACC; k++) D_STORE(s+k*D_W, acc[k]);
+    return (s[0]+s[1])+(s[2]+s[3]);
+}
+
+/* VTERM(p, q) is a vector of D_W terms starting from offset p of x
+   and q of y.  TERM(i) is the i-th term in double. */
+#define UVK_SIMD_SUM(VTERM, TERM)                                       \
+    do {                                                                \
+        D_T acc[D_NACC];                                                \
+        ScmSmallInt i = 0;                                              \
+        for (int k=0; k<D_NACC; k++) acc[k] = D_ZERO;                   \
+        for (; i+4 <= n; i+=4) {                                        \
+            for (int k=0; k<D_NACC; k++) {                              \
+                acc[k] = D_ADD(acc[k], VTERM(i+k*D_W));                 \
+            }                                                           \
+        }                                                               \
+        double r = UVK_NAME(lanesum)(acc);                              \
+        for (; i<n; i++) r += TERM(i);                                  \
+        return r;                                                       \
+    } while (0)
+
+#define UVK_F64_SUM_VTERM(i)  D_LOAD(x+(i))
+#define UVK_F32_SUM_VTERM(i)  DF_LOAD(x+(i))
+#define UVK_F64_DOT_VTERM(i)  D_MUL(D_LOAD(x+(i)), D_LOAD(y+(i)))
+#define UVK_F32_DOT_VTERM(i)  D_MUL(DF_LOAD(x+(i)), DF_LOAD(y+(i)))
+
+static UVK_ATTR double UVK_NAME(f64_sum)(const double *x, ScmSmallInt n)
+{
+    UVK_SIMD_SUM(UVK_F64_SUM_VTERM, UVK_SUM_TERM);
+}
+
+static UVK_ATTR double UVK_NAME(f32_sum)(const float *x, ScmSmallInt n)
+{
+    UVK_SIMD_SUM(UVK_F32_SUM_VTERM, UVK_SUM_TERM);
+}
+
+static UVK_ATTR double UVK_NAME(f64_dot)(const double *x, const double *y,
+                                         ScmSmallInt n)
+{
+    UVK_SIMD_SUM(UVK_F64_DOT_VTERM, UVK_DOT_TERM);
+}
+
+static UVK_ATTR double UVK_NAME(f32_dot)(const float *x, const float *y,
+                                         ScmSmallInt n)
+{
+    UVK_SIMD_SUM(UVK_F32_DOT_VTERM, UVK_DOT_TERM);
+}
+
+/*
+ * Min and max
+ */
+
+#define UVK_SIMD_MINMAX(name, type, VT, W, LOAD, STORE, VMIN, VMAX, ISNAN, OR, ANY) \
+    static UVK_ATTR int UVK_NAME(name)(const type *x, ScmSmallInt n,    \
+                                       int maxp, type *r)               \
+    {                                                                   \
+        ScmSmallInt i = 0;                                              \
+        type e = x[0];                                                  \
+        if (n >= W) {                                                   \
+            VT m = LOAD(x), nan = ISNAN(m);                             \
+            if (maxp) {                                                 \
+                for (i=W; i+W <= n; i+=W) {                             \
+                    VT v = LOAD(x+i);                                   \
+                    nan = OR(nan, ISNAN(v));                            \
+                    m = VMAX(m, v);                                     \
+                }                                                       \
+            } else {                                                    \
+                for (i=W; i+W <= n; i+=W) {                             \
+                    VT v = LOAD(x+i);                                   \
+                    nan = OR(nan, ISNAN(v));                            \
+                    m = VMIN(m, v);                                     \
+                }                                                       \
+            }                                                           \
+            if (ANY(nan)) return TRUE;                                  \
+            type lanes[W];                                              \
+            STORE(lanes, m);                                            \
+            e = lanes[0];                                               \
+            for (int k=1; k<W; k++) {                                   \
+                if (maxp ? (lanes[k] > e) : (lanes[k] < e)) e = lanes[k]; \
+            }                                                           \
+        }                                                               \
+        for (; i<n; i++) {                                              \
+            if (isnan(x[i])) return TRUE;                               \
+            if (maxp ? (x[i] > e) : (x[i] < e)) e = x[i];               \
+        }                                                               \
+        *r = e;                                                         \
+        return FALSE;                                                   \
+    }
+
+UVK_SIMD_MINMAX(f64_minmax, double, D_T, D_W, D_LOAD, D_STORE,
+                D_MIN, D_MAX, D_ISNAN, D_OR, D_ANY)
+UVK_SIMD_MINMAX(f32_minmax, float, F_T, F_W, F_LOAD, F_STORE,
+                F_MIN, F_MAX, F_ISNAN, F_OR, F_ANY)
+
+#undef UVK_ATTR
+#undef UVK_NAME
+#undef D_T
+#undef D_W
+#undef D_LOAD
+#undef D_STORE
+#undef D_ADD
+#undef D_SUB
+#undef D_MUL
+#undef D_DIV
+#undef D_MIN
+#undef D_MAX
+#undef D_ISNAN
+#undef D_OR
+#undef D_ANY
+#undef D_ZERO
+#undef D_NACC
+#undef DF_LOAD
+#undef F_T
+#undef F_W
+#undef F_LOAD
+#undef F_STORE
+#undef F_ADD
+#undef F_SUB
+#undef F_MUL
+#undef F_DIV
+#undef F_MIN
+#undef F_MAX
+#undef F_ISNAN
+#undef F_OR
+#undef F_ANY
+#undef UVK_SIMD_BINOP
+#undef UVK_SIMD_SUM
+#undef UVK_SIMD_MINMAX
+#undef UVK_F64_SUM_VTERM
+#undef UVK_F32_SUM_VTERM
+#undef UVK_F64_DOT_VTERM
+#undef UVK_F32_DOT_VTERM
@@ -343,6 +343,7 @@ ScmObj Scm_MakeDeflatingPort(ScmPort *source, int level,
     info->stream_endp = FALSE;
     info->level = level;
     info->strategy = strategy;
+    info->parallel = NULL;
 
     ScmPortBuffer bufrec;
     memset(&bufrec, 0, sizeof(bufrec));
@@ -361,6 +362,504 @@ ScmObj Scm_MakeDeflatingPort(ScmPort *source, int level,
                                 SCM_PORT_OUTPUT, TRUE, &bufrec);
 }
 
+/*================================================================
+ * Parallel deflating port
+ */
+
+/*
+ * The input is split into blocks of the port's buffer size, and each
+ * block is compressed by a worker thread as an independent raw deflate
+ * stream, primed with the last 32K bytes of the preceding input so
+ * that the compression ratio doesn't suffer much.  Each block but the
+ * last one ends with Z_SYNC_FLUSH, so the concatenated output is a
+ * single valid deflate stream.  The writing thread emits the zlib or
+ * gzip header, writes the compressed blocks in order, and combines
+ * the checksums of the blocks for the trailer.
+ */
+
+#if defined(GAUCHE_USE_PTHREADS)
+
+#define PDEFLATE_WINDOW   32768      /* max. history to prime a block */
+#define PDEFLATE_DEFAULT_BLOCK_SIZE (128*1024)
+
+enum {
+    PDEFLATE_RAW,
+    PDEFLATE_ZLIB,
+    PDEFLATE_GZIP
+};
+
+typedef struct pdeflate_job {
+    unsigned char *in;          /* history followed by the block data */
+    size_t histlen;
+    size_t inlen;
+    unsigned char *out;
+    size_t outlen;
+    uLong check;                /* crc32 or adler32 of the block data */
+    int level;
+    int strategy;
+    int flush;                  /* Z_SYNC_FLUSH, Z_FULL_FLUSH or Z_FINISH */
+    int done;
+    int error;                  /* zlib error code, or Z_OK */
+    struct pdeflate_job *next;
+} pdeflate_job;
+
+typedef struct ScmZlibParallelRec {
+    int format;                 /* PDEFLATE_RAW etc. */
+    int wbits;                  /* log2 of window size */
+    int memlevel;
+    int nthreads;
+    pthread_t *threads;
+    int shutdown;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  work_cond;  /* a job is available, or shutdown */
+    pthread_cond_t  done_cond;  /* a job is finished */
+    pdeflate_job *head;         /* oldest job not yet written out */
+    pdeflate_job *tail;
+    pdeflate_job *next_job;     /* next job to be picked by a worker */
+    int inflight;               /* # of jobs between head and tail */
+
+    /* Following fields are only touched by the writing thread. */
+    unsigned char hist[PDEFLATE_WINDOW]; /* last input, to prime a block */
+    size_t histlen;
+    int has_dict;               /* user dictionary is given */
+    uLong check;                /* combined check value so far */
+    int header_written;
+    int finished;
+} ScmZlibParallel;
+
+static void pdeflate_free_job(pdeflate_job *job)
+{
+    free(job->in);
+    free(job->out);
+    free(job);
+}
+
+/* Compress one block.  Called in a worker thread, so it mustn't touch
+   Scheme objects. */
+static void pdeflate_run(ScmZlibParallel *par, z_streamp strm,
+                         pdeflate_job *job)
+{
+    int r = deflateReset(strm);
+    if (r == Z_OK) r = deflateParams(strm, job->level, job->strategy);
+    if (r == Z_OK && job->histlen > 0) {
+        r = deflateSetDictionary(strm, job->in, job->histlen);
+    }
+    if (r != Z_OK) { job->error = r; return; }
+
+    size_t cap = deflateBound(strm, job->inlen) + 16;
+    job->out = malloc(cap);
+    if (job->out == NULL) { job->error = Z_MEM_ERROR; return; }
+    strm->next_in = job->in + job->histlen;
+    strm->avail_in = job->inlen;
+    for (;;) {
+        strm->next_out = job->out + job->outlen;
+        strm->avail_out = cap - job->outlen;
+        r = deflate(strm, job->flush);
+        job->outlen = strm->next_out - job->out;
+        if (r == Z_STREAM_END) break;
+        if (r != Z_OK && r != Z_BUF_ERROR) { job->error = r; return; }
+        if (strm->avail_out != 0) break;   /* all input consumed */
+        unsigned char *nout = realloc(job->out, cap*2);
+        if (nout == NULL) { job->error = Z_MEM_ERROR; return; }
+        job->out = nout;
+        cap *= 2;
+    }
+    if (par->format == PDEFLATE_GZIP) {
+        job->check = crc32(crc32(0, NULL, 0),
+                           job->in + job->histlen, job->inlen);
+    } else if (par->format == PDEFLATE_ZLIB) {
+        job->check = adler32(adler32(0, NULL, 0),
+                             job->in + job->histlen, job->inlen);
+    }
+}
+
+static void *pdeflate_worker(void *data)
+{
+    ScmZlibParallel *par = (ScmZlibParallel*)data;
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    int r = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         -par->wbits, par->memlevel, Z_DEFAULT_STRATEGY);
+
+    pthread_mutex_lock(&par->mutex);
+    for (;;) {
+        while (!par->shutdown && par->next_job == NULL) {
+            pthread_cond_wait(&par->work_cond, &par->mutex);
+        }
+        if (par->shutdown) break;
+        pdeflate_job *job = par->next_job;
+        par->next_job = job->next;
+        pthread_mutex_unlock(&par->mutex);
+
+        if (r == Z_OK) pdeflate_run(par, &strm, job);
+        else job->error = r;
+
+        pthread_mutex_lock(&par->mutex);
+        job->done = TRUE;
+        pthread_cond_broadcast(&par->done_cond);
+    }
+    pthread_mutex_unlock(&par->mutex);
+    if (r == Z_OK) deflateEnd(&strm);
+    return NULL;
+}
+
+static void put_u32be(unsigned char *p, uLong v)
+{
+    p[0] = (v>>24)&0xff; p[1] = (v>>16)&0xff; p[2] = (v>>8)&0xff; p[3] = v&0xff;
+}
+
+static void put_u32le(unsigned char *p, uLong v)
+{
+    p[0] = v&0xff; p[1] = (v>>8)&0xff; p[2] = (v>>16)&0xff; p[3] = (v>>24)&0xff;
+}
+
+/* Emits the same header as zlib's deflate would. */
+static void pdeflate_write_header(ScmZlibInfo *info)
+{
+    ScmZlibParallel *par = info->parallel;
+    unsigned char hdr[10];
+    int level = (info->level == Z_DEFAULT_COMPRESSION)? 6 : info->level;
+
+    if (par->format == PDEFLATE_ZLIB) {
+        int flevel;
+        if (info->strategy >= Z_HUFFMAN_ONLY || level < 2) flevel = 0;
+        else if (level < 6) flevel = 1;
+        else if (level == 6) flevel = 2;
+        else flevel = 3;
+        unsigned int h = (Z_DEFLATED + ((par->wbits-8)<<4)) << 8;
+        h |= flevel << 6;
+        if (par->has_dict) h |= 0x20; /* FDICT */
+        h += 31 - (h % 31);
+        hdr[0] = (h>>8) & 0xff;
+        hdr[1] = h & 0xff;
+        Scm_Putz((char*)hdr, 2, info->remote);
+        info->strm->total_out += 2;
+        if (par->has_dict) {
+            put_u32be(hdr, Scm_GetIntegerU(info->dict_adler));
+            Scm_Putz((char*)hdr, 4, info->remote);
+            info->strm->total_out += 4;
+        }
+    } else if (par->format == PDEFLATE_GZIP) {
+        memset(hdr, 0, 10);
+        hdr[0] = 0x1f; hdr[1] = 0x8b; hdr[2] = Z_DEFLATED;
+        hdr[8] = (level == 9)? 2
+            : ((info->strategy >= Z_HUFFMAN_ONLY || level < 2)? 4 : 0);
+        hdr[9] = 255;           /* OS unknown */
+        Scm_Putz((char*)hdr, 10, info->remote);
+        info->strm->total_out += 10;
+    }
+    par->header_written = TRUE;
+}
+
+/* Writes out finished jobs in order.  If WAIT_ALL is true, waits for all
+   jobs; otherwise, waits only while there are too many jobs in flight. */
+static void pdeflate_drain(ScmZlibInfo *info, int wait_all)
+{
+    ScmZlibParallel *par = info->parallel;
+    z_streamp strm = info->strm;
+
+    for (;;) {
+        pthread_mutex_lock(&par->mutex);
+        while (par->head && !par->head->done
+               && (wait_all || par->inflight > 2*par->nthreads)) {
+            pthread_cond_wait(&par->done_cond, &par->mutex);
+        }
+        pdeflate_job *job = par->head;
+        if (job == NULL || !job->done) {
+            pthread_mutex_unlock(&par->mutex);
+            return;
+        }
+        par->head = job->next;
+        if (par->head == NULL) par->tail = NULL;
+        par->inflight--;
+        pthread_mutex_unlock(&par->mutex);
+
+        if (job->error != Z_OK) {
+            int e = job->error;
+            pdeflate_free_job(job);
+            Scm_ZlibError(e, "deflate failed in a worker thread");
+        }
+        if (job->outlen > 0) {
+            Scm_Putz((char*)job->out, job->outlen, info->remote);
+        }
+        if (par->format == PDEFLATE_GZIP) {
+            par->check = crc32_combine(par->check, job->check, job->inlen);
+        } else if (par->format == PDEFLATE_ZLIB) {
+            par->check = adler32_combine(par->check, job->check, job->inlen);
+        }
+        strm->adler = par->check;
+        strm->total_in += job->inlen;
+        strm->total_out += job->outlen;
+        pdeflate_free_job(job);
+    }
+}
+
+/* Queues a job to compress LEN bytes from DATA. */
+static void pdeflate_submit(ScmZlibInfo *info, const unsigned char *data,
+                            size_t len, int flush)
+{
+    ScmZlibParallel *par = info->parallel;
+    pdeflate_job *job = malloc(sizeof(pdeflate_job));
+    unsigned char *in = malloc(par->histlen + len + 1);
+    if (job == NULL || in == NULL) {
+        free(job);
+        free(in);
+        Scm_ZlibError(Z_MEM_ERROR, "out of memory");
+    }
+
+    memset(job, 0, sizeof(pdeflate_job));
+    job->in = in;
+    memcpy(job->in, par->hist, par->histlen);
+    if (len > 0) memcpy(job->in + par->histlen, data, len);
+    job->histlen = par->histlen;
+    job->inlen = len;
+    job->level = info->level;
+    job->strategy = info->strategy;
+    job->flush = flush;
+    job->error = Z_OK;
+
+    /* Update history for the next block.  After a full flush, the next
+       block shouldn't refer to the preceding data. */
+    if (flush == Z_FULL_FLUSH) {
+        par->histlen = 0;
+    } else if (len >= PDEFLATE_WINDOW) {
+        memcpy(par->hist, data + len - PDEFLATE_WINDOW, PDEFLATE_WINDOW);
+        par->histlen = PDEFLATE_WINDOW;
+    } else {
+        size_t keep = par->histlen;
+        if (keep + len > PDEFLATE_WINDOW) keep = PDEFLATE_WINDOW - len;
+        memmove(par->hist, par->hist + par->histlen - keep, keep);
+        memcpy(par->hist + keep, data, len);
+        par->histlen = keep + len;
+    }
+
+    pthread_mutex_lock(&par->mutex);
+    if (par->tail) par->tail->next = job;
+    else par->head = job;
+    par->tail = job;
+    if (par->next_job == NULL) par->next_job = job;
+    par->inflight++;
+    pthread_cond_signal(&par->work_cond);
+    pthread_mutex_unlock(&par->mutex);
+}
+
+static ScmSize pdeflate_flusher(ScmPort *port, ScmSize cnt SCM_UNUSED,
+                                int forcep)
+{
+    ScmZlibInfo *info = SCM_PORT_ZLIB_INFO(port);
+    ScmSize avail = SCM_PORT_BUFFER_AVAIL(port);
+    int flush = (info->flush == Z_FULL_FLUSH)? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+
+    if (!info->parallel->header_written) pdeflate_write_header(info);
+    pdeflate_submit(info, (unsigned char*)port->src.buf.buffer, avail, flush);
+    info->flush = Z_NO_FLUSH;
+    pdeflate_drain(info, forcep);
+    return avail;
+}
+
+static void pdeflate_shutdown(ScmZlibParallel *par)
+{
+    pthread_mutex_lock(&par->mutex);
+    par->shutdown = TRUE;
+    pthread_cond_broadcast(&par->work_cond);
+    pthread_mutex_unlock(&par->mutex);
+    for (int i=0; i<par->nthreads; i++) {
+        pthread_join(par->threads[i], NULL);
+    }
+    /* Jobs may be left if an error is raised during the output. */
+    while (par->head) {
+        pdeflate_job *job = par->head;
+        par->head = job->next;
+        pdeflate_free_job(job);
+    }
+    pthread_mutex_destroy(&par->mutex);
+    pthread_cond_destroy(&par->work_cond);
+    pthread_cond_destroy(&par->done_cond);
+    free(par->threads);
+    free(par);
+}
+
+static void pdeflate_closer(ScmPort *port)
+{
+    ScmZlibInfo *info = SCM_PORT_ZLIB_INFO(port);
+    ScmZlibParallel *par = info->parallel;
+
+    if (par == NULL) return;    /* already closed */
+    SCM_UNWIND_PROTECT {
+        if (!par->header_written) pdeflate_write_header(info);
+        /* The buffer is already flushed; an empty final block
+           terminates the stream. */
+        pdeflate_submit(info, NULL, 0, Z_FINISH);
+        pdeflate_drain(info, TRUE);
+
+        unsigned char trailer[8];
+        if (par->format == PDEFLATE_GZIP) {
+            put_u32le(trailer, par->check);
+            put_u32le(trailer+4, info->strm->total_in & 0xffffffffUL);
+            Scm_Putz((char*)trailer, 8, info->remote);
+            info->strm->total_out += 8;
+        } else if (par->format == PDEFLATE_ZLIB) {
+            put_u32be(trailer, par->check);
+            Scm_Putz((char*)trailer, 4, info->remote);
+            info->strm->total_out += 4;
+        }
+        Scm_Flush(info->remote);
+    }
+    SCM_WHEN_ERROR {
+        info->parallel = NULL;
+        pdeflate_shutdown(par);
+        SCM_NEXT_HANDLER;
+    }
+    SCM_END_PROTECT;
+    info->parallel = NULL;
+    pdeflate_shutdown(par);
+    if (info->ownerp) {
+        Scm_ClosePort(info->remote);
+    }
+}
+
+ScmObj Scm_MakeParallelDeflatingPort(ScmPort *sink, int level,
+                                     int window_bits, int memlevel,
+                                     int strategy, ScmObj dict,
+                                     ScmSize blocksiz, int nthreads,
+                                     int ownerp)
+{
+    if (nthreads <= 0) nthreads = Scm_AvailableProcessors();
+    if (nthreads <= 1) {
+        return Scm_MakeDeflatingPort(sink, level, window_bits, memlevel,
+                                     strategy, dict, blocksiz, ownerp);
+    }
+    if (blocksiz <= 0) blocksiz = PDEFLATE_DEFAULT_BLOCK_SIZE;
+    blocksiz = fix_buffer_size(blocksiz);
+
+    /* Validate parameters in the same way as the single-threaded port,
+       and to get the adler32 of the dictionary. */
+    z_stream check;
+    memset(&check, 0, sizeof(check));
+    int r = deflateInit2(&check, level, Z_DEFLATED, window_bits,
+                         memlevel, strategy);
+    if (r != Z_OK) {
+        Scm_ZlibError(r, "deflateInit2 error: %s", check.msg);
+    }
+    ScmObj dict_adler = SCM_FALSE;
+    if (!SCM_FALSEP(dict)) {
+        if (!SCM_STRINGP(dict)) {
+            deflateEnd(&check);
+            Scm_Error("String required, but got %S", dict);
+        }
+        r = deflateSetDictionary(&check,
+                                 (unsigned char*)SCM_STRING_START(dict),
+                                 SCM_STRING_SIZE(dict));
+        if (r != Z_OK) {
+            deflateEnd(&check);
+            Scm_ZlibError(r, "deflateSetDictionary failed: %s", check.msg);
+        }
+        dict_adler = Scm_MakeIntegerU(check.adler);
+    }
+    deflateEnd(&check);
+
+    ScmZlibParallel *par = calloc(1, sizeof(ScmZlibParallel));
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    if (par == NULL || threads == NULL) {
+        free(par);
+        free(threads);
+        Scm_ZlibError(Z_MEM_ERROR, "out of memory");
+    }
+    par->threads = threads;
+    if (window_bits < 0) {
+        par->format = PDEFLATE_RAW;
+        par->wbits = -window_bits;
+    } else if (window_bits > 15) {
+        par->format = PDEFLATE_GZIP;
+        par->wbits = window_bits - 16;
+    } else {
+        par->format = PDEFLATE_ZLIB;
+        par->wbits = window_bits;
+    }
+    if (par->wbits == 8) par->wbits = 9; /* zlib does the same */
+    par->memlevel = memlevel;
+    par->check = (par->format == PDEFLATE_GZIP)
+        ? crc32(0, NULL, 0) : adler32(0, NULL, 0);
+    if (!SCM_FALSEP(dict)) {
+        /* The dictionary primes the first block, as if it were
+           the preceding data. */
+        const char *d = SCM_STRING_START(dict);
+        size_t dlen = SCM_STRING_SIZE(dict);
+        if (dlen > PDEFLATE_WINDOW) {
+            d += dlen - PDEFLATE_WINDOW;
+            dlen = PDEFLATE_WINDOW;
+        }
+        memcpy(par->hist, d, dlen);
+        par->histlen = dlen;
+        par->has_dict = TRUE;
+    }
+    pthread_mutex_init(&par->mutex, NULL);
+    pthread_cond_init(&par->work_cond, NULL);
+    pthread_cond_init(&par->done_cond, NULL);
+    for (int i=0; i<nthreads; i++) {
+        if (pthread_create(&par->threads[i], NULL, pdeflate_worker, par)
+            != 0) {
+            par->nthreads = i;
+            pdeflate_shutdown(par);
+            Scm_SysError("couldn't create a deflating thread");
+        }
+        par->nthreads = i+1;
+    }
+
+    ScmZlibInfo *info = SCM_NEW(ScmZlibInfo);
+    /* We don't run deflate on this stream; we only keep total_in,
+       total_out and adler up to date for zstream-* procedures. */
+    z_streamp strm = SCM_NEW_ATOMIC2(z_streamp, sizeof(z_stream));
+    memset(strm, 0, sizeof(z_stream));
+    strm->adler = par->check;
+    strm->data_type = Z_UNKNOWN;
+
+    info->strm = strm;
+    info->remote = sink;
+    info->bufsiz = 0;
+    info->buf = NULL;
+    info->ptr = NULL;
+    info->ownerp = ownerp;
+    info->flush = Z_NO_FLUSH;
+    info->stream_endp = FALSE;
+    info->level = level;
+    info->strategy = strategy;
+    info->dict_adler = dict_adler;
+    info->parallel = par;
+
+    ScmPortBuffer bufrec;
+    memset(&bufrec, 0, sizeof(bufrec));
+    bufrec.size = blocksiz;
+    bufrec.buffer = SCM_NEW_ATOMIC2(char *, blocksiz);
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    bufrec.filler = NULL;
+    bufrec.flusher = pdeflate_flusher;
+    bufrec.closer = pdeflate_closer;
+    bufrec.ready = NULL;
+    bufrec.filenum = zlib_fileno;
+    bufrec.data = (void*)info;
+
+    ScmObj name = port_name("deflating", sink);
+    return Scm_MakeBufferedPort(SCM_CLASS_DEFLATING_PORT, name,
+                                SCM_PORT_OUTPUT, TRUE, &bufrec);
+}
+
+#else  /* !GAUCHE_USE_PTHREADS */
+
+ScmObj Scm_MakeParallelDeflatingPort(ScmPort *sink, int level,
+                                     int window_bits, int memlevel,
+                                     int strategy, ScmObj dict,
+                                     ScmSize blocksiz,
+                                     int nthreads SCM_UNUSED,
+                                     int ownerp)
+{
+    return Scm_MakeDeflatingPort(sink, level, window_bits, memlevel,
+                                 strategy, dict, blocksiz, ownerp);
+}
+
+#endif /* !GAUCHE_USE_PTHREADS */
+
 /*================================================================
  * Inflating port
  */
@@ -492,6 +991,7 @@ ScmObj Scm_MakeInflatingPort(ScmPort *sink, ScmSize bufsiz,
     info->level = 0;
     info->strategy = 0;
     info->dict_adler = SCM_FALSE;
+    info->parallel = NULL;
 
     ScmPortBuffer bufrec;
     memset(&bufrec, 0, sizeof(bufrec));
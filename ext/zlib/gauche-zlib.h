@@ -47,6 +47,8 @@
 
 SCM_DECL_BEGIN
 
+struct ScmZlibParallelRec;      /* defined in gauche-zlib.c */
+
 typedef struct ScmZlibInfoRec {
     z_streamp strm;
     ScmPort *remote;            /* source or drain port */
@@ -61,6 +63,8 @@ typedef struct ScmZlibInfoRec {
     int level;
     int strategy;
     ScmObj dict_adler;
+    struct ScmZlibParallelRec *parallel; /* non-NULL if deflating by
+                                            worker threads */
 } ScmZlibInfo;
 
 #define SCM_PORT_ZLIB_INFO(p) ((ScmZlibInfo*)(p)->src.buf.data)
@@ -77,6 +81,11 @@ extern ScmObj Scm_MakeDeflatingPort(ScmPort *source, int level,
                                     int window_bits, int memlevel,
                                     int strategy, ScmObj dict,
                                     ScmSize bufsiz, int ownerp);
+extern ScmObj Scm_MakeParallelDeflatingPort(ScmPort *sink, int level,
+                                            int window_bits, int memlevel,
+                                            int strategy, ScmObj dict,
+                                            ScmSize blocksiz, int nthreads,
+                                            int ownerp);
 extern ScmObj Scm_MakeInflatingPort(ScmPort *sink, ScmSize bufsiz,
                                     int window_bits, ScmObj dict,
                                     int ownerp);
@@ -123,7 +132,7 @@ SCM_CLASS_DECL(Scm_ZlibVersionErrorClass);
 #define SCM_ZLIB_VERSION_ERRORP(obj)    SCM_ISA(obj, SCM_CLASS_ZLIB_VERSION_ERROR)
 
 extern ScmObj Scm_MakeZlibError(ScmObj message, int error_code);
-extern void Scm_ZlibError(int error_code, const char *msg, ...);
+extern void Scm_ZlibError(int error_code, const char *msg, ...) SCM_NORETURN;
 extern ScmObj Scm_InflateSync(ScmPort *port);
 
 extern void Scm_Init_zlib(void);
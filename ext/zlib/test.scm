@@ -219,6 +219,75 @@
          (close-output-port p)
          (zstream-data-type p)))
 
+;; parallel deflating
+(let ()
+  ;; Compressible, but not too repetitive data, spanning several blocks.
+  (define data
+    (with-output-to-string
+      (^[] (dotimes [i 20000] (format #t "~d:~a " i (modulo (* i 7919) 1009))))))
+  (define (pdeflate str . args)
+    (call-with-output-string
+      (^p (let1 p2 (apply open-deflating-port p :threads 3
+                          :buffer-size 4096 args)
+            (display str p2)
+            (close-output-port p2)))))
+
+  (test* "parallel deflate (empty)" #*"x\x9c\x03\0\0\0\0\x01"
+         (pdeflate ""))
+  (test* "parallel deflate" data
+         (inflate-string (pdeflate data)))
+  (test* "parallel deflate (gzip)" data
+         (gzip-decode-string (pdeflate data :window-bits 31)))
+  (test* "parallel deflate (raw)" data
+         (inflate-string (pdeflate data :window-bits -15) :window-bits -15))
+  (test* "parallel deflate (dictionary)" data
+         (inflate-string (pdeflate data :dictionary "1009 7919")
+                         :dictionary "1009 7919"))
+  (test* "parallel deflate (default threads and block size)" data
+         (inflate-string
+          (call-with-output-string
+            (^p (let1 p2 (open-deflating-port p :threads 0)
+                  (display data p2)
+                  (close-output-port p2))))))
+  (test* "parallel deflate (flush and full flush)" data
+         (inflate-string
+          (call-with-output-string
+            (^p (let1 p2 (open-deflating-port p :threads 2)
+                  (display (substring data 0 1000) p2)
+                  (flush p2)
+                  (display (substring data 1000 50000) p2)
+                  (deflating-port-full-flush p2)
+                  (zstream-params-set! p2 :compression-level 1)
+                  (display (substring data 50000 (string-length data)) p2)
+                  (close-output-port p2))))))
+  (test* "parallel deflate zstream-total-in/out, adler32"
+         (list (string-size data) #t (adler32 data))
+         (let* ([out (open-output-string)]
+                [p (open-deflating-port out :threads 2 :buffer-size 8192)])
+           (display data p)
+           (close-output-port p)
+           (list (zstream-total-in p)
+                 (= (zstream-total-out p)
+                    (string-size (get-output-string out)))
+                 (zstream-adler32 p))))
+  (test* "parallel deflate zstream-adler32 (gzip)" (crc32 data)
+         (let1 p (open-deflating-port (open-output-string) :threads 2
+                                      :window-bits 31)
+           (display data p)
+           (close-output-port p)
+           (zstream-adler32 p)))
+  (test* "parallel deflate owner?" #t
+         (let1 p (open-output-string)
+           (close-output-port (open-deflating-port p :threads 2 :owner? #t))
+           (port-closed? p)))
+  (test* "parallel deflate :compression-level 10" 'OK
+         (guard (e ((<zlib-stream-error> e) 'OK)
+                   (else 'error))
+           (open-deflating-port (open-output-string) :threads 2
+                                :compression-level 10)
+           'error))
+  )
+
 ;;------------------------------------------------------------------
 (test-section "inflate port")
 
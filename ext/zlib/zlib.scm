@@ -125,10 +125,17 @@
                                      strategy::<fixnum>
                                      dictionary
                                      buffer-size::<fixnum>
+                                     threads::<fixnum>
                                      owner?)
-   (return (Scm_MakeDeflatingPort source compression-level window-bits
-                                  memory-level strategy dictionary
-                                  buffer-size (not (SCM_FALSEP owner?)))))
+   (if (== threads 1)
+     (return (Scm_MakeDeflatingPort source compression-level window-bits
+                                    memory-level strategy dictionary
+                                    buffer-size (not (SCM_FALSEP owner?))))
+     (return (Scm_MakeParallelDeflatingPort source compression-level
+                                            window-bits memory-level
+                                            strategy dictionary buffer-size
+                                            threads
+                                            (not (SCM_FALSEP owner?))))))
 
  (define-cproc open-inflating-port (sink::<input-port>
                                     :key (buffer-size::<fixnum> 0)
@@ -159,9 +166,13 @@
       [(SCM_FALSEP strategy) (set! st (-> info strategy))]
       [(SCM_INTP strategy) (set! st (SCM_INT_VALUE strategy))]
       [else (SCM_TYPE_ERROR strategy "fixnum or #f")])
-     (let* ([r::int (deflateParams strm lv st)])
-       (unless (== r Z_OK)
-         (Scm_ZlibError r "deflateParams failed: %s" (-> strm msg))))))
+     (if (-> info parallel)
+       ;; takes effect from the next block
+       (set! (-> info level) lv
+             (-> info strategy) st)
+       (let* ([r::int (deflateParams strm lv st)])
+         (unless (== r Z_OK)
+           (Scm_ZlibError r "deflateParams failed: %s" (-> strm msg)))))))
 
  (define-cproc deflating-port-full-flush (port::<deflating-port>) ::<void>
    (set! (-> (SCM_PORT_ZLIB_INFO port) flush) Z_FULL_FLUSH)
@@ -190,11 +201,12 @@
                                   (strategy Z_DEFAULT_STRATEGY)
                                   (dictionary #f)
                                   (buffer-size 0)
+                                  (threads 1)
                                   (owner? #f))
   (%open-deflating-port source compression-level
                         window-bits memory-level
                         strategy dictionary
-                        buffer-size owner?))
+                        buffer-size threads owner?))
 
 ;; utility procedures
 (define (deflate-string str . args)
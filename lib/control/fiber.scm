@@ -0,0 +1,533 @@
+;;;
+;;; control.fiber - lightweight threads on a few carrier threads
+;;;
+;;;   Copyright (c) 2019  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module control.fiber
+  (use gauche.threads)
+  (use gauche.net)
+  (use gauche.fcntl)
+  (use gauche.uvector)
+  (use gauche.record)
+  (use data.queue)
+  (use data.heap)
+  (export <fiber> fiber? fiber-name fiber-done? current-fiber
+          run-fibers spawn-fiber fiber-yield fiber-sleep fiber-join
+          fiber-wait-readable fiber-wait-writable
+          fiber-socket-accept fiber-socket-connect
+          fiber-socket-recv fiber-socket-recv! fiber-socket-send
+
+          <fiber-mutex> make-fiber-mutex fiber-mutex? fiber-mutex-name
+          fiber-mutex-lock! fiber-mutex-unlock! with-fiber-mutex
+
+          <fiber-queue> make-fiber-queue fiber-queue? fiber-queue-length
+          fiber-enqueue! fiber-dequeue!))
+(select-module control.fiber)
+
+;; A fiber is a lightweight thread of control.  Fibers are run by
+;; carriers---a few Gauche threads, each of which runs its own scheduler
+;; loop.  A fiber stays on the carrier it is assigned to at creation,
+;; for a continuation can't be resumed in another VM.  New fibers are
+;; distributed to carriers in round-robin.
+;;
+;; Fibers are switched by full continuations.  The scheduler loop and
+;; the fibers of a carrier run on the same C stack, so guard and
+;; dynamic-wind in a fiber work across switching.  It also means a fiber
+;; can't be suspended while it is called back from C, e.g. in a
+;; procedural port or in a comparator passed to sort; it gets "attempt
+;; to return from a ghost continuation" error when it is resumed.
+;;
+;; When a fiber waits for I/O, it registers the fd to the carrier's
+;; fd-poller and parks.  The carrier waits on the poller when it has
+;; nothing to run.  Reading from or writing to ports, and the socket
+;; operations of gauche.net, are done in C and block the carrier;
+;; fiber-socket-* procedures use non-blocking calls and park the fiber
+;; instead.
+;;
+;; Carrier-local structures (waiters and timers) are only touched by the
+;; carrier thread.  Other structures are shared, and protected by
+;; a mutex which is never held while a fiber is parked.
+
+(define-record-type <scheduler> %make-scheduler scheduler?
+  (carriers scheduler-carriers scheduler-carriers-set!) ; #(<carrier> ...)
+  (lock     scheduler-lock)                             ; for next and live
+  (next     scheduler-next scheduler-next-set!)         ; round-robin index
+  (live     scheduler-live scheduler-live-set!)         ; # of alive fibers
+  (main     scheduler-main scheduler-main-set!)         ; the initial fiber
+  (drain?   scheduler-drain?)
+  (stop?    scheduler-stop? scheduler-stop-set!))
+
+(define-record-type <carrier> %make-carrier carrier?
+  (scheduler carrier-scheduler)
+  (runq      carrier-runq)                  ; mtqueue of runnable fibers
+  (poller    carrier-poller)
+  (waiters   carrier-waiters)               ; fd -> (reader . writer)
+  (timers    carrier-timers)                ; heap of (time . fiber)
+  (thread    carrier-thread carrier-thread-set!)
+  (sched-k   carrier-sched-k carrier-sched-k-set!) ; back to scheduler
+  (current   carrier-current carrier-current-set!)); running fiber
+
+(define-record-type <fiber> %make-fiber fiber?
+  (name      fiber-name)
+  (thunk     fiber-thunk)
+  (carrier   fiber-carrier)
+  (k         fiber-k fiber-k-set!)          ; continuation while parked
+  (value     fiber-value fiber-value-set!)  ; passed to k when resumed
+  (lock      fiber-lock)                    ; for the following slots
+  (done?     fiber-done? fiber-done-set!)
+  (result    fiber-result fiber-result-set!)       ; list of values
+  (exception fiber-exception fiber-exception-set!)
+  (joiners   fiber-joiners fiber-joiners-set!))
+
+(define-method write-object ((f <fiber>) port)
+  (format port "#<fiber ~s~a>" (fiber-name f)
+          (if (fiber-done? f) " (done)" "")))
+
+;; We never park while holding a mutex, nor raise an error.
+(define-syntax with-lock
+  (syntax-rules ()
+    [(_ m body ...)
+     (let1 m. m
+       (mutex-lock! m.)
+       (begin0 (begin body ...) (mutex-unlock! m.)))]))
+
+(define %current-carrier (make-parameter #f))
+
+;; A thread created within a fiber inherits the parameter; we check
+;; the thread so that it isn't mistaken as a carrier.
+(define (current-carrier)
+  (let1 c (%current-carrier)
+    (and c (eq? (carrier-thread c) (current-thread)) c)))
+
+(define (current-fiber)
+  (cond [(current-carrier) => carrier-current] [else #f]))
+
+(define (%check-fiber who)
+  (let1 c (current-carrier)
+    (unless (and c (carrier-current c))
+      (errorf "~a must be called within a fiber" who))
+    c))
+
+(define (%now)
+  (receive (sec nsec) (sys-clock-gettime-monotonic)
+    (if sec
+      (+ sec (/. nsec 1e9))
+      (time->seconds (current-time)))))
+
+;;;
+;;; Scheduler
+;;;
+
+(define (run-fibers thunk :key (carriers #f) (drain? #f))
+  (when (current-fiber)
+    (error "run-fibers can't be called within a fiber"))
+  (let* ([n (cond [carriers]
+                  [(eq? (gauche-thread-type) 'none) 1]
+                  [else (sys-available-processors)])]
+         [s (%make-scheduler #f (make-mutex) 0 1 #f drain? #f)]
+         [cs (vector-tabulate n (^_ (%make-carrier s (make-mtqueue)
+                                                  (make-fd-poller)
+                                                  (make-hash-table 'eqv?)
+                                                  (make-binary-heap :key car)
+                                                  #f #f #f)))]
+         [c0 (vector-ref cs 0)]
+         [main (%make-fiber 'main thunk c0 #f #f (make-mutex) #f '() #f '())])
+    (scheduler-carriers-set! s cs)
+    (scheduler-main-set! s main)
+    (enqueue! (carrier-runq c0) main)
+    (carrier-thread-set! c0 (current-thread))
+    (let1 threads
+        (map (^i (let1 c (vector-ref cs i)
+                   (rlet1 t (make-thread (cut carrier-run c) #"carrier ~i")
+                     (carrier-thread-set! c t))))
+             (iota (- n 1) 1))
+      (for-each thread-start! threads)
+      (unwind-protect (carrier-run c0)
+        (begin
+          (%stop! s)
+          (for-each thread-join! threads)
+          (vector-for-each (^c (fd-poller-close (carrier-poller c))) cs))))
+    (if-let1 e (fiber-exception main)
+      (raise e)
+      (apply values (fiber-result main)))))
+
+(define (carrier-run c)
+  (parameterize ([%current-carrier c])
+    (let loop ()
+      (unless (scheduler-stop? (carrier-scheduler c))
+        (run-ready! c)
+        (wake-timers! c)
+        (poll-io! c)
+        (loop)))))
+
+(define (%stop! s)
+  (scheduler-stop-set! s #t)
+  (vector-for-each (^c (fd-poller-wakeup (carrier-poller c)))
+                   (scheduler-carriers s)))
+
+(define (run-ready! c)
+  (let loop ([fs (dequeue-all! (carrier-runq c))])
+    (unless (null? fs)
+      (run-fiber! c (car fs))
+      (loop (cdr fs)))))
+
+;; Runs F until it parks or finishes.  Both come back here through
+;; sched-k.
+(define (run-fiber! c f)
+  (call/cc
+   (^[k]
+     (carrier-sched-k-set! c k)
+     (carrier-current-set! c f)
+     (if-let1 fk (fiber-k f)
+       (begin (fiber-k-set! f #f) (fk (fiber-value f)))
+       (start-fiber! f))))
+  (carrier-current-set! c #f))
+
+(define (start-fiber! f)
+  (let1 r (guard (e [else (fiber-exception-set! f e) '()])
+            (values->list ((fiber-thunk f))))
+    (finish-fiber! f r)
+    ;; We may have parked since we started; we have to return to the
+    ;; scheduler that resumed us the last time.
+    ((carrier-sched-k (fiber-carrier f)) #f)))
+
+(define (finish-fiber! f r)
+  (let ([s (carrier-scheduler (fiber-carrier f))]
+        [joiners (with-lock (fiber-lock f)
+                   (fiber-result-set! f r)
+                   (fiber-done-set! f #t)
+                   (begin0 (fiber-joiners f) (fiber-joiners-set! f '())))])
+    (for-each (cut %resume! <> #t) joiners)
+    (when (or (zero? (with-lock (scheduler-lock s)
+                       (rlet1 n (- (scheduler-live s) 1)
+                         (scheduler-live-set! s n))))
+              (and (eq? f (scheduler-main s)) (not (scheduler-drain? s))))
+      (%stop! s))))
+
+;; Makes F runnable; VAL is returned from %park! in F.
+;; This can be called from any thread.
+(define (%resume! f val)
+  (let1 c (fiber-carrier f)
+    (fiber-value-set! f val)
+    (enqueue! (carrier-runq c) f)
+    (unless (eq? c (current-carrier))
+      (fd-poller-wakeup (carrier-poller c)))))
+
+;; Suspends the current fiber.  Whoever registers the fiber to be
+;; resumed must do so before calling this; the carrier won't look at
+;; the run queue until we're back in the scheduler.
+(define (%park! c)
+  (let1 f (carrier-current c)
+    (call/cc (^[k]
+               (fiber-k-set! f k)
+               ((carrier-sched-k c) #f)))))
+
+(define (wake-timers! c)
+  (let1 h (carrier-timers c)
+    (unless (binary-heap-empty? h)
+      (let1 now (%now)
+        (let loop ()
+          (unless (or (binary-heap-empty? h)
+                      (> (car (binary-heap-find-min h)) now))
+            (%resume! (cdr (binary-heap-pop-min! h)) #f)
+            (loop)))))))
+
+(define (poll-io! c)
+  (let* ([timers (carrier-timers c)]
+         [timeout (cond [(not (queue-empty? (carrier-runq c))) 0]
+                        [(binary-heap-empty? timers) #f]
+                        [else (max 0 (* (- (car (binary-heap-find-min timers))
+                                           (%now))
+                                        1e6))])])
+    (let loop ([evs (fd-poller-wait (carrier-poller c) timeout)])
+      (unless (null? evs)
+        (io-ready! c (caar evs) (cdar evs))
+        (loop (cdr evs))))))
+
+(define (interest w) (cond-list [(car w) 'r] [(cdr w) 'w]))
+
+(define (io-ready! c fd flags)
+  (and-let1 w (hash-table-get (carrier-waiters c) fd #f)
+    (when (and (car w) (memq 'r flags))
+      (%resume! (car w) #t)
+      (set-car! w #f))
+    (when (and (cdr w) (memq 'w flags))
+      (%resume! (cdr w) #t)
+      (set-cdr! w #f))
+    (if (or (car w) (cdr w))
+      (fd-poller-add! (carrier-poller c) fd (interest w)) ; poller is one-shot
+      (hash-table-delete! (carrier-waiters c) fd))))
+
+;;;
+;;; Fiber API
+;;;
+
+(define (spawn-fiber thunk :optional (name #f))
+  (let* ([s (carrier-scheduler (%check-fiber 'spawn-fiber))]
+         [cs (scheduler-carriers s)]
+         [c (vector-ref cs (with-lock (scheduler-lock s)
+                             (scheduler-live-set! s (+ (scheduler-live s) 1))
+                             (rlet1 i (scheduler-next s)
+                               (scheduler-next-set!
+                                s (modulo (+ i 1) (vector-length cs))))))]
+         [f (%make-fiber name thunk c #f #f (make-mutex) #f '() #f '())])
+    (%resume! f #f)
+    f))
+
+(define (fiber-yield)
+  (let1 c (%check-fiber 'fiber-yield)
+    (%resume! (carrier-current c) #f)
+    (%park! c)
+    (undefined)))
+
+(define (fiber-sleep seconds)
+  (let1 c (%check-fiber 'fiber-sleep)
+    (binary-heap-push! (carrier-timers c)
+                       (cons (+ (%now) seconds) (carrier-current c)))
+    (%park! c)
+    (undefined)))
+
+(define (fiber-join fiber)
+  (let* ([c (%check-fiber 'fiber-join)]
+         [me (carrier-current c)])
+    (when (eq? fiber me)
+      (error "a fiber can't join itself:" fiber))
+    (when (with-lock (fiber-lock fiber)
+            (and (not (fiber-done? fiber))
+                 (begin (fiber-joiners-set! fiber
+                                            (cons me (fiber-joiners fiber)))
+                        #t)))
+      (%park! c))
+    (if-let1 e (fiber-exception fiber)
+      (raise e)
+      (apply values (fiber-result fiber)))))
+
+;;;
+;;; I/O
+;;;
+
+(define (%fd obj)
+  (cond [(integer? obj) obj]
+        [(is-a? obj <socket>) (socket-fd obj)]
+        [(and (port? obj) (port-file-number obj))]
+        [else (error "file descriptor, port or socket required, \
+                      but got:" obj)]))
+
+(define (%wait-fd who obj dir)
+  (let* ([c (%check-fiber who)]
+         [fd (%fd obj)]
+         [tab (carrier-waiters c)]
+         [w (or (hash-table-get tab fd #f)
+                (rlet1 w (cons #f #f) (hash-table-put! tab fd w)))])
+    (when ((if (eq? dir 'r) car cdr) w)
+      (errorf "~a: another fiber is already waiting on ~s" who obj))
+    ((if (eq? dir 'r) set-car! set-cdr!) w (carrier-current c))
+    (fd-poller-add! (carrier-poller c) fd (interest w))
+    (%park! c)
+    (undefined)))
+
+(define (fiber-wait-readable obj) (%wait-fd 'fiber-wait-readable obj 'r))
+(define (fiber-wait-writable obj) (%wait-fd 'fiber-wait-writable obj 'w))
+
+(define *dontwait* (global-variable-ref (find-module 'gauche.net)
+                                        'MSG_DONTWAIT 0))
+
+(define %blocked (list 'blocked))      ;unique marker
+
+(define (would-block? e)
+  (and (condition-has-type? e <system-error>)
+       (memv (condition-ref e 'errno) `(,EAGAIN ,EWOULDBLOCK))))
+
+;; Tries EXPR, and if it would block, waits until SOCK gets ready.
+(define-syntax retry-on-block
+  (syntax-rules ()
+    [(_ who sock dir expr)
+     (let loop ()
+       (let1 r (guard (e [(would-block? e) %blocked]) expr)
+         (if (eq? r %blocked)
+           (begin (%wait-fd who sock dir) (loop))
+           r)))]))
+
+(define (%set-nonblocking! sock)
+  (let* ([fd (socket-fd sock)]
+         [flags (sys-fcntl fd F_GETFL)])
+    (unless (logtest flags O_NONBLOCK)
+      (sys-fcntl fd F_SETFL (logior flags O_NONBLOCK)))))
+
+(define (fiber-socket-accept sock)
+  (%set-nonblocking! sock)
+  (let loop ()
+    (or (socket-accept sock)            ;returns #f if it would block
+        (begin (%wait-fd 'fiber-socket-accept sock 'r) (loop)))))
+
+(define (fiber-socket-connect sock addr)
+  (%set-nonblocking! sock)
+  (unless (socket-connect sock addr)    ;returns #f if it would block
+    (%wait-fd 'fiber-socket-connect sock 'w)
+    (let1 err (socket-getsockopt sock SOL_SOCKET SO_ERROR 0)
+      (unless (zero? err)
+        (errorf "connect failed to ~a: ~a" addr (sys-strerror err)))
+      (socket-connect sock addr)))
+  sock)
+
+(define (fiber-socket-recv sock bytes :optional (flags 0))
+  (retry-on-block 'fiber-socket-recv sock 'r
+                  (socket-recv sock bytes (logior flags *dontwait*))))
+
+(define (fiber-socket-recv! sock buf :optional (flags 0))
+  (retry-on-block 'fiber-socket-recv! sock 'r
+                  (socket-recv! sock buf (logior flags *dontwait*))))
+
+;; Sends the whole MSG, possibly with several send(2) calls.
+(define (fiber-socket-send sock msg :optional (flags 0))
+  (let* ([buf (if (string? msg)
+                (string->u8vector msg)
+                (uvector-alias <u8vector> msg))]
+         [len (u8vector-length buf)])
+    (let loop ([start 0])
+      (when (< start len)
+        (loop (+ start
+                 (retry-on-block
+                  'fiber-socket-send sock 'w
+                  (socket-send sock
+                               (if (zero? start)
+                                 buf
+                                 (uvector-alias <u8vector> buf start))
+                               (logior flags *dontwait*)))))))
+    len))
+
+;;;
+;;; Fiber mutex
+;;;
+
+;; Ownership is handed over directly to the waiting fiber on unlock.
+
+(define-record-type <fiber-mutex> %make-fiber-mutex fiber-mutex?
+  (name    fiber-mutex-name)
+  (lock    fiber-mutex-lock)
+  (owner   fiber-mutex-owner fiber-mutex-owner-set!)
+  (waiters fiber-mutex-waiters))            ; queue of fibers
+
+(define (make-fiber-mutex :optional (name #f))
+  (%make-fiber-mutex name (make-mutex) #f (make-queue)))
+
+(define (fiber-mutex-lock! m)
+  (let* ([c (%check-fiber 'fiber-mutex-lock!)]
+         [me (carrier-current c)]
+         [r (with-lock (fiber-mutex-lock m)
+              (cond [(not (fiber-mutex-owner m))
+                     (fiber-mutex-owner-set! m me) 'locked]
+                    [(eq? (fiber-mutex-owner m) me) 'recursive]
+                    [else (enqueue! (fiber-mutex-waiters m) me) 'wait]))])
+    (case r
+      [(recursive) (error "fiber mutex is already locked by this fiber:" m)]
+      [(wait) (%park! c)])
+    #t))
+
+(define (fiber-mutex-unlock! m)
+  (let* ([me (current-fiber)]
+         [next (with-lock (fiber-mutex-lock m)
+                 (if (eq? (fiber-mutex-owner m) me)
+                   (rlet1 next (dequeue! (fiber-mutex-waiters m) #f)
+                     (fiber-mutex-owner-set! m next))
+                   me))])
+    (cond [(eq? next me)
+           (error "fiber mutex is not locked by this fiber:" m)]
+          [next (%resume! next #t)])
+    #t))
+
+(define (with-fiber-mutex m thunk)
+  (fiber-mutex-lock! m)
+  (unwind-protect (thunk) (fiber-mutex-unlock! m)))
+
+;;;
+;;; Fiber queue
+;;;
+
+;; Enqueuing and dequeuing without waiting can be done outside of
+;; fibers, so that other threads can feed fibers.
+
+(define %wait (list 'wait))             ;unique markers
+(define %full (list 'full))
+(define %empty (list 'empty))
+
+(define-record-type <fiber-queue> %make-fiber-queue fiber-queue?
+  (lock       fiber-queue-lock)
+  (items      fiber-queue-items)             ; <queue>
+  (max-length fiber-queue-max-length)
+  (readers    fiber-queue-readers)           ; queue of fibers
+  (writers    fiber-queue-writers))          ; queue of (fiber . item)
+
+(define (make-fiber-queue :key (max-length #f))
+  (%make-fiber-queue (make-mutex) (make-queue) max-length
+                     (make-queue) (make-queue)))
+
+(define (fiber-queue-length q)
+  (with-lock (fiber-queue-lock q) (queue-length (fiber-queue-items q))))
+
+(define (fiber-enqueue! q item)
+  (let* ([me (current-fiber)]
+         [r (with-lock (fiber-queue-lock q)
+              (cond [(not (queue-empty? (fiber-queue-readers q)))
+                     (dequeue! (fiber-queue-readers q))]
+                    [(and-let1 mx (fiber-queue-max-length q)
+                       (>= (queue-length (fiber-queue-items q)) mx))
+                     (if me
+                       (begin (enqueue! (fiber-queue-writers q) (cons me item))
+                              %wait)
+                       %full)]
+                    [else (enqueue! (fiber-queue-items q) item) #f]))])
+    (cond [(fiber? r) (%resume! r item)]
+          [(eq? r %wait) (%park! (fiber-carrier me))]
+          [(eq? r %full) (error "fiber queue is full:" q)])
+    (undefined)))
+
+(define (fiber-dequeue! q)
+  (let* ([me (current-fiber)]
+         [writer #f]
+         [r (with-lock (fiber-queue-lock q)
+              (let ([items (fiber-queue-items q)]
+                    [writers (fiber-queue-writers q)])
+                (define (take-writer!)
+                  (rlet1 w (dequeue! writers)
+                    (set! writer (car w))))
+                (cond [(not (queue-empty? items))
+                       (rlet1 x (dequeue! items)
+                         (unless (queue-empty? writers)
+                           (enqueue! items (cdr (take-writer!)))))]
+                      [(not (queue-empty? writers)) ; max-length is 0
+                       (cdr (take-writer!))]
+                      [me (enqueue! (fiber-queue-readers q) me) %wait]
+                      [else %empty])))])
+    (when writer (%resume! writer #t))
+    (cond [(eq? r %wait) (%park! (fiber-carrier me))]
+          [(eq? r %empty) (error "fiber queue is empty:" q)]
+          [else r])))
@@ -151,6 +151,10 @@
 ;;      which isn't exported) are not included in the output.  But sometimes
 ;;      hygienic public macros expands to a call of private macros, and
 ;;      gauche.cgen.precomp cannot detect such dependencies yet.
+;;
+;; auto-inline : If true, compile with the compiler's auto-inline mode,
+;;      in which small exported procedures are made inlinable so that
+;;      the code using the module can inline them.
 
 (define (cgen-precompile src . keys)
   (with-tmodule-recording
@@ -167,7 +171,8 @@
                                     (predef-syms '())
                                     (macros-to-keep '())
                                     (single-sci-file #f)
-                                    (extra-optimization #f))
+                                    (extra-optimization #f)
+                                    (auto-inline #f))
   (define (precomp-1 main src)
     (let* ([out.c (cgen-scm-path->c-file (strip-prefix src prefix))]
            [initname (cgen-c-file->initfn out.c)])
@@ -179,6 +184,7 @@
                         :strip-prefix prefix
                         :macros-to-keep macros-to-keep
                         :extra-optimization extra-optimization
+                        :auto-inline auto-inline
                         :ext-initializer (and (equal? src main)
                                               ext-initializer)
                         :initializer-name initname)))
@@ -224,13 +230,15 @@
                                (sub-initializers '())
                                (predef-syms '())
                                (macros-to-keep '())
-                               (extra-optimization #f))
+                               (extra-optimization #f)
+                               (auto-inline #f))
   (define (do-it)
     (parameterize ([omitted-code '()])
       (setup ext-initializer sub-initializers)
       (with-input-from-file src
-        (cut emit-toplevel-executor
-             (reverse (generator-fold compile-toplevel-form '() read))))
+        (cut with-auto-inline auto-inline
+             (^[] (emit-toplevel-executor
+                   (reverse (generator-fold compile-toplevel-form '() read))))))
       (finalize sub-initializers)
       (cgen-emit-c (cgen-current-unit))))
   (let ([out.c   (or out.c (path-swap-extension (sys-basename src) "c"))]
@@ -343,6 +351,19 @@
 
 ;; compatibility kludge
 (define compile       (with-module gauche.internal compile))
+
+;; Runs THUNK with the compiler's auto-inline mode if FLAG is true.
+(define (with-auto-inline flag thunk)
+  (define flag-get (with-module gauche.internal vm-compiler-flag))
+  (define flag-set! (with-module gauche.internal vm-compiler-flag-set!))
+  (define flag-clear! (with-module gauche.internal vm-compiler-flag-clear!))
+  (define auto-inline (with-module gauche.internal SCM_COMPILE_AUTO_INLINE))
+  (if flag
+    (let1 save (flag-get)
+      (unwind-protect
+          (begin (flag-set! auto-inline) (thunk))
+        (begin (flag-clear! auto-inline) (flag-set! save))))
+    (thunk)))
 (define %procedure-inliner
   (with-module gauche.internal %procedure-inliner))
 (define vm-code->list (with-module gauche.internal vm-code->list))
@@ -109,19 +109,40 @@
 (define (copy-port src dst :key (unit 4096) (size -1))
   (check-arg input-port? src)
   (check-arg output-port? dst)
+  (cond [(eq? unit 'char)
+         (if (and (integer? size) (not (negative? size)))
+           (%do-copy/limit1 (read-char src) (write-char data dst) size)
+           (%do-copy (read-char src) (write-char data dst) (+ count 1)))]
+        [(or (eq? unit 'byte) (integer? unit))
+         (%copy-port-bytes src dst unit size)]
+        [else (error "unit must be 'char, 'byte, or non-negative integer" unit)]
+        ))
+
+;; If both ports are connected to file descriptors, we let the kernel
+;; move the data (sendfile, splice or copy_file_range) as far as it can,
+;; and copy the rest, if any, through the buffers.
+(define (%copy-port-bytes src dst unit size)
+  (define limit
+    (if (and (integer? size) (not (negative? size))) (exact size) -1))
+  (with-port-locking src
+    (^[]
+      (with-port-locking dst
+        (^[]
+          (receive (n done) ((with-module gauche.internal %copy-port-direct)
+                             src dst limit)
+            (cond [done n]
+                  [(< limit 0) (+ n (%copy-port-buffered src dst unit size))]
+                  [else (+ n (%copy-port-buffered src dst unit
+                                                  (- limit n)))])))))))
+
+(define (%copy-port-buffered src dst unit size)
   (cond [(eq? unit 'byte)
          (if (and (integer? size) (not (negative? size)))
            (%do-copy/limit1 (read-byte src) (write-byte data dst) size)
            (%do-copy (read-byte src) (write-byte data dst) (+ count 1)))]
-        [(eq? unit 'char)
-         (if (and (integer? size) (not (negative? size)))
-           (%do-copy/limit1 (read-char src) (write-char data dst) size)
-           (%do-copy (read-char src) (write-char data dst) (+ count 1)))]
-        [(integer? unit)
+        [else
          (let ((buf (make-u8vector (if (zero? unit) 4096 unit))))
            (if (and (integer? size) (not (negative? size)))
              (%do-copy/limitN src dst buf unit size)
              (%do-copy (read-block! buf src) (write-block buf dst 0 data)
-                       (+ count data))))]
-        [else (error "unit must be 'char, 'byte, or non-negative integer" unit)]
-        ))
+                       (+ count data))))]))
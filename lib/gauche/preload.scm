@@ -0,0 +1,251 @@
+;;;
+;;; gauche.preload - load libraries in parallel
+;;;
+;;;   Copyright (c) 2019  Shiro Kawai  <shiro@acm.org>
+;;;
+;;;   Redistribution and use in source and binary forms, with or without
+;;;   modification, are permitted provided that the following conditions
+;;;   are met:
+;;;
+;;;   1. Redistributions of source code must retain the above copyright
+;;;      notice, this list of conditions and the following disclaimer.
+;;;
+;;;   2. Redistributions in binary form must reproduce the above copyright
+;;;      notice, this list of conditions and the following disclaimer in the
+;;;      documentation and/or other materials provided with the distribution.
+;;;
+;;;   3. Neither the name of the authors nor the names of its contributors
+;;;      may be used to endorse or promote products derived from this
+;;;      software without specific prior written permission.
+;;;
+;;;   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+;;;   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+;;;   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+;;;   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+;;;   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+;;;   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+;;;   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+;;;   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+;;;   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+;;;   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+;;;   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+;;;
+
+(define-module gauche.preload
+  (use srfi-1)
+  (use data.queue)
+  (use util.match)
+  (use gauche.threads)
+  (export preload-dependency-graph preload-libraries
+          preload-script-dependencies))
+(select-module gauche.preload)
+
+;; Loading a program that uses many libraries spends most of its startup
+;; time in reading and compiling them one after another, although the
+;; libraries that don't depend on each other could be loaded in parallel.
+;;
+;; We scan the source files, without evaluating them, for toplevel 'use'
+;; and 'require' forms (including the ones in define-module) to build the
+;; dependency graph of the features.  Then worker threads 'require' the
+;; features, each one after all the features it depends on are loaded.
+;; So the toplevel side effects of a library take place after the ones
+;; of the libraries it depends on, as in sequential loading; the relative
+;; order of independent libraries is unspecified.
+;;
+;; Features depending on each other (a strongly connected component of
+;; the graph) are loaded by a single thread, starting from the one that
+;; sequential loading would require first; if it's a real loop, 'require'
+;; reports it as usual.
+;;
+;; A dependency we can't find by scanning, e.g. a 'use' in cond-expand
+;; or a 'require' in a procedure body, is simply loaded by the thread that
+;; needs it.  'require' is thread-safe; if the feature is being loaded by
+;; another thread, it waits for it.
+
+;;;
+;;; Dependency graph
+;;;
+
+;; Returns a list of features FORM requires.
+(define (form-requires form)
+  (match form
+    [('use (? symbol? m) . _)
+     (guard (e [else '()]) (list (module-name->path m)))]
+    [('require (? string? feature)) (list feature)]
+    [('define-module _ . body) (append-map form-requires body)]
+    [('begin . body) (append-map form-requires body)]
+    [_ '()]))
+
+;; Returns a list of features required by the toplevel forms in FILE.
+;; If we hit something unreadable, we give up there.
+(define (file-requires file)
+  (guard (e [else '()])
+    (call-with-input-file file
+      (^p (let1 p (open-coding-aware-port p)
+            (let loop ([r '()])
+              (let1 form (guard (e [else (eof-object)]) (read p))
+                (if (eof-object? form)
+                  (delete-duplicates (reverse r))
+                  (loop (append-reverse (form-requires form) r))))))))))
+
+(define (feature->file feature)
+  (and-let* ([r ((with-module gauche.internal find-load-file)
+                 feature *load-path* *load-suffixes*)])
+    (car r)))
+
+(define (root->feature root)
+  (cond [(string? root) root]
+        [(symbol? root) (module-name->path root)]
+        [else (error "module name or feature string required, but got:"
+                     root)]))
+
+;; API
+;; Returns ((<feature> <file> <dependency> ...) ...) for the features
+;; reachable from ROOTS that aren't provided yet, in the order of
+;; sequential loading (that is, dependencies first).  Features whose
+;; file can't be found in *load-path* are omitted.
+(define (preload-dependency-graph roots)
+  (define seen (make-hash-table 'equal?)) ; feature -> file or #f
+  (define (visit feature)
+    (if (or (hash-table-exists? seen feature) (provided? feature))
+      '()
+      (match (feature->file feature)
+        [#f (hash-table-put! seen feature #f) '()]
+        [file
+         (hash-table-put! seen feature file)
+         (let* ([deps (file-requires file)]
+                [nodes (append-map visit deps)])
+           `(,@nodes (,feature ,file ,@deps)))])))
+  (let1 nodes (append-map visit (map root->feature roots))
+    (map (match-lambda
+           [(feature file . deps)
+            `(,feature ,file ,@(filter (cut hash-table-get seen <> #f) deps))])
+         nodes)))
+
+;; Returns a list of strongly connected components of GRAPH, each being
+;; a list of features.  A component comes after the ones it depends on
+;; (Tarjan's algorithm yields them in that order).  The first feature of
+;; a component is the one sequential loading would require first, that
+;; is, the one that comes last in GRAPH; the rest are required from it.
+(define (strongly-connected-components graph)
+  (define deps (make-hash-table 'equal?))
+  (define rank (make-hash-table 'equal?))  ; position in GRAPH
+  (define index (make-hash-table 'equal?))
+  (define lowlink (make-hash-table 'equal?))
+  (define on-stack (make-hash-table 'equal?))
+  (define stack '())
+  (define counter 0)
+  (define result '())
+  (define (connect v)
+    (hash-table-put! index v counter)
+    (hash-table-put! lowlink v counter)
+    (inc! counter)
+    (push! stack v)
+    (hash-table-put! on-stack v #t)
+    (dolist [w (hash-table-get deps v)]
+      (cond [(not (hash-table-exists? index w))
+             (connect w)
+             (hash-table-update! lowlink v
+                                 (cut min <> (hash-table-get lowlink w)))]
+            [(hash-table-get on-stack w #f)
+             (hash-table-update! lowlink v
+                                 (cut min <> (hash-table-get index w)))]))
+    (when (= (hash-table-get lowlink v) (hash-table-get index v))
+      (let loop ([component '()])
+        (let1 w (pop! stack)
+          (hash-table-put! on-stack w #f)
+          (if (equal? w v)
+            (push! result (sort (cons w component) >
+                                (cut hash-table-get rank <>)))
+            (loop (cons w component)))))))
+
+  (for-each (^[node i]
+              (hash-table-put! deps (car node) (cddr node))
+              (hash-table-put! rank (car node) i))
+            graph (iota (length graph)))
+  (dolist [node graph]
+    (unless (hash-table-exists? index (car node))
+      (connect (car node))))
+  (reverse result))
+
+;;;
+;;; Loading
+;;;
+
+(define (%require feature) ((with-module gauche.internal %require) feature))
+
+;; Load the components with NTHREADS worker threads.  A component is
+;; handed to a worker when all the components it depends on are loaded.
+;; If an error occurs, we stop handing out new components, and reraise
+;; the first error after all the workers finish.
+(define (load-components components graph nthreads)
+  (define component-of (make-hash-table 'equal?))
+  (define pending (make-hash-table 'eq?))     ; component -> # of deps
+  (define dependents (make-hash-table 'eq?))  ; component -> components
+  (define ready (make-mtqueue))
+  (define lock (make-mutex))
+  (define remaining (length components))
+  (define failure #f)
+
+  (define (finish! c)
+    (with-locking-mutex lock
+      (^[]
+        (dec! remaining)
+        (dolist [d (hash-table-get dependents c '())]
+          (hash-table-update! pending d (cut - <> 1))
+          (when (zero? (hash-table-get pending d))
+            (enqueue! ready d)))
+        (when (zero? remaining)
+          (dotimes [_ nthreads] (enqueue! ready #f))))))
+
+  (define (fail! e)
+    (with-locking-mutex lock
+      (^[]
+        (unless failure
+          (set! failure e)
+          (dotimes [_ nthreads] (enqueue! ready #f))))))
+
+  (define (worker)
+    (let loop ()
+      (and-let1 c (dequeue/wait! ready)
+        (unless failure
+          (guard (e [else (fail! e)])
+            (for-each %require c)
+            (finish! c)))
+        (loop))))
+
+  (dolist [c components]
+    (dolist [f c] (hash-table-put! component-of f c)))
+  (dolist [c components]
+    (let1 ds (delete-duplicates
+              (filter-map (^f (let1 d (hash-table-get component-of f)
+                                (and (not (eq? d c)) d)))
+                          (append-map (^f (cddr (assoc f graph))) c))
+              eq?)
+      (hash-table-put! pending c (length ds))
+      (dolist [d ds] (hash-table-push! dependents d c))
+      (when (null? ds) (enqueue! ready c))))
+  (unless (zero? remaining)
+    (for-each thread-join!
+              (map (^_ (thread-start! (make-thread worker)))
+                   (iota nthreads))))
+  (when failure (raise failure)))
+
+;; API
+;; Loads the libraries ROOTS (module names or feature strings) and
+;; their dependencies in parallel.  Returns the list of features loaded.
+(define (preload-libraries roots :key (threads (sys-available-processors)))
+  (let* ([graph (preload-dependency-graph roots)]
+         [components (strongly-connected-components graph)])
+    (if (or (<= threads 1) (eq? (gauche-thread-type) 'none))
+      (for-each %require (concatenate components))
+      (load-components components graph (min threads (length components))))
+    (map car graph)))
+
+;; API
+;; Preloads the libraries the script FILE uses.  The script itself
+;; isn't loaded.  Used by 'gosh -fparallel-load'.
+(define (preload-script-dependencies file
+                                     :key (threads (sys-available-processors)))
+  (preload-libraries (if (file-exists? file) (file-requires file) '())
+                     :threads threads))
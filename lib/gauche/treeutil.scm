@@ -32,28 +32,37 @@
 ;;;
 
 (define-module gauche.treeutil
-  (export make-tree-map tree-map-empty?
+  (export make-tree-map make-btree-map tree-map-empty?
           tree-map-min tree-map-max tree-map-pop-min! tree-map-pop-max!
           tree-map-seek tree-map-fold tree-map-fold-right
           tree-map-map tree-map-for-each
           tree-map-keys tree-map-values
-          tree-map->alist alist->tree-map
+          tree-map->alist alist->tree-map sorted-alist->btree-map
           tree-map-compare-as-sets
           tree-map-compare-as-sequences)
   )
 (select-module gauche.treeutil)
 
-(define make-tree-map
-  (case-lambda
-    [() (%make-tree-map default-comparator)]
-    [(cmp)
-     (if (comparator? cmp)
-       (begin
-         (unless (comparator-ordered? cmp)
-           (error "make-tree-map needs an ordered comparator, but got:" cmp))
-         (%make-tree-map cmp))
-       (%make-tree-map (make-comparator/compare #t #t cmp #f)))]
-    [(=? <?) (%make-tree-map (make-comparator #t =? <? #f))]))
+(define (%tree-map-comparator who args)
+  (apply (case-lambda
+           [() default-comparator]
+           [(cmp)
+            (if (comparator? cmp)
+              (begin
+                (unless (comparator-ordered? cmp)
+                  (errorf "~a needs an ordered comparator, but got: ~s"
+                          who cmp))
+                cmp)
+              (make-comparator/compare #t #t cmp #f))]
+           [(=? <?) (make-comparator #t =? <? #f)])
+         args))
+
+(define (make-tree-map . args)
+  (%make-tree-map (%tree-map-comparator 'make-tree-map args)))
+
+;; Same as make-tree-map, but uses B+tree instead of red-black tree.
+(define (make-btree-map . args)
+  (%make-tree-map (%tree-map-comparator 'make-btree-map args) #t))
 
 (define (tree-map-empty? tm) (zero? (tree-map-num-entries tm)))
 
@@ -112,6 +121,13 @@
     (dolist (kv alist)
       (tree-map-put! tm (car kv) (cdr kv)))))
 
+;; ALIST must be sorted in strictly ascending order of the keys.
+(define (sorted-alist->btree-map alist . args)
+  (rlet1 tm (%make-tree-map (%tree-map-comparator 'sorted-alist->btree-map
+                                                  args)
+                            #t)
+    ((with-module gauche.internal %tree-map-bulk-load!) tm alist)))
+
 ;; Compare two tree-maps as sets.
 (define (tree-map-compare-as-sets tm1 tm2
                                   :optional (value=? equal?)
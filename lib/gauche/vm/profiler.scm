@@ -34,9 +34,13 @@
 (define-module gauche.vm.profiler
   (use srfi-13)
   (use util.match)
+  (use gauche.uvector)
+  (use gauche.vport)
   (extend gauche.internal)
   (export profiler-show profiler-get-result
-          profiler-show-load-stats with-profiler)
+          profiler-get-stacks profiler-write-flamegraph profiler-write-pprof
+          profiler-get-allocations profiler-show-allocations
+          profiler-show-load-stats with-profiler with-allocation-profiler)
   )
 (select-module gauche.vm.profiler)
 
@@ -81,6 +85,113 @@
       ;; show 'em.
       (show-stats (hash-table-map ht cons) sort-by max-rows))))
 
+;;
+;; Returns a portable representation of the sampled call stacks,
+;; a list of (<frame-names> . <sample-count>).  <frame-names> is a list
+;; of strings, outermost first.
+;;
+(define (profiler-get-stacks)
+  ;; NB: this part depends on the result object of profiler-raw-stacks.
+  ;; Keep this in sync with src/prof.c.
+  (if-let1 r (profiler-raw-stacks)
+    (let1 ht (make-hash-table 'equal?)
+      (dolist [e r]
+        (hash-table-update! ht (map frame-name (vector->list (car e)))
+                            (cut + (cdr e) <>) 0))
+      (hash-table->alist ht))
+    #f))
+
+;;
+;; Returns a portable representation of the allocation samples,
+;; a list of (<frame-names> <type> <samples> <bytes>).  <frame-names>
+;; is a list of strings, outermost first, and <type> is the name of
+;; the allocated C type.  <bytes> is the estimated bytes allocated.
+;; If LIVE is true, only the samples that are still alive are counted.
+;;
+(define (profiler-get-allocations :key (live #f))
+  ;; NB: this part depends on the result object of
+  ;; allocation-profiler-raw-result.  Keep this in sync with src/prof.c.
+  (when live (gc))
+  (if-let1 r (allocation-profiler-raw-result live)
+    (let1 ht (make-hash-table 'equal?)
+      (dolist [e r]
+        (let* ([v (car e)]
+               [n (- (vector-length v) 1)]
+               [k (cons (vector-ref v n)
+                        (map frame-name (vector->list v 0 n)))])
+          (hash-table-update! ht k
+                              (^p (cons (+ (cadr e) (car p))
+                                        (+ (cddr e) (cdr p))))
+                              '(0 . 0))))
+      (hash-table-map ht (^[k v] (list (cdr k) (car k) (car v) (cdr v)))))
+    #f))
+
+;;
+;; Show the allocation samples, summed up by the innermost frame
+;; and the type.
+;;
+;;  Keyword args:
+;;    :results - give a list of results returned by profiler-get-allocations.
+;;               If not given, the current result is used.
+;;    :live    - if true and results isn't given, show the live objects
+;;               only.
+;;    :sort-by - either one of 'bytes or 'count
+;;    :max-rows - # of rows to be shown.  #f to show everything.
+;;
+(define (profiler-show-allocations :key (results #f) (live #f)
+                                        (sort-by 'bytes) (max-rows 50))
+  (let1 allocs (merge-allocations results live)
+    (if (null? allocs)
+      (print "No allocation profiling data has been gathered.")
+      (show-allocation-stats allocs live sort-by max-rows))))
+
+;;
+;; Write the sampled call stacks in the 'collapsed stack' format,
+;; which flamegraph.pl and similar tools accept.
+;;
+;;  Keyword args:
+;;    :results - give a list of results returned by profiler-get-stacks,
+;;               e.g. the ones gathered from multiple threads.
+;;               If not given, the current result is used.
+;;    :allocations - if true, write allocation samples instead, weighted
+;;               by bytes.  The allocated type is added as the innermost
+;;               frame.  Results must be the ones of
+;;               profiler-get-allocations.  If it is the symbol live,
+;;               and results isn't given, live objects are written.
+;;    :port    - output port.
+;;
+(define (profiler-write-flamegraph :key (results #f) (allocations #f)
+                                        (port (current-output-port)))
+  (dolist [e (if allocations
+               (map (^e (cons (car e) (cadr e)))
+                    (allocation-stacks results (eq? allocations 'live)))
+               (merge-stacks results))]
+    (format port "~a ~d\n"
+            (string-join (map (cut regexp-replace-all #/[;\s]/ <> "_")
+                              (car e))
+                         ";")
+            (cdr e))))
+
+;;
+;; Write the sampled call stacks in the pprof profile format
+;; (uncompressed profile.proto).  Keyword args are the same as
+;; profiler-write-flamegraph.
+;;
+(define (profiler-write-pprof :key (results #f) (allocations #f)
+                                   (port (current-output-port)))
+  (write-uvector
+   (if allocations
+     (pprof-encode (map (^e (cons (car e) (reverse (cdr e))))
+                        (allocation-stacks results (eq? allocations 'live)))
+                   '(("alloc_objects" "count") ("alloc_space" "bytes"))
+                   '("space" "bytes") 0)
+     (pprof-encode (map (^e (list (car e) (cdr e)
+                                  (* (cdr e) *sampling-period-ns*)))
+                        (merge-stacks results))
+                   '(("samples" "count") ("cpu" "nanoseconds"))
+                   '("cpu" "nanoseconds") *sampling-period-ns*))
+   port))
+
 ;; *EXPERIMENTAL*
 ;; Show the load statistics.
 ;; Called from the cleanup routine of main.c.  Passed STATS is a list of
@@ -129,6 +240,15 @@
     (profiler-reset)
     (apply values vals)))
 
+(define (with-allocation-profiler thunk :key (interval 0) (live #f))
+  (receive vals (dynamic-wind
+                  (cut allocation-profiler-start interval)
+                  thunk
+                  allocation-profiler-stop)
+    (profiler-show-allocations :live live)
+    (allocation-profiler-reset)
+    (apply values vals)))
+
 ;;;==========================================================
 ;;; Internal routines
 ;;;
@@ -167,6 +287,138 @@
     ))
 
 
+;; Show the allocation samples
+(define (show-allocation-stats allocs live sort-by max-rows)
+  (let* ([ht (make-hash-table 'equal?)]
+         [_  (dolist [e allocs]
+               (hash-table-update! ht (list (if (null? (car e))
+                                              "???"
+                                              (last (car e)))
+                                            (cadr e))
+                                   (^p (cons (+ (caddr e) (car p))
+                                             (+ (cadddr e) (cdr p))))
+                                   '(0 . 0)))]
+         [stat (hash-table-map ht cons)] ; ((site type) samples . bytes)
+         [total (fold (^[e n] (+ (cddr e) n)) 0 stat)]
+         [key (case sort-by
+                [(bytes) cddr]
+                [(count) cadr]
+                [else
+                 (error "profiler-show-allocations: sort-by argument must be either one of bytes or count, but got:" sort-by)])]
+         [sorted (sort stat (^[a b] (> (key a) (key b))))])
+    (print "Allocation statistics (" (if live "live" "total") ", "
+           total " bytes estimated)")
+    (print "Name                                     Type                 samples       bytes")
+    (print "----------------------------------------+--------------------+-------+-----------------")
+    (dolist [e (if (integer? max-rows) (take* sorted max-rows) sorted)]
+      (match-let1 ((site type) samples . bytes) e
+        (format #t "~40a ~20a ~7d ~11d(~3d%)\n"
+                site type samples bytes
+                (if (zero? total)
+                  0
+                  (exact (round (* 100 (/ bytes total))))))))))
+
+;; Merge the results of profiler-get-allocations.  If RESULTS is #f,
+;; the current result is used.
+(define (merge-allocations results live)
+  (if (not results)
+    (or (profiler-get-allocations :live live) '())
+    (let1 ht (make-hash-table 'equal?)
+      (dolist [r results]
+        (dolist [e r]
+          (hash-table-update! ht (list (car e) (cadr e))
+                              (^p (list (+ (caddr e) (car p))
+                                        (+ (cadddr e) (cadr p))))
+                              '(0 0))))
+      (hash-table-map ht append))))
+
+;; Returns a list of (<frame-names> <bytes> <samples>) from allocation
+;; samples, with the type name as the innermost frame.
+(define (allocation-stacks results live)
+  (map (^e (list (append (car e) (list #"<~(cadr e)>")) (cadddr e) (caddr e)))
+       (merge-allocations results live)))
+
+;; Merge the results of profiler-get-stacks.  If RESULTS is #f,
+;; the current result is used.
+(define (merge-stacks results)
+  (if (not results)
+    (or (profiler-get-stacks) '())
+    (let1 ht (make-hash-table 'equal?)
+      (dolist [r results]
+        (dolist [e r]
+          (hash-table-update! ht (car e) (cut + (cdr e) <>) 0)))
+      (hash-table->alist ht))))
+
+;; Encoder of pprof profile format.  See profile.proto in
+;; https://github.com/google/pprof for the definition.
+;; We create one Function and one Location for each distinct frame name,
+;; and use the same id for both.
+(define *sampling-period-ns* 10000000)  ; see SAMPLING_PERIOD in prof.c
+
+;; STACKS is a list of (<frame-names> <value> ...), where the values
+;; correspond to SAMPLE-TYPES, a list of (<type> <unit>).
+(define (pprof-encode stacks sample-types period-type period)
+  (define strings (make-hash-table 'equal?)) ; string -> index
+  (define (intern! str)
+    (or (hash-table-get strings str #f)
+        (rlet1 i (hash-table-num-entries strings)
+          (hash-table-put! strings str i))))
+  (define functions (make-hash-table 'equal?)) ; name -> id
+  (define (function-id! name)
+    (or (hash-table-get functions name #f)
+        (rlet1 id (+ (hash-table-num-entries functions) 1)
+          (hash-table-put! functions name id))))
+  (define (value-type type unit)
+    (pb-message (^p (pb-uint 1 (intern! type) p)
+                    (pb-uint 2 (intern! unit) p))))
+
+  (intern! "")                          ;string_table[0] must be ""
+  (pb-message
+   (^p
+     (dolist [t sample-types]                             ;sample_type
+       (pb-bytes 1 (apply value-type t) p))
+     (dolist [e stacks]                                   ;sample
+       (pb-bytes 2
+                 (pb-message
+                  (^q (pb-packed 1 (reverse (map function-id! (car e))) q)
+                      (pb-packed 2 (cdr e) q)))
+                 p))
+     (dolist [e (sort (hash-table->alist functions) < cdr)]
+       (let ([name (car e)] [id (cdr e)])
+         (pb-bytes 4 (pb-message (^q (pb-uint 1 id q)    ;location
+                                     (pb-bytes 4 (pb-message
+                                                  (^r (pb-uint 1 id r)))
+                                               q)))
+                   p)
+         (pb-bytes 5 (pb-message (^q (pb-uint 1 id q)    ;function
+                                     (pb-uint 2 (intern! name) q)
+                                     (pb-uint 3 (intern! name) q)))
+                   p)))
+     (pb-bytes 11 (apply value-type period-type) p)      ;period_type
+     (pb-uint 12 period p)                                ;period
+     (dolist [e (sort (hash-table->alist strings) < cdr)] ;string_table
+       (pb-bytes 6 (string->u8vector (car e)) p)))))
+
+;; Protocol buffer primitives.
+(define (pb-varint n port)
+  (if (< n 128)
+    (write-u8 n port)
+    (begin (write-u8 (logior (logand n #x7f) #x80) port)
+           (pb-varint (ash n -7) port))))
+(define (pb-uint field n port)
+  (pb-varint (ash field 3) port)
+  (pb-varint n port))
+(define (pb-bytes field bytes port)
+  (pb-varint (logior (ash field 3) 2) port)
+  (pb-varint (u8vector-length bytes) port)
+  (write-uvector bytes port))
+(define (pb-packed field ns port)
+  (pb-bytes field (pb-message (^p (dolist [n ns] (pb-varint n p)))) port))
+(define (pb-message proc)
+  (let1 p (open-output-uvector)
+    (proc p)
+    (get-output-uvector p)))
+
 ;; Get a fixed-decimal notation of time/call (in us)
 ;; If the time is under 100ms:  ##.####
 ;; If the time is under 10^6ms: ###.### - ######.
@@ -178,6 +430,11 @@
         (receive (q r) (quotient&remainder val 10000)
           (format "~2d.~4,'0d" q r))))))
 
+;; Return a string to name a frame in the stack sample
+(define (frame-name obj)
+  (let1 n (entry-name obj)
+    (if (string? n) n (write-to-string n))))
+
 ;; Return a 'printable' notation of sampled code location
 (define (entry-name obj)
   (cond
@@ -55,10 +55,14 @@
   (use gauche.sequence)
   (use gauche.uvector)
   (use gauche.connection)
+  (use gauche.threads)
+  (use gauche.record)
   (use util.match)
   (use text.tree)
   (export <http-error>
           http-user-agent make-http-connection reset-http-connection
+          <http-connection-pool> make-http-connection-pool
+          http-connection-pool http-connection-pool-clear!
           http-compose-query http-compose-form-data
           http-status-code->description
 
@@ -69,6 +73,7 @@
           http-file-sender http-multipart-sender
 
           http-get http-head http-post http-put http-delete
+          http-pipeline
           http-default-auth-handler
           http-default-redirect-handler
 
@@ -231,11 +236,7 @@
                            ((:request-encoding enc) (gauche-character-encoding))
                       :allow-other-keys opts)
 
-  (define extra-headers
-    ($ concatenate $ reverse
-       $ rlet1 z '()
-       (do-plist [(k v) opts]
-         (when v (push! z (list k v))))))
+  (define extra-headers (options->headers opts))
 
   (define conn (ensure-connection server auth-handler auth-user auth-password
                                   proxy secure extra-headers))
@@ -245,20 +246,19 @@
                          [(#t) (http-default-redirect-handler)]
                          [(#f) #f]
                          [else => identity])))
-  (define no-body-replies '("204" "304"))
+  ;; set when the reply body is read up to its end, so that the
+  ;; connection can be reused.
+  (define body-drained #f)
 
   (define (get-body iport method code headers receiver)
-    (and (not (eq? method 'HEAD))
-         (not (member code no-body-replies))
-         (receive-body iport code headers receiver)))
+    (if (no-body-reply? method code)
+      (begin (set! body-drained #t) #f)
+      (receive-body iport code headers receiver
+                    (^[] (set! body-drained #t)))))
 
   ;; final touch of request headers
   (define (req-headers host)
-    (cond-list [(~ conn'persistent) @ (if (~ conn'proxy)
-                                        '(:proxy-connection keep-alive)
-                                        '(:connection keep-alive))]
-               [#t @ `(:host ,host :user-agent ,user-agent
-                       ,@(http-auth-headers conn) ,@extra-headers)]))
+    (request-headers conn host user-agent extra-headers))
 
   ;; If we decide to give up redirection, we read from already-retrieved
   ;; body of 3xx reply.  This modifies reply headers if necessary.
@@ -274,25 +274,33 @@
   ;;   (reply <code> <headers> <body>)
   ;;   (redirect-to <method> <location>)
   (define (request-response in out method uri host sender)
+    (set! body-drained #f)
     (send-request out method uri sender (req-headers host) enc)
-    (receive (code rep-headers) (receive-header in)
-      (if-let1 consider-redirect (and (string-prefix? "3" code) redirector)
-        ;; we retrieve body as string, not using caller-provided receiver
-        (let* ([body (get-body in method code rep-headers
-                               (http-string-receiver))]
-               [verdict (consider-redirect method code rep-headers body)])
-          ;; consider-redirect returns either #f (don't redirect) or
-          ;; (METHOD . LOCATION).
-          (if verdict
-            `(redirect-to ,(car verdict) ,(cdr verdict))
-            (let1 hdrs (redirect-headers body rep-headers) ;giving up
-              `(reply ,code ,hdrs
-                      ,(and body
-                            (receive-body (open-input-string body) code
-                                          hdrs receiver))))))
-        ;; no redirection
-        `(reply ,code ,rep-headers
-                ,(get-body in method code rep-headers receiver)))))
+    (receive (code rep-headers version) (receive-header in)
+      (set! (~ conn'replied) #t)
+      (rlet1 result (reply-or-redirect in method code rep-headers)
+        (set! (~ conn'reusable)
+              (and body-drained
+                   (reusable-response? version method code rep-headers))))))
+
+  (define (reply-or-redirect in method code rep-headers)
+    (if-let1 consider-redirect (and (string-prefix? "3" code) redirector)
+      ;; we retrieve body as string, not using caller-provided receiver
+      (let* ([body (get-body in method code rep-headers
+                             (http-string-receiver))]
+             [verdict (consider-redirect method code rep-headers body)])
+        ;; consider-redirect returns either #f (don't redirect) or
+        ;; (METHOD . LOCATION).
+        (if verdict
+          `(redirect-to ,(car verdict) ,(cdr verdict))
+          (let1 hdrs (redirect-headers body rep-headers) ;giving up
+            `(reply ,code ,hdrs
+                    ,(and body
+                          (receive-body (open-input-string body) code
+                                        hdrs receiver))))))
+      ;; no redirection
+      `(reply ,code ,rep-headers
+              ,(get-body in method code rep-headers receiver))))
 
   ;; main loop
   (let loop ([history '()]
@@ -304,7 +312,8 @@
       (let1 result
           (with-connection
            conn
-           (^[i o] (request-response i o method uri host sender)))
+           (^[i o] (request-response i o method uri host sender))
+           (memq method '(GET HEAD)))
         (match result
           [('reply code rep-headers body) (values code rep-headers body)]
           [('redirect-to method location)
@@ -480,6 +489,74 @@
                        [else (http-blob-sender body)])
          :receiver recvr opts))
 
+;;
+;; Pipelining
+;;
+
+;; Sends REQUESTS, each of which is (METHOD REQUEST-URI), over a single
+;; connection without waiting for each reply, then reads the replies
+;; in order.  Only idempotent GET and HEAD requests are allowed, so that
+;; we can safely resend the requests when the server closes the
+;; connection before replying to all of them.
+;; Returns a list of (<code> <headers> <body>), where <body> is a string,
+;; or #f for HEAD requests.  Redirections are not followed.
+(define (http-pipeline server requests
+                       :key (host #f)
+                            auth-handler
+                            auth-user
+                            auth-password
+                            (proxy (http-proxy))
+                            (user-agent (http-user-agent))
+                            (secure #f)
+                            ((:request-encoding enc) (gauche-character-encoding))
+                       :allow-other-keys opts)
+  (define conn (ensure-connection server auth-handler auth-user auth-password
+                                  proxy secure (options->headers opts)))
+
+  (define reqs
+    (map (^r (match r
+               [((and (or 'GET 'HEAD) method) request-uri)
+                (receive (host uri)
+                    (consider-proxy conn (or host (~ conn'server))
+                                    (ensure-request-uri request-uri enc))
+                  (list method uri host))]
+               [_ (error "http-pipeline only accepts (GET uri) or (HEAD uri), \
+                          but got:" r)]))
+         requests))
+
+  ;; Send all the requests, then receive as many replies as possible.
+  ;; We stop after a reply that doesn't allow the connection to be reused.
+  (define (send&receive in out reqs)
+    (dolist [r reqs]
+      (match-let1 (method uri host) r
+        (send-request out method uri #f
+                      (request-headers conn host user-agent (~ conn'extra-headers))
+                      enc)))
+    (let loop ([reqs reqs] [replies '()])
+      (if (null? reqs)
+        (reverse replies)
+        (let1 method (car (car reqs))
+          (receive (code headers version) (receive-header in)
+            (set! (~ conn'replied) #t)
+            (set! (~ conn'reusable) #f)
+            (let* ([drained (no-body-reply? method code)]
+                   [body (and (not drained)
+                              (receive-body in code headers
+                                            (http-string-receiver)
+                                            (^[] (set! drained #t))))]
+                   [replies (cons (list code headers body) replies)])
+              (if (and drained
+                       (reusable-response? version method code headers))
+                (begin (set! (~ conn'reusable) #t)
+                       (loop (cdr reqs) replies))
+                (reverse replies))))))))
+
+  (let loop ([reqs reqs] [results '()])
+    (if (null? reqs)
+      (concatenate (reverse results))
+      (let1 replies (with-connection conn (cut send&receive <> <> reqs) #t)
+        (loop (drop reqs (length replies)) (cons replies results))))))
+
 ;;==============================================================
 ;; HTTP connection context
 ;;
@@ -504,6 +581,12 @@
    (proxy         :init-keyword :proxy)
    (extra-headers :init-keyword :extra-headers)
    (secure        :init-keyword :secure) ; either #f, tls or stunnel
+   (pool          :init-keyword :pool    ; <http-connection-pool> or #f.
+                  :init-value #f)        ; If set, socket is only valid
+                                         ; during with-connection.
+   (replied       :init-value #f)        ; set when a reply header is read
+   (reusable      :init-value #f)        ; set when the reply allows us to
+                                         ; send next request on the socket.
    ))
 
 (define (make-http-connection server :key
@@ -512,9 +595,11 @@
                               (auth-user     #f)
                               (auth-password #f)
                               (proxy #f)
-                              (extra-headers '()))
+                              (extra-headers '())
+                              (pool #f))
   (make <http-connection>
     :persistent persistent
+    :pool pool
     :server server
     :auth-handler (or auth-handler (http-default-auth-handler))
     :auth-user auth-user
@@ -543,11 +628,13 @@
 ;; API
 (define (reset-http-connection conn)
   (when (~ conn'socket)
-    (guard (e [(<system-error> e) #f])
-      (connection-shutdown (~ conn'socket) 'both)
-      (connection-close (~ conn'socket)))
+    (close-socket (~ conn'socket))
     (set! (~ conn'socket) #f)))
 
+(define (close-socket sock)
+  (guard (e [(<system-error> e) #f])
+    (connection-shutdown sock 'both)
+    (connection-close sock)))
 
 ;; API
 (define (http-secure-connection-available? :optional (type #t))
@@ -562,6 +649,165 @@
      (error "Unknown secure connection type (must be tls, stunnel or #t):"
             type)]))
 
+;;==============================================================
+;; Connection pool
+;;
+
+;; One-shot requests (that is, the server argument is given as a string)
+;; take a socket from the pool bound to the http-connection-pool
+;; parameter, and return it after the request if the reply allows
+;; keep-alive.  Sockets are shared per (secure server proxy) combination.
+;; The pool can be shared among threads.
+;;
+;;  max-per-host - Max number of sockets (both idle and in use) for each
+;;             server.  A request that needs another socket waits until
+;;             one becomes available.
+;;  idle-timeout - Seconds an idle socket is kept.  #f to keep it forever.
+;;  wait-timeout - Seconds to wait for a socket when max-per-host sockets
+;;             are in use.  #f to wait indefinitely.  <http-error> is
+;;             thrown on timeout.
+;;  health-check - If given, it is called with an idle socket and the
+;;             seconds it has been idle before reusing it.  The socket is
+;;             discarded unless it returns true.
+
+(define-class <http-connection-pool> ()
+  ;; All slots are private.
+  ((max-per-host :init-keyword :max-per-host :init-value 8)
+   (idle-timeout :init-keyword :idle-timeout :init-value 30)
+   (wait-timeout :init-keyword :wait-timeout :init-value #f)
+   (health-check :init-keyword :health-check :init-value #f)
+   (mutex        :init-form (make-mutex))
+   (cv           :init-form (make-condition-variable))
+   (hosts        :init-form (make-hash-table 'equal?)) ; key -> pool-host
+   (last-sweep   :init-value 0)
+   ))
+
+;; COUNT is the number of sockets for the host, including those in use.
+;; IDLE is a list of (<socket> . <time-returned>), most recent first.
+(define-record-type pool-host make-pool-host #f
+  (count pool-host-count pool-host-count-set!)
+  (idle  pool-host-idle  pool-host-idle-set!))
+
+;; API
+(define (make-http-connection-pool :key (max-per-host 8)
+                                        (idle-timeout 30)
+                                        (wait-timeout #f)
+                                        (health-check #f))
+  (make <http-connection-pool>
+    :max-per-host max-per-host
+    :idle-timeout idle-timeout
+    :wait-timeout wait-timeout
+    :health-check health-check))
+
+;; API
+(define http-connection-pool (make-parameter (make-http-connection-pool)))
+
+;; API
+;; Closes all idle sockets.  Sockets currently in use are not affected.
+(define (http-connection-pool-clear! :optional (pool (http-connection-pool)))
+  (when pool
+    (for-each (^e (close-socket (car e)))
+              (with-locking-mutex (~ pool'mutex)
+                (^[] (rlet1 idles (append-map pool-host-idle
+                                              (hash-table-values (~ pool'hosts)))
+                       (hash-table-for-each
+                        (~ pool'hosts)
+                        (^[k h]
+                          (pool-host-count-set! h (- (pool-host-count h)
+                                                     (length (pool-host-idle h))))
+                          (pool-host-idle-set! h '())))
+                       (condition-variable-broadcast! (~ pool'cv))))))))
+
+(define (pool-key conn)
+  (list (~ conn'secure) (~ conn'server) (~ conn'proxy)))
+
+(define (pool-now) (time->seconds (current-time)))
+
+;; Returns a socket and a flag whether it is reused one.
+;; If FRESH is true, we don't reuse idle sockets; they're closed, for
+;; they're likely to be stale as well.
+(define (pool-checkout! pool conn key fresh)
+  (define mutex (~ pool'mutex))
+  (define deadline (and-let1 t (~ pool'wait-timeout) (+ (pool-now) t)))
+  (define (usable? sock idle-secs)
+    (and (or (not (~ pool'idle-timeout))
+             (< idle-secs (~ pool'idle-timeout)))
+         ;; An idle socket shouldn't have anything to read; if it has,
+         ;; the server has closed it (or sent garbage).
+         (not (and (is-a? sock <socket>)
+                   (char-ready? (connection-input-port sock))))
+         (or (not (~ pool'health-check))
+             (guard (e [else #f])
+               ((~ pool'health-check) sock idle-secs)))))
+  ;; Returns an idle entry (<socket> . <time>), or #f if the caller
+  ;; is allowed to open a new socket.  Must be called with the lock held.
+  (define (take! h)
+    (cond [(pair? (pool-host-idle h))
+           (rlet1 e (car (pool-host-idle h))
+             (pool-host-idle-set! h (cdr (pool-host-idle h))))]
+          [(< (pool-host-count h) (~ pool'max-per-host))
+           (pool-host-count-set! h (+ (pool-host-count h) 1))
+           #f]
+          [(mutex-unlock! mutex (~ pool'cv)
+                          (and deadline (max 0 (- deadline (pool-now)))))
+           (mutex-lock! mutex)
+           (take! h)]
+          [else
+           (errorf <http-error> "timed out waiting for a connection to ~a"
+                   (~ conn'server))]))
+  (define (checkout!)
+    (mutex-lock! mutex)
+    (let* ([h (or (hash-table-get (~ pool'hosts) key #f)
+                  (rlet1 h (make-pool-host 0 '())
+                    (hash-table-put! (~ pool'hosts) key h)))]
+           [stale (if fresh (pool-host-idle h) '())])
+      (pool-host-idle-set! h (if fresh '() (pool-host-idle h)))
+      (pool-host-count-set! h (- (pool-host-count h) (length stale)))
+      (set! fresh #f)
+      (for-each (^e (close-socket (car e))) stale)
+      (rlet1 e (take! h)
+        (mutex-unlock! mutex))))
+  (let loop ()
+    (if-let1 e (checkout!)
+      (if (usable? (car e) (- (pool-now) (cdr e)))
+        (values (car e) #t)
+        (begin (pool-discard! pool key (car e)) (loop)))
+      (guard (e [else (pool-release! pool key) (raise e)])
+        (start-connection conn)
+        (values (~ conn'socket) #f)))))
+
+(define (pool-checkin! pool key sock)
+  (define now (pool-now))
+  (define timeout (~ pool'idle-timeout))
+  ;; Removes expired idle sockets of all hosts and returns them.
+  (define (sweep!)
+    (set! (~ pool'last-sweep) now)
+    (append-map! (^h (let* ([live? (^e (< (- now (cdr e)) timeout))]
+                            [expired (remove live? (pool-host-idle h))])
+                       (pool-host-idle-set! h (filter live? (pool-host-idle h)))
+                       (pool-host-count-set! h (- (pool-host-count h)
+                                                  (length expired)))
+                       expired))
+                 (hash-table-values (~ pool'hosts))))
+  ($ for-each (^e (close-socket (car e)))
+     $ with-locking-mutex (~ pool'mutex)
+     (^[] (let1 h (hash-table-get (~ pool'hosts) key)
+            (pool-host-idle-set! h (acons sock now (pool-host-idle h)))
+            (condition-variable-broadcast! (~ pool'cv))
+            (if (and timeout (> (- now (~ pool'last-sweep)) timeout))
+              (sweep!)
+              '())))))
+
+(define (pool-discard! pool key sock)
+  (close-socket sock)
+  (pool-release! pool key))
+
+(define (pool-release! pool key)
+  (with-locking-mutex (~ pool'mutex)
+    (^[] (let1 h (hash-table-get (~ pool'hosts) key)
+           (pool-host-count-set! h (- (pool-host-count h) 1))
+           (condition-variable-broadcast! (~ pool'cv))))))
+
 ;;==============================================================
 ;; query and request body composition
 ;;
@@ -701,7 +947,8 @@
                            proxy secure extra-headers)
   (rlet1 conn (cond
                [(is-a? server <http-connection>) server]
-               [(string? server) (make-http-connection server :persistent #f)]
+               [(string? server) (make-http-connection server :persistent #f
+                                                       :pool (http-connection-pool))]
                [else (error "bad type of argument for server: must be an <http-connection> object or a string of the server's name, but got:" server)])
     ;; TODO: Might need to reset connections if parameters are changed
     (let-syntax ([check-override
@@ -752,14 +999,48 @@
             [rhost:port (if (string-index rhost #\:) rhost #"~|rhost|:https")])
        (set! (~ conn'socket) (make-stunnel-connection rhost:port)))]))
 
-(define (with-connection conn proc)
-  (unwind-protect
-      (begin
-        (unless (~ conn'socket) (start-connection conn))
-        (proc (connection-input-port (~ conn'socket))
-              (connection-output-port (~ conn'socket))))
-    (unless (~ conn'persistent)
-      (reset-http-connection conn))))
+(define (options->headers opts)
+  ($ concatenate $ reverse
+     $ rlet1 z '()
+     (do-plist [(k v) opts]
+       (when v (push! z (list k v))))))
+
+;; If RETRY? is true, the request is idempotent and we can resend it
+;; once when a connection taken from the pool turns out to be stale.
+(define (with-connection conn proc :optional (retry? #f))
+  (set! (~ conn'replied) #f)
+  (set! (~ conn'reusable) #f)
+  (if-let1 pool (~ conn'pool)
+    (with-pooled-connection conn pool proc retry?)
+    (unwind-protect
+        (begin
+          (unless (~ conn'socket) (start-connection conn))
+          (proc (connection-input-port (~ conn'socket))
+                (connection-output-port (~ conn'socket))))
+      (unless (and (~ conn'persistent) (~ conn'reusable))
+        (reset-http-connection conn)))))
+
+(define (with-pooled-connection conn pool proc retry?)
+  (define key (pool-key conn))
+  (define stale (list 'stale))
+  (let loop ([fresh #f])
+    (receive (sock reused) (pool-checkout! pool conn key fresh)
+      (let1 r (guard (e [(and retry? reused (not (~ conn'replied))) stale])
+                (unwind-protect
+                    (begin
+                      (set! (~ conn'socket) sock)
+                      (proc (connection-input-port sock)
+                            (connection-output-port sock)))
+                  (begin
+                    (set! (~ conn'socket) #f)
+                    (if (~ conn'reusable)
+                      (pool-checkin! pool key sock)
+                      (pool-discard! pool key sock)))))
+        (if (eq? r stale)
+          (begin (set! (~ conn'replied) #f)
+                 (set! (~ conn'reusable) #f)
+                 (loop #t))
+          r)))))
 
 ;; canonicalize uri for the sake of redirection.
 ;; URI is a request-uri given to the API, or the redirect location specified
@@ -787,6 +1068,14 @@
     (values host uri)))
 
 ;; send
+;; final touch of request headers
+(define (request-headers conn host user-agent extra-headers)
+  (cond-list [(~ conn'persistent) @ (if (~ conn'proxy)
+                                      '(:proxy-connection keep-alive)
+                                      '(:connection keep-alive))]
+             [#t @ `(:host ,host :user-agent ,user-agent
+                     ,@(http-auth-headers conn) ,@extra-headers)]))
+
 (define (send-request out method uri sender headers enc)
   (define request-line #"~method ~uri HTTP/1.1\r\n")
   (define request-headers
@@ -821,9 +1110,19 @@
   (flush out))
 
 ;; receive
+;; Returns status code, headers, and the protocol version ("HTTP/1.1" etc.)
+;; Interim 1xx replies (100 Continue, 103 Early Hints etc.) are skipped,
+;; except 101 Switching Protocols, after which the server speaks another
+;; protocol.
 (define (receive-header remote)
-  (receive (code reason) (parse-status-line (read-line remote))
-    (values code (rfc822-header->list remote))))
+  (let loop ()
+    (let1 line (read-line remote)
+      (receive (code reason) (parse-status-line line)
+        (let1 headers (rfc822-header->list remote)
+          (if (and (string-prefix? "1" code) (not (equal? code "101")))
+            (loop)
+            (values code headers
+                    (rxmatch->string #/^HTTP\/\d+\.\d+/ line))))))))
 
 (define (parse-status-line line)
   (cond [(eof-object? line)
@@ -831,9 +1130,35 @@
         [(#/\w+\s+(\d\d\d)\s+(.*)/ line) => (^m (values (m 1) (m 2)))]
         [else (error <http-error> "bad reply from server" line)]))
 
-(define (receive-body remote code headers receiver)
-  (let1 total (and-let* ([p (assoc "content-length" headers)])
-                (x->integer (cadr p)))
+(define (no-body-reply? method code)
+  (or (eq? method 'HEAD)
+      (member code '("204" "304"))
+      (string-prefix? "1" code)))
+
+;; Whether we can send another request over the connection after
+;; receiving this reply.
+(define (reusable-response? version method code headers)
+  (and (equal? version "HTTP/1.1")
+       (not (string-prefix? "1" code))    ;101 switches the protocol
+       (not (any (^h (and (equal? (car h) "connection")
+                          (#/(?i)(?:^|,)\s*close\s*(?:,|$)/ (cadr h))))
+                 headers))
+       (or (no-body-reply? method code)
+           (assoc "content-length" headers)
+           (equal? (rfc822-header-ref headers "transfer-encoding") "chunked"))))
+
+;; If ON-DRAIN is given, it is called when the receiver reads the body
+;; up to its end.
+(define (receive-body remote code headers receiver :optional (on-drain #f))
+  (let ([total (and-let* ([p (assoc "content-length" headers)])
+                 (x->integer (cadr p)))]
+        [receiver (if on-drain
+                    (^[code hdrs total retr]
+                      (receiver code hdrs total
+                                (^[] (receive (remote size) (retr)
+                                       (when (eqv? size 0) (on-drain))
+                                       (values remote size)))))
+                    receiver)])
     (if-let1 enc (assoc "transfer-encoding" headers)
       (if (equal? (cadr enc) "chunked")
         (receive-body-chunked remote code headers total receiver)
@@ -34,7 +34,6 @@
 (define-module gauche.generator
   (use srfi-1)
   (use gauche.sequence)
-  (use gauche.partcont)
   (export list->generator vector->generator reverse-vector->generator
           string->generator uvector->generator
           bits->generator reverse-bits->generator
@@ -61,6 +60,9 @@
           gtake gtake* gdrop gtake-while gdrop-while grxmatch gslices
           glet* glet1 do-generator
 
+          gchunks gunchunk vector->chunk-generator uvector->chunk-generator
+          port->line-chunk-generator gchunk-map gchunk-filter gchunk-fold
+
           ;; srfi-121 compatibility
           generator make-iota-generator make-range-generator
           make-coroutine-generator bytevector->generator
@@ -85,7 +87,7 @@
 
 ;; Avoid circular dependency during build
 (autoload gauche.uvector uvector-ref uvector-set! uvector-length
-          make-uvector u8vector?
+          uvector-copy make-uvector u8vector?
           <u8vector> <s8vector> <u16vector> <s16vector>
           <u32vector> <s32vector> <u64vector> <s64vector>
           <f16vector> <f32vector> <f64vector>)
@@ -581,12 +583,22 @@
                             [else (g)]))]))))
 
 ;; generate :: ((a -> ()) -> ()) -> Generator a
+;; Each yield captures the rest of PROC as a one-shot partial continuation,
+;; which is resumed within a new reset by the next call of the generator.
+;; We use the primitives directly instead of shift/reset macros to avoid
+;; the wrapper closures gauche.partcont creates on every capture.
+(define %reset (with-module gauche.internal %reset))
+(define %call/1pc (with-module gauche.internal %call/1pc))
+
 (define (generate proc)
-  (define (cont)
-    (reset (proc (^[value] (shift k (set! cont k) value)))
-           (set! cont null-generator)
-           (eof-object)))
-  (^[] (cont)))
+  (define k #f)                         ;continuation of the last yield
+  (define done #f)
+  (define (yield value) (%call/1pc (^c (set! k c) value)))
+  (define (start) (proc yield) (set! done #t) (eof-object))
+  (define (resume) (k))
+  (^[] (cond [done (eof-object)]
+             [k (%reset resume)]
+             [else (%reset start)])))
 
 ;; grxmatch :: (Regexp, Generator Char) -> Generator RegMatch
 ;;          |  (Regexp, String) -> Generator RegMatch
@@ -774,6 +786,123 @@
 (define (generator-unfold gen unfold . args)
   (apply unfold eof-object? identity (^_ (gen)) (gen) args))
 
+;;;
+;;; Chunk generators
+;;;
+
+;; A chunk generator yields vectors or uvectors of elements ("chunks")
+;; instead of each element, and EOF at the end.  The chunk operators run
+;; a loop over each chunk, so the cost of calling a generator and checking
+;; EOF at every stage of the pipeline is paid once per chunk.  Any
+;; generator can feed chunk operators via gchunks, and a chunk generator
+;; can be fed to the ordinary operators and consumers via gunchunk.
+;; Operators don't generate empty chunks.  Chunks may be shared between
+;; stages, so they shouldn't be modified.
+
+(define-constant *chunk-size* 256)
+
+(define (%chunk-length c) (if (vector? c) (vector-length c) (uvector-length c)))
+(define (%chunk-accessor c) (if (vector? c) vector-ref uvector-ref))
+;; With size 0, we'd yield empty chunks forever and never reach EOF.
+(define (%check-chunk-size size)
+  (unless (and (exact-integer? size) (positive? size))
+    (error "chunk size must be a positive exact integer, but got:" size)))
+
+;; gchunks :: (Generator a, Int) -> ChunkGenerator a
+(define (gchunks gen :optional (size *chunk-size*))
+  (%check-chunk-size size)
+  (let1 gen (%->gen gen)
+    (^[] (let1 buf (make-vector size)
+           (let loop ([i 0])
+             (if (= i size)
+               buf
+               (let1 v (gen)
+                 (cond [(not (eof-object? v))
+                        (vector-set! buf i v) (loop (+ i 1))]
+                       [(zero? i) v]
+                       [else (vector-copy buf 0 i)]))))))))
+
+;; gunchunk :: ChunkGenerator a -> Generator a
+(define (gunchunk cgen)
+  (let ([c '#()] [ref vector-ref] [i 0] [n 0])
+    (rec (g)
+      (if (< i n)
+        (%begin0 (ref c i) (inc! i))
+        (glet1 c1 (cgen)
+          (set! c c1)
+          (set! ref (%chunk-accessor c1))
+          (set! i 0)
+          (set! n (%chunk-length c1))
+          (g))))))
+
+(define (vector->chunk-generator vec :optional (size *chunk-size*)
+                                              (start #f) (end #f))
+  (%check-chunk-size size)
+  (let ([i (or start 0)] [len (or end (vector-length vec))])
+    (^[] (if (>= i len)
+           (eof-object)
+           (let1 e (min len (+ i size))
+             (%begin0 (vector-copy vec i e) (set! i e)))))))
+
+(define (uvector->chunk-generator uvec :optional (size *chunk-size*)
+                                                (start #f) (end #f))
+  (%check-chunk-size size)
+  (let ([i (or start 0)] [len (or end (uvector-length uvec))])
+    (^[] (if (>= i len)
+           (eof-object)
+           (let1 e (min len (+ i size))
+             (%begin0 (uvector-copy uvec i e) (set! i e)))))))
+
+(define (port->line-chunk-generator port :optional (size *chunk-size*))
+  (gchunks (cut read-line port) size))
+
+;; gchunk-map :: (a -> b, ChunkGenerator a) -> ChunkGenerator b
+(define (gchunk-map fn cgen)
+  (^[] (glet1 c (cgen)
+         (if (vector? c)
+           (vector-map fn c)
+           (let* ([n (uvector-length c)]
+                  [r (make-vector n)])
+             (dotimes [i n] (vector-set! r i (fn (uvector-ref c i))))
+             r)))))
+
+;; gchunk-filter :: (a -> Bool, ChunkGenerator a) -> ChunkGenerator a
+;; The result chunk has the same type as the input chunk.
+(define (gchunk-filter pred cgen)
+  (define (filter-chunk c)
+    (let ([ref (%chunk-accessor c)]
+          [n (%chunk-length c)])
+      (let loop ([i 0] [r '()] [k 0])
+        (cond [(< i n)
+               (let1 v (ref c i)
+                 (if (pred v)
+                   (loop (+ i 1) (cons v r) (+ k 1))
+                   (loop (+ i 1) r k)))]
+              [(= k n) c]
+              [(vector? c) (reverse-list->vector r)]
+              [else (rlet1 u (make-uvector (class-of c) k)
+                      (do ([j (- k 1) (- j 1)]
+                           [r r (cdr r)])
+                          [(null? r)]
+                        (uvector-set! u j (car r))))]))))
+  (rec (g)
+    (glet1 c (cgen)
+      (let1 r (filter-chunk c)
+        (if (zero? (%chunk-length r)) (g) r)))))
+
+;; gchunk-fold :: ((a, b) -> b, b, ChunkGenerator a) -> b
+(define (gchunk-fold fn knil cgen)
+  (let loop ([acc knil])
+    (let1 c (cgen)
+      (if (eof-object? c)
+        acc
+        (let ([ref (%chunk-accessor c)]
+              [n (%chunk-length c)])
+          (let inner ([i 0] [acc acc])
+            (if (< i n)
+              (inner (+ i 1) (fn (ref c i) acc))
+              (loop acc))))))))
+
 ;; srfi-121 compatibility aliases
 ;; NB: We're not sure if we should put them here, or split them to
 ;; srfi-121 module.
@@ -129,7 +129,10 @@
           debug-print-pre debug-print-post debug-funcall-pre)
 
 (autoload gauche.vm.profiler
-          profiler-show profiler-show-load-stats with-profiler)
+          profiler-show profiler-show-load-stats with-profiler
+          profiler-get-stacks profiler-write-flamegraph profiler-write-pprof
+          profiler-get-allocations profiler-show-allocations
+          with-allocation-profiler)
 
 (autoload srfi-7  (:macro program))
 (autoload srfi-55 (:macro require-extension))
@@ -170,13 +173,14 @@
 
 (autoload gauche.hashutil string-ci-hash)
 
-(autoload gauche.treeutil make-tree-map tree-map-empty?
+(autoload gauche.treeutil make-tree-map make-btree-map tree-map-empty?
                           tree-map-min tree-map-max
                           tree-map-pop-min! tree-map-pop-max!
                           tree-map-seek tree-map-fold tree-map-fold-right
                           tree-map-map tree-map-for-each
                           tree-map-keys tree-map-values
                           tree-map->alist alist->tree-map
+                          sorted-alist->btree-map
                           tree-map-compare-as-sets
                           tree-map-compare-as-sequences)
 
@@ -540,9 +540,27 @@
          (unless (vm-compiler-flag-is-set? SCM_COMPILE_LEGACY_DEFINE)
            (%insert-binding module (unwrap-syntax name) 
                             (%uninitialized) '(fresh)))
-         ($define oform flags id (pass1 expr cenv))))]
+         (let1 iform (pass1 expr cenv)
+           (if (pass1/auto-inlinable? name flags iform module cenv)
+             (begin
+               (pass1/mark-closure-inlinable! iform name cenv)
+               ($define oform '(inlinable) id iform))
+             ($define oform flags id iform)))))]
     [_ (error "syntax-error:" oform)]))
 
+;; In the auto-inline mode, a small exported procedure is defined as if
+;; with define-inline, so that the code using the module can inline it.
+;; The binding is marked inlinable, so altering or redefining it later
+;; is warned, as for define-inline.
+(define (pass1/auto-inlinable? name flags iform module cenv)
+  (and (vm-compiler-flag-is-set? SCM_COMPILE_AUTO_INLINE)
+       (not (vm-compiler-flag-is-set? SCM_COMPILE_NOINLINE_GLOBALS))
+       (null? flags)
+       (symbol? name)
+       (eq? module (cenv-module cenv))   ;not define-in-module
+       (memq name (module-exports module))
+       (iform-auto-inlinable? iform name module)))
+
 (define (%rename-toplevel-identifier! identifier)
   (slot-set! identifier 'name (gensym #"~(identifier->symbol identifier)."))
   identifier)
@@ -313,3 +313,101 @@
                     )))))]
       [_ (undefined)])))
 
+
+;;--------------------------------------------------------
+;; Inlining higher-order procedures
+;;
+
+;; When a lambda node is directly passed to map, for-each or fold with
+;; a single list, we expand the call into a loop.  The lambda is then
+;; referenced only in operator position, so Pass 2 sees it doesn't
+;; escape and inlines it into the loop body; no closure is created, nor
+;; the environment frames it would close are moved to the heap.
+;;
+;; The expansion is
+;;
+;;   (let ([p PROC] [lis LIS] [seed SEED] ...)
+;;     (let loop ([xs lis] [acc seed] ...)
+;;       (cond [(pair? xs) PAIR-CASE]
+;;             [(null? xs) NULL-CASE]
+;;             [else (error MSG lis)])))
+;;
+;; PAIR-CASE is made by (pair-case p loop xs accs) and NULL-CASE by
+;; (null-case accs), where p, loop, xs and accs are lvars.  If TAIL? is
+;; true, the error reports xs instead of lis, as fold does.
+
+(define error. (global-id 'error))
+
+(define (lambda-node-with-arity? iform nargs)
+  (and (has-tag? iform $LAMBDA)
+       (= ($lambda-reqargs iform) nargs)
+       (zero? ($lambda-optarg iform))))
+
+(define (expand-list-loop src name proc lis seeds msg tail?
+                          pair-case null-case)
+  (let* ([p (make-lvar 'proc)]
+         [lis0 (make-lvar 'lis)]
+         [ss (imap (^_ (make-lvar 'seed)) seeds)]
+         [loop (make-lvar name)]
+         [xs (make-lvar 'xs)]
+         [accs (imap (^_ (make-lvar 'acc)) seeds)]
+         [lmda ($lambda src name (+ (length accs) 1) 0 (cons xs accs)
+                        ($if src ($asm src `(,PAIRP) (list ($lref xs)))
+                             (pair-case p loop xs accs)
+                             ($if src ($asm src `(,NULLP) (list ($lref xs)))
+                                  (null-case accs)
+                                  ($call src ($gref error.)
+                                         (list ($const msg)
+                                               ($lref (if tail? xs lis0)))))))])
+    (lvar-initval-set! loop lmda)
+    ($let src 'let (list* p lis0 ss) (list* proc lis seeds)
+          ($let src 'rec (list loop) (list lmda)
+                ($call src ($lref loop)
+                       (cons ($lref lis0) (imap (^[s] ($lref s)) ss)))))))
+
+(define (car-of xs) ($asm #f `(,CAR) (list ($lref xs))))
+(define (cdr-of xs) ($asm #f `(,CDR) (list ($lref xs))))
+
+(define-builtin-inliner for-each
+  (^[src args]
+    (match args
+      [((? (cut lambda-node-with-arity? <> 1) proc) lis)
+       (expand-list-loop src 'for-each proc lis '() "improper list not allowed:" #f
+                         (^[p loop xs _]
+                           ($seq (list ($call src ($lref p) (list (car-of xs)))
+                                       ($call src ($lref loop)
+                                              (list (cdr-of xs))))))
+                         (^_ ($const-undef)))]
+      [_ (undefined)])))
+
+(define-builtin-inliner map
+  (^[src args]
+    (match args
+      [((? (cut lambda-node-with-arity? <> 1) proc) lis)
+       (expand-list-loop src 'map proc lis (list ($const-nil))
+                         "improper list not allowed:" #f
+                         (^[p loop xs accs]
+                           ($call src ($lref loop)
+                                  (list (cdr-of xs)
+                                        ($asm #f `(,CONS)
+                                              (list ($call src ($lref p)
+                                                           (list (car-of xs)))
+                                                    ($lref (car accs)))))))
+                         (^[accs] ($asm src `(,REVERSE)
+                                        (list ($lref (car accs))))))]
+      [_ (undefined)])))
+
+(define-builtin-inliner fold
+  (^[src args]
+    (match args
+      [((? (cut lambda-node-with-arity? <> 2) proc) knil lis)
+       (expand-list-loop src 'fold proc lis (list knil)
+                         "argument must be a list, but got:" #t
+                         (^[p loop xs accs]
+                           ($call src ($lref loop)
+                                  (list (cdr-of xs)
+                                        ($call src ($lref p)
+                                               (list (car-of xs)
+                                                     ($lref (car accs)))))))
+                         (^[accs] ($lref (car accs))))]
+      [_ (undefined)])))
@@ -1007,6 +1007,37 @@
           [else (rec-list (cdr iform-list) (rec (car iform-list) cnt))]))
   (rec iform 0))
 
+;; Returns #t if IFORM, the value of a toplevel definition of NAME in
+;; MODULE, is a $LAMBDA node small and simple enough to be made inlinable
+;; without define-inline (SCM_COMPILE_AUTO_INLINE).  We don't take
+;; closures, loops and assignments, nor a reference to NAME itself,
+;; which would make the inliner recurse.
+(define (iform-auto-inlinable? iform name module)
+  (define (self? id)
+    (and (eq? (identifier->symbol id) name)
+         (eq? (identifier-module id) module)))
+  (define (rec iform)
+    (case/unquote
+     (iform-tag iform)
+     [($LREF $CONST $IT) #t]
+     [($GREF)   (not (self? ($gref-id iform)))]
+     [($IF)     (and (rec ($if-test iform))
+                     (rec ($if-then iform))
+                     (rec ($if-else iform)))]
+     [($LET)    (and (every rec ($let-inits iform)) (rec ($let-body iform)))]
+     [($RECEIVE)(and (rec ($receive-expr iform)) (rec ($receive-body iform)))]
+     [($SEQ)    (every rec ($seq-body iform))]
+     [($CALL)   (and (rec ($call-proc iform)) (every rec ($call-args iform)))]
+     [($ASM)    (every rec ($asm-args iform))]
+     [($CONS $APPEND $MEMV $EQ? $EQV?)
+      (and (rec ($*-arg0 iform)) (rec ($*-arg1 iform)))]
+     [($VECTOR $LIST $LIST*) (every rec ($*-args iform))]
+     [($LIST->VECTOR) (rec ($*-arg0 iform))]
+     [else #f]))
+  (and (has-tag? iform $LAMBDA)
+       (< (iform-count-size-upto iform SMALL_LAMBDA_SIZE) SMALL_LAMBDA_SIZE)
+       (rec ($lambda-body iform))))
+
 ;; Copy iform.
 ;;  Lvars that are bound within iform should be copied.  Other lvars
 ;;  (free in iform, bound outside iform) should be shared and their
@@ -1943,6 +1974,7 @@
  (define-enum SCM_COMPILE_NODISSOLVE_APPLY)
  (define-enum SCM_COMPILE_LEGACY_DEFINE)
  (define-enum SCM_COMPILE_MUTABLE_LITERALS)
+ (define-enum SCM_COMPILE_AUTO_INLINE)
 
  ;; Set/get VM's current module info. (temporary)
  (define-cproc vm-current-module () (return (SCM_OBJ (-> (Scm_VM) module))))
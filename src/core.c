@@ -34,6 +34,7 @@
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gauche/prof.h"
 
 /* GC_print_static_roots() is declared in private/gc_priv.h.  It is too much
    hassle to include it with other GC internal baggages, so we just declare
@@ -118,6 +119,7 @@ extern void Scm_Init_libomega(void);
 
 static void finalizable(void);
 static void init_cond_features(void);
+static void GC_CALLBACK gc_event(GC_EventType event);
 
 #ifdef GAUCHE_USE_PTHREADS
 /* a trick to make sure the gc thread object is linked */
@@ -152,6 +154,7 @@ void Scm_Init(const char *signature)
     GC_oom_fn = oom_handler;
     GC_finalize_on_demand = TRUE;
     GC_finalizer_notifier = finalizable;
+    GC_set_on_collection_event(gc_event);
 
     (void)SCM_INTERNAL_MUTEX_INIT(cond_features.mutex);
 
@@ -245,6 +248,267 @@ void Scm_PrintStaticRoots()
     GC_print_static_roots();
 }
 
+/*=============================================================
+ * GC statistics
+ */
+
+/* We record each stop-the-world pause and each full collection with
+ * GC's collection event callback.  The callback is called with the
+ * GC lock held, possibly with the world stopped, so it must not allocate;
+ * it only updates gc_stats.  The readers copy it while holding the GC lock.
+ *
+ * In incremental mode, a collection consists of several short pauses
+ * (and some of them don't belong to a full collection), so we keep
+ * the pauses and the collections separately.
+ */
+
+#define GC_PAUSE_HISTOGRAM_SIZE  32 /* i-th bucket counts pauses shorter
+                                       than 2^i usec.  The last bucket
+                                       also counts longer ones. */
+#define GC_RECENT_COLLECTIONS    64 /* # of collections to keep details */
+
+typedef struct gc_collection_rec {
+    u_long gcNo;
+    uint64_t start;             /* monotonic time in nsec */
+    uint64_t duration;          /* nsec */
+    uint64_t pause;             /* nsec, world-stopped time in duration */
+    size_t heapBefore;
+    size_t heapAfter;
+    size_t reclaimed;           /* as GC's approximation */
+} gc_collection;
+
+typedef struct gc_stats_rec {
+    /* The collection in progress */
+    int inCollection;
+    uint64_t collectionStart;
+    uint64_t collectionPause;
+    uint64_t pauseStart;
+    size_t heapBefore;
+    /* Accumulated data */
+    u_long numCollections;
+    u_long numPauses;
+    uint64_t totalPause;
+    uint64_t maxPause;
+    uint64_t totalCollectionTime;
+    uint64_t totalReclaimed;
+    u_long histogram[GC_PAUSE_HISTOGRAM_SIZE];
+    gc_collection recent[GC_RECENT_COLLECTIONS]; /* indexed by
+                                                    numCollections */
+} gc_stats;
+
+static gc_stats gcstats;
+
+static uint64_t gc_now(void)
+{
+    u_long sec, nsec;
+    Scm_ClockGetTimeMonotonic(&sec, &nsec);
+    return (uint64_t)sec * 1000000000 + nsec;
+}
+
+/* We're in the GC lock, so we can't call GC_get_prof_stats. */
+static void gc_heap_stats(struct GC_prof_stats_s *st)
+{
+#if defined(GC_THREADS)
+    GC_get_prof_stats_unsafe(st, sizeof(*st));
+#else  /*!GC_THREADS*/
+    GC_get_prof_stats(st, sizeof(*st));
+#endif /*!GC_THREADS*/
+}
+
+static void GC_CALLBACK gc_event(GC_EventType event)
+{
+    struct GC_prof_stats_s st;
+
+    switch (event) {
+    case GC_EVENT_START:
+        gc_heap_stats(&st);
+        gcstats.inCollection = TRUE;
+        gcstats.collectionStart = gc_now();
+        gcstats.collectionPause = 0;
+        gcstats.heapBefore = st.heapsize_full - st.unmapped_bytes;
+        break;
+    case GC_EVENT_PRE_STOP_WORLD:
+        gcstats.pauseStart = gc_now();
+        break;
+    case GC_EVENT_POST_START_WORLD: {
+        uint64_t pause = gc_now() - gcstats.pauseStart;
+        uint64_t usec = pause / 1000;
+        int i = 0;
+        while (i < GC_PAUSE_HISTOGRAM_SIZE-1 && ((uint64_t)1 << i) <= usec) {
+            i++;
+        }
+        gcstats.histogram[i]++;
+        gcstats.numPauses++;
+        gcstats.totalPause += pause;
+        if (pause > gcstats.maxPause) gcstats.maxPause = pause;
+        if (gcstats.inCollection) gcstats.collectionPause += pause;
+        break;
+    }
+    case GC_EVENT_END: {
+        if (!gcstats.inCollection) break;
+        gc_heap_stats(&st);
+        gc_collection *c =
+            &gcstats.recent[gcstats.numCollections % GC_RECENT_COLLECTIONS];
+        c->gcNo = (u_long)st.gc_no;
+        c->start = gcstats.collectionStart;
+        c->duration = gc_now() - gcstats.collectionStart;
+        c->pause = gcstats.collectionPause;
+        c->heapBefore = gcstats.heapBefore;
+        c->heapAfter = st.heapsize_full - st.unmapped_bytes;
+        c->reclaimed = st.bytes_reclaimed_since_gc;
+        gcstats.numCollections++;
+        gcstats.totalCollectionTime += c->duration;
+        gcstats.totalReclaimed += c->reclaimed;
+        gcstats.inCollection = FALSE;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* Called via GC_call_with_alloc_lock */
+static void *gc_stats_copy(void *data)
+{
+    memcpy(data, &gcstats, sizeof(gc_stats));
+    return NULL;
+}
+
+static void *gc_stats_copy_and_reset(void *data)
+{
+    memcpy(data, &gcstats, sizeof(gc_stats));
+    gcstats.numCollections = 0;
+    gcstats.numPauses = 0;
+    gcstats.totalPause = 0;
+    gcstats.maxPause = 0;
+    gcstats.totalCollectionTime = 0;
+    gcstats.totalReclaimed = 0;
+    memset(gcstats.histogram, 0, sizeof(gcstats.histogram));
+    return NULL;
+}
+
+#define NSEC_TO_SEC(ns)  Scm_MakeFlonum((double)(ns)/1.0e9)
+
+/* Returns a list of lists, each of which consists of a keyword and
+   a value, as gc-stat.  If RESET is true, accumulated data is cleared. */
+ScmObj Scm_GCPauseStats(int reset)
+{
+    gc_stats st;
+    GC_call_with_alloc_lock(reset? gc_stats_copy_and_reset : gc_stats_copy,
+                            &st);
+
+    ScmObj hist = SCM_NIL;
+    int top = GC_PAUSE_HISTOGRAM_SIZE;
+    while (top > 0 && st.histogram[top-1] == 0) top--;
+    for (int i=top-1; i>=0; i--) {
+        hist = Scm_Cons(Scm_Cons(Scm_MakeIntegerU64((uint64_t)1 << i),
+                                 Scm_MakeIntegerU(st.histogram[i])),
+                        hist);
+    }
+
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+#define ENTRY(key, val) \
+    SCM_APPEND1(h, t, SCM_LIST2(SCM_MAKE_KEYWORD(key), val))
+    ENTRY("collections", Scm_MakeIntegerU(st.numCollections));
+    ENTRY("pauses", Scm_MakeIntegerU(st.numPauses));
+    ENTRY("total-pause-time", NSEC_TO_SEC(st.totalPause));
+    ENTRY("max-pause-time", NSEC_TO_SEC(st.maxPause));
+    ENTRY("total-collection-time", NSEC_TO_SEC(st.totalCollectionTime));
+    ENTRY("total-reclaimed-bytes", Scm_MakeIntegerU64(st.totalReclaimed));
+    ENTRY("pause-histogram", hist);
+#undef ENTRY
+    return h;
+}
+
+/* Returns a list of the recent collections, newest first.  Each
+   collection is a property list. */
+ScmObj Scm_GCRecentCollections(void)
+{
+    gc_stats st;
+    GC_call_with_alloc_lock(gc_stats_copy, &st);
+
+    u_long n = st.numCollections;
+    u_long count = (n < GC_RECENT_COLLECTIONS)? n : GC_RECENT_COLLECTIONS;
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    for (u_long i=0; i<count; i++) {
+        gc_collection *c = &st.recent[(n-1-i) % GC_RECENT_COLLECTIONS];
+        ScmObj e = SCM_NIL;
+        e = Scm_Cons(SCM_MAKE_KEYWORD("reclaimed"),
+                     Scm_Cons(Scm_MakeIntegerU(c->reclaimed), e));
+        e = Scm_Cons(SCM_MAKE_KEYWORD("heap-after"),
+                     Scm_Cons(Scm_MakeIntegerU(c->heapAfter), e));
+        e = Scm_Cons(SCM_MAKE_KEYWORD("heap-before"),
+                     Scm_Cons(Scm_MakeIntegerU(c->heapBefore), e));
+        e = Scm_Cons(SCM_MAKE_KEYWORD("pause-time"),
+                     Scm_Cons(NSEC_TO_SEC(c->pause), e));
+        e = Scm_Cons(SCM_MAKE_KEYWORD("collection-time"),
+                     Scm_Cons(NSEC_TO_SEC(c->duration), e));
+        e = Scm_Cons(SCM_MAKE_KEYWORD("start-time"),
+                     Scm_Cons(NSEC_TO_SEC(c->start), e));
+        e = Scm_Cons(SCM_MAKE_KEYWORD("gc-no"),
+                     Scm_Cons(Scm_MakeIntegerU(c->gcNo), e));
+        SCM_APPEND1(h, t, e);
+    }
+    return h;
+}
+
+/*
+ * GC tuning.  These can be called any time, but the number of
+ * marker threads can only be set before GC is initialized (see main.c).
+ */
+void Scm_GCSetFreeSpaceDivisor(u_long divisor)
+{
+    if (divisor == 0) Scm_Error("free space divisor must be positive");
+    GC_set_free_space_divisor((GC_word)divisor);
+}
+
+void Scm_GCEnableIncremental(void)
+{
+    GC_enable_incremental();
+}
+
+/* Make the heap at least SIZE bytes. */
+void Scm_GCExpandHeap(size_t size)
+{
+    size_t cur = GC_get_heap_size();
+    if (size > cur) {
+        if (!GC_expand_hp(size - cur)) {
+            Scm_Error("couldn't expand the heap to %lu bytes", (u_long)size);
+        }
+    }
+}
+
+/* Returns a list of lists of a keyword and a value, as gc-stat. */
+ScmObj Scm_GCConfiguration(void)
+{
+    int markers = 1;
+#if defined(GC_THREADS)
+    markers = GC_get_parallel() + 1;
+#endif /*GC_THREADS*/
+    return SCM_LIST4(SCM_LIST2(SCM_MAKE_KEYWORD("markers"),
+                               SCM_MAKE_INT(markers)),
+                     SCM_LIST2(SCM_MAKE_KEYWORD("free-space-divisor"),
+                               Scm_MakeIntegerU(GC_get_free_space_divisor())),
+                     SCM_LIST2(SCM_MAKE_KEYWORD("incremental"),
+                               SCM_MAKE_BOOL(GC_is_incremental_mode())),
+                     SCM_LIST2(SCM_MAKE_KEYWORD("heap-size"),
+                               Scm_MakeIntegerU(GC_get_heap_size())));
+}
+
+/*
+ * Allocation entry while the allocation profiler is running.
+ * See SCM_MALLOC in gauche.h.  The flag is turned on and off by
+ * the profiler (prof.c).
+ */
+int Scm__AllocProfilerActive = 0;
+
+void *Scm__ProfiledMalloc(size_t size, const char *type, int atomic)
+{
+    void *z = atomic ? GC_MALLOC_ATOMIC(size) : GC_MALLOC(size);
+    Scm_ProfilerCountAlloc(z, size, type);
+    return z;
+}
+
 /*
  * External API to register root set in dynamically loaded library.
  * Boehm GC doesn't do this automatically on some platforms.
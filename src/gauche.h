@@ -520,18 +520,36 @@ typedef struct ScmInstanceRec {
 #define SCM_INSTANCE(obj)        ((ScmInstance*)(obj))
 #define SCM_INSTANCE_SLOTS(obj)  (SCM_INSTANCE(obj)->slots)
 
-/* Fundamental allocators */
-#define SCM_MALLOC(size)          GC_MALLOC(size)
-#define SCM_MALLOC_ATOMIC(size)   GC_MALLOC_ATOMIC(size)
+/* Fundamental allocators
+ *
+ * While the allocation profiler is running in any thread,
+ * Scm__AllocProfilerActive is nonzero and the allocation goes through
+ * Scm__ProfiledMalloc (core.c), which passes it to the profiler.
+ * Otherwise we call GC directly; the cost is one load and one branch.
+ * TYPE is the name of the allocated C type, or NULL if unknown.
+ */
+SCM_EXTERN int   Scm__AllocProfilerActive;
+SCM_EXTERN void *Scm__ProfiledMalloc(size_t size, const char *type,
+                                     int atomic);
+
+#define SCM__MALLOC_T(size, type)                                       \
+    (Scm__AllocProfilerActive                                           \
+     ? Scm__ProfiledMalloc(size, type, FALSE) : GC_MALLOC(size))
+#define SCM__MALLOC_ATOMIC_T(size, type)                                \
+    (Scm__AllocProfilerActive                                           \
+     ? Scm__ProfiledMalloc(size, type, TRUE) : GC_MALLOC_ATOMIC(size))
+
+#define SCM_MALLOC(size)          SCM__MALLOC_T(size, NULL)
+#define SCM_MALLOC_ATOMIC(size)   SCM__MALLOC_ATOMIC_T(size, NULL)
 #define SCM_STRDUP(s)             GC_STRDUP(s)
 #define SCM_STRDUP_PARTIAL(s, n)  Scm_StrdupPartial(s, n)
 
-#define SCM_NEW(type)         ((type*)(SCM_MALLOC(sizeof(type))))
-#define SCM_NEW_ARRAY(type, nelts) ((type*)(SCM_MALLOC(sizeof(type)*(nelts))))
-#define SCM_NEW2(type, size)  ((type)(SCM_MALLOC(size)))
-#define SCM_NEW_ATOMIC(type)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type))))
-#define SCM_NEW_ATOMIC_ARRAY(type, nelts)  ((type*)(SCM_MALLOC_ATOMIC(sizeof(type)*(nelts))))
-#define SCM_NEW_ATOMIC2(type, size) ((type)(SCM_MALLOC_ATOMIC(size)))
+#define SCM_NEW(type)         ((type*)(SCM__MALLOC_T(sizeof(type), #type)))
+#define SCM_NEW_ARRAY(type, nelts) ((type*)(SCM__MALLOC_T(sizeof(type)*(nelts), #type "[]")))
+#define SCM_NEW2(type, size)  ((type)(SCM__MALLOC_T(size, #type)))
+#define SCM_NEW_ATOMIC(type)  ((type*)(SCM__MALLOC_ATOMIC_T(sizeof(type), #type)))
+#define SCM_NEW_ATOMIC_ARRAY(type, nelts)  ((type*)(SCM__MALLOC_ATOMIC_T(sizeof(type)*(nelts), #type "[]")))
+#define SCM_NEW_ATOMIC2(type, size) ((type)(SCM__MALLOC_ATOMIC_T(size, #type)))
 
 typedef void (*ScmFinalizerProc)(ScmObj z, void *data);
 SCM_EXTERN void Scm_RegisterFinalizer(ScmObj z, ScmFinalizerProc finalizer,
@@ -657,7 +675,9 @@ SCM_EXTERN ScmObj Scm_VMEval(ScmObj expr, ScmObj env);
 SCM_EXTERN ScmObj Scm_VMCall(ScmObj *args, int argcnt, void *data);
 
 SCM_EXTERN ScmObj Scm_VMCallCC(ScmObj proc);
+SCM_EXTERN ScmObj Scm_VMCallOneShotCC(ScmObj proc);
 SCM_EXTERN ScmObj Scm_VMCallPC(ScmObj proc);
+SCM_EXTERN ScmObj Scm_VMCallOneShotPC(ScmObj proc);
 SCM_EXTERN ScmObj Scm_VMReset(ScmObj proc);
 SCM_EXTERN ScmObj Scm_VMDynamicWind(ScmObj pre, ScmObj body, ScmObj post);
 SCM_EXTERN ScmObj Scm_VMDynamicWindC(ScmSubrProc *before,
@@ -2024,6 +2044,13 @@ SCM_EXTERN void Scm_RegisterDL(void *data_start, void *data_end,
                                void *bss_start, void *bss_end);
 SCM_EXTERN void Scm_GCSentinel(void *obj, const char *name);
 
+SCM_EXTERN ScmObj Scm_GCPauseStats(int reset);
+SCM_EXTERN ScmObj Scm_GCRecentCollections(void);
+SCM_EXTERN ScmObj Scm_GCConfiguration(void);
+SCM_EXTERN void   Scm_GCSetFreeSpaceDivisor(u_long divisor);
+SCM_EXTERN void   Scm_GCEnableIncremental(void);
+SCM_EXTERN void   Scm_GCExpandHeap(size_t size);
+
 SCM_EXTERN ScmObj Scm_GetFeatures(void);
 SCM_EXTERN void   Scm_AddFeature(const char *feature, const char *mod);
 SCM_EXTERN void   Scm_DisableFeature(const char *feature);
@@ -327,6 +327,8 @@ SCM_EXTERN ScmObj Scm_PortSeek(ScmPort *port, ScmObj off, int whence);
 SCM_EXTERN ScmObj Scm_PortSeekUnsafe(ScmPort *port, ScmObj off, int whence);
 SCM_EXTERN int    Scm_PortFileNo(ScmPort *port);
 SCM_EXTERN void   Scm_PortFdDup(ScmPort *dst, ScmPort *src);
+SCM_EXTERN ScmSize Scm_CopyPortDirect(ScmPort *src, ScmPort *dst,
+                                      ScmSize size, int *donep);
 SCM_EXTERN int    Scm_FdReady(int fd, int dir);
 SCM_EXTERN int    Scm_ByteReady(ScmPort *port);
 SCM_EXTERN int    Scm_ByteReadyUnsafe(ScmPort *port);
@@ -386,12 +388,27 @@ SCM_EXTERN ScmObj Scm_UngottenBytesUnsafe(ScmPort *port);
 SCM_EXTERN ScmObj Scm_ReadLine(ScmPort *port);
 SCM_EXTERN ScmObj Scm_ReadLineUnsafe(ScmPort *port);
 
+/* Scanner of Scm_ScanBytes.  It is called with the bytes [beg, end)
+   that are available from the port, and returns the number of bytes
+   it consumed.  It sets *done to stop scanning; otherwise it must
+   consume all the given bytes. */
+typedef ScmSize (*ScmPortByteScanner)(const char *beg, const char *end,
+                                      int *done, void *data);
+
+SCM_EXTERN int    Scm_ScanBytes(ScmPort *port, ScmPortByteScanner scanner,
+                                void *data);
+SCM_EXTERN int    Scm_ScanBytesUnsafe(ScmPort *port,
+                                      ScmPortByteScanner scanner,
+                                      void *data);
+
 /*================================================================
  * File ports
  */
 
 SCM_EXTERN ScmObj Scm_OpenFilePort(const char *path, int flags,
                                    int buffering, int perm);
+SCM_EXTERN ScmObj Scm_OpenMappedFilePort(const char *path, int flags,
+                                         int buffering);
 
 SCM_EXTERN ScmObj Scm_Stdin(void);
 SCM_EXTERN ScmObj Scm_Stdout(void);
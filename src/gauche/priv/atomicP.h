@@ -28,9 +28,12 @@ typedef volatile _Atomic ScmAtomicWord ScmAtomicVar;
 #define AO_store_full(loc, val)  atomic_store(loc, val)
 #define AO_store(loc, val)       atomic_store(loc, val)
 #define AO_load(loc)             atomic_load(loc)
+#define AO_load_acquire(loc)     atomic_load_explicit(loc, memory_order_acquire)
 #define AO_compare_and_swap_full(loc, oldval, newval) \
     atomic_compare_exchange_strong(loc, &oldval, newval)
 #define AO_nop_full()            atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define AO_nop_read()            atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define AO_nop_write()           atomic_thread_fence(__ATOMIC_RELEASE)
 
 #  else /* GC_BUILTIN_ATOMIC && !HAVE_STDATOMIC_H */
 /*
@@ -43,9 +46,12 @@ typedef volatile ScmAtomicWord ScmAtomicVar;
 #define AO_store_full(loc, val)  __atomic_store_n(loc, val, __ATOMIC_SEQ_CST)
 #define AO_store(loc, val)       __atomic_store_n(loc, val, __ATOMIC_SEQ_CST)
 #define AO_load(loc)             __atomic_load_n(loc, __ATOMIC_SEQ_CST)
+#define AO_load_acquire(loc)     __atomic_load_n(loc, __ATOMIC_ACQUIRE)
 #define AO_compare_and_swap_full(loc, oldval, newval) \
     __atomic_compare_exchange_n(loc, &oldval, newval, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
 #define AO_nop_full()            __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define AO_nop_read()            __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define AO_nop_write()           __atomic_thread_fence(__ATOMIC_RELEASE)
 
 
 #  endif /* GC_BUILTIN_ATOMIC && !HAVE_STDATOMIC_H */
@@ -105,6 +105,12 @@ typedef struct ScmEscapePointRec {
     int reraised;               /* EXPERIMENTAL: if exception is reraised,
                                    this flag is set to TRUE and the exception
                                    handler can return to the caller. */
+    int oneShot;                /* TRUE if this is a one-shot continuation
+                                   (call/1cc).  It can be invoked at most
+                                   once; the reference to the captured
+                                   frames is dropped when it is invoked. */
+    int shot;                   /* TRUE once a one-shot continuation is
+                                   invoked. */
 } ScmEscapePoint;
 
 /* Link management */
@@ -40,24 +40,23 @@
 
 /* We have two types of profilers, a statistic sampler and call-counter.
  *
- * The statistic sampler uses ITIMER_PROF and records the current code
- * base and PC for every SIGPROF.
- * (NB: in order for this to work, VM's PC must always be saved
- * in VM structure; in another word, vm.c must be compiled with
- * SMALL_REGS == 0).
+ * The statistic sampler records the current code base, and the bases of
+ * all the continuation frames, for every SIGPROF.  Where available,
+ * we use a per-thread CPU-time timer (timer_create with SIGEV_THREAD_ID),
+ * so each thread that runs the profiler gets samples of its own.
+ * Otherwise we fall back to process-wide ITIMER_PROF, in which case the
+ * sampling doesn't work well with multiple threads.
  *
  * The call counter records every event of CALL and TAIL-CALL instruction
  * execution on the thread.   Each entry just records the address of
  * the called object.
  *
- * TODO: It is not known if sampling profiler works when more than one
- * thread requests profiling.  Should be considrered later.
- *
  * When the on-memory buffer of the call counter gets full, it is collected
- * to a hash table.  When the statistic sampling buffer gets full, it
- * is flushed to a temporary file (we can't use a hashtable, since the
- * flushing may be done within a signal handler and we can't call allocator
- * in it).
+ * to a hash table.  The samples are written to a ring buffer by the
+ * signal handler, since we can't call allocator in it.  The ring is drained
+ * into hash tables whenever the call counter is flushed, and when the
+ * result is requested.  The ring buffer is in the GC-visible memory, so
+ * the sampled objects won't be collected before being drained.
  *
  * Profiler status:
  *
@@ -72,8 +71,23 @@
  *
  * Profile result can only be examined when the profile is in "PAUSING"
  * state.
+ *
+ * The allocation profiler is independent from the above two, and has
+ * its own status which changes in the same way.  While it is running,
+ * every allocation via SCM_MALLOC (and SCM_NEW etc.) is reported to
+ * Scm_ProfilerCountAlloc.  Every time the thread allocates allocInterval
+ * bytes, the allocation at that moment is sampled; we record the stack,
+ * the C type and the bytes allocated since the last sample, which are
+ * accumulated to allocHash.  We also keep a weak reference to the sampled
+ * object, so that we can tell which samples are still alive.
  */
 
+/* Whether we can use per-thread CPU-time timer */
+#if defined(HAVE_TIMER_CREATE) && defined(SIGEV_THREAD_ID) \
+    && defined(CLOCK_THREAD_CPUTIME_ID)
+#define GAUCHE_PROF_THREAD_TIMER 1
+#endif
+
 /* Profiler status */
 enum {
     SCM_PROFILER_INACTIVE,
@@ -81,14 +95,22 @@ enum {
     SCM_PROFILER_PAUSING
 };
 
-/* A sample of statistic sampler */
-typedef struct ScmProfSampleRec {
-    ScmObj func;                /* ScmCompiledCode or ScmSubr */
-    ScmWord *pc;
-} ScmProfSample;
+/* The ring buffer of the statistic sampler.  Defined in prof.c.
+   Each sample is a sequence of words; the number of frames N,
+   followed by N objects (ScmCompiledCode or ScmSubr), innermost first. */
+typedef struct ScmProfRingRec ScmProfRing;
+
+/* # of words in the ring buffer.  Must be a power of 2. */
+#define SCM_PROF_RING_SIZE  (1UL<<16)
+
+/* Max # of frames recorded per sample. */
+#define SCM_PROF_MAX_DEPTH  128
 
-/* # of on-memory samples for the statistic sampler. */
-#define SCM_PROF_SAMPLES_IN_BUFFER  6000
+/* A sample of the allocation profiler.  Defined in prof.c. */
+typedef struct ScmProfAllocRecordRec ScmProfAllocRecord;
+
+/* Default sampling interval of the allocation profiler, in bytes. */
+#define SCM_PROF_ALLOC_INTERVAL  (512*1024)
 
 /* A record of call counter */
 typedef struct ScmProfCountRec {
@@ -104,25 +126,50 @@ typedef struct ScmProfCountRec {
  */
 struct ScmVMProfilerRec {
     int state;                  /* profiler state */
-    int samplerFd;              /* temporary file for the sampler */
-    int currentSample;          /* index to the current sample */
     int totalSamples;           /* total # of samples */
-    int errorOccurred;          /* TRUE if error has occurred during I/O */
+    int droppedSamples;         /* # of samples lost as the ring was full */
     int currentCount;           /* index to the current counter */
     ScmHashTable* statHash;     /* hashtable for collected data.
                                    value is a pair of integers,
                                    (<call-count> . <sample-hits>) */
+    ScmHashCore stackHash;      /* vector of frames, outermost first,
+                                   to # of sample hits */
+    ScmProfRing *ring;          /* sample buffer */
+
+    int allocState;             /* allocation profiler state */
+    int allocSampling;          /* TRUE while we're taking a sample */
+    size_t allocInterval;       /* sampling interval in bytes */
+    size_t allocBytes;          /* bytes allocated since the last sample */
+    int allocSamples;           /* total # of allocation samples */
+    ScmHashCore allocHash;      /* vector of frames, outermost first, plus
+                                   the type name, to
+                                   (<samples> . <bytes>) */
+    ScmHashCore allocTypes;     /* C type name (const char*) to ScmString */
+    ScmProfAllocRecord *allocLive; /* samples that may be alive */
+    size_t allocNumLive;        /* # of records in allocLive */
+    size_t allocPruneAt;        /* prune allocLive when it gets this long */
 #if defined(GAUCHE_WINDOWS)
     HANDLE hTargetThread;       /* target thread */
     HANDLE hObserverThread;     /* observer thread */
     HANDLE hTimerEvent;         /* sampling timer event */
-    char *samplerFileName;      /* temporary file name to remove the file */
-#endif /* GAUCHE_WINDOWS */
-    ScmProfSample samples[SCM_PROF_SAMPLES_IN_BUFFER];
+#elif defined(GAUCHE_PROF_THREAD_TIMER)
+    timer_t timer;              /* per-thread CPU-time timer */
+    int timerCreated;
+#endif /* GAUCHE_PROF_THREAD_TIMER */
     ScmProfCount  counts[SCM_PROF_COUNTER_IN_BUFFER];
 };
 
 SCM_EXTERN ScmObj Scm_ProfilerRawResult(void);
+SCM_EXTERN ScmObj Scm_ProfilerRawStacks(void);
+
+/* Allocation profiler API */
+
+SCM_EXTERN void   Scm_AllocProfilerStart(ScmSmallInt interval);
+SCM_EXTERN int    Scm_AllocProfilerStop(void);
+SCM_EXTERN void   Scm_AllocProfilerReset(void);
+SCM_EXTERN ScmObj Scm_AllocProfilerRawResult(int liveOnly);
+SCM_EXTERN void   Scm_ProfilerCountAlloc(void *obj, size_t size,
+                                         const char *type);
 
 /* Call Counter API */
 
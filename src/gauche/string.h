@@ -180,6 +180,8 @@ SCM_CLASS_DECL(Scm_StringCursorLargeClass);
 
 SCM_EXTERN int    Scm_StringCursorP(ScmObj obj);
 SCM_EXTERN ScmObj Scm_MakeStringCursorFromIndex(ScmString *src, ScmSmallInt index);
+SCM_EXTERN ScmObj Scm_MakeStringCursorFromPointer(ScmString *src,
+                                                 const char *ptr);
 SCM_EXTERN ScmObj Scm_MakeStringCursorEnd(ScmString *src);
 SCM_EXTERN ScmObj Scm_StringCursorIndex(ScmString *s, ScmObj sc);
 SCM_EXTERN ScmObj Scm_StringCursorStart(ScmString* s);
@@ -69,6 +69,7 @@ typedef enum {
 SCM_EXTERN ScmObj Scm_MakeSymbol(ScmString *name, int interned);
 SCM_EXTERN ScmObj Scm_Gensym(ScmString *prefix);
 SCM_EXTERN ScmObj Scm_SymbolSansPrefix(ScmSymbol *s, ScmSymbol *p);
+SCM_EXTERN ScmObj Scm__SymbolTableStats(void); /* internal */
 
 #define Scm_Intern(name)  Scm_MakeSymbol(name, TRUE)
 #define SCM_INTERN(cstr)  Scm_Intern(SCM_STRING(SCM_MAKE_STR_IMMUTABLE(cstr)))
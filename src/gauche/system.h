@@ -278,6 +278,30 @@ typedef struct ScmHeaderRec ScmSysFdset;
 #define SCM_SYS_FDSET_P(obj)    (FALSE)
 #endif /*!HAVE_SELECT*/
 
+/*==============================================================
+ * Memory-mapped file region
+ */
+
+/* A read-only mapping of a file region.  The mapping is released by the
+   finalizer when nothing refers to this structure any longer; ports
+   and uvectors using the region keep a pointer to it (uvectors in the
+   owner field). */
+typedef struct ScmMappedRegionRec {
+    char    *addr;              /* start of the region */
+    ScmSize  size;              /* size of the region in bytes */
+    void    *base;              /* page-aligned start of the mapping */
+    size_t   baseSize;          /* size of the mapping */
+} ScmMappedRegion;
+
+SCM_EXTERN ScmMappedRegion *Scm_MapFdRegion(int fd, off_t offset,
+                                            ScmSize size);
+SCM_EXTERN ScmMappedRegion *Scm_MapFileRegion(const char *path,
+                                              off_t offset, ScmSize size);
+SCM_EXTERN ScmMappedRegion *Scm_PortMappedRegion(ScmPort *port);
+
+SCM_EXTERN ScmSize Scm_SysTransferFd(int outfd, int infd, off_t *offset,
+                                     ScmSize count, int *stopped);
+
 /*==============================================================
  * Miscellaneous
  */
@@ -34,8 +34,14 @@
 /* This file is included from gauche.h */
 
 /*
- * Provides ScmTreeCore, a raw red-black tree implementation,
+ * Provides ScmTreeCore, a raw balanced tree implementation,
  * and ScmTreeMap, ScmObj wrapper of ScmTreeCore.
+ *
+ * ScmTreeCore has two backends; a red-black tree (default), and
+ * a B+tree (SCM_TREE_CORE_BTREE).  The B+tree keeps keys of up to
+ * a few dozens of entries packed in a node, so it uses less memory
+ * per entry and touches fewer cache lines per lookup.  Both backends
+ * return ScmDictEntry's that stay valid while the entry is in the tree.
  */
 
 #ifndef GAUCHE_TREEMAP_H
@@ -52,12 +58,17 @@ typedef int ScmTreeCoreCompareProc(ScmTreeCore*, intptr_t, intptr_t);
 /* A general tree map for internal use.  This is NOT a Scheme object. */
 
 struct ScmTreeCoreRec {
-    ScmDictEntry *root;
+    ScmDictEntry *root;         /* for B+tree, this is the root node */
     ScmTreeCoreCompareProc *cmp;
     int   num_entries;
+    int   flags;                /* ScmTreeCoreFlags */
     void  *data;
 };
 
+typedef enum {
+    SCM_TREE_CORE_BTREE = (1L<<0)   /* Use B+tree backend */
+} ScmTreeCoreFlags;
+
 #define SCM_TREE_CORE_DATA(core)  ((core)->data)
 
 /* The tree iterator is bidirectional.  We need to keep both next and
@@ -78,6 +89,10 @@ struct ScmTreeCoreRec {
 
    NULL   cur    NULL           edge case: map only has one entry
    NULL   NULL   NULL           edge case: map has no entries
+
+   For the B+tree backend, 'next' holds the leaf node that contains
+   'current' while 'current' isn't NULL, and 'prev' is NULL.  Other
+   states are the same as above.
 */
 typedef struct ScmTreeIterRec {
     ScmTreeCore  *t;
@@ -92,9 +107,17 @@ typedef struct ScmTreeIterRec {
 SCM_EXTERN void Scm_TreeCoreInit(ScmTreeCore *tc,
                                  ScmTreeCoreCompareProc *cmp,
                                  void *data);
+SCM_EXTERN void Scm_TreeCoreInitWithFlags(ScmTreeCore *tc,
+                                          ScmTreeCoreCompareProc *cmp,
+                                          void *data,
+                                          int flags);
 SCM_EXTERN void Scm_TreeCoreCopy(ScmTreeCore *dst,
                                  const ScmTreeCore *src);
 SCM_EXTERN void Scm_TreeCoreClear(ScmTreeCore *tc);
+SCM_EXTERN void Scm_TreeCoreBulkLoad(ScmTreeCore *tc,
+                                     const intptr_t *keys,
+                                     const intptr_t *values,
+                                     int num_entries);
 
 /*
  * Accessors
@@ -162,6 +185,9 @@ SCM_CLASS_DECL(Scm_TreeMapClass);
 
 SCM_EXTERN ScmObj    Scm_MakeTreeMap(ScmTreeCoreCompareProc *cmp,
                                      void *data);
+SCM_EXTERN ScmObj    Scm_MakeTreeMapWithFlags(ScmTreeCoreCompareProc *cmp,
+                                              void *data,
+                                              int flags);
 SCM_EXTERN ScmObj    Scm_TreeMapCopy(const ScmTreeMap *src);
 
 SCM_EXTERN ScmObj    Scm_TreeMapRef(ScmTreeMap *tm, ScmObj key,
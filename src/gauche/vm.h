@@ -643,7 +643,9 @@ enum {
                                               (pass2/dissolve-apply) */
     SCM_COMPILE_LEGACY_DEFINE = (1L<<11),  /* Do not insert toplevel binding
                                               at compile-time. */
-    SCM_COMPILE_MUTABLE_LITERALS = (1L<<12) /* Literal pairs are mutable */
+    SCM_COMPILE_MUTABLE_LITERALS = (1L<<12), /* Literal pairs are mutable */
+    SCM_COMPILE_AUTO_INLINE = (1L<<13)     /* Make small exported procedures
+                                              inlinable */
 };
 
 #define SCM_VM_COMPILER_FLAG_IS_SET(vm, flag) ((vm)->compilerFlags & (flag))
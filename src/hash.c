@@ -36,6 +36,7 @@
 #include "gauche.h"
 #include "gauche/class.h"
 #include "gauche/priv/atomicP.h"
+#include "gauche/priv/hashP.h"
 
 /*============================================================
  * Internal structures
@@ -552,9 +553,13 @@ static Entry *insert_entry(ScmHashCore *table,
         /* gc friendliness */
         for (int i=0; i<table->numBuckets; i++) table->buckets[i] = NULL;
 
+        /* The new bucket array must be visible before the new size, so
+           that Scm__HashTableRefUnlocked running concurrently never
+           indexes the old array with the new size. */
+        table->buckets = (void**)newb;
+        AO_nop_write();
         table->numBuckets = newsize;
         table->numBucketsLog2 = newbits;
-        table->buckets = (void**)newb;
     }
     return e;
 }
@@ -995,6 +1000,40 @@ ScmObj Scm_HashTableRef(ScmHashTable *ht, ScmObj key, ScmObj fallback)
     else    return SCM_DICT_VALUE(e);
 }
 
+/* Lookup without locking.  This is for an eq-hash table whose mutators
+   are serialized by the caller but whose readers don't want to take the
+   lock (the binding tables of modules; see module.c).  While another
+   thread is inserting, deleting or extending the table, this may miss
+   an existing entry or return an obsolete value, but it never reads
+   outside of the bucket array nor loops forever.  It's the caller's
+   responsibility to detect concurrent modification and retry. */
+ScmObj Scm__HashTableRefUnlocked(ScmHashTable *ht, ScmObj key,
+                                 ScmObj fallback)
+{
+    ScmHashCore *table = SCM_HASH_TABLE_CORE(ht);
+    SCM_ASSERT(table->accessfn == (void*)address_access);
+
+    u_long hashval, index;
+    ADDRESS_HASH(hashval, key);
+    /* Read the size first; see insert_entry */
+    int size = table->numBuckets;
+    int bits = table->numBucketsLog2;
+    AO_nop_read();
+    Entry **buckets = (Entry**)table->buckets;
+    index = HASH2INDEX(size, bits, hashval);
+
+    /* Entries may be relinked under us while the table is extended,
+       so we bound the chain walk. */
+    int limit = table->numEntries + 1;
+    for (Entry *e = buckets[index]; e && limit-- > 0; e = e->next) {
+        if (e->key == (intptr_t)key) {
+            if (e->value == 0) break;
+            return SCM_DICT_VALUE(e);
+        }
+    }
+    return fallback;
+}
+
 /* Returns previous value; can return SCM_UNBOUND when the association hasn't
    been there.  Be careful not to let SCM_UNBOUND leak out to Scheme! */
 ScmObj Scm_HashTableSet(ScmHashTable *ht, ScmObj key, ScmObj value, int flags)
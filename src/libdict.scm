@@ -640,10 +640,11 @@
        (return (SCM_INT_VALUE r)))))
  )
 
-(define-cproc %make-tree-map (comparator)
+(define-cproc %make-tree-map (comparator :optional (btree::<boolean> #f))
   (begin
     (SCM_ASSERT (SCM_COMPARATORP comparator))
-    (return (Scm_MakeTreeMap tree_map_cmp comparator))))
+    (return (Scm_MakeTreeMapWithFlags tree_map_cmp comparator
+                                      (?: btree SCM_TREE_CORE_BTREE 0)))))
 
 ;; TODO: We do want to return something even for tree-maps that aren't
 ;; created from the Scheme world.  But how?
@@ -726,6 +727,21 @@
     (Scm_TreeIterInit iter (SCM_TREE_MAP_CORE tm) NULL)
     (return (Scm_MakeSubr tree_map_iter iter 2 0 '"tree-map-iterator"))))
 
+(select-module gauche.internal)
+;; ALIST must be sorted by the keys in strictly ascending order.
+(define-cproc %tree-map-bulk-load! (tm::<tree-map> alist) ::<void>
+  (let* ([n::ScmSize (Scm_Length alist)]
+         [i::ScmSize 0])
+    (when (< n 0) (SCM_TYPE_ERROR alist "proper list"))
+    (let* ([keys::intptr_t* (SCM_NEW_ARRAY intptr_t n)]
+           [vals::intptr_t* (SCM_NEW_ARRAY intptr_t n)])
+      (dolist [p alist]
+        (unless (SCM_PAIRP p) (SCM_TYPE_ERROR p "pair"))
+        (set! (aref keys i) (cast intptr_t (SCM_CAR p)))
+        (set! (aref vals i) (cast intptr_t (SCM_CDR p)))
+        (post++ i))
+      (Scm_TreeCoreBulkLoad (SCM_TREE_MAP_CORE tm) keys vals (cast int n)))))
+
 (select-module gauche.internal)
 (define-cproc %tree-map-check-consistency (tm::<tree-map>)
   (Scm_TreeCoreCheckConsistency (SCM_TREE_MAP_CORE tm))
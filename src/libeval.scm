@@ -559,6 +559,23 @@
     (list ':total-bytes
           (Scm_MakeIntegerFromUI (cast u_long (GC_get_total_bytes)))))))
 
+;; API
+(define-cproc gc-pause-stats (:key (reset::<boolean> #f)) Scm_GCPauseStats)
+(define-cproc gc-recent-collections () Scm_GCRecentCollections)
+
+;; API
+(define-cproc gc-configuration () Scm_GCConfiguration)
+(define-cproc gc-configure (:key (free-space-divisor #f)
+                                 (incremental #f)
+                                 (heap-size #f))
+  ::<void>
+  (unless (SCM_FALSEP free-space-divisor)
+    (Scm_GCSetFreeSpaceDivisor (Scm_GetIntegerU free-space-divisor)))
+  (unless (SCM_FALSEP incremental)
+    (Scm_GCEnableIncremental))
+  (unless (SCM_FALSEP heap-size)
+    (Scm_GCExpandHeap (Scm_GetIntegerU heap-size))))
+
 (select-module gauche.internal)
 ;; for diagnostics
 (define-cproc gc-print-static-roots () ::<void> Scm_PrintStaticRoots)
@@ -190,7 +190,8 @@
 (define-cproc %open-input-file (path::<string>
                                 :key (if-does-not-exist :error)
                                 (buffering #f)
-                                (element-type :binary))
+                                (element-type :binary)
+                                (mmap #f))
   (let* ([ignerr::int FALSE]
          [flags::int O_RDONLY])
     (cond [(SCM_FALSEP if-does-not-exist) (set! ignerr TRUE)]
@@ -207,8 +208,11 @@
            (logior= flags O_BINARY)))
     (let* ([bufmode::int (Scm_BufferingMode buffering SCM_PORT_INPUT
                                             SCM_PORT_BUFFER_FULL)]
-           [o (Scm_OpenFilePort (Scm_GetStringConst path)
-                                flags bufmode 0)])
+           [o (?: (SCM_FALSEP mmap)
+                  (Scm_OpenFilePort (Scm_GetStringConst path)
+                                    flags bufmode 0)
+                  (Scm_OpenMappedFilePort (Scm_GetStringConst path)
+                                          flags bufmode))])
       (when (and (SCM_FALSEP o) (not (%open/allow-noexist? ignerr)))
         (Scm_SysError "couldn't open input file: %S" path))
       (return o))))
@@ -634,6 +638,16 @@
 (define-cproc %port-ungotten-bytes (port::<input-port>)
   Scm_UngottenBytes)
 
+;; Used by copy-port.  Returns the number of bytes copied in the kernel,
+;; and a flag whether the copy is finished.  SIZE is -1 to copy until EOF.
+(define-cproc %copy-port-direct (src::<input-port> dst::<output-port>
+                                 size::<integer>)
+  ::(<integer> <boolean>)
+  (let* ([done::int FALSE]
+         [siz::ScmSize (Scm_GetIntegerClamp size SCM_CLAMP_BOTH NULL)]
+         [n::ScmSize (Scm_CopyPortDirect src dst siz (& done))])
+    (return (Scm_MakeInteger n) done)))
+
 ;; Read time constructor (srfi-10)
 (select-module gauche)
 
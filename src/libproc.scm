@@ -68,9 +68,13 @@
 
 (define-in-module scheme call/cc call-with-current-continuation)
 
+(select-module gauche)
+(define-cproc call/1cc (proc) Scm_VMCallOneShotCC)
+
 (select-module gauche.internal)
 ;; for partial continuation.  See lib/gauche/partcont.scm
 (define-cproc %call/pc (proc) (return (Scm_VMCallPC proc)))
+(define-cproc %call/1pc (proc) (return (Scm_VMCallOneShotPC proc)))
 (define-cproc %reset (proc) (return (Scm_VMReset proc)))
 
 ;;;
@@ -82,10 +86,18 @@
 (define-cproc profiler-stop  () ::<int>  Scm_ProfilerStop)
 (define-cproc profiler-reset () ::<void> Scm_ProfilerReset)
 
+(define-cproc allocation-profiler-start (:optional (interval::<fixnum> 0))
+  ::<void> Scm_AllocProfilerStart)
+(define-cproc allocation-profiler-stop  () ::<int>  Scm_AllocProfilerStop)
+(define-cproc allocation-profiler-reset () ::<void> Scm_AllocProfilerReset)
+
 (select-module gauche.internal)
 ;; Autoloaded profiler-get-result will use this.
 ;; See lib/gauche/vm/profiler.scm
 (define-cproc profiler-raw-result () Scm_ProfilerRawResult)
+(define-cproc profiler-raw-stacks () Scm_ProfilerRawStacks)
+(define-cproc allocation-profiler-raw-result (live::<boolean>)
+  Scm_AllocProfilerRawResult)
 
 ;;;
 ;;; Introspection
@@ -55,9 +55,13 @@
 (define-cproc symbol-sans-prefix (s::<symbol> p::<symbol>)
   Scm_SymbolSansPrefix)
 
+(select-module gauche.internal)
+;; Returns (#buckets #entries #live-entries) of the symbol table.
+;; For diagnostics.
+(define-cproc %symbol-table-stats () Scm__SymbolTableStats)
+
 ;; Bigloo has symbol-append symbol ... -> symbol
 ;; We enhance it a bit.
-(select-module gauche.internal)
 (define-in-module gauche symbol-append
   (letrec ([->string
             ;; to make it work regardless of keyword-symbol integration
@@ -62,6 +62,8 @@ int interactive_mode = FALSE;   /* force interactive mode */
 int test_mode = FALSE;          /* add . and ../lib implicitly  */
 int profiling_mode = FALSE;     /* profile the script? */
 int stats_mode = FALSE;         /* collect stats (EXPERIMENTAL) */
+int parallel_load = FALSE;      /* preload the libraries used by the script
+                                   in parallel */
 
 ScmObj pre_cmds = SCM_NIL;      /* assoc list of commands that needs to be
                                    processed before entering repl.
@@ -91,7 +93,7 @@ ScmModule *default_toplevel_module = NULL;
 void usage(int errorp)
 {
     fprintf(errorp? stderr:stdout,
-            "Usage: gosh [-biqV][-I<path>][-A<path>][-u<module>][-m<module>][-l<file>][-L<file>][-e<expr>][-E<expr>][-p<type>][-F<feature>][-r<standard>][-f<flag>][--] [file]\n"
+            "Usage: gosh [-biqV][-I<path>][-A<path>][-u<module>][-m<module>][-l<file>][-L<file>][-e<expr>][-E<expr>][-p<type>][-F<feature>][-r<standard>][-f<flag>][-g<gc-option>][--] [file]\n"
             "Options:\n"
             "  -V       Prints version and exits.\n"
             "  -h       Show this message to stdout.\n"
@@ -127,6 +129,8 @@ void usage(int errorp)
             "           values are supported as <standard>.\n"
             "      7               R7RS (R7RS-small)\n"
             "  -f<flag> Sets various flags\n"
+            "      auto-inline     make small exported procedures inlinable from\n"
+            "                      other modules, as if defined by define-inline\n"
             "      case-fold       uses case-insensitive reader (as in R5RS)\n"
             "      include-verbose report while including files\n"
             "      load-verbose    report while loading files\n"
@@ -146,12 +150,23 @@ void usage(int errorp)
             "      no-post-inline-pass\n"
             "                      don't run post-inline optimization pass.\n"
             "      no-source-info  don't preserve source information for debugging\n"
+            "      parallel-load   load the libraries the script uses in parallel\n"
+            "                      before running the script\n"
             "      safe-string-cursors\n"
             "                      performs extra validation for use of string cursors\n"
             "      test            test mode, to run gosh inside the build tree\n"
             "                      without installing.\n"
             "      warn-legacy-syntax\n"
             "                      print warning when legacy Gauche syntax is encountered\n"
+            "  -g<gc-option> Tunes the garbage collector\n"
+            "      markers=<n>     use <n> threads for marking (parallel mark)\n"
+            "      free-space-divisor=<n>\n"
+            "                      trade memory for speed; larger <n> makes the heap\n"
+            "                      smaller and GC more frequent (default 3)\n"
+            "      incremental     use incremental (generational) collection\n"
+            "      initial-heap-size=<size>\n"
+            "                      initial heap size in bytes; suffix k, m or g\n"
+            "                      can be used\n"
             "Environment variables:\n"
             "  GAUCHE_AVAILABLE_PROCESSORS\n"
             "      Value must be an integer.  If set, it overrides the number of\n"
@@ -274,6 +289,9 @@ void further_options(const char *optarg)
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NOINLINE_CONSTS);
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NOINLINE_SETTERS);
     }
+    else if (strcmp(optarg, "auto-inline") == 0) {
+        SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_AUTO_INLINE);
+    }
     else if (strcmp(optarg, "no-post-inline-pass") == 0) {
         SCM_VM_COMPILER_FLAG_SET(vm, SCM_COMPILE_NO_POST_INLINE_OPT);
     }
@@ -304,6 +322,9 @@ void further_options(const char *optarg)
     else if (strcmp(optarg, "safe-string-cursors") == 0) {
         SCM_VM_RUNTIME_FLAG_SET(vm, SCM_SAFE_STRING_CURSORS);
     }
+    else if (strcmp(optarg, "parallel-load") == 0) {
+        parallel_load = TRUE;
+    }
     /* For development; not for public use */
     else if (strcmp(optarg, "collect-stats") == 0) {
         stats_mode = TRUE;
@@ -323,7 +344,8 @@ void further_options(const char *optarg)
     }
     else {
         fprintf(stderr, "unknown -f option: %s\n", optarg);
-        fprintf(stderr, "supported options are: -fcase-fold, -fload-verbose, "
+        fprintf(stderr, "supported options are: -fauto-inline, "
+                "-fcase-fold, -fload-verbose, "
                 "-finclude-verbose, -fno-dissolve-apply -fno-inline, "
                 "-fno-inline-globals, -fno-inline-locals, "
                 "-fno-inline-constants, -fno-inline-setters, -fno-source-info, "
@@ -349,6 +371,78 @@ void profiler_options(const char *optarg)
     }
 }
 
+/* Parse the numeric value of -g option, which may have k, m or g suffix. */
+static size_t gc_option_value(const char *optarg, const char *val)
+{
+    char *end;
+    size_t n = (size_t)strtoul(val, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': n *= 1024; end++; break;
+    case 'm': case 'M': n *= 1024*1024; end++; break;
+    case 'g': case 'G': n *= 1024UL*1024*1024; end++; break;
+    }
+    if (end == val || *end != '\0' || n == 0) {
+        fprintf(stderr, "invalid value for -g option: %s\n", optarg);
+        exit(1);
+    }
+    return n;
+}
+
+void gc_options(const char *optarg)
+{
+    const char *val = strchr(optarg, '=');
+    size_t len = val ? (size_t)(val - optarg) : strlen(optarg);
+#define GC_OPTION_IS(name) \
+    (len == sizeof(name)-1 && strncmp(optarg, name, len) == 0)
+
+    if (val && GC_OPTION_IS("markers")) {
+        /* This has already been processed before GC_INIT.  Just check. */
+        (void)gc_option_value(optarg, val+1);
+    }
+    else if (val && GC_OPTION_IS("free-space-divisor")) {
+        Scm_GCSetFreeSpaceDivisor(gc_option_value(optarg, val+1));
+    }
+    else if (!val && GC_OPTION_IS("incremental")) {
+        Scm_GCEnableIncremental();
+    }
+    else if (val && GC_OPTION_IS("initial-heap-size")) {
+        Scm_GCExpandHeap(gc_option_value(optarg, val+1));
+    }
+    else {
+        fprintf(stderr, "unknown -g option: %s\n", optarg);
+        fprintf(stderr, "supported options are: -gmarkers=<n>, "
+                "-gfree-space-divisor=<n>, -gincremental, "
+                "or -ginitial-heap-size=<size>\n");
+        exit(1);
+    }
+#undef GC_OPTION_IS
+}
+
+/* The number of marker threads of GC is fixed when GC is initialized,
+   so we look for -gmarkers=<n> before GC_INIT and pass it to GC via
+   the environment variable GC_MARKERS, which GC reads in the
+   initialization.  Options are scanned in the same way as getopt. */
+static void gc_early_options(int argc, char **argv)
+{
+    static char markers_env[32];
+
+    for (int i=1; i<argc; i++) {
+        const char *arg = argv[i];
+        if (arg[0] != '-' || strcmp(arg, "--") == 0) break;
+        if (arg[1] == 'g') {
+            const char *opt = (arg[2] == '\0' && i+1 < argc)? argv[++i] : arg+2;
+            if (strncmp(opt, "markers=", 8) == 0) {
+                snprintf(markers_env, sizeof(markers_env), "GC_MARKERS=%s",
+                         opt+8);
+                putenv(markers_env);
+            }
+        } else if (arg[1] != '\0' && arg[2] == '\0'
+                   && strchr("eEplLmuvrFfIA", arg[1]) != NULL) {
+            i++;                /* skip option argument */
+        }
+    }
+}
+
 void feature_options(const char *optarg)
 {
     if (optarg[0] == '-') {
@@ -361,7 +455,7 @@ void feature_options(const char *optarg)
 int parse_options(int argc, char *argv[])
 {
     int c;
-    while ((c = getopt(argc, argv, "+be:E:hip:ql:L:m:u:Vv:r:F:f:I:A:-")) >= 0) {
+    while ((c = getopt(argc, argv, "+be:E:hip:ql:L:m:u:Vv:r:F:f:g:I:A:-")) >= 0) {
         switch (c) {
         case 'b': batch_mode = TRUE; break;
         case 'i': interactive_mode = TRUE; break;
@@ -369,6 +463,7 @@ int parse_options(int argc, char *argv[])
         case 'V': version(); break;
         case 'f': further_options(optarg); break;
         case 'p': profiler_options(optarg); break;
+        case 'g': gc_options(optarg); break;
         case 'F': feature_options(optarg); break;
         case 'm':
             main_module = Scm_Intern(SCM_STRING(SCM_MAKE_STR_COPYING(optarg)));
@@ -650,9 +745,32 @@ static void process_command_args(ScmObj cmd_args)
     }
 }
 
+/* -fparallel-load: Load the libraries the script uses, and the ones they
+   use, with multiple threads (see lib/gauche/preload.scm).  The script
+   itself is loaded as usual afterwards, and its 'use' forms find the
+   libraries already loaded. */
+static void preload_script_dependencies(const char *scriptfile)
+{
+    ScmLoadPacket lpak;
+    if (Scm_Require(SCM_MAKE_STR("gauche/preload"), 0, &lpak) < 0) {
+        error_exit(lpak.exception);
+    }
+    ScmObj proc = Scm_GlobalVariableRef(SCM_FIND_MODULE("gauche.preload", 0),
+                                        SCM_SYMBOL(SCM_INTERN("preload-script-dependencies")),
+                                        0);
+    SCM_ASSERT(SCM_PROCEDUREP(proc));
+    ScmEvalPacket epak;
+    if (Scm_Apply(proc, SCM_LIST1(SCM_MAKE_STR_COPYING(scriptfile)),
+                  &epak) < 0) {
+        error_exit(epak.exception);
+    }
+}
+
 /* When scriptfile is provided, execute it.  Returns exit code. */
 int execute_script(const char *scriptfile, ScmObj args)
 {
+    if (parallel_load) preload_script_dependencies(scriptfile);
+
     /* If script file is specified, load it. */
     ScmLoadPacket lpak;
     Scm_Load(scriptfile, SCM_LOAD_PROPAGATE_ERROR|SCM_LOAD_MAIN_SCRIPT, &lpak);
@@ -762,6 +880,8 @@ int main(int ac, char **av)
         }
     }
 
+    gc_early_options(argc, argv);
+
     GC_INIT();
     Scm_Init(GAUCHE_SIGNATURE);
     sig_setup();
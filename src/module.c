@@ -34,7 +34,9 @@
 #define LIBGAUCHE_BODY
 #include "gauche.h"
 #include "gauche/class.h"
+#include "gauche/priv/atomicP.h"
 #include "gauche/priv/builtin-syms.h"
+#include "gauche/priv/hashP.h"
 #include "gauche/priv/moduleP.h"
 
 /*
@@ -76,6 +78,37 @@
  *    affect normal runtime performance.
  *
  * Benchmark showed the change made program loading 30% faster.
+ *
+ * However, when multiple threads evaluate code (e.g. each thread has
+ * its own sandbox module), they all contend for the lock in
+ * Scm_FindBinding, which is called whenever the compiler looks up
+ * a global identifier, and whenever a gloc is resolved at runtime.
+ * So now only the mutators take the lock.  Readers (Scm_FindBinding
+ * and lookup_module) run without it, sequence-lock style:
+ *
+ *  - Every mutator increments modules.gen before and after modifying
+ *    the tables, while holding modules.mutex.  So modules.gen is odd
+ *    while a modification is in progress.
+ *
+ *  - A reader reads modules.gen with an acquire load, so that the
+ *    search isn't reordered before it, does the search with
+ *    Scm__HashTableRefUnlocked, and reads modules.gen again.  If it
+ *    is unchanged and even, nobody has modified the tables during the
+ *    search and the result is valid.  Otherwise it retries, and after
+ *    a few unsuccessful tries it falls back to do the search with the
+ *    lock.
+ *
+ * The hash tables themselves are modified in place; the lookup in
+ * hash.c tolerates concurrent modification, in the sense that it never
+ * crashes.  The lists (imported and mpl) are replaced by new lists
+ * rather than modified, except the removal of duplicates in
+ * Scm_ImportModule, which leaves the removed cell pointing to the
+ * rest of the list.
+ *
+ * The counter is global, not per module, since a search visits many
+ * modules.  It means a definition in any module makes concurrent
+ * lookups retry, but definitions are mostly done during loading, and
+ * lookups are far more frequent.
  */
 
 /* Special treatment of keyword modules.
@@ -122,10 +155,39 @@
 /* Global module table */
 static struct {
     ScmHashTable *table;    /* Maps name -> module. */
-    ScmInternalMutex mutex; /* Lock for table.  Only register_module and
-                               lookup_module may hold the lock. */
+    ScmInternalMutex mutex; /* Lock for mutation of the table and the
+                               bindings of modules. */
+    ScmAtomicVar gen;       /* Modification counter.  Odd while the
+                               tables are being modified.  See the note
+                               above. */
 } modules;
 
+/* Number of attempts of unlocked search before falling back to take
+   the lock. */
+#define MAX_UNLOCKED_SEARCH  3
+
+/* The mutators must call these, with modules.mutex held, around
+   modification of modules.table and the binding tables. */
+static inline void modules_write_begin(void)
+{
+    AO_store_full(&modules.gen, AO_load(&modules.gen) + 1);
+    AO_nop_full();
+}
+
+static inline void modules_write_end(void)
+{
+    AO_nop_full();
+    AO_store_full(&modules.gen, AO_load(&modules.gen) + 1);
+}
+
+/* Returns TRUE if no modification has been made since modules.gen was
+   GEN. */
+static inline int modules_read_valid(ScmAtomicWord gen)
+{
+    AO_nop_read();
+    return !(gen & 1) && AO_load(&modules.gen) == gen;
+}
+
 /* Predefined modules - slots will be initialized by Scm__InitModule */
 #define DEFINE_STATIC_MODULE(cname) \
     static ScmModule cname;
@@ -182,9 +244,17 @@ static ScmObj make_module(ScmObj name, ScmHashTable *internal)
 /* Internal.  Lookup module with name N from the table. */
 static ScmModule *lookup_module(ScmSymbol *name)
 {
+    ScmObj v = SCM_UNBOUND;
+    for (int i=0; i<MAX_UNLOCKED_SEARCH; i++) {
+        ScmAtomicWord gen = AO_load_acquire(&modules.gen);
+        v = Scm__HashTableRefUnlocked(modules.table, SCM_OBJ(name),
+                                      SCM_UNBOUND);
+        if (modules_read_valid(gen)) goto found;
+    }
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
-    ScmObj v = Scm_HashTableRef(modules.table, SCM_OBJ(name), SCM_UNBOUND);
+    v = Scm_HashTableRef(modules.table, SCM_OBJ(name), SCM_UNBOUND);
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
+ found:
     if (SCM_UNBOUNDP(v)) return NULL;
     else return SCM_MODULE(v);
 }
@@ -192,7 +262,14 @@ static ScmModule *lookup_module(ScmSymbol *name)
 /* Internal.  Lookup module, and if there's none, create one. */
 static ScmModule *lookup_module_create(ScmSymbol *name, int *created)
 {
+    ScmModule *m = lookup_module(name);
+    if (m != NULL) {
+        *created = FALSE;
+        return m;
+    }
+
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    modules_write_begin();
     ScmDictEntry *e = Scm_HashCoreSearch(SCM_HASH_TABLE_CORE(modules.table),
                                          (intptr_t)name,
                                          SCM_DICT_CREATE);
@@ -202,6 +279,7 @@ static ScmModule *lookup_module_create(ScmSymbol *name, int *created)
     } else {
         *created = FALSE;
     }
+    modules_write_end();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
     return SCM_MODULE(e->value);
 }
@@ -306,7 +384,9 @@ static inline void module_add_visited(module_cache *c, ScmModule *m)
    we need recursive searching in case of phantom binding (see gloc.h
    about phantom bindings).  The flags stay_in_module and external_only
    corresponds to the flags passed to Scm_FindBinding.  The exclude_self
-   flag is only used in recursive search. */
+   flag is only used in recursive search.
+   This may be called without holding modules.mutex; see "Note on mutex
+   of module operation" above. */
 static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
                                int stay_in_module, int external_only,
                                int exclude_self)
@@ -317,7 +397,7 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
     /* First, search from the specified module.  In this phase, we just ignore
        phantom bindings, for we'll search imported bindings later anyway. */
     if (!exclude_self) {
-        ScmObj v = Scm_HashTableRef(
+        ScmObj v = Scm__HashTableRefUnlocked(
             external_only? module->external : module->internal,
             SCM_OBJ(symbol), SCM_FALSE);
         if (SCM_GLOCP(v)) {
@@ -359,7 +439,8 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
                 prefixed = TRUE;
             }
 
-            ScmObj v = Scm_HashTableRef(m->external, SCM_OBJ(sym), SCM_FALSE);
+            ScmObj v = Scm__HashTableRefUnlocked(m->external, SCM_OBJ(sym),
+                                                 SCM_FALSE);
             if (SCM_GLOCP(v)) {
                 g = SCM_GLOC(v);
                 if (g->hidden) break;
@@ -385,8 +466,9 @@ static ScmGloc *search_binding(ScmModule *module, ScmSymbol *symbol,
             if (!SCM_SYMBOLP(sym)) return NULL;
             symbol = SCM_SYMBOL(sym);
         }
-        ScmObj v = Scm_HashTableRef(external_only?m->external:m->internal,
-                                    SCM_OBJ(symbol), SCM_FALSE);
+        ScmObj v = Scm__HashTableRefUnlocked(external_only
+                                             ? m->external : m->internal,
+                                             SCM_OBJ(symbol), SCM_FALSE);
 
         if (SCM_GLOCP(v)) {
             if (SCM_GLOC_PHANTOM_BINDING_P(SCM_GLOC(v))) {
@@ -407,6 +489,13 @@ ScmGloc *Scm_FindBinding(ScmModule *module, ScmSymbol *symbol, int flags)
     int external_only = flags&SCM_BINDING_EXTERNAL;
     ScmGloc *gloc = NULL;
 
+    for (int i=0; i<MAX_UNLOCKED_SEARCH; i++) {
+        ScmAtomicWord gen = AO_load_acquire(&modules.gen);
+        gloc = search_binding(module, symbol, stay_in_module, external_only,
+                              FALSE);
+        if (modules_read_valid(gen)) return gloc;
+    }
+
     SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
     gloc = search_binding(module, symbol, stay_in_module, external_only, FALSE);
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
@@ -455,11 +544,13 @@ ScmGloc *Scm_MakeBinding(ScmModule *module, ScmSymbol *symbol,
         oldval = g->value;
     } else {
         g = SCM_GLOC(Scm_MakeGloc(symbol, module));
+        modules_write_begin();
         Scm_HashTableSet(module->internal, SCM_OBJ(symbol), SCM_OBJ(g), 0);
         /* If module is marked 'export-all', export this binding by default */
         if (module->exportAll && SCM_SYMBOL_INTERNED(symbol)) {
             Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
         }
+        modules_write_end();
     }
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
 
@@ -514,7 +605,9 @@ void Scm_HideBinding(ScmModule *module, ScmSymbol *symbol)
     } else {
         ScmGloc *g = SCM_GLOC(Scm_MakeGloc(symbol, module));
         g->hidden = TRUE;
+        modules_write_begin();
         Scm_HashTableSet(module->external, SCM_OBJ(symbol), SCM_OBJ(g), 0);
+        modules_write_end();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
@@ -556,8 +649,10 @@ int Scm_AliasBinding(ScmModule *target, ScmSymbol *targetName,
     ScmGloc *g = Scm_FindBinding(origin, originName, SCM_BINDING_EXTERNAL);
     if (g == NULL) return FALSE;
     SCM_INTERNAL_MUTEX_SAFE_LOCK_BEGIN(modules.mutex);
+    modules_write_begin();
     Scm_HashTableSet(target->external, SCM_OBJ(targetName), SCM_OBJ(g), 0);
     Scm_HashTableSet(target->internal, SCM_OBJ(targetName), SCM_OBJ(g), 0);
+    modules_write_end();
     SCM_INTERNAL_MUTEX_SAFE_LOCK_END();
     return TRUE;
 }
@@ -592,6 +687,7 @@ ScmObj Scm_ImportModule(ScmModule *module,
 
     /* Prepend imported module to module->imported list. */
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    modules_write_begin();
     {
         ScmObj ms, prev = p;
         SCM_SET_CDR_UNCHECKED(p, module->imported);
@@ -612,6 +708,7 @@ ScmObj Scm_ImportModule(ScmModule *module,
         }
         module->imported = p;
     }
+    modules_write_end();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
     return module->imported;
@@ -651,6 +748,7 @@ ScmObj Scm_ExportSymbols(ScmModule *module, ScmObj specs)
     }
 
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
+    modules_write_begin();
     SCM_FOR_EACH(lp, specs) {
         ScmObj spec = SCM_CAR(lp);
         ScmSymbol *name, *exported_name;
@@ -695,6 +793,7 @@ ScmObj Scm_ExportSymbols(ScmModule *module, ScmObj specs)
                              SCM_DICT_VALUE(e), 0);
         }
     }
+    modules_write_end();
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
 
     /* Now, if this export changes the meaning of exported symbols, we
@@ -718,6 +817,7 @@ ScmObj Scm_ExportAll(ScmModule *module)
 {
     (void)SCM_INTERNAL_MUTEX_LOCK(modules.mutex);
     if (!module->exportAll) {
+        modules_write_begin();
         /* Mark the module 'export-all' so that the new bindings would get
            exported mark by default. */
         module->exportAll = TRUE;
@@ -734,6 +834,7 @@ ScmObj Scm_ExportAll(ScmModule *module)
                 (void)SCM_DICT_SET_VALUE(ee, SCM_DICT_VALUE(e));
             }
         }
+        modules_write_end();
     }
     (void)SCM_INTERNAL_MUTEX_UNLOCK(modules.mutex);
     return SCM_OBJ(module);
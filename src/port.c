@@ -1236,6 +1236,201 @@ ScmObj Scm_MakePortWithFd(ScmObj name, int direction,
     return p;
 }
 
+/*===============================================================
+ * Direct copy between file ports
+ */
+
+static ScmSize copy_direct(ScmPort *src, ScmPort *dst, ScmSize size,
+                           int *donep)
+{
+    /* Peeked bytes are kept outside of the buffer; we leave such cases
+       to the ordinary path. */
+    if (src->ungotten != SCM_CHAR_INVALID || src->scrcnt > 0) return 0;
+
+    /* Pass the data already read into SRC's buffer through DST, then
+       DST's buffer is flushed so that the fds are in sync with the ports. */
+    ScmSize n = src->src.buf.end - src->src.buf.current;
+    if (size >= 0 && n > size) n = size;
+    if (n > 0) {
+        Scm_Putz(src->src.buf.current, n, dst);
+        src->src.buf.current += n;
+        src->bytes += n;
+    }
+    if (n == size) {
+        *donep = TRUE;
+        return n;
+    }
+    Scm_Flush(dst);
+
+    int stopped = FALSE;
+    ScmSize r = Scm_SysTransferFd(FILE_PORT_DATA(dst)->fd,
+                                  FILE_PORT_DATA(src)->fd, NULL,
+                                  (size < 0) ? -1 : size - n, &stopped);
+    src->bytes += r;
+    *donep = !stopped;
+    return n + r;
+}
+
+/* Copies up to SIZE bytes (until EOF if SIZE is negative) from SRC to DST
+   within the kernel (see Scm_SysTransferFd), if both ports are directly
+   connected to file descriptors, e.g. file ports and socket ports.
+   The result is the same as copying through the port buffers.
+   Returns the number of bytes copied.  *DONEP is set to TRUE if the copy
+   is finished, i.e. SIZE bytes are copied or SRC reaches EOF.  Otherwise
+   the caller should copy the rest in the ordinary way; it is the case
+   when the ports aren't eligible (nothing is copied then), or the kernel
+   can't transfer between their fds. */
+ScmSize Scm_CopyPortDirect(ScmPort *src, ScmPort *dst, ScmSize size,
+                           int *donep)
+{
+    ScmSize n = 0;
+    *donep = FALSE;
+
+    if (SCM_PORT_TYPE(src) != SCM_PORT_FILE || !file_buffered_port_p(src)
+        || SCM_PORT_DIR(src) != SCM_PORT_INPUT || SCM_PORT_CLOSED_P(src))
+        return 0;
+    if (SCM_PORT_TYPE(dst) != SCM_PORT_FILE || !file_buffered_port_p(dst)
+        || SCM_PORT_DIR(dst) != SCM_PORT_OUTPUT || SCM_PORT_CLOSED_P(dst))
+        return 0;
+
+    ScmVM *vm = Scm_VM();
+    PORT_LOCK(src, vm);
+    PORT_LOCK(dst, vm);
+    SCM_UNWIND_PROTECT {
+        n = copy_direct(src, dst, size, donep);
+    } SCM_WHEN_ERROR {
+        PORT_UNLOCK(dst);
+        PORT_UNLOCK(src);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    PORT_UNLOCK(dst);
+    PORT_UNLOCK(src);
+    return n;
+}
+
+/*===============================================================
+ * Memory-mapped file port
+ *
+ *   An input buffered port whose buffer is the mapped file itself.
+ *   The whole file is in the buffer from the beginning, so reading
+ *   never calls the filler or copies the data to an intermediate
+ *   buffer.  The filler is only called after seeking (the buffer is
+ *   invalidated then), and it moves the buffer window over the mapping
+ *   instead of filling it.  It relies on the fact that bufport_fill
+ *   calls the filler only when the buffer is empty, so the read-only
+ *   mapping is never written.
+ */
+
+typedef struct mmap_port_data_rec {
+    ScmMappedRegion *region;
+    off_t pos;                  /* file position corresponding to the end
+                                   of the buffer */
+} mmap_port_data;
+
+#define MMAP_PORT_DATA(p)  ((mmap_port_data*)(p)->src.buf.data)
+
+static ScmSize mmap_filler(ScmPort *p, ScmSize cnt SCM_UNUSED)
+{
+    mmap_port_data *data = MMAP_PORT_DATA(p);
+    ScmSize rest = data->region->size - (ScmSize)data->pos;
+    if (rest <= 0) return 0;
+    p->src.buf.buffer = data->region->addr + data->pos;
+    p->src.buf.current = p->src.buf.end = p->src.buf.buffer;
+    p->src.buf.size = rest;
+    data->pos += rest;
+    return rest;
+}
+
+static off_t mmap_seeker(ScmPort *p, off_t offset, int whence)
+{
+    mmap_port_data *data = MMAP_PORT_DATA(p);
+    off_t pos;
+    switch (whence) {
+    case SEEK_SET: pos = offset; break;
+    case SEEK_CUR: pos = data->pos + offset; break;
+    case SEEK_END: pos = (off_t)data->region->size + offset; break;
+    default: errno = EINVAL; return (off_t)-1;
+    }
+    if (pos < 0) {
+        errno = EINVAL;
+        return (off_t)-1;
+    }
+    data->pos = pos;
+    return pos;
+}
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+/* Maps the whole file FD, and closes FD even if an error is signalled. */
+static ScmMappedRegion *map_mapped_port_region(int fd)
+{
+    ScmMappedRegion *region = NULL;
+    SCM_UNWIND_PROTECT {
+        region = Scm_MapFdRegion(fd, 0, -1);
+    } SCM_WHEN_ERROR {
+        close(fd);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    close(fd);
+    return region;
+}
+#endif /*HAVE_SYS_MMAN_H && HAVE_MMAP*/
+
+/* Opens PATH as a memory-mapped input port.  Returns #f if the file
+   can't be opened, like Scm_OpenFilePort.  FLAGS are the flags of open(2),
+   and must be for reading.  If PATH isn't a regular file, or on platforms
+   without mmap, an ordinary file port with BUFFERING is returned. */
+ScmObj Scm_OpenMappedFilePort(const char *path, int flags, int buffering)
+{
+    if ((flags & O_ACCMODE) != O_RDONLY) {
+        Scm_Error("mapped file port must be opened for reading: %s", path);
+    }
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+    int fd, r;
+    struct stat st;
+    SCM_SYSCALL(fd, open(path, flags));
+    if (fd < 0) return SCM_FALSE;
+    SCM_SYSCALL(r, fstat(fd, &st));
+    if (r < 0 || !S_ISREG(st.st_mode)) {
+        return Scm_MakePortWithFd(SCM_MAKE_STR_COPYING(path), SCM_PORT_INPUT,
+                                  fd, buffering, TRUE);
+    }
+    /* We map the file we've checked, not whatever PATH names now. */
+    ScmMappedRegion *region = map_mapped_port_region(fd);
+
+    mmap_port_data *data = SCM_NEW(mmap_port_data);
+    data->region = region;
+    data->pos = (off_t)region->size;
+
+    ScmPortBuffer bufrec;
+    bufrec.mode = SCM_PORT_BUFFER_FULL;
+    /* Empty file isn't mapped, so we need a dummy buffer. */
+    bufrec.buffer = region->size > 0 ? region->addr : SCM_NEW_ATOMIC2(char*, 1);
+    bufrec.size = region->size > 0 ? region->size : 1;
+    bufrec.filler = mmap_filler;
+    bufrec.flusher = NULL;
+    bufrec.closer = NULL;       /* the mapping is released by GC */
+    bufrec.ready = NULL;
+    bufrec.filenum = NULL;
+    bufrec.seeker = mmap_seeker;
+    bufrec.data = data;
+    ScmObj p = Scm_MakeBufferedPort(SCM_CLASS_PORT, SCM_MAKE_STR_COPYING(path),
+                                    SCM_PORT_INPUT, TRUE, &bufrec);
+    SCM_PORT(p)->src.buf.end = SCM_PORT(p)->src.buf.buffer + region->size;
+    return p;
+#else  /*!(HAVE_SYS_MMAN_H && HAVE_MMAP)*/
+    return Scm_OpenFilePort(path, flags, buffering, 0);
+#endif /*!(HAVE_SYS_MMAN_H && HAVE_MMAP)*/
+}
+
+/* Returns the mapped region of a memory-mapped file port, or NULL
+   if PORT isn't one. */
+ScmMappedRegion *Scm_PortMappedRegion(ScmPort *port)
+{
+    if (SCM_PORT_TYPE(port) != SCM_PORT_FILE) return NULL;
+    if (port->src.buf.filler != mmap_filler) return NULL;
+    return MMAP_PORT_DATA(port)->region;
+}
+
 /*===============================================================
  * String port
  */
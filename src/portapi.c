@@ -874,6 +874,82 @@ ScmObj Scm_ReadLineUnsafe(ScmPort *p)
     return r;
 }
 
+/*=================================================================
+ * ScanBytes
+ *   Feeds the input bytes to SCANNER until it says done or we reach
+ *   EOF.  Returns TRUE in the former case, FALSE in the latter.
+ *   The buffer of a file port or the string of an input string port
+ *   is handed to SCANNER as is, so that it can process a bulk of bytes
+ *   at once without consuming bytes it doesn't need.
+ */
+
+#ifndef SCANBYTES_AUX
+#define SCANBYTES_AUX
+static ScmSize count_newlines(const char *s, const char *e)
+{
+    ScmSize n = 0;
+    while ((s = memchr(s, '\n', e - s)) != NULL) {
+        n++;
+        s++;
+    }
+    return n;
+}
+
+/* Assumes the port is locked, and the caller takes care of unlocking
+   even if an error is signalled within this body */
+static int scanbytes_body(ScmPort *p, ScmPortByteScanner scanner, void *data)
+{
+    int done = FALSE;
+
+    while (!done) {
+        const char *s = NULL, *e = NULL;
+        if (p->scrcnt == 0 && p->ungotten == SCM_CHAR_INVALID) {
+            if (SCM_PORT_TYPE(p) == SCM_PORT_FILE) {
+                s = p->src.buf.current;
+                e = p->src.buf.end;
+            } else if (SCM_PORT_TYPE(p) == SCM_PORT_ISTR) {
+                s = p->src.istr.current;
+                e = p->src.istr.end;
+            }
+        }
+        if (s < e) {
+            ScmSize n = scanner(s, e, &done, data);
+            p->line += count_newlines(s, s + n);
+            p->bytes += n;
+            if (SCM_PORT_TYPE(p) == SCM_PORT_FILE) p->src.buf.current += n;
+            else p->src.istr.current += n;
+        } else {
+            /* Pending bytes, a procedural port, or the buffer is empty.
+               Scm_GetbUnsafe fills the buffer as needed.  A newline
+               in the ungotten char has been counted by Scm_Getc. */
+            int counted = (p->ungotten != SCM_CHAR_INVALID);
+            int b = Scm_GetbUnsafe(p);
+            if (b == EOF) return FALSE;
+            char c = (char)b;
+            scanner(&c, &c + 1, &done, data);
+            if (c == '\n' && !counted) p->line++;
+        }
+    }
+    return TRUE;
+}
+#endif /* SCANBYTES_AUX */
+
+#ifdef SAFE_PORT_OP
+int Scm_ScanBytes(ScmPort *p, ScmPortByteScanner scanner, void *data)
+#else
+int Scm_ScanBytesUnsafe(ScmPort *p, ScmPortByteScanner scanner, void *data)
+#endif
+{
+    int r = FALSE;
+    VMDECL;
+    SHORTCUT(p, return Scm_ScanBytesUnsafe(p, scanner, data));
+
+    LOCK(p);
+    SAFE_CALL(p, r = scanbytes_body(p, scanner, data));
+    UNLOCK(p);
+    return r;
+}
+
 /*=================================================================
  * ByteReady
  */
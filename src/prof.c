@@ -37,6 +37,14 @@
 #include "gauche/code.h"
 #include "gauche/vminsn.h"
 #include "gauche/prof.h"
+#include "gauche/priv/atomicP.h"
+
+#if defined(GAUCHE_PROF_THREAD_TIMER)
+#include <sys/syscall.h>
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif /* GAUCHE_PROF_THREAD_TIMER */
 
 #ifdef GAUCHE_PROFILE
 
@@ -86,10 +94,8 @@ static unsigned __stdcall observer_thread(void *arg)
     return 0;
 }
 
-static void ITIMER_START(void)
+static void ITIMER_START(ScmVM *vm)
 {
-    ScmVM *vm = Scm_VM();
-
     vm->prof->hTimerEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
     if (vm->prof->hTimerEvent == NULL) {
         Scm_SysError("CreateEvent failed");
@@ -113,10 +119,8 @@ static void ITIMER_START(void)
     }
 }
 
-static void ITIMER_STOP(void)
+static void ITIMER_STOP(ScmVM *vm)
 {
-    ScmVM *vm = Scm_VM();
-
     if (vm->prof->hTimerEvent != NULL && vm->prof->hObserverThread !=NULL) {
         SetEvent(vm->prof->hTimerEvent);
         WaitForSingleObject(vm->prof->hObserverThread, INFINITE);
@@ -131,9 +135,46 @@ static void ITIMER_STOP(void)
     }
 }
 
-#else  /* !GAUCHE_WINDOWS */
+#elif defined(GAUCHE_PROF_THREAD_TIMER)
+
+/* The timer measures CPU time consumed by the calling thread, and
+   the signal is delivered to that thread.  So each thread can run
+   its own profiler. */
+static void ITIMER_START(ScmVM *vm)
+{
+    if (!vm->prof->timerCreated) {
+        struct sigevent sev;
+        memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = SIGPROF;
+        sev.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+        if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev,
+                         &vm->prof->timer) < 0) {
+            Scm_SysError("timer_create failed");
+        }
+        vm->prof->timerCreated = TRUE;
+    }
+    struct itimerspec tval;
+    tval.it_interval.tv_sec = 0;
+    tval.it_interval.tv_nsec = SAMPLING_PERIOD * 1000;
+    tval.it_value = tval.it_interval;
+    timer_settime(vm->prof->timer, 0, &tval, NULL);
+}
+
+static void ITIMER_STOP(ScmVM *vm)
+{
+    if (vm->prof->timerCreated) {
+        /* The timer is tied to the thread, so we delete it here; the
+           next Scm_ProfilerStart may be called from a different thread
+           when the profiler data is passed around. */
+        timer_delete(vm->prof->timer);
+        vm->prof->timerCreated = FALSE;
+    }
+}
+
+#else  /* !GAUCHE_WINDOWS && !GAUCHE_PROF_THREAD_TIMER */
 
-#define ITIMER_START()                                  \
+#define ITIMER_START(vm)                                \
     do {                                                \
         struct itimerval tval, oval;                    \
         tval.it_interval.tv_sec = 0;                    \
@@ -143,7 +184,7 @@ static void ITIMER_STOP(void)
         setitimer(ITIMER_PROF, &tval, &oval);           \
     } while (0)
 
-#define ITIMER_STOP()                           \
+#define ITIMER_STOP(vm)                         \
     do {                                        \
         struct itimerval tval, oval;            \
         tval.it_interval.tv_sec = 0;            \
@@ -153,32 +194,54 @@ static void ITIMER_STOP(void)
         setitimer(ITIMER_PROF, &tval, &oval);   \
     } while (0)
 
-#endif /* !GAUCHE_WINDOWS */
+#endif /* !GAUCHE_WINDOWS && !GAUCHE_PROF_THREAD_TIMER */
 
 /*=============================================================
  * Statistic sampler
  */
 
-/* Flush sample buffer to the file.
-   We save the address value to the file.  The address should also be
-   recorded in the call counter, thus we don't need to worry about
-   the addressed object being GCed. */
-
-#define CHK(exp)  do { if (!(exp)) goto bad; } while (0)
-
-static void sampler_flush(ScmVM *vm)
+/* Single-producer, single-consumer ring buffer.  The producer is
+   the signal handler (or the observer thread on Windows) and the
+   consumer is the profiled thread itself.  The producer only writes
+   the region beyond HEAD and advances HEAD after writing the whole
+   sample; the consumer only reads the region between TAIL and HEAD.
+   So neither needs a lock, which we can't use in a signal handler anyway.
+   The indices increase monotonically; we mask them to get the position. */
+struct ScmProfRingRec {
+    ScmAtomicVar head;          /* written by the producer */
+    ScmAtomicVar tail;          /* written by the consumer */
+    ScmWord buf[SCM_PROF_RING_SIZE];
+};
+
+#define RING_REF(ring, i)  ((ring)->buf[(i)&(SCM_PROF_RING_SIZE-1)])
+
+/* Store the current code and the code of each continuation frame
+   to FRAMES, innermost first.  Returns the number of frames.
+   This is called from the signal handler, so it must not allocate. */
+static int capture_stack(ScmVM *vm, ScmObj *frames)
 {
-    if (vm->prof == NULL) return; /* for safety */
-    if (vm->prof->samplerFd < 0 || vm->prof->currentSample == 0) return;
+    int n = 0;
 
-    int nsamples = vm->prof->currentSample;
-    ssize_t r = write(vm->prof->samplerFd, vm->prof->samples,
-                      nsamples * sizeof(ScmProfSample[1]));
-    if (r == (ssize_t)-1) {
-        vm->prof->errorOccurred++;
+    if (vm->base) {
+        /* If vm->pc is RET and val0 is a subr, it is pretty likely that
+           we're actually executing that subr. */
+        if (vm->pc && SCM_VM_INSN_CODE(*vm->pc) == SCM_VM_RET
+            && SCM_SUBRP(vm->val0)) {
+            frames[n++] = vm->val0;
+        } else {
+            frames[n++] = SCM_OBJ(vm->base);
+        }
+    } else {
+        frames[n++] = SCM_FALSE;
+    }
+    /* Each continuation frame keeps the code to return to.  Note that
+       the frames may be being moved to the heap (save_cont) when we're
+       interrupted, but the links are always valid in that case. */
+    for (ScmContFrame *c = vm->cont; c && n < SCM_PROF_MAX_DEPTH;
+         c = c->prev) {
+        if (c->base) frames[n++] = SCM_OBJ(c->base);
     }
-    vm->prof->currentSample = 0;
-    return;
+    return n;
 }
 
 /* signal handler */
@@ -194,50 +257,225 @@ static void sampler_sample(int sig SCM_UNUSED)
     if (vm == NULL || vm->prof == NULL) return;
     if (vm->prof->state != SCM_PROFILER_RUNNING) return;
 
-    if (vm->prof->currentSample >= SCM_PROF_SAMPLES_IN_BUFFER) {
-#if !defined(GAUCHE_WINDOWS)
-        ITIMER_STOP();
-#endif /* !GAUCHE_WINDOWS */
-        sampler_flush(vm);
-#if !defined(GAUCHE_WINDOWS)
-        ITIMER_START();
-#endif /* !GAUCHE_WINDOWS */
+    ScmObj frames[SCM_PROF_MAX_DEPTH];
+    int n = capture_stack(vm, frames);
+
+    ScmProfRing *ring = vm->prof->ring;
+    u_long head = (u_long)AO_load(&ring->head);
+    u_long tail = (u_long)AO_load(&ring->tail);
+    vm->prof->totalSamples++;
+    if (SCM_PROF_RING_SIZE - (head - tail) < (u_long)n + 1) {
+        vm->prof->droppedSamples++;
+        return;
     }
+    RING_REF(ring, head) = (ScmWord)n;
+    for (int i=0; i<n; i++) RING_REF(ring, head+1+i) = SCM_WORD(frames[i]);
+    AO_store_full(&ring->head, (ScmAtomicWord)(head + n + 1));
+}
 
-    int i = vm->prof->currentSample++;
-    if (vm->base) {
-        /* If vm->pc is RET and val0 is a subr, it is pretty likely that
-           we're actually executing that subr. */
-        if (vm->pc && SCM_VM_INSN_CODE(*vm->pc) == SCM_VM_RET
-            && SCM_SUBRP(vm->val0)) {
-            vm->prof->samples[i].func = vm->val0;
-            vm->prof->samples[i].pc = NULL;
-        } else {
-            vm->prof->samples[i].func = SCM_OBJ(vm->base);
-            vm->prof->samples[i].pc = vm->pc;
+/* Hash table for stack samples.  Keys are vectors of frames;
+   we compare elements by eq?. */
+static u_long stack_hash(const ScmHashCore *hc SCM_UNUSED, intptr_t key)
+{
+    ScmVector *v = SCM_VECTOR(key);
+    u_long h = 0;
+    for (ScmSmallInt i=0; i<SCM_VECTOR_SIZE(v); i++) {
+        h = Scm_CombineHashValue(h, Scm_EqHash(SCM_VECTOR_ELEMENT(v, i)));
+    }
+    return h;
+}
+
+static int stack_compare(const ScmHashCore *hc SCM_UNUSED, intptr_t key,
+                         intptr_t entrykey)
+{
+    ScmVector *x = SCM_VECTOR(key), *y = SCM_VECTOR(entrykey);
+    if (SCM_VECTOR_SIZE(x) != SCM_VECTOR_SIZE(y)) return FALSE;
+    for (ScmSmallInt i=0; i<SCM_VECTOR_SIZE(x); i++) {
+        if (!SCM_EQ(SCM_VECTOR_ELEMENT(x, i), SCM_VECTOR_ELEMENT(y, i))) {
+            return FALSE;
         }
-    } else {
-        vm->prof->samples[i].func = SCM_FALSE;
-        vm->prof->samples[i].pc = NULL;
     }
-    vm->prof->totalSamples++;
+    return TRUE;
 }
 
-/* register samples into the stat table.  Called from Scm_ProfilerResult */
-void collect_samples(ScmVMProfiler *prof)
+/* Move samples from the ring buffer to statHash and stackHash.
+   Called in the profiled thread.  The signal handler may add samples
+   while we're working. */
+static void sampler_drain(ScmVMProfiler *prof)
 {
-    for (int i=0; i<prof->currentSample; i++) {
-        ScmObj e = Scm_HashTableRef(prof->statHash,
-                                    prof->samples[i].func, SCM_UNBOUND);
+    ScmProfRing *ring = prof->ring;
+    u_long head = (u_long)AO_load(&ring->head);
+    u_long tail = (u_long)AO_load(&ring->tail);
+
+    while (tail != head) {
+        int n = (int)RING_REF(ring, tail);
+        ScmObj v = Scm_MakeVector(n, SCM_FALSE);
+        for (int i=0; i<n; i++) {
+            /* outermost first */
+            SCM_VECTOR_ELEMENT(v, n-i-1) = SCM_OBJ(RING_REF(ring, tail+1+i));
+        }
+        tail += n + 1;
+        AO_store(&ring->tail, (ScmAtomicWord)tail);
+
+        /* The innermost frame gets the hit in the flat profile.  It may
+           not have been called since the profiler started, so we may
+           need to create an entry. */
+        ScmObj leaf = SCM_VECTOR_ELEMENT(v, n-1);
+        ScmObj e = Scm_HashTableRef(prof->statHash, leaf, SCM_UNBOUND);
         if (SCM_UNBOUNDP(e)) {
-            /* NB: just for now */
-            Scm_Warn("profiler: uncounted object appeared in a sample: %p (%S)",
-                     prof->samples[i].func, prof->samples[i].func);
+            e = Scm_Cons(SCM_MAKE_INT(0), SCM_MAKE_INT(0));
+            Scm_HashTableSet(prof->statHash, leaf, e, 0);
+        }
+        SCM_ASSERT(SCM_PAIRP(e));
+        SCM_SET_CDR_UNCHECKED(e, Scm_Add(SCM_CDR(e), SCM_MAKE_INT(1)));
+
+        ScmDictEntry *se = Scm_HashCoreSearch(&prof->stackHash, (intptr_t)v,
+                                              SCM_DICT_CREATE);
+        if (se->value) {
+            (void)SCM_DICT_SET_VALUE(se, Scm_Add(SCM_DICT_VALUE(se),
+                                                 SCM_MAKE_INT(1)));
+        } else {
+            (void)SCM_DICT_SET_VALUE(se, SCM_MAKE_INT(1));
+        }
+    }
+}
+
+static void sampler_init(ScmVMProfiler *prof)
+{
+    prof->ring = SCM_NEW(ScmProfRing);
+    prof->ring->head = 0;
+    prof->ring->tail = 0;
+    Scm_HashCoreInitGeneral(&prof->stackHash, stack_hash, stack_compare,
+                            0, NULL);
+}
+
+/*=============================================================
+ * Allocation profiler
+ */
+
+/* We keep samples that may still be alive in a list.  OBJ is cleared
+   by GC when the sampled object is collected; such records are pruned
+   from time to time. */
+struct ScmProfAllocRecordRec {
+    ScmProfAllocRecord *next;
+    ScmObj key;                 /* the key of allocHash */
+    size_t bytes;               /* bytes this sample represents */
+    ScmWeakBox *obj;            /* sampled object */
+};
+
+/* Number of threads running the allocation profiler.
+   Scm__AllocProfilerActive (core.c) is TRUE iff it is positive. */
+static struct {
+    int count;
+    ScmInternalMutex mutex;
+} alloc_profilers = { 0, SCM_INTERNAL_MUTEX_INITIALIZER };
+
+static void alloc_profilers_inc(int delta)
+{
+    SCM_INTERNAL_MUTEX_LOCK(alloc_profilers.mutex);
+    alloc_profilers.count += delta;
+    Scm__AllocProfilerActive = (alloc_profilers.count > 0);
+    SCM_INTERNAL_MUTEX_UNLOCK(alloc_profilers.mutex);
+}
+
+static void alloc_init(ScmVMProfiler *prof)
+{
+    Scm_HashCoreInitGeneral(&prof->allocHash, stack_hash, stack_compare,
+                            0, NULL);
+    Scm_HashCoreInitSimple(&prof->allocTypes, SCM_HASH_WORD, 0, NULL);
+    prof->allocBytes = 0;
+    prof->allocSamples = 0;
+    prof->allocLive = NULL;
+    prof->allocNumLive = 0;
+    prof->allocPruneAt = 1024;
+}
+
+/* Remove records whose objects have been collected. */
+static void alloc_prune(ScmVMProfiler *prof)
+{
+    ScmProfAllocRecord **pr = &prof->allocLive;
+    while (*pr) {
+        if (Scm_WeakBoxEmptyP((*pr)->obj)) {
+            *pr = (*pr)->next;
+            prof->allocNumLive--;
         } else {
-            SCM_ASSERT(SCM_PAIRP(e));
-            SCM_SET_CDR_UNCHECKED(e, Scm_Add(SCM_CDR(e), SCM_MAKE_INT(1)));
+            pr = &(*pr)->next;
         }
     }
+    prof->allocPruneAt = prof->allocNumLive*2;
+    if (prof->allocPruneAt < 1024) prof->allocPruneAt = 1024;
+}
+
+/* Returns Scheme string for C type name.  We can't keep const char*
+   in the hash key, so we map it to the same string object every time. */
+static ScmObj alloc_type_name(ScmVMProfiler *prof, const char *type)
+{
+    if (type == NULL) type = "?";
+    ScmDictEntry *e = Scm_HashCoreSearch(&prof->allocTypes, (intptr_t)type,
+                                         SCM_DICT_CREATE);
+    if (!e->value) {
+        (void)SCM_DICT_SET_VALUE(e, SCM_MAKE_STR_COPYING(type));
+    }
+    return SCM_DICT_VALUE(e);
+}
+
+static void alloc_sample(ScmVM *vm, void *obj, size_t bytes,
+                         const char *type)
+{
+    ScmVMProfiler *prof = vm->prof;
+    ScmObj frames[SCM_PROF_MAX_DEPTH];
+    int n = capture_stack(vm, frames);
+
+    ScmObj key = Scm_MakeVector(n+1, SCM_FALSE);
+    for (int i=0; i<n; i++) {
+        /* outermost first */
+        SCM_VECTOR_ELEMENT(key, n-i-1) = frames[i];
+    }
+    SCM_VECTOR_ELEMENT(key, n) = alloc_type_name(prof, type);
+
+    ScmDictEntry *e = Scm_HashCoreSearch(&prof->allocHash, (intptr_t)key,
+                                         SCM_DICT_CREATE);
+    if (!e->value) {
+        (void)SCM_DICT_SET_VALUE(e, Scm_Cons(SCM_MAKE_INT(0),
+                                             SCM_MAKE_INT(0)));
+    }
+    ScmObj p = SCM_DICT_VALUE(e);
+    SCM_SET_CAR_UNCHECKED(p, Scm_Add(SCM_CAR(p), SCM_MAKE_INT(1)));
+    SCM_SET_CDR_UNCHECKED(p, Scm_Add(SCM_CDR(p), Scm_MakeIntegerU(bytes)));
+
+    ScmProfAllocRecord *r = SCM_NEW(ScmProfAllocRecord);
+    r->key = SCM_OBJ(SCM_DICT_KEY(e));
+    r->bytes = bytes;
+    r->obj = Scm_MakeWeakBox(obj);
+    r->next = prof->allocLive;
+    prof->allocLive = r;
+    if (++prof->allocNumLive >= prof->allocPruneAt) alloc_prune(prof);
+}
+
+/* Called for every allocation via SCM_MALLOC while
+   Scm__AllocProfilerActive is set, which may be by any thread. */
+void Scm_ProfilerCountAlloc(void *obj, size_t size, const char *type)
+{
+    ScmVM *vm = Scm_VM();
+    if (vm == NULL || vm->prof == NULL) return;
+    ScmVMProfiler *prof = vm->prof;
+    if (prof->allocState != SCM_PROFILER_RUNNING) return;
+    /* Allocations while taking a sample aren't counted. */
+    if (prof->allocSampling) return;
+
+    /* The sample represents all the bytes allocated since the last one.
+       The chance of being sampled is proportional to the size, so
+       the estimation is unbiased as far as each allocation is smaller
+       than the interval. */
+    prof->allocBytes += size;
+    if (prof->allocBytes < prof->allocInterval) return;
+    size_t bytes = prof->allocBytes;
+    prof->allocBytes = 0;
+    prof->allocSamples++;
+
+    prof->allocSampling = TRUE;
+    alloc_sample(vm, obj, bytes, type);
+    prof->allocSampling = FALSE;
 }
 
 /*=============================================================
@@ -245,12 +483,12 @@ void collect_samples(ScmVMProfiler *prof)
  */
 
 /* Inserting data into array is done in a macro (prof.h).  It calls
-   this flush routine when the array gets full. */
+   this flush routine when the array gets full.  We also drain the
+   sample buffer here, since it is a safe place to allocate. */
 
 void Scm_ProfilerCountBufferFlush(ScmVM *vm)
 {
     if (vm->prof == NULL) return; /* for safety */
-    if (vm->prof->currentCount == 0) return;
 
     /* suspend itimer during hash table operation */
 #if !defined(GAUCHE_WINDOWS)
@@ -282,6 +520,8 @@ void Scm_ProfilerCountBufferFlush(ScmVM *vm)
     }
     vm->prof->currentCount = 0;
 
+    sampler_drain(vm->prof);
+
     /* resume itimer */
 #if !defined(GAUCHE_WINDOWS)
     SIGPROCMASK(SIG_UNBLOCK, &set, NULL);
@@ -291,45 +531,40 @@ void Scm_ProfilerCountBufferFlush(ScmVM *vm)
 /*=============================================================
  * External API
  */
+static void profiler_init(ScmVM *vm)
+{
+    if (vm->prof) return;
+    vm->prof = SCM_NEW(ScmVMProfiler);
+    vm->prof->state = SCM_PROFILER_INACTIVE;
+    vm->prof->totalSamples = 0;
+    vm->prof->droppedSamples = 0;
+    vm->prof->currentCount = 0;
+    vm->prof->statHash =
+        SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    sampler_init(vm->prof);
+    vm->prof->allocState = SCM_PROFILER_INACTIVE;
+    vm->prof->allocSampling = FALSE;
+    vm->prof->allocInterval = SCM_PROF_ALLOC_INTERVAL;
+    alloc_init(vm->prof);
+#if defined(GAUCHE_WINDOWS)
+    vm->prof->hTargetThread = NULL;
+    vm->prof->hObserverThread = NULL;
+    vm->prof->hTimerEvent = NULL;
+#elif defined(GAUCHE_PROF_THREAD_TIMER)
+    vm->prof->timerCreated = FALSE;
+#endif /* GAUCHE_PROF_THREAD_TIMER */
+}
+
 void Scm_ProfilerStart(void)
 {
     ScmVM *vm = Scm_VM();
-    ScmObj templat = Scm_StringAppendC(SCM_STRING(Scm_TmpDir()),
-                                       "/gauche-profXXXXXX", -1, -1);
-    char *templat_buf = Scm_GetString(SCM_STRING(templat)); /*mutable copy*/
-
-    if (!vm->prof) {
-        vm->prof = SCM_NEW(ScmVMProfiler);
-        vm->prof->state = SCM_PROFILER_INACTIVE;
-        vm->prof->samplerFd = Scm_Mkstemp(templat_buf);
-        vm->prof->currentSample = 0;
-        vm->prof->totalSamples = 0;
-        vm->prof->errorOccurred = 0;
-        vm->prof->currentCount = 0;
-        vm->prof->statHash =
-            SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
-#if defined(GAUCHE_WINDOWS)
-        vm->prof->hTargetThread = NULL;
-        vm->prof->hObserverThread = NULL;
-        vm->prof->hTimerEvent = NULL;
-        vm->prof->samplerFileName = templat_buf;
-#else  /* !GAUCHE_WINDOWS */
-        unlink(templat_buf);       /* keep anonymous tmpfile */
-#endif /* !GAUCHE_WINDOWS */
-    } else if (vm->prof->samplerFd < 0) {
-        vm->prof->samplerFd = Scm_Mkstemp(templat_buf);
-#if defined(GAUCHE_WINDOWS)
-        vm->prof->samplerFileName = templat_buf;
-#else  /* !GAUCHE_WINDOWS */
-        unlink(templat_buf);
-#endif /* !GAUCHE_WINDOWS */
-    }
+
+    profiler_init(vm);
 
     if (vm->prof->state == SCM_PROFILER_RUNNING) return;
     vm->prof->state = SCM_PROFILER_RUNNING;
     vm->profilerRunning = TRUE;
 
-    /* NB: this should be done globally!!! */
 #if defined(GAUCHE_WINDOWS)
     if (!DuplicateHandle(GetCurrentProcess(),
                          GetCurrentThread(),
@@ -340,6 +575,8 @@ void Scm_ProfilerStart(void)
         Scm_SysError("DuplicateHandle failed");
     }
 #else  /* !GAUCHE_WINDOWS */
+    /* The handler is process-wide, but it only records samples
+       for the VM running in the signaled thread. */
     struct sigaction act;
     act.sa_handler = sampler_sample;
     sigfillset(&act.sa_mask);
@@ -349,7 +586,7 @@ void Scm_ProfilerStart(void)
     }
 #endif /* !GAUCHE_WINDOWS */
 
-    ITIMER_START();
+    ITIMER_START(vm);
 }
 
 int Scm_ProfilerStop(void)
@@ -357,7 +594,7 @@ int Scm_ProfilerStop(void)
     ScmVM *vm = Scm_VM();
     if (vm->prof == NULL) return 0;
     if (vm->prof->state != SCM_PROFILER_RUNNING) return 0;
-    ITIMER_STOP();
+    ITIMER_STOP(vm);
 #if defined(GAUCHE_WINDOWS)
     if (vm->prof->hTargetThread != NULL) {
         CloseHandle(vm->prof->hTargetThread);
@@ -377,68 +614,143 @@ void Scm_ProfilerReset(void)
     if (vm->prof->state == SCM_PROFILER_INACTIVE) return;
     if (vm->prof->state == SCM_PROFILER_RUNNING) Scm_ProfilerStop();
 
-    if (vm->prof->samplerFd >= 0) {
-        close(vm->prof->samplerFd);
-        vm->prof->samplerFd = -1;
-#if defined(GAUCHE_WINDOWS)
-        unlink(vm->prof->samplerFileName);
-#endif /* GAUCHE_WINDOWS */
-    }
     vm->prof->totalSamples = 0;
-    vm->prof->currentSample = 0;
-    vm->prof->errorOccurred = 0;
+    vm->prof->droppedSamples = 0;
     vm->prof->currentCount = 0;
     vm->prof->statHash =
         SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_EQ, 0));
+    sampler_init(vm->prof);
     vm->prof->state = SCM_PROFILER_INACTIVE;
 }
 
-/* Returns the statHash */
-ScmObj Scm_ProfilerRawResult(void)
+/* Stop the profiler and collect all the pending data. */
+static ScmVMProfiler *profiler_collect(void)
 {
     ScmVM *vm = Scm_VM();
 
-    if (vm->prof == NULL) return SCM_FALSE;
-    if (vm->prof->state == SCM_PROFILER_INACTIVE) return SCM_FALSE;
+    if (vm->prof == NULL) return NULL;
+    if (vm->prof->state == SCM_PROFILER_INACTIVE) return NULL;
     if (vm->prof->state == SCM_PROFILER_RUNNING) Scm_ProfilerStop();
 
-    if (vm->prof->errorOccurred > 0) {
-        Scm_Warn("profiler: An error has been occurred during saving profiling samples.  The result may not be accurate");
+    if (vm->prof->droppedSamples > 0) {
+        Scm_Warn("profiler: %d out of %d samples are lost because the sample buffer was full.  The result may not be accurate",
+                 vm->prof->droppedSamples, vm->prof->totalSamples);
+        vm->prof->droppedSamples = 0;
     }
 
     Scm_ProfilerCountBufferFlush(vm);
+    return vm->prof;
+}
 
-    /* collect samples in the current buffer */
-    collect_samples(vm->prof);
+/* Returns the statHash */
+ScmObj Scm_ProfilerRawResult(void)
+{
+    ScmVMProfiler *prof = profiler_collect();
+    if (prof == NULL) return SCM_FALSE;
+    return SCM_OBJ(prof->statHash);
+}
 
-    /* collect samples in the saved file */
-    off_t off;
-    SCM_SYSCALL(off, lseek(vm->prof->samplerFd, 0, SEEK_SET));
-    if (off == (off_t)-1) {
-        Scm_ProfilerReset();
-        Scm_Error("profiler: seek failed in retrieving sample data");
-    }
-    for (;;) {
-        ssize_t r = read(vm->prof->samplerFd, vm->prof->samples,
-                         sizeof(ScmProfSample[1]) * SCM_PROF_SAMPLES_IN_BUFFER);
-        if (r <= 0) break;
-        vm->prof->currentSample = r / sizeof(ScmProfSample[1]);
-        collect_samples(vm->prof);
+/* Returns a list of (<frames> . <sample-hits>), where <frames> is
+   a vector of ScmCompiledCode or ScmSubr, outermost first. */
+ScmObj Scm_ProfilerRawStacks(void)
+{
+    ScmVMProfiler *prof = profiler_collect();
+    if (prof == NULL) return SCM_FALSE;
+
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    Scm_HashIterInit(&iter, &prof->stackHash);
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        SCM_APPEND1(h, t, Scm_Cons(SCM_DICT_KEY(e), SCM_DICT_VALUE(e)));
     }
-    vm->prof->currentSample = 0;
-#if defined(GAUCHE_WINDOWS)
-    if (vm->prof->samplerFd >= 0) {
-        close(vm->prof->samplerFd);
-        vm->prof->samplerFd = -1;
-        unlink(vm->prof->samplerFileName);
+    return h;
+}
+
+/* Allocation profiler.  INTERVAL is the sampling interval in bytes;
+   0 to keep the current setting. */
+void Scm_AllocProfilerStart(ScmSmallInt interval)
+{
+    ScmVM *vm = Scm_VM();
+
+    if (interval < 0) {
+        Scm_Error("allocation profiler interval must be a nonnegative integer, but got %ld", interval);
     }
-#else  /* !GAUCHE_WINDOWS */
-    if (ftruncate(vm->prof->samplerFd, 0) < 0) {
-        Scm_SysError("profiler: failed to truncate temporary file");
+    profiler_init(vm);
+    if (interval > 0) vm->prof->allocInterval = (size_t)interval;
+
+    if (vm->prof->allocState == SCM_PROFILER_RUNNING) return;
+    vm->prof->allocState = SCM_PROFILER_RUNNING;
+    alloc_profilers_inc(1);
+}
+
+int Scm_AllocProfilerStop(void)
+{
+    ScmVM *vm = Scm_VM();
+    if (vm->prof == NULL) return 0;
+    if (vm->prof->allocState != SCM_PROFILER_RUNNING) return 0;
+    vm->prof->allocState = SCM_PROFILER_PAUSING;
+    alloc_profilers_inc(-1);
+    return vm->prof->allocSamples;
+}
+
+void Scm_AllocProfilerReset(void)
+{
+    ScmVM *vm = Scm_VM();
+
+    if (vm->prof == NULL) return;
+    if (vm->prof->allocState == SCM_PROFILER_INACTIVE) return;
+    if (vm->prof->allocState == SCM_PROFILER_RUNNING) Scm_AllocProfilerStop();
+    alloc_init(vm->prof);
+    vm->prof->allocState = SCM_PROFILER_INACTIVE;
+}
+
+/* Returns a list of (<key> <samples> . <bytes>), where <key> is a vector
+   of ScmCompiledCode or ScmSubr, outermost first, followed by the name
+   of the allocated C type.  If LIVEONLY is true, only the samples whose
+   objects are still alive are counted.  The caller should run GC before
+   calling this to get accurate live view. */
+ScmObj Scm_AllocProfilerRawResult(int liveOnly)
+{
+    ScmVM *vm = Scm_VM();
+
+    if (vm->prof == NULL) return SCM_FALSE;
+    if (vm->prof->allocState == SCM_PROFILER_INACTIVE) return SCM_FALSE;
+
+    ScmVMProfiler *prof = vm->prof;
+    ScmHashCore *hc = &prof->allocHash;
+    ScmHashCore live;
+    int saved = prof->allocSampling;
+    prof->allocSampling = TRUE; /* don't sample ourselves */
+    if (liveOnly) {
+        alloc_prune(prof);
+        Scm_HashCoreInitGeneral(&live, stack_hash, stack_compare, 0, NULL);
+        for (ScmProfAllocRecord *r = prof->allocLive; r; r = r->next) {
+            ScmDictEntry *e = Scm_HashCoreSearch(&live, (intptr_t)r->key,
+                                                 SCM_DICT_CREATE);
+            if (!e->value) {
+                (void)SCM_DICT_SET_VALUE(e, Scm_Cons(SCM_MAKE_INT(0),
+                                                     SCM_MAKE_INT(0)));
+            }
+            ScmObj p = SCM_DICT_VALUE(e);
+            SCM_SET_CAR_UNCHECKED(p, Scm_Add(SCM_CAR(p), SCM_MAKE_INT(1)));
+            SCM_SET_CDR_UNCHECKED(p, Scm_Add(SCM_CDR(p),
+                                             Scm_MakeIntegerU(r->bytes)));
+        }
+        hc = &live;
     }
-#endif /* !GAUCHE_WINDOWS */
 
-    return SCM_OBJ(vm->prof->statHash);
+    ScmObj h = SCM_NIL, t = SCM_NIL;
+    ScmHashIter iter;
+    ScmDictEntry *e;
+    Scm_HashIterInit(&iter, hc);
+    while ((e = Scm_HashIterNext(&iter)) != NULL) {
+        ScmObj p = SCM_DICT_VALUE(e);
+        SCM_APPEND1(h, t, Scm_Cons(SCM_DICT_KEY(e),
+                                   Scm_Cons(SCM_CAR(p), SCM_CDR(p))));
+    }
+    prof->allocSampling = saved;
+    return h;
 }
 
 #else  /* !GAUCHE_PROFILE */
@@ -463,4 +775,37 @@ ScmObj Scm_ProfilerRawResult(void)
     Scm_Error("profiler is not supported.");
     return SCM_FALSE;
 }
+
+ScmObj Scm_ProfilerRawStacks(void)
+{
+    Scm_Error("profiler is not supported.");
+    return SCM_FALSE;
+}
+
+void Scm_AllocProfilerStart(ScmSmallInt interval SCM_UNUSED)
+{
+    Scm_Error("profiler is not supported.");
+}
+
+int Scm_AllocProfilerStop(void)
+{
+    Scm_Error("profiler is not supported.");
+    return 0;
+}
+
+void Scm_AllocProfilerReset(void)
+{
+    Scm_Error("profiler is not supported.");
+}
+
+ScmObj Scm_AllocProfilerRawResult(int liveOnly SCM_UNUSED)
+{
+    Scm_Error("profiler is not supported.");
+    return SCM_FALSE;
+}
+
+void Scm_ProfilerCountAlloc(void *obj SCM_UNUSED, size_t size SCM_UNUSED,
+                            const char *type SCM_UNUSED)
+{
+}
 #endif /* !GAUCHE_PROFILE */
@@ -1905,6 +1905,13 @@ ScmObj Scm_MakeStringCursorFromIndex(ScmString *src, ScmSmallInt index)
     return make_string_cursor(src, index2ptr(srcb, index));
 }
 
+/* PTR must point to a character boundary within the body of SRC.
+   For the code that scans the string body by itself. */
+ScmObj Scm_MakeStringCursorFromPointer(ScmString *src, const char *ptr)
+{
+    return make_string_cursor(src, ptr);
+}
+
 ScmObj Scm_MakeStringCursorEnd(ScmString *src)
 {
     const ScmStringBody *srcb = SCM_STRING_BODY(src);
@@ -35,6 +35,7 @@
 #include "gauche.h"
 #include "gauche/priv/builtin-syms.h"
 #include "gauche/priv/moduleP.h"
+#include "gauche/priv/atomicP.h"
 
 /*-----------------------------------------------------------
  * Symbols
@@ -55,9 +56,148 @@ static ScmClass *keyword_cpl[] = {
 SCM_DEFINE_BUILTIN_CLASS(Scm_KeywordClass, symbol_print, symbol_compare,
                          NULL, NULL, keyword_cpl);
 
-/* name -> symbol mapper */
-static ScmInternalMutex obtable_mutex = SCM_INTERNAL_MUTEX_INITIALIZER;
-static ScmHashTable *obtable = NULL;
+/* name -> symbol mapper
+ *
+ *  The obtable is a chained hash table specialized for symbols.
+ *  Lookup doesn't take a lock.  Insertion is serialized by obtable.mutex;
+ *  a new entry is fully initialized before being linked into the chain,
+ *  and when the table is extended we build a new bucket array and
+ *  atomically swap the reference, so concurrent readers always see a
+ *  consistent (if possibly outdated) table.  A reader that misses
+ *  retries under the lock, so it never creates a duplicate symbol.
+ *
+ *  Symbols are held weakly.  A symbol nobody refers to can be
+ *  collected; if the same name is interned later, a new symbol is
+ *  created, which is indistinguishable since no reference to the old
+ *  one remains.  Statically allocated symbols (builtin ones and
+ *  the ones in precompiled code) are never collected.  The entries
+ *  whose symbol is gone are swept when the table gets crowded.
+ */
+typedef struct obentry_rec {
+    ScmAtomicVar next;          /* obentry* */
+    u_long hashval;
+    ScmWeakBox *sym;            /* ScmSymbol* */
+} obentry;
+
+typedef struct obbuckets_rec {
+    u_long size;                /* # of buckets.  power of 2. */
+    ScmSize numEntries;         /* # of entries, including dead ones. */
+    ScmAtomicVar buckets[1];    /* obentry* */
+} obbuckets;
+
+static struct {
+    ScmAtomicVar table;         /* obbuckets* */
+    ScmInternalMutex mutex;
+} obtable;
+
+#define OBTABLE_INITIAL_SIZE 4096
+
+static obbuckets *make_obbuckets(u_long size)
+{
+    obbuckets *b = SCM_NEW2(obbuckets*,
+                            sizeof(obbuckets)+sizeof(ScmAtomicWord)*(size-1));
+    b->size = size;
+    b->numEntries = 0;
+    for (u_long i=0; i<size; i++) b->buckets[i] = 0;
+    return b;
+}
+
+static inline int obentry_match(obentry *e, u_long hashval,
+                                const ScmStringBody *nb, ScmSymbol **psym)
+{
+    if (e->hashval != hashval) return FALSE;
+    ScmSymbol *sym = (ScmSymbol*)Scm_WeakBoxRef(e->sym);
+    if (sym == NULL) return FALSE;
+    const ScmStringBody *sb = SCM_STRING_BODY(sym->name);
+    if (SCM_STRING_BODY_SIZE(sb) == SCM_STRING_BODY_SIZE(nb)
+        && memcmp(SCM_STRING_BODY_START(sb), SCM_STRING_BODY_START(nb),
+                  SCM_STRING_BODY_SIZE(nb)) == 0) {
+        *psym = sym;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Lock-free lookup.  Returns NULL if not found. */
+static ScmSymbol *obtable_lookup(obbuckets *b, u_long hashval,
+                                 const ScmStringBody *nb)
+{
+    ScmSymbol *sym = NULL;
+    ScmAtomicVar *loc = &b->buckets[hashval & (b->size-1)];
+    for (obentry *e = (obentry*)AO_load(loc); e;
+         e = (obentry*)AO_load(&e->next)) {
+        if (obentry_match(e, hashval, nb, &sym)) return sym;
+    }
+    return NULL;
+}
+
+/* Unlink entries whose symbols are gone.  Returns # of live entries.
+   Must be called with the lock held.  Concurrent readers may be
+   traversing an unlinked entry, but its next link stays intact. */
+static ScmSize obtable_sweep(obbuckets *b)
+{
+    ScmSize live = 0;
+    for (u_long i=0; i<b->size; i++) {
+        ScmAtomicVar *prev = &b->buckets[i];
+        for (obentry *e = (obentry*)AO_load(prev); e;
+             e = (obentry*)AO_load(prev)) {
+            if (Scm_WeakBoxEmptyP(e->sym)) {
+                AO_store(prev, AO_load(&e->next));
+            } else {
+                live++;
+                prev = &e->next;
+            }
+        }
+    }
+    b->numEntries = live;
+    return live;
+}
+
+/* Rebuild the table with twice as many buckets.  Entries are copied,
+   for the old ones may still be traversed by readers.
+   Must be called with the lock held. */
+static obbuckets *obtable_extend(obbuckets *b)
+{
+    obbuckets *nb = make_obbuckets(b->size*2);
+    for (u_long i=0; i<b->size; i++) {
+        for (obentry *e = (obentry*)AO_load(&b->buckets[i]); e;
+             e = (obentry*)AO_load(&e->next)) {
+            if (Scm_WeakBoxEmptyP(e->sym)) continue;
+            obentry *ne = SCM_NEW(obentry);
+            ScmAtomicVar *loc = &nb->buckets[e->hashval & (nb->size-1)];
+            ne->hashval = e->hashval;
+            ne->sym = e->sym;
+            ne->next = AO_load(loc);
+            AO_store(loc, (ScmAtomicWord)ne);
+            nb->numEntries++;
+        }
+    }
+    AO_store_full(&obtable.table, (ScmAtomicWord)nb);
+    return nb;
+}
+
+/* Insert SYM unless a symbol of the same name is already there.
+   Returns the symbol in the table.  Must be called with the lock held. */
+static ScmSymbol *obtable_insert(u_long hashval, ScmSymbol *sym)
+{
+    obbuckets *b = (obbuckets*)AO_load(&obtable.table);
+    const ScmStringBody *nb = SCM_STRING_BODY(sym->name);
+    ScmSymbol *s = obtable_lookup(b, hashval, nb);
+    if (s != NULL) return s;
+
+    if ((u_long)b->numEntries >= b->size*2) {
+        if ((u_long)obtable_sweep(b) >= b->size) b = obtable_extend(b);
+    }
+
+    obentry *e = SCM_NEW(obentry);
+    ScmAtomicVar *loc = &b->buckets[hashval & (b->size-1)];
+    e->hashval = hashval;
+    e->sym = Scm_MakeWeakBox(sym);
+    e->next = AO_load(loc);
+    AO_store_full(loc, (ScmAtomicWord)e);
+    b->numEntries++;
+    return sym;
+}
 
 #if GAUCHE_KEEP_DISJOINT_KEYWORD_OPTION
 /* Global keyword table. */
@@ -72,12 +212,13 @@ static int keyword_disjoint_p = FALSE;
 /* internal constructor.  NAME must be an immutable string. */
 static ScmSymbol *make_sym(ScmClass *klass, ScmString *name, int interned)
 {
+    u_long hashval = 0;
     if (interned) {
         /* fast path */
-        SCM_INTERNAL_MUTEX_LOCK(obtable_mutex);
-        ScmObj e = Scm_HashTableRef(obtable, SCM_OBJ(name), SCM_FALSE);
-        SCM_INTERNAL_MUTEX_UNLOCK(obtable_mutex);
-        if (!SCM_FALSEP(e)) return SCM_SYMBOL(e);
+        hashval = Scm_HashString(name, 0);
+        ScmSymbol *s = obtable_lookup((obbuckets*)AO_load(&obtable.table),
+                                      hashval, SCM_STRING_BODY(name));
+        if (s != NULL) return s;
     }
 
     ScmSymbol *sym = SCM_NEW(ScmSymbol);
@@ -88,17 +229,28 @@ static ScmSymbol *make_sym(ScmClass *klass, ScmString *name, int interned)
     if (!interned) {
         return sym;
     } else {
-        /* Using SCM_DICT_NO_OVERWRITE ensures that if another thread interns
-           the same name symbol between above HashTableRef and here, we'll
-           get the already interned symbol. */
-        SCM_INTERNAL_MUTEX_LOCK(obtable_mutex);
-        ScmObj r = Scm_HashTableSet(obtable, SCM_OBJ(name), SCM_OBJ(sym),
-                                    SCM_DICT_NO_OVERWRITE);
-        SCM_INTERNAL_MUTEX_UNLOCK(obtable_mutex);
-        return SCM_UNBOUNDP(r)? sym : SCM_SYMBOL(r);
+        /* Another thread may have interned the same name symbol
+           after the above lookup; obtable_insert checks it again. */
+        SCM_INTERNAL_MUTEX_LOCK(obtable.mutex);
+        ScmSymbol *r = obtable_insert(hashval, sym);
+        SCM_INTERNAL_MUTEX_UNLOCK(obtable.mutex);
+        return r;
     }
 }
 
+/* For diagnostics.  Returns (#buckets #entries #live-entries). */
+ScmObj Scm__SymbolTableStats(void)
+{
+    SCM_INTERNAL_MUTEX_LOCK(obtable.mutex);
+    obbuckets *b = (obbuckets*)AO_load(&obtable.table);
+    ScmSize entries = b->numEntries;
+    ScmSize live = obtable_sweep(b);
+    SCM_INTERNAL_MUTEX_UNLOCK(obtable.mutex);
+    return SCM_LIST3(Scm_MakeIntegerU(b->size),
+                     Scm_MakeInteger(entries),
+                     Scm_MakeInteger(live));
+}
+
 /* Intern */
 ScmObj Scm_MakeSymbol(ScmString *name, int interned)
 {
@@ -471,8 +623,9 @@ ScmObj Scm_ExtractKeywords(ScmObj kv_list,
 
 void Scm__InitSymbol(void)
 {
-    SCM_INTERNAL_MUTEX_INIT(obtable_mutex);
-    obtable = SCM_HASH_TABLE(Scm_MakeHashTableSimple(SCM_HASH_STRING, 4096));
+    SCM_INTERNAL_MUTEX_INIT(obtable.mutex);
+    AO_store(&obtable.table,
+             (ScmAtomicWord)make_obbuckets(OBTABLE_INITIAL_SIZE));
     init_builtin_syms();
 #if GAUCHE_KEEP_DISJOINT_KEYWORD_OPTION
     (void)SCM_INTERNAL_MUTEX_INIT(keywords.mutex);
@@ -46,6 +46,15 @@
 #include <fcntl.h>
 #include <math.h>
 #include <dirent.h>
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+#if defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 #if !defined(GAUCHE_WINDOWS)
 #include <grp.h>
@@ -620,6 +629,240 @@ ScmObj Scm_SysMkdtemp(ScmString *templat)
     return SCM_MAKE_STR_COPYING(name);
 }
 
+/*===============================================================
+ * Memory-mapped file region
+ */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+static void unmap_region(ScmObj obj, void *data SCM_UNUSED)
+{
+    ScmMappedRegion *m = (ScmMappedRegion*)obj;
+    if (m->base) {
+        munmap(m->base, m->baseSize);
+        m->base = NULL;
+    }
+}
+#endif /*HAVE_SYS_MMAN_H && HAVE_MMAP*/
+
+/* Maps SIZE bytes from OFFSET of the file opened as FD read-only.  If
+   SIZE is negative, maps up to the end of the file.  FD is left open;
+   the caller may close it, and the mapping stays valid.
+   NB: Accessing the region after the file is truncated by others
+   raises SIGBUS.  We don't guard against it. */
+ScmMappedRegion *Scm_MapFdRegion(int fd, off_t offset, ScmSize size)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+    int r;
+    struct stat st;
+
+    if (offset < 0) Scm_Error("offset must be nonnegative, but got %ld",
+                              (long)offset);
+    SCM_SYSCALL(r, fstat(fd, &st));
+    if (r < 0) Scm_SysError("fstat failed on fd %d", fd);
+    if (!S_ISREG(st.st_mode)) {
+        Scm_Error("regular file required to map, but got fd %d", fd);
+    }
+    if (offset > st.st_size) offset = st.st_size;
+    if (size < 0 || offset + size > st.st_size) size = st.st_size - offset;
+
+    ScmMappedRegion *m = SCM_NEW(ScmMappedRegion);
+    m->addr = NULL;
+    m->size = size;
+    m->base = NULL;
+    m->baseSize = 0;
+    if (size > 0) {
+        /* mmap requires the offset to be page-aligned */
+        off_t pagesize = (off_t)sysconf(_SC_PAGESIZE);
+        off_t base = offset - offset % pagesize;
+        size_t baseSize = (size_t)(offset - base) + (size_t)size;
+        void *p = mmap(NULL, baseSize, PROT_READ, MAP_SHARED, fd, base);
+        if (p == MAP_FAILED) Scm_SysError("mmap failed on fd %d", fd);
+        m->base = p;
+        m->baseSize = baseSize;
+        m->addr = (char*)p + (offset - base);
+        Scm_RegisterFinalizer(SCM_OBJ(m), unmap_region, NULL);
+    }
+    return m;
+#else  /*!(HAVE_SYS_MMAN_H && HAVE_MMAP)*/
+    (void)fd;     /* suppress unused var warning */
+    (void)offset; /* suppress unused var warning */
+    (void)size;   /* suppress unused var warning */
+    Scm_Error("mapping files into memory isn't supported on this platform");
+    return NULL;                /* dummy */
+#endif /*!(HAVE_SYS_MMAN_H && HAVE_MMAP)*/
+}
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+/* Scm_MapFdRegion, then closes FD even if an error is signalled. */
+static ScmMappedRegion *map_owned_fd_region(int fd, off_t offset,
+                                            ScmSize size)
+{
+    ScmMappedRegion *m = NULL;
+    SCM_UNWIND_PROTECT {
+        m = Scm_MapFdRegion(fd, offset, size);
+    } SCM_WHEN_ERROR {
+        close(fd);
+        SCM_NEXT_HANDLER;
+    } SCM_END_PROTECT;
+    close(fd);
+    return m;
+}
+#endif /*HAVE_SYS_MMAN_H && HAVE_MMAP*/
+
+/* Like Scm_MapFdRegion, but opens the file PATH.  Returns NULL if the
+   file can't be opened (errno is set); other errors are signalled. */
+ScmMappedRegion *Scm_MapFileRegion(const char *path, off_t offset,
+                                   ScmSize size)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+    int fd;
+    SCM_SYSCALL(fd, open(path, O_RDONLY));
+    if (fd < 0) return NULL;
+    return map_owned_fd_region(fd, offset, size);
+#else  /*!(HAVE_SYS_MMAN_H && HAVE_MMAP)*/
+    (void)path;   /* suppress unused var warning */
+    (void)offset; /* suppress unused var warning */
+    (void)size;   /* suppress unused var warning */
+    Scm_Error("mapping files into memory isn't supported on this platform");
+    return NULL;                /* dummy */
+#endif /*!(HAVE_SYS_MMAN_H && HAVE_MMAP)*/
+}
+
+/*===============================================================
+ * In-kernel data transfer
+ */
+
+#if defined(__linux__)
+/* Methods to move data between fds without going through the user space,
+   in the order of preference.  copy_file_range and splice are called
+   via syscall(), for glibc only declares them with _GNU_SOURCE (and
+   older glibc doesn't have copy_file_range at all). */
+enum {
+    TRANSFER_COPY_FILE_RANGE,   /* file -> file */
+    TRANSFER_SENDFILE,          /* file -> anything */
+    TRANSFER_SPLICE,            /* either end is a pipe */
+    TRANSFER_NMETHODS
+};
+
+#define TRANSFER_CHUNK  ((ScmSize)1 << 30)
+
+static int transfer_applicable_p(int method, struct stat *in, struct stat *out,
+                                 off_t *offset)
+{
+    switch (method) {
+#if defined(SYS_copy_file_range)
+    case TRANSFER_COPY_FILE_RANGE:
+        /* Files in procfs and sysfs say their size is 0, and
+           copy_file_range copies nothing from them. */
+        return S_ISREG(in->st_mode) && S_ISREG(out->st_mode)
+            && in->st_size > 0;
+#endif
+#if defined(HAVE_SYS_SENDFILE_H)
+    case TRANSFER_SENDFILE:
+        return S_ISREG(in->st_mode) || S_ISBLK(in->st_mode);
+#endif
+#if defined(SYS_splice)
+    case TRANSFER_SPLICE:
+        if (S_ISFIFO(in->st_mode)) return offset == NULL;
+        return S_ISFIFO(out->st_mode);
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+static ssize_t transfer_1(int method, int outfd, int infd, off_t *offset,
+                          ScmSize count)
+{
+    ssize_t r = -1;
+    int64_t off = offset ? (int64_t)*offset : 0;
+
+    switch (method) {
+#if defined(SYS_copy_file_range)
+    case TRANSFER_COPY_FILE_RANGE:
+        r = syscall(SYS_copy_file_range, infd, offset ? &off : NULL,
+                    outfd, NULL, (size_t)count, 0);
+        break;
+#endif
+#if defined(HAVE_SYS_SENDFILE_H)
+    case TRANSFER_SENDFILE:
+        return sendfile(outfd, infd, offset, (size_t)count);
+#endif
+#if defined(SYS_splice)
+    case TRANSFER_SPLICE:
+        r = syscall(SYS_splice, infd, offset ? &off : NULL,
+                    outfd, NULL, (size_t)count, 0);
+        break;
+#endif
+    default:
+        errno = ENOSYS;
+        return -1;
+    }
+    if (r > 0 && offset) *offset = (off_t)off;
+    return r;
+}
+
+/* Errors that tell the method can't be used for the pair of fds, rather
+   than a failure of I/O.  EAGAIN is also here; a non-blocking fd that
+   isn't ready is left to the caller. */
+static int transfer_unsupported_p(int e)
+{
+    return e == EINVAL || e == ENOSYS || e == EXDEV || e == EBADF
+        || e == ESPIPE || e == EOPNOTSUPP || e == EAGAIN;
+}
+#endif /*__linux__*/
+
+/* Transfers up to COUNT bytes (until EOF if COUNT is negative) from
+   the file descriptor INFD to OUTFD within the kernel, without copying
+   the data to the user space.  If OFFSET isn't NULL, INFD is read from
+   *OFFSET, which is updated, and the file position of INFD doesn't change;
+   otherwise the file positions of the fds advance.
+   Returns the number of bytes transferred.  If it stops before COUNT bytes
+   or EOF, *STOPPED is set to TRUE.  That happens when the kernel can't
+   transfer between that kind of fds (e.g. from a socket to a file), or
+   on platforms other than Linux.  The caller is supposed to transfer
+   the rest in the ordinary way.  I/O errors are signalled. */
+ScmSize Scm_SysTransferFd(int outfd, int infd, off_t *offset, ScmSize count,
+                          int *stopped)
+{
+    ScmSize total = 0;
+    *stopped = TRUE;
+#if defined(__linux__)
+    struct stat in, out;
+    int r;
+
+    SCM_SYSCALL(r, fstat(infd, &in));
+    if (r < 0) Scm_SysError("fstat failed on fd %d", infd);
+    SCM_SYSCALL(r, fstat(outfd, &out));
+    if (r < 0) Scm_SysError("fstat failed on fd %d", outfd);
+
+    for (int m = 0; m < TRANSFER_NMETHODS; m++) {
+        if (!transfer_applicable_p(m, &in, &out, offset)) continue;
+        for (;;) {
+            ScmSize n = TRANSFER_CHUNK;
+            if (count >= 0 && count - total < n) n = count - total;
+            if (n == 0) {
+                *stopped = FALSE;
+                return total;
+            }
+            ssize_t nx;
+            SCM_SYSCALL(nx, transfer_1(m, outfd, infd, offset, n));
+            if (nx < 0) {
+                if (transfer_unsupported_p(errno)) break; /* try next one */
+                Scm_SysError("transferring data from fd %d to fd %d failed",
+                             infd, outfd);
+            }
+            if (nx == 0) {
+                *stopped = FALSE;
+                return total;
+            }
+            total += nx;
+        }
+    }
+#endif /*__linux__*/
+    return total;
+}
+
 /*===============================================================
  * Stat (sys/stat.h)
  */
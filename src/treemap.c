@@ -88,6 +88,23 @@ static Node *prev_node(Node *n);
 static Node *delete_node(ScmTreeCore *tc, Node *n);
 static Node *copy_tree(Node *parent, Node *self);
 static int   node_cleared_p(Node *n);
+static void  balance_tree(ScmTreeCore *tc, Node *n);
+static Node *new_node(Node *parent, intptr_t key);
+
+/* B+tree backend.  See below for the details. */
+#define BTREEP(tc)       ((tc)->flags & SCM_TREE_CORE_BTREE)
+
+static ScmDictEntry *bt_ref(ScmTreeCore *tc, intptr_t key, enum TreeOp op,
+                            ScmDictEntry **lo, ScmDictEntry **hi);
+static ScmDictEntry *bt_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op,
+                              int pop);
+static void bt_copy(ScmTreeCore *dst, const ScmTreeCore *src);
+static void bt_bulk_load(ScmTreeCore *tc, const intptr_t *keys,
+                         const intptr_t *values, int num_entries);
+static void bt_iter_init(ScmTreeIter *iter, ScmDictEntry *start);
+static ScmDictEntry *bt_iter_step(ScmTreeIter *iter, int dir);
+static void bt_check(ScmTreeCore *tc);
+static void bt_dump(ScmTreeCore *tc, ScmPort *out, int scmobj);
 
 /*
  * Public API
@@ -96,22 +113,34 @@ static int   node_cleared_p(Node *n);
 void Scm_TreeCoreInit(ScmTreeCore *tc,
                       ScmTreeCoreCompareProc *cmp,
                       void *data)
+{
+    Scm_TreeCoreInitWithFlags(tc, cmp, data, 0);
+}
+
+void Scm_TreeCoreInitWithFlags(ScmTreeCore *tc,
+                               ScmTreeCoreCompareProc *cmp,
+                               void *data,
+                               int flags)
 {
     tc->root = NULL;
     tc->cmp = cmp;
     tc->num_entries = 0;
+    tc->flags = flags;
     tc->data = data;
 }
 
 void Scm_TreeCoreCopy(ScmTreeCore *dst, const ScmTreeCore *src)
 {
-    if (ROOT(src)) {
+    if (BTREEP(src)) {
+        bt_copy(dst, src);
+    } else if (ROOT(src)) {
         SET_ROOT(dst, copy_tree(NULL, ROOT(src)));
     } else {
         SET_ROOT(dst, NULL);
     }
     dst->cmp = src->cmp;
     dst->num_entries = src->num_entries;
+    dst->flags = src->flags;
     dst->data = src->data;
 }
 
@@ -121,11 +150,64 @@ void Scm_TreeCoreClear(ScmTreeCore *tc)
     tc->num_entries = 0;
 }
 
+/* Populates an empty tree with NUM_ENTRIES entries at once.  KEYS must
+   be sorted in strictly ascending order.  This is much faster than
+   inserting entries one by one, for we don't need to compare keys
+   (except to check the order) nor to rebalance the tree.  For B+tree,
+   the nodes are packed, too. */
+void Scm_TreeCoreBulkLoad(ScmTreeCore *tc,
+                          const intptr_t *keys,
+                          const intptr_t *values,
+                          int num_entries)
+{
+    if (tc->num_entries != 0) {
+        Scm_Error("Scm_TreeCoreBulkLoad: the tree isn't empty");
+    }
+    for (int i=1; i<num_entries; i++) {
+        int r = (tc->cmp
+                 ? tc->cmp(tc, keys[i-1], keys[i])
+                 : (keys[i-1] < keys[i]? -1 : 1));
+        if (r >= 0) {
+            Scm_Error("Scm_TreeCoreBulkLoad: keys aren't in strictly "
+                      "ascending order at index %d", i);
+        }
+    }
+
+    if (BTREEP(tc)) {
+        bt_bulk_load(tc, keys, values, num_entries);
+    } else {
+        /* Each new node becomes the rightmost one, so we can attach it
+           without searching. */
+        Node *last = NULL;
+        for (int i=0; i<num_entries; i++) {
+            Node *n = new_node(last, keys[i]);
+            n->value = values[i];
+            if (last) last->right = n;
+            else      SET_ROOT(tc, n);
+            balance_tree(tc, n);
+            last = n;
+        }
+    }
+    tc->num_entries = num_entries;
+}
+
+static ScmDictEntry *tree_ref(ScmTreeCore *tc, intptr_t key, enum TreeOp op,
+                              ScmDictEntry **lo, ScmDictEntry **hi)
+{
+    if (BTREEP(tc)) return bt_ref(tc, key, op, lo, hi);
+
+    Node *l = NULL, *h = NULL;
+    Node *r = core_ref(tc, key, op, &l, &h);
+    if (lo) *lo = (ScmDictEntry*)l;
+    if (hi) *hi = (ScmDictEntry*)h;
+    return (ScmDictEntry*)r;
+}
+
 ScmDictEntry *Scm_TreeCoreSearch(ScmTreeCore *tc,
                                  intptr_t key,
                                  ScmDictOp op)
 {
-    return (ScmDictEntry*)core_ref(tc, key, (enum TreeOp)op, NULL, NULL);
+    return tree_ref(tc, key, (enum TreeOp)op, NULL, NULL);
 }
 
 ScmDictEntry *Scm_TreeCoreClosestEntries(ScmTreeCore *tc,
@@ -133,25 +215,21 @@ ScmDictEntry *Scm_TreeCoreClosestEntries(ScmTreeCore *tc,
                                          ScmDictEntry **lo,
                                          ScmDictEntry **hi)
 {
-    Node *l, *h;
-    Node *r = core_ref(tc, key, TREE_NEAR, &l, &h);
-    *lo = (ScmDictEntry*)l;
-    *hi = (ScmDictEntry*)h;
-    return (ScmDictEntry*)r;
+    return tree_ref(tc, key, TREE_NEAR, lo, hi);
 }
 
 ScmDictEntry *Scm_TreeCoreNextEntry(ScmTreeCore *tc, intptr_t key)
 {
-    Node *l, *h;
-    core_ref(tc, key, TREE_NEAR, &l, &h);
-    return (ScmDictEntry*)h;
+    ScmDictEntry *l, *h;
+    tree_ref(tc, key, TREE_NEAR, &l, &h);
+    return h;
 }
 
 ScmDictEntry *Scm_TreeCorePrevEntry(ScmTreeCore *tc, intptr_t key)
 {
-    Node *l, *h;
-    core_ref(tc, key, TREE_NEAR, &l, &h);
-    return (ScmDictEntry*)l;
+    ScmDictEntry *l, *h;
+    tree_ref(tc, key, TREE_NEAR, &l, &h);
+    return l;
 }
 
 static Node *core_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op, int pop)
@@ -171,11 +249,13 @@ static Node *core_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op, int pop)
 
 ScmDictEntry *Scm_TreeCoreGetBound(ScmTreeCore *tc, ScmTreeCoreBoundOp op)
 {
+    if (BTREEP(tc)) return bt_bound(tc, op, FALSE);
     return (ScmDictEntry*)core_bound(tc, op, FALSE);
 }
 
 ScmDictEntry *Scm_TreeCorePopBound(ScmTreeCore *tc, ScmTreeCoreBoundOp op)
 {
+    if (BTREEP(tc)) return bt_bound(tc, op, TRUE);
     return (ScmDictEntry*)core_bound(tc, op, TRUE);
 }
 
@@ -225,6 +305,10 @@ void Scm_TreeIterInit(ScmTreeIter *iter,
         Scm_Error("Scm_TreeIterInit: iteration start point is not a part of the tree.");
     }
     iter->t = tc;
+    if (BTREEP(tc)) {
+        bt_iter_init(iter, start);
+        return;
+    }
     iter->c = start;
     iter->n = (start
                ? advance_iter(start)
@@ -237,6 +321,7 @@ void Scm_TreeIterInit(ScmTreeIter *iter,
 /* Mind that the 'current' node might be deleted. */
 ScmDictEntry *Scm_TreeIterNext(ScmTreeIter *iter)
 {
+    if (BTREEP(iter->t)) return bt_iter_step(iter, 1);
     if (node_cleared_p((Node*)iter->c)) {
         iter->c = iter->n;
         iter->p = retrogress_iter(iter->c);
@@ -251,6 +336,7 @@ ScmDictEntry *Scm_TreeIterNext(ScmTreeIter *iter)
 
 ScmDictEntry *Scm_TreeIterPrev(ScmTreeIter *iter)
 {
+    if (BTREEP(iter->t)) return bt_iter_step(iter, -1);
     if (node_cleared_p((Node*)iter->c)) {
         iter->c = iter->p;
         iter->n = advance_iter(iter->c);
@@ -308,6 +394,11 @@ static int check_traverse(Node *node, int depth, int *count)
 
 void Scm_TreeCoreCheckConsistency(ScmTreeCore *tc)
 {
+    if (BTREEP(tc)) {
+        bt_check(tc);
+        return;
+    }
+
     Node *r = ROOT(tc);
     int cnt = 0;
 
@@ -339,11 +430,17 @@ SCM_DEFINE_BUILTIN_CLASS(Scm_TreeMapClass, treemap_print, Scm_ObjectCompare,
  */
 
 ScmObj Scm_MakeTreeMap(ScmTreeCoreCompareProc *cmp, void *data)
+{
+    return Scm_MakeTreeMapWithFlags(cmp, data, 0);
+}
+
+ScmObj Scm_MakeTreeMapWithFlags(ScmTreeCoreCompareProc *cmp, void *data,
+                                int flags)
 {
     ScmTreeMap *tm = SCM_NEW(ScmTreeMap);
     SCM_SET_CLASS(tm, SCM_CLASS_TREE_MAP);
     /* TODO: default cmp should be different from TreeCore */
-    Scm_TreeCoreInit(SCM_TREE_MAP_CORE(tm), cmp, data);
+    Scm_TreeCoreInitWithFlags(SCM_TREE_MAP_CORE(tm), cmp, data, flags);
     return SCM_OBJ(tm);
 }
 
@@ -412,7 +509,9 @@ void Scm_TreeMapDump(ScmTreeMap *tm, ScmPort *out)
     ScmTreeCore *tc = SCM_TREE_MAP_CORE(tm);
     Node *r = ROOT(tc);
     Scm_Printf(out, "Entries=%d\n", tc->num_entries);
-    if (r) {
+    if (BTREEP(tc)) {
+        bt_dump(tc, out, TRUE);
+    } else if (r) {
         dump_traverse(r, 0, out, TRUE);
     }
 }
@@ -421,7 +520,9 @@ void Scm_TreeCoreDump(ScmTreeCore *tc, ScmPort *out)
 {
     Node *r = ROOT(tc);
     Scm_Printf(out, "Entries=%d\n", tc->num_entries);
-    if (r) {
+    if (BTREEP(tc)) {
+        bt_dump(tc, out, FALSE);
+    } else if (r) {
         dump_traverse(r, 0, out, FALSE);
     }
 }
@@ -808,3 +909,756 @@ static Node *copy_tree(Node *parent, Node *self)
     if (self->right) n->right = copy_tree(n, self->right);
     return n;
 }
+
+/*=============================================================
+ * Internal stuff (B+tree implementation)
+ */
+
+/* A leaf holds up to BT_ORDER entries, and a branch holds up to
+   BT_ORDER children.  Other than the root, a node has at least BT_MIN
+   of them, except that the rightmost leaf may have fewer; when keys
+   are added in ascending order, we leave the full leaf as is and start
+   a new one, instead of splitting it in half.
+
+   The entries are allocated separately, so that the ScmDictEntry's we
+   return stay valid while nodes are split and merged.  A leaf keeps
+   a copy of the keys as well, so that searching in it doesn't need to
+   touch the entries.  Leaves are doubly linked for traversal.
+
+   In a branch, keys[i] (i > 0) is a lower bound of the keys in
+   children[i], and all the keys in children[i-1] are less than it.
+   keys[0] isn't used.
+
+   tc->root points to the root node, or NULL if the tree is empty.
+*/
+
+#define BT_ORDER      32
+#define BT_MIN        (BT_ORDER/2)
+#define BT_MAX_DEPTH  16        /* enough for INT_MAX entries */
+
+/* The same layout as ScmDictEntry, except the key isn't const. */
+typedef struct BEntryRec {
+    intptr_t key;
+    intptr_t value;
+} BEntry;
+
+/* Common header of BLeaf and BBranch */
+typedef struct BNodeRec {
+    int n;                      /* # of entries or children */
+    int leafp;
+} BNode;
+
+typedef struct BLeafRec {
+    int n;
+    int leafp;                  /* TRUE */
+    struct BLeafRec *prev;
+    struct BLeafRec *next;
+    intptr_t keys[BT_ORDER];
+    BEntry  *entries[BT_ORDER];
+} BLeaf;
+
+typedef struct BBranchRec {
+    int n;
+    int leafp;                  /* FALSE */
+    intptr_t keys[BT_ORDER];
+    BNode   *children[BT_ORDER];
+} BBranch;
+
+/* The branches we go through from the root to a leaf, and the index
+   of the child we took in each of them. */
+typedef struct BPathRec {
+    int depth;
+    BBranch *node[BT_MAX_DEPTH];
+    int      index[BT_MAX_DEPTH];
+} BPath;
+
+#define BROOT(tc)         ((BNode*)(tc)->root)
+#define SET_BROOT(tc, n)  ((tc)->root = (ScmDictEntry*)(n))
+
+static inline int bt_cmp(const ScmTreeCore *tc, intptr_t a, intptr_t b)
+{
+    if (tc->cmp) return tc->cmp((ScmTreeCore*)tc, a, b);
+    return (a < b)? -1 : (a > b)? 1 : 0;
+}
+
+static BEntry *new_entry(intptr_t key, intptr_t value)
+{
+    BEntry *e = SCM_NEW(BEntry);
+    e->key = key;
+    e->value = value;
+    return e;
+}
+
+static BLeaf *new_leaf(void)
+{
+    BLeaf *l = SCM_NEW(BLeaf);
+    l->n = 0;
+    l->leafp = TRUE;
+    l->prev = l->next = NULL;
+    return l;
+}
+
+static BBranch *new_branch(void)
+{
+    BBranch *b = SCM_NEW(BBranch);
+    b->n = 0;
+    b->leafp = FALSE;
+    return b;
+}
+
+/* Returns the index of the first key in L that is not less than KEY.
+   *FOUND is set if the key equals to KEY. */
+static int leaf_search(ScmTreeCore *tc, BLeaf *l, intptr_t key, int *found)
+{
+    int lo = 0, hi = l->n;
+    *found = FALSE;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        int r = bt_cmp(tc, l->keys[mid], key);
+        if (r == 0) { *found = TRUE; return mid; }
+        if (r < 0) lo = mid + 1;
+        else       hi = mid;
+    }
+    return lo;
+}
+
+/* Returns the index of the child of B that may contain KEY. */
+static int branch_search(ScmTreeCore *tc, BBranch *b, intptr_t key)
+{
+    int lo = 1, hi = b->n;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        if (bt_cmp(tc, b->keys[mid], key) <= 0) lo = mid + 1;
+        else                                     hi = mid;
+    }
+    return lo - 1;
+}
+
+/* Descends from the root to the leaf that may contain KEY.  The tree
+   must not be empty. */
+static BLeaf *bt_descend(ScmTreeCore *tc, intptr_t key, BPath *path)
+{
+    BNode *n = BROOT(tc);
+    path->depth = 0;
+    while (!n->leafp) {
+        BBranch *b = (BBranch*)n;
+        int i = branch_search(tc, b, key);
+        SCM_ASSERT(path->depth < BT_MAX_DEPTH);
+        path->node[path->depth] = b;
+        path->index[path->depth++] = i;
+        n = b->children[i];
+    }
+    return (BLeaf*)n;
+}
+
+/* Descends to the leftmost or the rightmost leaf. */
+static BLeaf *bt_descend_edge(ScmTreeCore *tc, int rightp, BPath *path)
+{
+    BNode *n = BROOT(tc);
+    path->depth = 0;
+    while (!n->leafp) {
+        BBranch *b = (BBranch*)n;
+        int i = rightp? b->n - 1 : 0;
+        SCM_ASSERT(path->depth < BT_MAX_DEPTH);
+        path->node[path->depth] = b;
+        path->index[path->depth++] = i;
+        n = b->children[i];
+    }
+    return (BLeaf*)n;
+}
+
+/* Primitive operations on a node.  They don't care about the capacity.
+   Vacated slots are cleared so that we won't retain garbage. */
+static void leaf_insert(BLeaf *l, int i, BEntry *e)
+{
+    memmove(l->keys+i+1, l->keys+i, (l->n - i)*sizeof(intptr_t));
+    memmove(l->entries+i+1, l->entries+i, (l->n - i)*sizeof(BEntry*));
+    l->keys[i] = e->key;
+    l->entries[i] = e;
+    l->n++;
+}
+
+static void leaf_remove(BLeaf *l, int i)
+{
+    memmove(l->keys+i, l->keys+i+1, (l->n - i - 1)*sizeof(intptr_t));
+    memmove(l->entries+i, l->entries+i+1, (l->n - i - 1)*sizeof(BEntry*));
+    l->n--;
+    l->keys[l->n] = 0;
+    l->entries[l->n] = NULL;
+}
+
+/* Moves entries of L from index I to the end into the end of M. */
+static void leaf_move(BLeaf *l, int i, BLeaf *m)
+{
+    int k = l->n - i;
+    memcpy(m->keys+m->n, l->keys+i, k*sizeof(intptr_t));
+    memcpy(m->entries+m->n, l->entries+i, k*sizeof(BEntry*));
+    memset(l->keys+i, 0, k*sizeof(intptr_t));
+    memset(l->entries+i, 0, k*sizeof(BEntry*));
+    m->n += k;
+    l->n = i;
+}
+
+static void branch_insert(BBranch *b, int i, intptr_t key, BNode *child)
+{
+    memmove(b->keys+i+1, b->keys+i, (b->n - i)*sizeof(intptr_t));
+    memmove(b->children+i+1, b->children+i, (b->n - i)*sizeof(BNode*));
+    b->keys[i] = key;
+    b->children[i] = child;
+    b->n++;
+}
+
+static void branch_remove(BBranch *b, int i)
+{
+    memmove(b->keys+i, b->keys+i+1, (b->n - i - 1)*sizeof(intptr_t));
+    memmove(b->children+i, b->children+i+1, (b->n - i - 1)*sizeof(BNode*));
+    b->n--;
+    b->keys[0] = 0;
+    b->keys[b->n] = 0;
+    b->children[b->n] = NULL;
+}
+
+/* Moves children of B from index I to the end into the end of C.
+   KEY is the lower bound of children[I]. */
+static void branch_move(BBranch *b, int i, intptr_t key, BBranch *c)
+{
+    int k = b->n - i;
+    memcpy(c->keys+c->n, b->keys+i, k*sizeof(intptr_t));
+    memcpy(c->children+c->n, b->children+i, k*sizeof(BNode*));
+    c->keys[c->n] = key;
+    memset(b->keys+i, 0, k*sizeof(intptr_t));
+    memset(b->children+i, 0, k*sizeof(BNode*));
+    c->n += k;
+    b->n = i;
+}
+
+/* Inserts RIGHT with the lower bound KEY next to the child LEFT, which
+   is at the end of PATH.  Branches are split up to the root as needed. */
+static void bt_insert_child(ScmTreeCore *tc, BPath *path,
+                            BNode *left, intptr_t key, BNode *right)
+{
+    for (int d = path->depth - 1; d >= 0; d--) {
+        BBranch *b = path->node[d];
+        int i = path->index[d] + 1;
+        if (b->n < BT_ORDER) {
+            branch_insert(b, i, key, right);
+            return;
+        }
+        BBranch *c = new_branch();
+        int m = (BT_ORDER+1)/2;
+        if (i < m) {
+            branch_move(b, m-1, b->keys[m-1], c);
+            branch_insert(b, i, key, right);
+        } else {
+            branch_move(b, m, b->keys[m], c);
+            branch_insert(c, i-m, key, right);
+        }
+        key = c->keys[0];
+        c->keys[0] = 0;
+        left = (BNode*)b;
+        right = (BNode*)c;
+    }
+    /* The root is split */
+    BBranch *r = new_branch();
+    r->n = 2;
+    r->children[0] = left;
+    r->keys[1] = key;
+    r->children[1] = right;
+    SET_BROOT(tc, r);
+}
+
+/* Inserts a new entry E at index I of the leaf L. */
+static void bt_insert(ScmTreeCore *tc, BPath *path, BLeaf *l, int i,
+                      BEntry *e)
+{
+    if (l->n < BT_ORDER) {
+        leaf_insert(l, i, e);
+        return;
+    }
+
+    BLeaf *m = new_leaf();
+    if (i == BT_ORDER && l->next == NULL) {
+        /* Appending to the end of the tree.  Keep L full. */
+        leaf_insert(m, 0, e);
+    } else {
+        int k = (BT_ORDER+1)/2;
+        if (i < k) {
+            leaf_move(l, k-1, m);
+            leaf_insert(l, i, e);
+        } else {
+            leaf_move(l, k, m);
+            leaf_insert(m, i-k, e);
+        }
+    }
+    m->next = l->next;
+    if (m->next) m->next->prev = m;
+    m->prev = l;
+    l->next = m;
+    bt_insert_child(tc, path, (BNode*)l, m->keys[0], (BNode*)m);
+}
+
+/* Appends all the entries of M to L, and unlinks M. */
+static void leaf_merge(BLeaf *l, BLeaf *m)
+{
+    leaf_move(m, 0, l);
+    l->next = m->next;
+    if (l->next) l->next->prev = l;
+    m->prev = m->next = NULL;
+}
+
+/* Removes the child at index K of the branch at level D of PATH,
+   and rebalances the tree up to the root. */
+static void bt_remove_child(ScmTreeCore *tc, BPath *path, int d, int k)
+{
+    for (;;) {
+        BBranch *b = path->node[d];
+        branch_remove(b, k);
+        if (d == 0) {
+            if (b->n == 1) SET_BROOT(tc, b->children[0]);
+            return;
+        }
+        if (b->n >= BT_MIN) return;
+
+        BBranch *p = path->node[d-1];
+        int j = path->index[d-1];
+        BBranch *ls = (j > 0)? (BBranch*)p->children[j-1] : NULL;
+        BBranch *rs = (j < p->n-1)? (BBranch*)p->children[j+1] : NULL;
+        if (ls && ls->n > BT_MIN) {
+            branch_insert(b, 0, 0, ls->children[ls->n-1]);
+            b->keys[1] = p->keys[j];
+            p->keys[j] = ls->keys[ls->n-1];
+            branch_remove(ls, ls->n-1);
+            return;
+        }
+        if (rs && rs->n > BT_MIN) {
+            branch_insert(b, b->n, p->keys[j+1], rs->children[0]);
+            p->keys[j+1] = rs->keys[1];
+            branch_remove(rs, 0);
+            return;
+        }
+        if (ls) {
+            branch_move(b, 0, p->keys[j], ls);
+            k = j;
+        } else {
+            SCM_ASSERT(rs != NULL);
+            branch_move(rs, 0, p->keys[j+1], b);
+            k = j+1;
+        }
+        d--;
+    }
+}
+
+/* Removes the entry at index I of the leaf L, and returns it. */
+static BEntry *bt_delete(ScmTreeCore *tc, BPath *path, BLeaf *l, int i)
+{
+    BEntry *e = l->entries[i];
+    leaf_remove(l, i);
+
+    if (path->depth == 0) {
+        if (l->n == 0) SET_BROOT(tc, NULL);
+        return e;
+    }
+    if (l->n >= BT_MIN || (l->next == NULL && l->n > 0)) return e;
+
+    BBranch *p = path->node[path->depth-1];
+    int k = path->index[path->depth-1];
+    BLeaf *ls = (k > 0)? (BLeaf*)p->children[k-1] : NULL;
+    BLeaf *rs = (k < p->n-1)? (BLeaf*)p->children[k+1] : NULL;
+    if (ls && ls->n > BT_MIN) {
+        leaf_insert(l, 0, ls->entries[ls->n-1]);
+        leaf_remove(ls, ls->n-1);
+        p->keys[k] = l->keys[0];
+    } else if (rs && rs->n > BT_MIN) {
+        leaf_insert(l, l->n, rs->entries[0]);
+        leaf_remove(rs, 0);
+        p->keys[k+1] = rs->keys[0];
+    } else if (ls) {
+        leaf_merge(ls, l);
+        bt_remove_child(tc, path, path->depth-1, k);
+    } else {
+        SCM_ASSERT(rs != NULL);
+        leaf_merge(l, rs);
+        bt_remove_child(tc, path, path->depth-1, k+1);
+    }
+    return e;
+}
+
+/* Entry at index I of L, or the first one in the next leaf if I == L->n */
+static ScmDictEntry *bt_entry_at(BLeaf *l, int i)
+{
+    if (i < l->n) return (ScmDictEntry*)l->entries[i];
+    if (l->next)  return (ScmDictEntry*)l->next->entries[0];
+    return NULL;
+}
+
+/* Entry right before index I of L */
+static ScmDictEntry *bt_entry_before(BLeaf *l, int i)
+{
+    if (i > 0)   return (ScmDictEntry*)l->entries[i-1];
+    if (l->prev) return (ScmDictEntry*)l->prev->entries[l->prev->n-1];
+    return NULL;
+}
+
+static ScmDictEntry *bt_ref(ScmTreeCore *tc, intptr_t key, enum TreeOp op,
+                            ScmDictEntry **lo, ScmDictEntry **hi)
+{
+    if (BROOT(tc) == NULL) {
+        if (op == TREE_CREATE) {
+            BLeaf *l = new_leaf();
+            BEntry *e = new_entry(key, 0);
+            leaf_insert(l, 0, e);
+            SET_BROOT(tc, l);
+            tc->num_entries++;
+            return (ScmDictEntry*)e;
+        }
+        if (op == TREE_NEAR) {
+            *lo = *hi = NULL;
+        }
+        return NULL;
+    }
+
+    BPath path;
+    int found;
+    BLeaf *l = bt_descend(tc, key, &path);
+    int i = leaf_search(tc, l, key, &found);
+
+    switch (op) {
+    case TREE_GET:
+        return found? (ScmDictEntry*)l->entries[i] : NULL;
+    case TREE_CREATE:
+        if (found) return (ScmDictEntry*)l->entries[i];
+        else {
+            BEntry *e = new_entry(key, 0);
+            bt_insert(tc, &path, l, i, e);
+            tc->num_entries++;
+            return (ScmDictEntry*)e;
+        }
+    case TREE_DELETE:
+        if (!found) return NULL;
+        tc->num_entries--;
+        return (ScmDictEntry*)bt_delete(tc, &path, l, i);
+    case TREE_NEAR:
+        *lo = bt_entry_before(l, i);
+        *hi = bt_entry_at(l, found? i+1 : i);
+        return found? (ScmDictEntry*)l->entries[i] : NULL;
+    }
+    return NULL;                /* dummy */
+}
+
+static ScmDictEntry *bt_bound(ScmTreeCore *tc, ScmTreeCoreBoundOp op, int pop)
+{
+    if (BROOT(tc) == NULL) return NULL;
+
+    BPath path;
+    int maxp = (op == SCM_TREE_CORE_MAX);
+    BLeaf *l = bt_descend_edge(tc, maxp, &path);
+    int i = maxp? l->n - 1 : 0;
+    if (pop) {
+        tc->num_entries--;
+        return (ScmDictEntry*)bt_delete(tc, &path, l, i);
+    } else {
+        return (ScmDictEntry*)l->entries[i];
+    }
+}
+
+/* Builds a tree from sorted entries.  Each node gets as many entries
+   or children as possible, while keeping them at least BT_MIN. */
+static void bt_build(ScmTreeCore *tc, BEntry **entries, int num_entries)
+{
+    if (num_entries == 0) {
+        SET_BROOT(tc, NULL);
+        return;
+    }
+
+    int count = (num_entries + BT_ORDER - 1)/BT_ORDER;
+    BNode **nodes = SCM_NEW_ARRAY(BNode*, count);
+    intptr_t *mins = SCM_NEW_ATOMIC_ARRAY(intptr_t, count);
+    BLeaf *prev = NULL;
+    for (int j = 0, k = 0; j < count; j++) {
+        int n = num_entries/count + (j < num_entries%count);
+        BLeaf *l = new_leaf();
+        for (int i = 0; i < n; i++, k++) {
+            l->keys[i] = entries[k]->key;
+            l->entries[i] = entries[k];
+        }
+        l->n = n;
+        l->prev = prev;
+        if (prev) prev->next = l;
+        prev = l;
+        nodes[j] = (BNode*)l;
+        mins[j] = l->keys[0];
+    }
+
+    /* Nodes of the upper level replace the ones of the lower level
+       in NODES and MINS from the beginning.  It is safe, since we
+       always read ahead of where we write. */
+    while (count > 1) {
+        int nb = (count + BT_ORDER - 1)/BT_ORDER;
+        for (int j = 0, k = 0; j < nb; j++) {
+            int n = count/nb + (j < count%nb);
+            BBranch *b = new_branch();
+            for (int i = 0; i < n; i++, k++) {
+                b->keys[i] = mins[k];
+                b->children[i] = nodes[k];
+            }
+            b->n = n;
+            mins[j] = b->keys[0];
+            b->keys[0] = 0;
+            nodes[j] = (BNode*)b;
+        }
+        count = nb;
+    }
+    SET_BROOT(tc, nodes[0]);
+}
+
+static void bt_bulk_load(ScmTreeCore *tc, const intptr_t *keys,
+                         const intptr_t *values, int num_entries)
+{
+    BEntry **entries = SCM_NEW_ARRAY(BEntry*, num_entries);
+    for (int i = 0; i < num_entries; i++) {
+        entries[i] = new_entry(keys[i], values[i]);
+    }
+    bt_build(tc, entries, num_entries);
+}
+
+/* Copies the entries and rebuilds the tree, which is as fast as copying
+   the nodes and gives a packed tree. */
+static void bt_copy(ScmTreeCore *dst, const ScmTreeCore *src)
+{
+    BEntry **entries = SCM_NEW_ARRAY(BEntry*, src->num_entries);
+    int k = 0;
+    if (BROOT(src)) {
+        BNode *n = BROOT(src);
+        while (!n->leafp) n = ((BBranch*)n)->children[0];
+        for (BLeaf *l = (BLeaf*)n; l; l = l->next) {
+            for (int i = 0; i < l->n; i++, k++) {
+                SCM_ASSERT(k < src->num_entries);
+                entries[k] = new_entry(l->entries[i]->key,
+                                       l->entries[i]->value);
+            }
+        }
+    }
+    SCM_ASSERT(k == src->num_entries);
+    bt_build(dst, entries, k);
+}
+
+/*
+ * Iterator
+ */
+
+/* Moves (L, I) by one entry to the direction DIR.  Returns FALSE if we
+   go off the end. */
+static int bt_step(BLeaf **l, int *i, int dir)
+{
+    *i += dir;
+    if (*i >= (*l)->n) {
+        *l = (*l)->next;
+        *i = 0;
+    } else if (*i < 0) {
+        *l = (*l)->prev;
+        if (*l) *i = (*l)->n - 1;
+    }
+    return *l != NULL;
+}
+
+/* Finds the position of the entry E in the tree.  Returns FALSE if E
+   is no longer in the tree. */
+static int bt_locate(ScmTreeCore *tc, BEntry *e, BLeaf **l, int *i)
+{
+    if (BROOT(tc) == NULL) return FALSE;
+    BPath path;
+    int found;
+    *l = bt_descend(tc, e->key, &path);
+    *i = leaf_search(tc, *l, e->key, &found);
+    return found && (*l)->entries[*i] == e;
+}
+
+/* Finds the position of the entry next to KEY to the direction DIR,
+   not including KEY itself. */
+static int bt_seek(ScmTreeCore *tc, intptr_t key, int dir, BLeaf **l, int *i)
+{
+    if (BROOT(tc) == NULL) return FALSE;
+    BPath path;
+    int found;
+    *l = bt_descend(tc, key, &path);
+    *i = leaf_search(tc, *l, key, &found);
+    if (dir < 0 || found) return bt_step(l, i, dir);
+    if (*i < (*l)->n) return TRUE;
+    return bt_step(l, i, 0);    /* *i == n; go to the next leaf */
+}
+
+static void bt_iter_init(ScmTreeIter *iter, ScmDictEntry *start)
+{
+    if (start) {
+        BLeaf *l;
+        int i;
+        if (!bt_locate(iter->t, (BEntry*)start, &l, &i)) {
+            Scm_Error("Scm_TreeIterInit: iteration start point is not a part of the tree.");
+        }
+        iter->c = start;
+        iter->n = (ScmDictEntry*)l;
+        iter->p = NULL;
+    } else {
+        iter->c = NULL;
+        iter->n = bt_bound(iter->t, SCM_TREE_CORE_MIN, FALSE);
+        iter->p = bt_bound(iter->t, SCM_TREE_CORE_MAX, FALSE);
+    }
+}
+
+/* While iter->c is in the tree, iter->n is its leaf.  We check if the
+   entry is still there, and if not, the tree has been modified and we
+   search the entry again by its key.  If the entry itself has been
+   deleted, we go to the one next to its key. */
+static ScmDictEntry *bt_iter_step(ScmTreeIter *iter, int dir)
+{
+    ScmTreeCore *tc = iter->t;
+    BEntry *c = (BEntry*)iter->c;
+    BLeaf *l = NULL;
+    int i = 0, ok;
+
+    if (c == NULL) {
+        /* Initial or exhausted state */
+        BEntry *e = (BEntry*)((dir > 0)? iter->n : iter->p);
+        if (e == NULL) return NULL;
+        ok = (bt_locate(tc, e, &l, &i) || bt_seek(tc, e->key, dir, &l, &i));
+    } else {
+        l = (BLeaf*)iter->n;
+        for (i = 0; i < l->n; i++) {
+            if (l->entries[i] == c) break;
+        }
+        if (i < l->n || bt_locate(tc, c, &l, &i)) {
+            ok = bt_step(&l, &i, dir);
+        } else {
+            ok = bt_seek(tc, c->key, dir, &l, &i);
+        }
+    }
+
+    if (ok) {
+        iter->c = (ScmDictEntry*)l->entries[i];
+        iter->n = (ScmDictEntry*)l;
+        iter->p = NULL;
+    } else {
+        iter->c = NULL;
+        iter->n = (dir > 0)? NULL : (ScmDictEntry*)c;
+        iter->p = (dir > 0)? (ScmDictEntry*)c : NULL;
+    }
+    return iter->c;
+}
+
+/*
+ * Consistency check and dump
+ */
+
+typedef struct BCheckRec {
+    ScmTreeCore *tc;
+    int leaf_depth;
+    BLeaf *last;                /* the last leaf we've seen */
+    int count;
+} BCheck;
+
+/* Keys in node N must be within [*LO, *HI).  LO and HI can be NULL
+   if there's no bound. */
+static void bt_check_node(BCheck *ck, BNode *n, int depth, int rightp,
+                          const intptr_t *lo, const intptr_t *hi)
+{
+    ScmTreeCore *tc = ck->tc;
+    int rootp = (depth == 0);
+
+    if (n->n > BT_ORDER) {
+        Scm_Error("[internal] btree node overflow: %d", n->n);
+    }
+    if (n->leafp) {
+        BLeaf *l = (BLeaf*)n;
+        if (l->n == 0 || (!rootp && !(rightp && l->next == NULL)
+                          && l->n < BT_MIN)) {
+            Scm_Error("[internal] btree leaf underflow: %d", l->n);
+        }
+        if (ck->leaf_depth < 0) ck->leaf_depth = depth;
+        else if (ck->leaf_depth != depth) {
+            Scm_Error("[internal] btree has leaves of different depth "
+                      "(%d vs %d)", ck->leaf_depth, depth);
+        }
+        if (l->prev != ck->last || (ck->last && ck->last->next != l)) {
+            Scm_Error("[internal] btree leaf chain is broken");
+        }
+        for (int i = 0; i < l->n; i++) {
+            if (l->entries[i] == NULL || l->entries[i]->key != l->keys[i]) {
+                Scm_Error("[internal] btree leaf has an inconsistent entry");
+            }
+            if ((i > 0 && bt_cmp(tc, l->keys[i-1], l->keys[i]) >= 0)
+                || (i == 0 && ck->last
+                    && bt_cmp(tc, ck->last->keys[ck->last->n-1],
+                              l->keys[0]) >= 0)
+                || (lo && bt_cmp(tc, *lo, l->keys[i]) > 0)
+                || (hi && bt_cmp(tc, l->keys[i], *hi) >= 0)) {
+                Scm_Error("[internal] btree keys are out of order");
+            }
+        }
+        ck->last = l;
+        ck->count += l->n;
+    } else {
+        BBranch *b = (BBranch*)n;
+        if (b->n < (rootp? 2 : BT_MIN)) {
+            Scm_Error("[internal] btree branch underflow: %d", b->n);
+        }
+        for (int i = 1; i < b->n; i++) {
+            if ((i > 1 && bt_cmp(tc, b->keys[i-1], b->keys[i]) >= 0)
+                || (lo && bt_cmp(tc, *lo, b->keys[i]) > 0)
+                || (hi && bt_cmp(tc, b->keys[i], *hi) >= 0)) {
+                Scm_Error("[internal] btree separators are out of order");
+            }
+        }
+        for (int i = 0; i < b->n; i++) {
+            bt_check_node(ck, b->children[i], depth+1,
+                          rightp && i == b->n-1,
+                          (i == 0)? lo : &b->keys[i],
+                          (i == b->n-1)? hi : &b->keys[i+1]);
+        }
+    }
+}
+
+static void bt_check(ScmTreeCore *tc)
+{
+    BCheck ck = { tc, -1, NULL, 0 };
+    if (BROOT(tc)) {
+        bt_check_node(&ck, BROOT(tc), 0, TRUE, NULL, NULL);
+        if (ck.last->next != NULL) {
+            Scm_Error("[internal] btree leaf chain is broken");
+        }
+    }
+    if (ck.count != tc->num_entries) {
+        Scm_Error("[internal] tree map node count mismatch: record %d vs actual %d", tc->num_entries, ck.count);
+    }
+}
+
+static void bt_dump_node(BNode *n, int depth, ScmPort *out, int scmobj)
+{
+    if (n->leafp) {
+        BLeaf *l = (BLeaf*)n;
+        for (int i = 0; i < l->n; i++) {
+            for (int j = 0; j < depth; j++) Scm_Printf(out, "  ");
+            if (scmobj) {
+                Scm_Printf(out, "%S => %S\n", SCM_OBJ(l->entries[i]->key),
+                           SCM_OBJ(l->entries[i]->value));
+            } else {
+                Scm_Printf(out, "%08x => %08x\n", l->entries[i]->key,
+                           l->entries[i]->value);
+            }
+        }
+    } else {
+        BBranch *b = (BBranch*)n;
+        for (int i = 0; i < b->n; i++) {
+            if (i > 0) {
+                for (int j = 0; j < depth; j++) Scm_Printf(out, "  ");
+                if (scmobj) Scm_Printf(out, "[%S]\n", SCM_OBJ(b->keys[i]));
+                else        Scm_Printf(out, "[%08x]\n", b->keys[i]);
+            }
+            bt_dump_node(b->children[i], depth+1, out, scmobj);
+        }
+    }
+}
+
+static void bt_dump(ScmTreeCore *tc, ScmPort *out, int scmobj)
+{
+    if (BROOT(tc)) bt_dump_node(BROOT(tc), 0, out, scmobj);
+}
@@ -2577,6 +2577,8 @@ static ScmObj throw_cont_body(ScmObj handlers,    /* after/before thunks
     vm->cont = ep->cont;
     /* restore reset-chain for reset/shift */
     if (ep->cstack) vm->resetChain = ep->resetChain;
+    /* one-shot continuation won't be used again; let the frames go */
+    if (ep->oneShot) ep->cont = NULL;
 
     nargs = Scm_Length(args);
     if (nargs == 1) {
@@ -2618,6 +2620,13 @@ static ScmObj throw_continuation(ScmObj *argframe,
     ScmObj args = argframe[0];
     ScmVM *vm = theVM;
 
+    if (ep->oneShot) {
+        if (ep->shot) {
+            Scm_Error("one-shot continuation invoked more than once");
+        }
+        ep->shot = TRUE;
+    }
+
     /* First, check to see if we need to rewind C stack.
        NB: If we are invoking a partial continuation (ep->cstack == NULL),
        we execute it on the current cstack. */
@@ -2673,7 +2682,17 @@ static ScmObj throw_continuation(ScmObj *argframe,
     return throw_cont_body(handlers_to_call, ep, args);
 }
 
-ScmObj Scm_VMCallCC(ScmObj proc)
+/* NB: save_cont only copies the frames that are still in the stack.
+   The frames moved to the heap by the previous captures are shared, so
+   the cost of capturing is proportional to the frames pushed since the
+   last capture, not to the depth of the whole continuation.
+
+   A one-shot continuation (call/1cc) is captured in the same way, but
+   it can be invoked only once, and it drops the captured frames when
+   invoked.  When two contexts pass the control back and forth by
+   capturing a fresh continuation every time, as coroutines and
+   generators do, the chain of the past captures won't be retained. */
+static ScmObj call_cc(ScmObj proc, int oneShot)
 {
     ScmVM *vm = theVM;
 
@@ -2686,17 +2705,29 @@ ScmObj Scm_VMCallCC(ScmObj proc)
     ep->cstack = vm->cstack;
     ep->resetChain = vm->resetChain;
     ep->partHandlers = SCM_NIL;
+    ep->oneShot = oneShot;
+    ep->shot = FALSE;
 
     ScmObj contproc = Scm_MakeSubr(throw_continuation, ep, 0, 1,
                                    SCM_MAKE_STR("continuation"));
     return Scm_VMApply1(proc, contproc);
 }
 
+ScmObj Scm_VMCallCC(ScmObj proc)
+{
+    return call_cc(proc, FALSE);
+}
+
+ScmObj Scm_VMCallOneShotCC(ScmObj proc)
+{
+    return call_cc(proc, TRUE);
+}
+
 /* call with partial continuation.  this corresponds to the 'shift' operator
    in shift/reset controls (Gasbichler&Sperber, "Final Shift for Call/cc",
    ICFP02.)   Note that we treat the boundary frame as the bottom of
    partial continuation. */
-ScmObj Scm_VMCallPC(ScmObj proc)
+static ScmObj call_pc(ScmObj proc, int oneShot)
 {
     ScmVM *vm = theVM;
 
@@ -2731,6 +2762,8 @@ ScmObj Scm_VMCallPC(ScmObj proc)
                           on any cstack state. */
     ep->resetChain = vm->resetChain;
     ep->partHandlers = SCM_NIL;
+    ep->oneShot = oneShot;
+    ep->shot = FALSE;
 
     /* get the dynamic handlers chain saved on reset */
     ScmObj reset_handlers = (SCM_PAIRP(vm->resetChain)?
@@ -2765,6 +2798,16 @@ ScmObj Scm_VMCallPC(ScmObj proc)
     return Scm_VMApply1(proc, contproc);
 }
 
+ScmObj Scm_VMCallPC(ScmObj proc)
+{
+    return call_pc(proc, FALSE);
+}
+
+ScmObj Scm_VMCallOneShotPC(ScmObj proc)
+{
+    return call_pc(proc, TRUE);
+}
+
 ScmObj Scm_VMReset(ScmObj proc)
 {
     ScmVM *vm = theVM;
@@ -0,0 +1,55 @@
+;;;
+;;; Performance test of binary record decoding/encoding
+;;;
+
+(use gauche.time)
+(use gauche.uvector)
+(use binary.io)
+
+(define *count* 100000)
+
+(define *layout*
+  (make-binary-layout '((id u32) (flags u8) 3 (x f64) (y f64)) 'big-endian))
+
+(define *data*
+  (rlet1 v (make-u8vector (* *count* (binary-layout-size *layout*)) 0)
+    (dotimes [i *count*]
+      (put-record! *layout* v (* i (binary-layout-size *layout*))
+                   (vector i (logand i #xff) (* i 0.5) (* i -0.25))))))
+
+;; Decode field by field, the way it had to be done without layouts.
+(define (per-field)
+  (let ([ids (make-u32vector *count*)]
+        [flags (make-u8vector *count*)]
+        [xs (make-f64vector *count*)]
+        [ys (make-f64vector *count*)])
+    (dotimes [i *count*]
+      (let1 off (* i 24)
+        (u32vector-set! ids i (get-u32be *data* off))
+        (u8vector-set! flags i (get-u8 *data* (+ off 4)))
+        (f64vector-set! xs i (get-f64be *data* (+ off 8)))
+        (f64vector-set! ys i (get-f64be *data* (+ off 16)))))
+    (vector ids flags xs ys)))
+
+(print #"decoding ~|*count*| records of ~(binary-layout-size *layout*) bytes")
+(time-these/report
+ '(cpu 5)
+ `((per-field   . ,per-field)
+   (get-record  . ,(^[] (dotimes [i *count*]
+                          (get-record *layout* *data* (* i 24)))))
+   (get-records . ,(^[] (get-records *layout* *data* 0)))))
+
+(print #"encoding ~|*count*| records")
+(let ([cols (get-records *layout* *data* 0)]
+      [dst (make-u8vector (u8vector-length *data*))])
+  (time-these/report
+   '(cpu 5)
+   `((per-field    . ,(^[] (dotimes [i *count*]
+                             (let1 off (* i 24)
+                               (put-u32be! dst off (u32vector-ref (~ cols 0) i))
+                               (put-u8! dst (+ off 4) (u8vector-ref (~ cols 1) i))
+                               (put-f64be! dst (+ off 8) (f64vector-ref (~ cols 2) i))
+                               (put-f64be! dst (+ off 16) (f64vector-ref (~ cols 3) i))))))
+     (put-records! . ,(^[] (put-records! *layout* dst 0 cols)))
+     (write-records . ,(^[] (call-with-output-string
+                              (cut write-records *layout* cols <>)))))))
@@ -0,0 +1,65 @@
+;;;
+;;; Performance test of chunk generators
+;;;
+
+;; Runs a read -> map -> filter -> fold pipeline over lines of numbers,
+;; once with per-item generators and once with chunk generators, and the
+;; same for a uvector source.  Bytes allocated per item is also shown.
+
+(use gauche.time)
+(use gauche.generator)
+(use gauche.uvector)
+
+(define *count* 500000)
+
+(define *text*
+  (with-output-to-string
+    (^[] (dotimes [i *count*] (print i)))))
+(define *uvec* (let1 v (make-u32vector *count*)
+                 (dotimes [i *count*] (u32vector-set! v i i))
+                 v))
+
+(define (allocated) (cadr (assq :total-bytes (gc-stat))))
+
+(define (run tag thunk)
+  (let ([counter (make <real-time-counter>)]
+        [bytes0 (allocated)])
+    (let1 r (with-time-counter counter (thunk))
+      (format #t "~32a: ~8,3f sec, ~6,1f bytes/item (~a)\n"
+              tag (time-counter-value counter)
+              (/. (- (allocated) bytes0) *count*) r))))
+
+(define (lines thunk) (with-input-from-string *text* thunk))
+
+(run "lines, per item"
+     (^[] (lines
+           (^[] (generator-fold + 0
+                                (gfilter even?
+                                         (gmap string->number
+                                               (port->line-generator
+                                                (current-input-port)))))))))
+(run "lines, chunks"
+     (^[] (lines
+           (^[] (gchunk-fold + 0
+                             (gchunk-filter even?
+                                            (gchunk-map string->number
+                                                        (port->line-chunk-generator
+                                                         (current-input-port)))))))))
+(run "u32vector, per item"
+     (^[] (generator-fold + 0
+                          (gfilter even?
+                                   (gmap (cut * <> 3)
+                                         (uvector->generator *uvec*))))))
+(run "u32vector, chunks"
+     (^[] (gchunk-fold + 0
+                       (gchunk-filter even?
+                                      (gchunk-map (cut * <> 3)
+                                                  (uvector->chunk-generator
+                                                   *uvec*))))))
+(run "u32vector, gchunks fallback"
+     (^[] (gchunk-fold + 0
+                       (gchunk-filter even?
+                                      (gchunk-map (cut * <> 3)
+                                                  (gchunks
+                                                   (uvector->generator
+                                                    *uvec*)))))))
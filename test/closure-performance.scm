@@ -0,0 +1,39 @@
+;;;
+;;; Allocation by closures passed to higher-order procedures
+;;;
+
+;; Calls map, for-each and fold with a lambda that closes local variables.
+;; The compiler expands such calls into loops so that the lambda doesn't
+;; escape and is inlined.  The baseline calls the same procedures through
+;; variables the compiler doesn't know, which creates the closures and
+;; moves the environment frames to the heap on every call.
+;; Bytes allocated per call is also shown.
+
+(use gauche.time)
+
+(define *count* 200000)
+(define *list* (iota 10))
+
+;; Opaque to the compiler
+(define map* map)
+(define for-each* for-each)
+(define fold* fold)
+
+(define (allocated) (cadr (assq :total-bytes (gc-stat))))
+
+(define (run tag proc)
+  (let ([counter (make <real-time-counter>)]
+        [bytes0 (allocated)])
+    (with-time-counter counter
+      (dotimes [i *count*] (proc i)))
+    (format #t "~24a: ~8,3f sec, ~8,1f bytes/call\n"
+            tag (time-counter-value counter)
+            (/. (- (allocated) bytes0) *count*))))
+
+(run "fold" (^k (fold (^[x acc] (+ x acc k)) 0 *list*)))
+(run "fold (closure)" (^k (fold* (^[x acc] (+ x acc k)) 0 *list*)))
+(run "for-each" (^k (let1 s 0 (for-each (^x (set! s (+ s x k))) *list*) s)))
+(run "for-each (closure)"
+     (^k (let1 s 0 (for-each* (^x (set! s (+ s x k))) *list*) s)))
+(run "map" (^k (map (^x (* x k)) *list*)))
+(run "map (closure)" (^k (map* (^x (* x k)) *list*)))
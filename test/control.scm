@@ -193,6 +193,181 @@
   ] ; gauche.sys.pthreads
  [else])
 
+;;--------------------------------------------------------------------
+;; control.fiber
+;;
+(test-section "control.fiber")
+(use control.fiber)
+(use gauche.net)
+(test-module 'control.fiber)
+
+(define *carriers* (cond-expand [gauche.sys.pthreads 3] [else 1]))
+
+(test* "run-fibers" '(1 2)
+       (receive r (run-fibers (^[] (values 1 2)) :carriers *carriers*) r))
+
+(test* "run-fibers exception" (test-error <error> "boo")
+       (run-fibers (^[] (error "boo")) :carriers *carriers*))
+
+(test* "current-fiber" '(#f #t)
+       (list (current-fiber)
+             (run-fibers (^[] (fiber? (current-fiber))) :carriers *carriers*)))
+
+(test* "spawn and join" (map (cut * <> <>) (iota 20))
+       (run-fibers (^[] (map fiber-join
+                             (map (^i (spawn-fiber (^[] (* i i))))
+                                  (iota 20))))
+                   :carriers *carriers*))
+
+(test* "join propagates exception" '(caught "oops")
+       (run-fibers (^[]
+                     (let1 f (spawn-fiber (^[] (fiber-yield) (error "oops")))
+                       (guard (e [(<error> e) (list 'caught
+                                                    (condition-message e))])
+                         (fiber-join f))))
+                   :carriers *carriers*))
+
+(test* "yield" '(a0 b0 a1 b1 a2 b2)
+       (let1 r '()
+         (run-fibers
+          (^[]
+            (let ([a (spawn-fiber (^[] (dotimes [i 3]
+                                         (push! r (symbol-append 'a i))
+                                         (fiber-yield))))]
+                  [b (spawn-fiber (^[] (dotimes [i 3]
+                                         (push! r (symbol-append 'b i))
+                                         (fiber-yield))))])
+              (fiber-join a)
+              (fiber-join b)))
+          :carriers 1)
+         (reverse r)))
+
+(test* "sleep" '(c b a)
+       (let ([r '()]
+             [m (make-mutex)])
+         (run-fibers
+          (^[]
+            (for-each fiber-join
+                      (map (^[name delay]
+                             (spawn-fiber (^[] (fiber-sleep delay)
+                                            (mutex-lock! m)
+                                            (push! r name)
+                                            (mutex-unlock! m))))
+                           '(a b c) '(0.3 0.2 0.1))))
+          :carriers *carriers*)
+         (reverse r)))
+
+(test* "guard across switching" 'ok
+       (run-fibers (^[] (guard (e [(eq? e 'x) 'ok])
+                          (fiber-sleep 0.01)
+                          (fiber-yield)
+                          (raise 'x)))
+                   :carriers *carriers*))
+
+(test* "drain?" 10
+       (let ([n 0]
+             [m (make-mutex)])
+         (run-fibers (^[] (dotimes [i 10]
+                            (spawn-fiber (^[] (fiber-sleep 0.05)
+                                           (mutex-lock! m)
+                                           (inc! n)
+                                           (mutex-unlock! m)))))
+                     :carriers *carriers* :drain? #t)
+         n))
+
+(test* "fiber-mutex" 1000
+       (let ([n 0]
+             [fm (make-fiber-mutex)])
+         (run-fibers
+          (^[]
+            (for-each fiber-join
+                      (map (^_ (spawn-fiber
+                                (^[] (dotimes [j 100]
+                                       (with-fiber-mutex fm
+                                         (^[] (let1 v n
+                                                (fiber-yield)
+                                                (set! n (+ v 1)))))))))
+                           (iota 10))))
+          :carriers *carriers*)
+         n))
+
+(test* "fiber-mutex unlock by non-owner" (test-error)
+       (run-fibers (^[] (let1 fm (make-fiber-mutex)
+                          (fiber-join (spawn-fiber
+                                       (^[] (fiber-mutex-lock! fm))))
+                          (fiber-mutex-unlock! fm)))))
+
+(test* "fiber-queue" (iota 100)
+       (run-fibers
+        (^[]
+          (let* ([q (make-fiber-queue :max-length 2)]
+                 [consumer (spawn-fiber
+                            (^[] (let loop ([r '()])
+                                   (let1 x (fiber-dequeue! q)
+                                     (if (eof-object? x)
+                                       (reverse r)
+                                       (loop (cons x r)))))))])
+            (dotimes [i 100] (fiber-enqueue! q i))
+            (fiber-enqueue! q (eof-object))
+            (fiber-join consumer)))
+        :carriers *carriers*))
+
+(test* "fiber-queue without waiting" '(2 a b)
+       (let1 q (make-fiber-queue)
+         (fiber-enqueue! q 'a)
+         (fiber-enqueue! q 'b)
+         (list (fiber-queue-length q) (fiber-dequeue! q) (fiber-dequeue! q))))
+
+(test* "fiber-queue empty" (test-error)
+       (fiber-dequeue! (make-fiber-queue)))
+
+(test* "fiber-wait-readable" '(woken #\x)
+       (receive (in out) (sys-pipe)
+         (begin0
+           (run-fibers
+            (^[]
+              (let1 f (spawn-fiber (^[] (fiber-wait-readable in)
+                                     (list 'woken (read-char in))))
+                (fiber-sleep 0.05)
+                (write-char #\x out)
+                (flush out)
+                (fiber-join f)))
+            :carriers 1)
+           (close-port in)
+           (close-port out))))
+
+(test* "socket echo" (map (^i (format "hello ~d" i)) (iota 20))
+       (let* ([server (make-server-socket 'inet 0 :reuse-addr? #t)]
+              [port (sockaddr-port (socket-getsockname server))])
+         (unwind-protect
+             (run-fibers
+              (^[]
+                (define (serve clnt)
+                  (let loop ()
+                    (let1 msg (fiber-socket-recv clnt 100)
+                      (if (zero? (string-size msg))
+                        (socket-close clnt)
+                        (begin (fiber-socket-send clnt msg) (loop))))))
+                (define (request i)
+                  (let ([sock (make-socket PF_INET SOCK_STREAM)]
+                        [msg (format "hello ~d" i)])
+                    (fiber-socket-connect sock (make <sockaddr-in>
+                                                 :host "127.0.0.1" :port port))
+                    (fiber-socket-send sock msg)
+                    (let loop ([r ""])
+                      (if (< (string-length r) (string-length msg))
+                        (loop (string-append r (fiber-socket-recv sock 100)))
+                        (begin (socket-close sock)
+                               (string-incomplete->complete r))))))
+                (spawn-fiber (^[] (let loop ()
+                                    (let1 clnt (fiber-socket-accept server)
+                                      (spawn-fiber (cut serve clnt))
+                                      (loop)))))
+                (map fiber-join
+                     (map (^i (spawn-fiber (cut request i))) (iota 20))))
+              :carriers *carriers*)
+           (socket-close server))))
+
 ;;--------------------------------------------------------------------
 ;; control.mapper
 ;;
@@ -0,0 +1,42 @@
+;;;
+;;; Performance test of CSV reader
+;;;
+
+;; Uses the postal code data in ext/peg/data, repeated to make it large
+;; enough.  Compares the Scheme tokenizer, the native one, and parallel
+;; parsing of a whole file.  Run this in the test directory.
+
+(use gauche.time)
+(use text.csv)
+
+(define *repeat* 10)
+(define *file* "csv-performance.o.csv")
+
+(define *data*
+  (let1 s (call-with-input-file "../ext/peg/data/13tokyo.csv" port->string)
+    (string-concatenate (make-list *repeat* s))))
+
+(with-output-to-file *file* (cut display *data*))
+
+(define (scheme-reader port)
+  ((with-module text.csv csv-reader) #\, #\" port))
+
+(define (read-all reader)
+  (call-with-input-string *data* (cut port->list reader <>)))
+
+(define (run tag thunk)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter (thunk))
+    (format #t "~16a: ~8,1f MB/s\n"
+            tag (/. (string-size *data*) (time-counter-value counter) 1e6))))
+
+(print #"~(string-size *data*) bytes, "
+       #"~(sys-available-processors) processors available")
+(run "scheme" (^[] (read-all scheme-reader)))
+(run "native" (^[] (read-all (make-csv-reader #\,))))
+(run "native vector"
+     (^[] (read-all (make-csv-reader #\, :row-type 'vector))))
+(dolist [n (delete-duplicates `(1 2 4 ,(sys-available-processors)))]
+  (run #"file threads=~n" (^[] (csv-file->rows *file* #\, :threads n))))
+
+(sys-unlink *file*)
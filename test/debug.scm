@@ -33,4 +33,78 @@
                      [_ #f])
                    (call/cc (^x (ra x) #f))))
 
+;;----------------------------------------------------------------
+(test-section "profiler output")
+
+(use gauche.vm.profiler)
+
+(define *stacks-1* '((("main" "foo" "bar") . 3) (("main" "foo") . 2)))
+(define *stacks-2* '((("main" "foo" "bar") . 1) (("main" "a b;c") . 4)))
+
+(test* "profiler-write-flamegraph"
+       '("main;a_b_c 4" "main;foo 2" "main;foo;bar 4")
+       (sort (string-split
+              (with-output-to-string
+                (cut profiler-write-flamegraph
+                     :results (list *stacks-1* *stacks-2*)))
+              #\newline 'infix)
+             string<?)
+       (^[e r] (equal? e (remove string-null? r))))
+
+(test* "profiler-write-pprof" #t
+       (let1 out (string-incomplete->complete
+                  (with-output-to-string
+                    (cut profiler-write-pprof :results (list *stacks-1*)))
+                  #\?)
+         ;; We don't decode it; just check the string table is there.
+         (and (#/samples/ out) (#/nanoseconds/ out) (#/bar/ out) #t)))
+
+(test* "profiler-get-stacks" #t
+       (begin
+         (profiler-start)
+         (let loop ([i 0]) (when (< i 3000000) (loop (+ i 1))))
+         (profiler-stop)
+         (let1 r (profiler-get-stacks)
+           (profiler-reset)
+           (and (list? r)
+                (every (^e (and (every string? (car e))
+                                (exact-integer? (cdr e))))
+                       r)))))
+
+(define *kept* #f)
+(define (alloc-keep n) (set! *kept* (make-list n 'x)))
+(define (alloc-drop n) (length (make-list n 'x)))
+
+(let ()
+  (define (bytes-of allocs name)
+    (apply + (filter-map (^e (and (any (cut string-scan <> name) (car e))
+                                  (cadddr e)))
+                         allocs)))
+  (allocation-profiler-start 4096)
+  (alloc-keep 100000)
+  (dotimes [i 10] (alloc-drop 100000))
+  (test* "allocation-profiler-stop" #t (> (allocation-profiler-stop) 0))
+  (let ([total (profiler-get-allocations)]
+        [live  (profiler-get-allocations :live #t)])
+    (test* "profiler-get-allocations" #t
+           (every (^e (and (every string? (car e))
+                           (string? (cadr e))
+                           (exact-integer? (caddr e))
+                           (exact-integer? (cadddr e))))
+                  total))
+    (test* "profiler-get-allocations (total)" #t
+           (> (bytes-of total "alloc-drop") (bytes-of total "alloc-keep") 0))
+    (test* "profiler-get-allocations (live)" #t
+           (and (> (bytes-of live "alloc-keep") 0)
+                (< (bytes-of live "alloc-drop")
+                   (bytes-of total "alloc-drop"))))
+    (test* "profiler-write-flamegraph :allocations" #t
+           (boolean
+            (#/alloc-keep.*;<\w+> \d+/
+                (with-output-to-string
+                  (cut profiler-write-flamegraph :results (list total)
+                       :allocations #t))))))
+  (allocation-profiler-reset)
+  (test* "allocation-profiler-reset" #f (profiler-get-allocations)))
+
 (test-end)
@@ -0,0 +1,48 @@
+;;;
+;;; Performance test of SHA digests
+;;;
+
+;; Run this as is, and with the environment variable
+;; GAUCHE_SHA_KERNEL=generic (or =avx2) to compare the accelerated
+;; code with the plain C version.
+
+(use gauche.time)
+(use gauche.uvector)
+(use rfc.sha)
+
+(define *large-size* 1000000)
+(define *small-size* 64)
+(define *small-count* 10000)
+
+(define (make-message size seed)
+  (let1 v (make-u8vector size)
+    (dotimes [i size]
+      (u8vector-set! v i (modulo (* (+ i seed) 7919) 256)))
+    v))
+
+(define (large tag digest digest-string)
+  (let* ([v (make-message *large-size* 0)]
+         [s (u8vector->string v)])
+    (print #"~|tag| of ~|*large-size*| bytes")
+    (time-these/report
+     '(cpu 5)
+     `((via-port      . ,(^[] (with-input-from-string s digest)))
+       (string        . ,(^[] (digest-string s)))
+       (u8vector      . ,(^[] (digest-string v)))))))
+
+(define (small tag digest-string digest-strings)
+  (let1 msgs (list-tabulate *small-count*
+                            (^i (make-message *small-size* i)))
+    (print #"~|tag| of ~|*small-count*| messages of ~|*small-size*| bytes")
+    (time-these/report
+     '(cpu 5)
+     `((map    . ,(^[] (map digest-string msgs)))
+       (multi  . ,(^[] (digest-strings msgs)))))))
+
+(print "kernel: " ((with-module rfc.sha %sha-kernel-name)))
+
+(large 'sha1 sha1-digest sha1-digest-string)
+(large 'sha256 sha256-digest sha256-digest-string)
+(large 'sha512 sha512-digest sha512-digest-string)
+(small 'sha1 sha1-digest-string sha1-digest-strings)
+(small 'sha256 sha256-digest-string sha256-digest-strings)
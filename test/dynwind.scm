@@ -193,6 +193,43 @@
                       (^[] (set! x (cons 'a x))))))
              x)))
 
+;; One-shot continuations
+
+(test* "call/1cc (escape)" 3
+       (call/1cc (^k (for-each (^x (when (= x 3) (k x))) '(1 2 3 4)) #f)))
+
+(test* "call/1cc (values)" '(1 2 3)
+       (receive x (call/1cc (^k (k 1 2 3))) x))
+
+(test* "call/1cc (invoked twice)" (test-error)
+       (let ([k1 #f] [n 0])
+         (call/1cc (^k (set! k1 k)))
+         (inc! n)
+         (if (< n 3) (k1 n) n)))
+
+(test* "call/1cc (coroutines)" '(a 1 b 2 c 3)
+       (let ([r '()] [main #f] [co #f])
+         (define (co-body xs)
+           (dolist [x xs]
+             (set! r (cons x r))
+             (call/1cc (^k (set! co k) (main #f))))
+           (main #t))
+         (let loop ([i 1])
+           (if (call/1cc (^k (set! main k)
+                             (if co (co #f) (co-body '(a b c)))))
+             (reverse r)
+             (begin (set! r (cons i r)) (loop (+ i 1)))))))
+
+(test* "call/1cc & dynwind" '(out b in a)
+       (let1 x '()
+         (call/1cc
+          (^k (dynamic-wind
+                  (^[] (push! x 'a))
+                  (^[] (push! x 'in) (k #f) (push! x 'z))
+                  (^[] (push! x 'b)))))
+         (push! x 'out)
+         x))
+
 ;;------------------------------------------------------------------------
 ;; Test for dynamic-wind
 
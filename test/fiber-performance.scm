@@ -0,0 +1,68 @@
+;;;
+;;; Connection scaling of echo servers
+;;;
+
+;; Runs examples/echo-server.scm (selector-based, single thread) and
+;; examples/fiber-echo-server.scm (a fiber per connection), and measures
+;; the throughput of round trips with increasing number of concurrent
+;; connections.  The clients are fibers as well.  Run this in the src
+;; directory, after building.  You may need to raise the limit of open
+;; files (ulimit -n) for larger numbers of connections.
+
+(use gauche.time)
+(use gauche.process)
+(use gauche.net)
+(use control.fiber)
+
+(define *port* 3131)
+(define *round-trips* 20000)            ; total, split among connections
+(define *connections* '(1 10 100 500))
+(define *message* (make-string 64 #\x))
+
+(define (start-server script)
+  (rlet1 p (run-process `("./gosh" "-ftest" ,script ,(x->string *port*))
+                        :output :null)
+    ;; wait until it accepts connections
+    (let loop ([n 0])
+      (unless (guard (e [(and (<system-error> e) (< n 100))
+                         (sys-nanosleep #e1e8) #f])
+                (socket-close (make-client-socket 'inet "127.0.0.1" *port*))
+                #t)
+        (loop (+ n 1))))))
+
+(define (stop-server p)
+  (process-kill p)
+  (process-wait p))
+
+;; A client connection doing N round trips.
+(define (client n)
+  (let1 sock (make-socket PF_INET SOCK_STREAM)
+    (fiber-socket-connect sock (make <sockaddr-in>
+                                 :host "127.0.0.1" :port *port*))
+    (dotimes [_ n]
+      (fiber-socket-send sock *message*)
+      (let loop ([got 0])
+        (when (< got (string-length *message*))
+          (loop (+ got (string-size (fiber-socket-recv sock 4096)))))))
+    (socket-close sock)))
+
+;; Returns round trips per second.
+(define (run nconns)
+  (let ([counter (make <real-time-counter>)]
+        [per-conn (quotient *round-trips* nconns)])
+    (with-time-counter counter
+      (run-fibers (^[] (for-each fiber-join
+                                 (map (^_ (spawn-fiber (cut client per-conn)))
+                                      (iota nconns))))))
+    (/. (* per-conn nconns) (time-counter-value counter))))
+
+(define (bench name script)
+  (let1 p (start-server script)
+    (unwind-protect
+        (dolist [n *connections*]
+          (format #t "~12a connections=~4d: ~10,1f round trips/s\n"
+                  name n (run n)))
+      (stop-server p))))
+
+(bench "selector" "../examples/echo-server.scm")
+(bench "fiber" "../examples/fiber-echo-server.scm")
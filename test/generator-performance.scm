@@ -0,0 +1,51 @@
+;;;
+;;; Performance test of generate
+;;;
+
+;; Compares generate, which suspends the generator body with a one-shot
+;; partial continuation, with the same generator written with reset/shift
+;; of gauche.partcont, and with a closure-based generator as the baseline.
+;; The consumer pulls the values at different stack depths, to see that
+;; the cost per value doesn't grow with the depth.
+;; Bytes allocated per value is also shown.
+
+(use gauche.time)
+(use gauche.generator)
+(use gauche.partcont)
+
+(define *count* 100000)
+
+(define (allocated) (cadr (assq :total-bytes (gc-stat))))
+
+;; What generate used to be
+(define (generate/shift proc)
+  (define (cont)
+    (reset (proc (^[value] (shift k (set! cont k) value)))
+           (set! cont null-generator)
+           (eof-object)))
+  (^[] (cont)))
+
+(define (body yield)
+  (let loop ([i 0])
+    (when (< i *count*) (yield i) (loop (+ i 1)))))
+
+;; Consume GEN at the stack depth DEPTH
+(define (consume gen depth)
+  (if (zero? depth)
+    (let loop ([s 0])
+      (let1 v (gen)
+        (if (eof-object? v) s (loop (+ s v)))))
+    (+ 1 (consume gen (- depth 1)))))
+
+(define (run tag make-gen depth)
+  (let ([counter (make <real-time-counter>)]
+        [bytes0 (allocated)])
+    (with-time-counter counter (consume (make-gen) depth))
+    (format #t "~32a: ~8,3f sec, ~8,1f bytes/value\n"
+            tag (time-counter-value counter)
+            (/. (- (allocated) bytes0) *count*))))
+
+(dolist [depth '(0 100 1000)]
+  (run #"giota (depth ~depth)" (cut giota *count*) depth)
+  (run #"generate (depth ~depth)" (cut generate body) depth)
+  (run #"reset/shift (depth ~depth)" (cut generate/shift body) depth))
@@ -0,0 +1,64 @@
+;;;
+;;; Performance test of http client connection reuse
+;;;
+
+;; Runs a small keep-alive server in a thread and compares making
+;; a new connection for each request, reusing pooled connections,
+;; and pipelining.  Since the time is mostly spent on waiting the
+;; network, we measure the throughput in real time.
+
+(use gauche.time)
+(use gauche.net)
+(use gauche.threads)
+(use rfc.822)
+(use rfc.http)
+
+(define *count* 2000)
+(define *body* (make-string 512 #\x))
+
+(define (serve-client client)
+  (let ([in  (socket-input-port client)]
+        [out (socket-output-port client)])
+    (guard (e [else #f])
+      (let loop ()
+        (let1 line (read-line in)
+          (when (string? line)
+            (rfc822-read-headers in)
+            (display #"HTTP/1.1 200 OK\r\nContent-Length: ~(string-size *body*)\r\n\r\n"
+                     out)
+            (unless (string-prefix? "HEAD" line) (display *body* out))
+            (flush out)
+            (loop)))))
+    (socket-close client)))
+
+(define (start-server)
+  (rlet1 sock (make-server-socket 'inet 0 :reuse-addr? #t)
+    (thread-start!
+     (make-thread
+      (^[] (let loop ()
+             (let1 client (socket-accept sock)
+               (thread-start! (make-thread (^[] (serve-client client))))
+               (loop))))))))
+
+(define *server*
+  #"localhost:~(sockaddr-port (socket-address (start-server)))")
+
+(define (run tag thunk)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter (thunk))
+    (format #t "~12a: ~8,1f requests/s\n"
+            tag (/. *count* (time-counter-value counter)))))
+
+(define (sequential)
+  (dotimes [_ *count*] (http-get *server* "/")))
+
+(print #"~|*count*| GET requests of ~(string-size *body*) bytes")
+(run "no pool"
+     (^[] (parameterize ([http-connection-pool #f]) (sequential))))
+(run "pool"
+     (^[] (parameterize ([http-connection-pool (make-http-connection-pool)])
+            (sequential))))
+(run "pipeline"
+     (^[] (parameterize ([http-connection-pool (make-http-connection-pool)])
+            (dotimes [_ (quotient *count* 20)]
+              (http-pipeline *server* (make-list 20 '(GET "/")))))))
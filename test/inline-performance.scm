@@ -0,0 +1,80 @@
+;;;
+;;; Performance test of cross-module inlining
+;;;
+
+;; Generates a library of small exported accessors and helpers, and a
+;; script that uses them along with gauche.sequence and gauche.collection
+;; in loops.  The script is run with and without -fauto-inline, which
+;; affects how the generated library is compiled.  (gauche.sequence and
+;; gauche.collection are precompiled with --auto-inline in the build.)
+;; Run this in the src directory, after building.
+
+(use gauche.time)
+(use gauche.process)
+(use file.util)
+
+(define *dir* "inline-performance.o")
+(define *repeat* 3)
+
+(define (write-library)
+  (with-output-to-file #"~|*dir*|/ip/lib.scm"
+    (^[]
+      (for-each
+       (^[form] (write form) (newline))
+       '((define-module ip.lib
+           (use gauche.sequence)
+           (export make-point point-x point-y point-add point-norm2
+                   clamp between? second-or first-index-of))
+         (select-module ip.lib)
+         (define (make-point x y) (vector 'point x y))
+         (define (point-x p) (vector-ref p 1))
+         (define (point-y p) (vector-ref p 2))
+         (define (point-add p q)
+           (make-point (+ (point-x p) (point-x q)) (+ (point-y p) (point-y q))))
+         (define (point-norm2 p)
+           (+ (* (point-x p) (point-x p)) (* (point-y p) (point-y p))))
+         (define (clamp x lo hi) (if (< x lo) lo (if (< hi x) hi x)))
+         (define (between? x lo hi) (and (<= lo x) (< x hi)))
+         (define (second-or lis default)
+           (if (and (pair? lis) (pair? (cdr lis))) (cadr lis) default))
+         (define (first-index-of pred seq) (find-index pred seq)))))))
+
+(define (write-script)
+  (with-output-to-file #"~|*dir*|/main.scm"
+    (^[]
+      (for-each
+       (^[form] (write form) (newline))
+       '((use gauche.sequence)
+         (use gauche.collection)
+         (use ip.lib)
+         (define pts (map-to <vector> (^i (make-point i (- i))) (iota 1000)))
+         (define (run)
+           (dotimes [_ 300]
+             (fold (^[p acc] (+ acc (clamp (point-norm2 p) 0 100000))) 0 pts)
+             (for-each-with-index
+              (^[i p] (when (between? i 10 20) (point-add p p)))
+              pts)
+             (map-to <list> (^p (second-or (list (point-x p) (point-y p)) 0))
+                     pts)
+             (first-index-of (^p (= (point-x p) 999)) pts)))
+         (define (main args) (run) 0))))))
+
+(define (setup)
+  (remove-files *dir*)
+  (make-directory* #"~|*dir*|/ip")
+  (write-library)
+  (write-script))
+
+(define (run tag . opts)
+  (let1 counter (make <real-time-counter>)
+    (dotimes [_ *repeat*]
+      (with-time-counter counter
+        (do-process `("./gosh" "-ftest" ,@opts ,#"-I~*dir*"
+                      ,#"~|*dir*|/main.scm")
+                    :on-abnormal-exit :error)))
+    (format #t "~24a: ~8,3f sec\n" tag (/ (time-counter-value counter) *repeat*))))
+
+(setup)
+(run "default")
+(run "-fauto-inline" "-fauto-inline")
+(remove-files *dir*)
@@ -103,6 +103,57 @@
              :if-exists #f)
            (call-with-input-file "tmp2.o" read)))
 
+(with-output-to-file "tmp2.o" (^() (display "abc\ndef\nghi\n")))
+
+(test* "open-input-file :mmap #t" '("abc" "def" "ghi")
+       (call-with-input-file "tmp2.o" port->string-list :mmap #t))
+
+(test* "open-input-file :mmap #t (seek)" '(4 "def" 1 "bc" 10 "hi" #t)
+       (call-with-input-file "tmp2.o"
+         (^p (let* ([a (port-seek p 4)]
+                    [b (read-line p)]
+                    [c (port-seek p 1 SEEK_SET)]
+                    [d (read-line p)]
+                    [e (port-seek p -2 SEEK_END)]
+                    [f (read-line p)])
+               (list a b c d e f (eof-object? (read-char p)))))
+         :mmap #t))
+
+(test* "open-input-file :mmap #t (read-uvector)" '#u8(100 101 102)
+       (call-with-input-file "tmp2.o"
+         (^p (read-char p) (read-char p) (read-char p) (read-char p)
+             (read-uvector <u8vector> 3 p))
+         :mmap #t))
+
+(with-output-to-file "tmp2.o" (^() #f))
+
+(test* "open-input-file :mmap #t (empty file)" #t
+       (call-with-input-file "tmp2.o" (^p (eof-object? (read-byte p)))
+                             :mmap #t))
+
+;; Non-regular files can't be mapped; :mmap is ignored.
+(cond-expand
+ [(or gauche.os.windows gauche.os.cygwin)]   ;cygwin's fork is not reliable
+ [else
+  (test* "open-input-file :mmap #t (/dev/null)" #t
+         (call-with-input-file "/dev/null" (^p (eof-object? (read-byte p)))
+                               :mmap #t))
+  (sys-unlink "tmp3.o")
+  (sys-mkfifo "tmp3.o" #o600)
+  (test* "open-input-file :mmap #t (fifo)" '("abc" "def")
+         (let1 pid (sys-fork)
+           (if (zero? pid)
+             (begin
+               (call-with-output-file "tmp3.o"
+                 (^p (display "abc\ndef\n" p)))
+               (sys-exit 0))
+             (begin0
+               (call-with-input-file "tmp3.o" port->string-list :mmap #t)
+               (sys-waitpid pid)))))
+  (sys-unlink "tmp3.o")])
+
+(sys-system "rm -f tmp2.o")
+
 ;;-------------------------------------------------------------------
 (test-section "port-attributes")
 
@@ -958,6 +1009,68 @@
               (cut for-each (^z (display z) (newline)) <>))
 
 (test-port->* port->sexp-list '(abc) (cut for-each print <>))
+;;-------------------------------------------------------------------
+(test-section "copy-port")
+
+;; Between file ports, copy-port lets the kernel move the data.  Make sure
+;; the result is the same as copying through the buffers.
+
+(define *copy-port-data*
+  (with-output-to-string (^[] (dotimes [i 5000] (print "line " i)))))
+
+(call-with-output-file "tmp2.o" (cut display *copy-port-data* <>))
+
+(define (copy-port-test name expected proc)
+  (test* #"copy-port ~name" expected
+         (begin
+           (sys-unlink "tmp3.o")
+           (let1 r (call-with-input-file "tmp2.o"
+                     (^[in]
+                       (call-with-output-file "tmp3.o"
+                         (^[out] (proc in out)))))
+             (list r (call-with-input-file "tmp3.o" port->string))))))
+
+(copy-port-test "whole" `(,(string-length *copy-port-data*) ,*copy-port-data*)
+                (^[in out] (copy-port in out)))
+(copy-port-test "after read-line"
+                `(,(- (string-length *copy-port-data*) 7)
+                  ,(string-append "head\n" (string-copy *copy-port-data* 7)))
+                (^[in out]
+                  (read-line in)
+                  (display "head\n" out)
+                  (copy-port in out)))
+(copy-port-test "size (within buffer)" `(5 "line ")
+                (^[in out] (copy-port in out :size 5)))
+(copy-port-test "size (beyond buffer)"
+                `(30000 ,(string-copy *copy-port-data* 7 30007))
+                (^[in out] (read-line in) (copy-port in out :size 30000)))
+(copy-port-test "unit byte" `(,(string-length *copy-port-data*)
+                              ,*copy-port-data*)
+                (^[in out] (copy-port in out :unit 'byte)))
+(copy-port-test "then read-line" `("e 2" "line 1\nlin")
+                (^[in out] (read-line in) (copy-port in out :size 10)
+                  (read-line in)))
+
+(test* "copy-port from pipe" `(,(string-length *copy-port-data*)
+                               ,*copy-port-data*)
+       (receive (in out) (sys-pipe)
+         (sys-unlink "tmp3.o")
+         (display (string-copy *copy-port-data* 0 4000) out)
+         (flush out)
+         (let1 r (call-with-output-file "tmp3.o"
+                   (^[o]
+                     (display (read-string 10 in) o)
+                     (display (string-copy *copy-port-data* 4000) out)
+                     (close-port out)
+                     (+ 10 (copy-port in o))))
+           (close-port in)
+           (list r (call-with-input-file "tmp3.o" port->string)))))
+
+(test* "copy-port to string port" *copy-port-data*
+       (call-with-input-file "tmp2.o"
+         (^[in] (call-with-output-string (cut copy-port in <>)))))
+
+(sys-unlink "tmp3.o")
 
 ;;-------------------------------------------------------------------
 (test-section "coding-aware-port basic")
@@ -0,0 +1,40 @@
+;;;
+;;; Performance test of JSON reader and writer
+;;;
+
+;; Compares the native reader with the parser.peg based one (json-parser),
+;; and measures the writer and the event generator.
+
+(use gauche.time)
+(use gauche.generator)
+(use parser.peg)
+(use rfc.json)
+
+(define *count* 2000)
+
+;; An array of records, something like a typical API response.
+(define *data*
+  (list->vector
+   (map (^i `(("id" . ,i)
+              ("name" . ,(format "user~d" i))
+              ("email" . ,(format "user~d@example.com" i))
+              ("score" . ,(* i 1.25))
+              ("active" . ,(if (even? i) 'true 'false))
+              ("tags" . #("alpha" "beta" "gamma"))
+              ("note" . "line 1\nline 2 \"quoted\"")))
+        (iota *count*))))
+
+(define *text* (construct-json-string *data*))
+
+(print #"~(string-size *text*) bytes of JSON")
+(time-these/report
+ '(cpu 5)
+ `((peg    . ,(^[] (peg-parse-string json-parser *text*)))
+   (native . ,(^[] (parse-json-string *text*)))
+   (port   . ,(^[] (call-with-input-string *text* parse-json)))
+   (events . ,(^[] (generator-fold (^[e n] (+ n 1)) 0
+                                   (json-event-generator *text*))))))
+
+(time-these/report
+ '(cpu 5)
+ `((write  . ,(^[] (construct-json-string *data*)))))
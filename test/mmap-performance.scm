@@ -0,0 +1,52 @@
+;;;
+;;; Performance test of memory-mapped file ports
+;;;
+
+;; Reads a file with an ordinary file port and with a memory-mapped port,
+;; line by line and in blocks.  Getting the whole file as a u8vector
+;; with map-file->uvector, which doesn't copy, is also measured.
+;; Bytes allocated per byte of the file is also shown.
+
+(use gauche.time)
+(use gauche.uvector)
+
+(define *file* "mmap-performance.o")
+(define *lines* 200000)
+(define *repeat* 5)
+
+(with-output-to-file *file*
+  (^[] (dotimes [i *lines*] (print "line " i " of the test file."))))
+
+(define *size* (~ (sys-stat *file*)'size))
+
+(define (allocated) (cadr (assq :total-bytes (gc-stat))))
+
+(define (run tag proc)
+  (let ([counter (make <real-time-counter>)]
+        [bytes0 (allocated)])
+    (with-time-counter counter (dotimes [_ *repeat*] (proc)))
+    (format #t "~32a: ~8,3f sec, ~6,2f bytes/byte\n"
+            tag (time-counter-value counter)
+            (/. (- (allocated) bytes0) (* *repeat* *size*)))))
+
+(define (count-lines . opts)
+  (apply call-with-input-file *file*
+         (^p (let loop ([n 0])
+               (if (eof-object? (read-line p)) n (loop (+ n 1)))))
+         opts))
+
+(define (read-blocks . opts)
+  (apply call-with-input-file *file*
+         (^p (let loop ([s 0])
+               (let1 v (read-uvector <u8vector> 65536 p)
+                 (if (eof-object? v) s (loop (+ s (u8vector-length v)))))))
+         opts))
+
+(print #"~*size* bytes, repeated ~*repeat* times")
+(run "read-line" count-lines)
+(run "read-line (mmap)" (cut count-lines :mmap #t))
+(run "read-uvector" read-blocks)
+(run "read-uvector (mmap)" (cut read-blocks :mmap #t))
+(run "map-file->uvector"
+     (^[] (u8vector-length (map-file->uvector <u8vector> *file*))))
+(sys-unlink *file*)
@@ -0,0 +1,63 @@
+;;;
+;;; Performance test of global binding lookup
+;;;
+
+;; Measures global-variable-ref and eval of a small expression, from
+;; multiple threads, each working in its own anonymous module (a sandbox).
+;; Both are dominated by global binding lookup, which doesn't take the
+;; module lock, so the throughput should scale with the number of threads.
+;; The last column runs the same with another thread continuously adding
+;; definitions, which makes the lookups retry or fall back to locking.
+
+(use gauche.time)
+(use gauche.threads)
+
+(define *lookups* 100000)
+(define *evals* 10000)
+(define *names* '(car cdr cons list vector-ref string-append map for-each
+                  hash-table-get print format))
+
+;; Returns Kops/s
+(define (run nthreads nops thunk)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter
+      (for-each thread-join!
+                (map (^_ (thread-start! (make-thread thunk)))
+                     (iota nthreads))))
+    (/. (* nthreads nops) (time-counter-value counter) 1000)))
+
+(define (lookup)
+  (let1 mod (make-module #f)
+    (let loop ([i 0] [names *names*])
+      (cond [(= i *lookups*)]
+            [(null? names) (loop i *names*)]
+            [else (global-variable-ref mod (car names))
+                  (loop (+ i 1) (cdr names))]))))
+
+(define (evaluate)
+  (let1 mod (make-module #f)
+    (dotimes [i *evals*]
+      (eval `(car (cons ,i (list (vector-ref #(1 2) 0)))) mod))))
+
+;; Keeps defining new bindings until stopped.
+(define (with-definer thunk)
+  (^[] (let* ([stop #f]
+              [mod (make-module #f)]
+              [t (thread-start!
+                  (make-thread
+                   (^[] (let loop ([i 0])
+                          (unless stop
+                            (eval `(define ,(string->symbol #"x~i") ,i) mod)
+                            (loop (+ i 1)))))))])
+         (unwind-protect (thunk)
+           (begin (set! stop #t) (thread-join! t))))))
+
+(define (report tag n nops thunk)
+  (format #t "~8a threads=~2d: ~10,1f Kops/s, ~10,1f Kops/s with definer\n"
+          tag n
+          (run n nops thunk)
+          ((with-definer (cut run n nops thunk)))))
+
+(dolist [n (delete-duplicates `(1 2 4 ,(sys-available-processors)))]
+  (report "lookup" n *lookups* lookup)
+  (report "eval" n *evals* evaluate))
@@ -104,6 +104,67 @@
                                                  ((LREF0-RET)))
        (unwrap-syntax (proc->insn/split (^x (begin0 (car x) (print "foo"))))))
 
+;; auto-inline mode
+(let ([flag-set! (with-module gauche.internal vm-compiler-flag-set!)]
+      [flag-clear! (with-module gauche.internal vm-compiler-flag-clear!)]
+      [auto-inline (with-module gauche.internal SCM_COMPILE_AUTO_INLINE)])
+  (define (define-test-module name)
+    (eval `(define-module ,name
+             (export ai-first ai-loop)
+             (define (ai-first x) (car x))
+             (define (ai-private x) (cdr x))
+             (define (ai-loop n) (let loop ([i 0]) (if (< i n) (loop (+ i 1)) i))))
+          (current-module)))
+  (define (client name proc)
+    (eval `(^[x] (,proc x))
+          (rlet1 m (make-module #f) (eval `(import ,name) m))))
+  (unwind-protect
+      (begin (flag-set! auto-inline)
+             (define-test-module 'opt.auto-inline))
+    (flag-clear! auto-inline))
+  (define-test-module 'opt.no-auto-inline)
+
+  (test* "auto-inline exported procedure" '()
+         (filter-insn (client 'opt.auto-inline 'ai-first) 'GREF-TAIL-CALL))
+  (test* "auto-inline doesn't take loops" 1
+         (length (filter-insn (client 'opt.auto-inline 'ai-loop)
+                              'GREF-TAIL-CALL)))
+  (test* "auto-inline is off by default" 1
+         (length (filter-insn (client 'opt.no-auto-inline 'ai-first)
+                              'GREF-TAIL-CALL)))
+  (test* "auto-inline result" 1
+         ((client 'opt.auto-inline 'ai-first) '(1 2)))
+  (test* "auto-inline only exported procedures" #f
+         ((with-module gauche.internal gloc-inlinable?)
+          ((with-module gauche.internal find-binding)
+           (find-module 'opt.auto-inline) 'ai-private #f))))
+
+;; higher-order procedures with a lambda argument
+(let ()
+  (define (no-closure? proc) (null? (filter-insn proc 'CLOSURE)))
+  (test* "for-each with lambda" #t
+         (no-closure? (^[lis] (for-each (^x (print x)) lis))))
+  (test* "map with lambda" #t
+         (no-closure? (^[lis k] (map (^x (+ x k)) lis))))
+  (test* "fold with lambda" #t
+         (no-closure? (^[lis k] (fold (^[x acc] (+ x acc k)) 0 lis))))
+  (test* "map with lambda (escaping)" #f
+         (no-closure? (^[lis] (map (^x (^[] x)) lis))))
+
+  (test* "for-each with lambda result" '(3 2 1)
+         (let1 r '() (for-each (^x (push! r x)) '(1 2 3)) r))
+  (test* "map with lambda result" '(11 12 13)
+         (let1 k 10 (map (^x (+ x k)) '(1 2 3))))
+  (test* "fold with lambda result" '(3 2 1)
+         (fold (^[x acc] (cons x acc)) '() '(1 2 3)))
+  (test* "map with lambda, empty" '() (map (^x (car x)) '()))
+  (test* "map with lambda, improper" (test-error)
+         (map (^x x) '(1 2 . 3)))
+  (test* "fold with lambda, improper" (test-error)
+         (fold (^[x acc] x) 0 '(1 . 2)))
+  (test* "for-each with wrong arity lambda, empty" (undefined)
+         (for-each (^[x y] x) '())))
+
 (test-section "lambda lifting")
 
 ;; bug reported by teppey
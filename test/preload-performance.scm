@@ -0,0 +1,76 @@
+;;;
+;;; Startup time with parallel preloading
+;;;
+
+;; Generates a tree of libraries, and measures the time to start a script
+;; that uses all of them, with and without -fparallel-load.  Libraries
+;; are arranged in layers; each one uses a few libraries of the layer
+;; below, and has enough definitions to make compiling it take a while.
+;; Run this in the src directory, after building.
+
+(use gauche.time)
+(use gauche.process)
+(use file.util)
+
+(define *dir* "preload-performance.o")
+(define *layers* 5)
+(define *width* 40)                     ; libraries per layer
+(define *fanout* 3)                     ; libraries used from the layer below
+(define *definitions* 60)               ; definitions per library
+(define *repeat* 3)
+
+(define (lib-name layer i) (string->symbol (format "pp.l~d-~d" layer i)))
+(define (lib-file layer i) (format "~a/pp/l~d-~d.scm" *dir* layer i))
+
+(define (write-library layer i)
+  (with-output-to-file (lib-file layer i)
+    (^[]
+      (write `(define-module ,(lib-name layer i)
+                ,@(if (zero? layer)
+                    '()
+                    (map (^k `(use ,(lib-name (- layer 1)
+                                              (modulo (+ i (* k 7)) *width*))))
+                         (iota *fanout*)))
+                (export f0)))
+      (newline)
+      (dotimes [k *definitions*]
+        (write `(define (,(string->symbol #"f~k") x)
+                  (let loop ([i 0] [acc '()])
+                    (if (< i x)
+                      (loop (+ i 1)
+                            (cons (cond [(even? i) (* i ,k)]
+                                        [(zero? (modulo i 3)) (list i ,k)]
+                                        [else (string-append "s" (x->string i))])
+                                  acc))
+                      (reverse acc)))))
+        (newline)))))
+
+(define (write-script)
+  (with-output-to-file #"~|*dir*|/main.scm"
+    (^[]
+      (dotimes [i *width*]
+        (write `(use ,(lib-name (- *layers* 1) i)))
+        (newline)))))
+
+(define (setup)
+  (remove-files *dir*)
+  (make-directory* #"~|*dir*|/pp")
+  (dotimes [layer *layers*]
+    (dotimes [i *width*] (write-library layer i)))
+  (write-script))
+
+(define (run tag . opts)
+  (let1 counter (make <real-time-counter>)
+    (dotimes [_ *repeat*]
+      (with-time-counter counter
+        (do-process `("./gosh" "-ftest" ,@opts ,#"-I~*dir*"
+                      ,#"~|*dir*|/main.scm")
+                    :on-abnormal-exit :error)))
+    (format #t "~24a: ~8,3f sec\n" tag (/ (time-counter-value counter) *repeat*))))
+
+(setup)
+(print #"~(* *layers* *width*) libraries, "
+       #"~(sys-available-processors) processors available")
+(run "sequential")
+(run "-fparallel-load" "-fparallel-load")
+(remove-files *dir*)
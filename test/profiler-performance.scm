@@ -0,0 +1,50 @@
+;;;
+;;; Overhead of the sampling profiler
+;;;
+
+;; Runs the same workload with and without the profiler, in a single
+;; thread and in multiple threads each running its own profiler.
+;; The workload has a moderately deep call stack, so that the cost of
+;; capturing the stack shows up.
+
+(use gauche.time)
+(use gauche.threads)
+
+(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (work) (dotimes [_ 5] (fib 25)))
+
+(define (measure thunk)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter (thunk))
+    (time-counter-value counter)))
+
+(define (in-threads n thunk)
+  (^[] (for-each thread-join!
+                 (map (^_ (thread-start! (make-thread thunk))) (iota n)))))
+
+(define (profiled thunk)
+  (^[] (profiler-start) (thunk) (profiler-stop)
+       (begin0 (profiler-get-stacks) (profiler-reset))))
+
+(define (report tag plain prof)
+  (format #t "~16a: ~8,3f sec without, ~8,3f sec with profiler (~5,1f%)\n"
+          tag plain prof (* 100 (- (/ prof plain) 1))))
+
+(work)                                  ; warm up
+
+(let ([plain (measure work)]
+      [prof  (measure (profiled work))])
+  (report "single thread" plain prof))
+
+(dolist [n (delete-duplicates `(2 4 ,(sys-available-processors)))]
+  (let ([plain (measure (in-threads n work))]
+        [prof  (measure (in-threads n (profiled work)))])
+    (report #"~n threads" plain prof)))
+
+;; Check the output is sane
+(let1 stacks ((profiled work))
+  (format #t "~d distinct stacks, ~d samples, deepest ~d frames\n"
+          (length stacks)
+          (apply + (map cdr stacks))
+          (apply max 0 (map (^e (length (car e))) stacks))))
@@ -531,6 +531,32 @@
                            "Content-length: 9\n\nNot found"))
         ht))
 
+    ;; Keeps serving requests on the same client connection.  The reply
+    ;; body is the number of requests served so far on the connection.
+    ;; Other request closes the connection.  "/continue" is the same as
+    ;; "/keepalive", except that interim 1xx replies precede the reply.
+    (define (keep-alive in out method uri n)
+      (let1 body (number->string n)
+        (when (equal? uri "/continue")
+          (display "HTTP/1.1 100 Continue\r\n\r\n" out)
+          (display "HTTP/1.1 103 Early Hints\r\nLink: </a.css>; rel=preload\r\n\r\n"
+                   out))
+        (display #"HTTP/1.1 200 OK\r\nContent-Length: ~(string-size body)\r\n\r\n"
+                 out)
+        (unless (equal? method "HEAD") (display body out))
+        (flush out)
+        (rxmatch-if (let1 line (read-line in)
+                      (and (string? line)
+                           (#/^(\S+) (\S+) HTTP\/1\.1$/ line)))
+            (#f method request-uri)
+          (begin
+            (rfc822-read-headers in)
+            (if (member request-uri '("/keepalive" "/continue"))
+              (keep-alive in out method request-uri (+ n 1))
+              (display "HTTP/1.x 200 OK\nContent-Type: text/plain\n\nother"
+                       out)))
+          #f)))
+
     (define (http-server socket)
       (let loop ()
         (let* ([client (socket-accept socket)]
@@ -549,6 +575,8 @@
                [(equal? request-uri "/exit")
                 (socket-close client)
                 (sys-exit 0)]
+               [(member request-uri '("/keepalive" "/continue"))
+                (keep-alive in out method request-uri 1)]
                [(hash-table-get %predefined-contents request-uri #f)
                 => (cut for-each (cut display <> out) <>)]
                [else
@@ -768,6 +796,53 @@
                        '(("a" "b") ("c" "d")))))
   )
 
+(let ([host #"localhost:~*http-port*"]
+      [pool (make-http-connection-pool)])
+  (define (body-of . args)
+    (values-ref (apply http-request 'GET host args) 2))
+
+  (parameterize ([http-connection-pool pool])
+    (test* "connection pool keep-alive" '("1" "2" "3")
+           (list (body-of "/keepalive")
+                 (body-of "/keepalive")
+                 (body-of "/keepalive")))
+    (test* "http-pipeline" '(("200" "4") ("200" "5") ("200" #f))
+           (map (^r (list (car r) (caddr r)))
+                (http-pipeline host '((GET "/keepalive")
+                                      (GET "/keepalive")
+                                      (HEAD "/keepalive")))))
+    ;; the server closes the connection after /get, so the last request
+    ;; is resent on a new connection.
+    (test* "http-pipeline (resend)" '("6" "other" "1")
+           (map caddr (http-pipeline host '((GET "/keepalive")
+                                            (GET "/get")
+                                            (GET "/keepalive")))))
+    (http-connection-pool-clear!)
+    ;; interim replies must be skipped, or the final reply would be left
+    ;; unread on the pooled connection.
+    (test* "connection pool with 1xx replies" '("1" "2" "3")
+           (list (body-of "/continue")
+                 (body-of "/keepalive")
+                 (body-of "/continue")))
+    (test* "http-pipeline with 1xx replies" '(("200" "4") ("200" "5"))
+           (map (^r (list (car r) (caddr r)))
+                (http-pipeline host '((GET "/continue")
+                                      (GET "/keepalive")))))
+    (http-connection-pool-clear!))
+
+  (parameterize ([http-connection-pool
+                  (make-http-connection-pool :health-check (^[sock idle] #f))])
+    (test* "connection pool health-check" '("1" "1")
+           (list (body-of "/keepalive")
+                 (body-of "/keepalive")))
+    (http-connection-pool-clear!))
+
+  (parameterize ([http-connection-pool #f])
+    (test* "without connection pool" '("1" "1")
+           (list (body-of "/keepalive")
+                 (body-of "/keepalive"))))
+  )
+
 (test* "<http-error>" #t
        (guard (e (else (is-a? e <http-error>)))
          (http-request 'GET #"localhost:~*http-port*" "/exit")))
@@ -119,6 +119,74 @@
              (process-output->string '("./gosh" "-ftest" "test.o")))
          (delete-files "test.o")))
 
+;;=======================================================================
+(test-section "parallel preloading")
+
+(use gauche.preload)
+(use gauche.threads)
+
+;; pl.a uses pl.b and pl.c, both of which use pl.d.  pl.x and pl.y use
+;; each other.  Each library records its loading in *preload-log*.
+(define *preload-log* (atom '()))
+
+(define (write-preload-lib name uses)
+  (with-output-to-file #"test.o/pl/~|name|.scm"
+    (^[]
+      (write `(define-module ,(string->symbol #"pl.~name")
+                ,@(map (^u `(use ,(string->symbol #"pl.~u"))) uses)))
+      (write `(with-module user
+                (atomic-update! *preload-log* (cut cons ',name <>)))))))
+
+(define (preload-libs-setup)
+  (make-directory* "test.o/pl")
+  (write-preload-lib "a" '("b" "c"))
+  (write-preload-lib "b" '("d"))
+  (write-preload-lib "c" '("d"))
+  (write-preload-lib "d" '())
+  (write-preload-lib "x" '("y"))
+  (write-preload-lib "y" '("x")))
+
+(wrap-with-test-directory
+ (^[]
+   (preload-libs-setup)
+   (add-load-path "test.o")
+   (test* "preload-dependency-graph"
+          '(("pl/d") ("pl/b" "pl/d") ("pl/c" "pl/d") ("pl/a" "pl/b" "pl/c"))
+          (map (^n (cons (car n) (cddr n)))
+               (preload-dependency-graph '(pl.a))))
+   (test* "preload-dependency-graph (loop)"
+          '(("pl/y" "pl/x") ("pl/x" "pl/y"))
+          (map (^n (cons (car n) (cddr n)))
+               (preload-dependency-graph '(pl.x))))
+   (test* "preload-libraries" '("pl/a" "pl/b" "pl/c" "pl/d")
+          (sort (preload-libraries '(pl.a) :threads 4)))
+   (test* "dependencies are loaded first" '(4 d a)
+          (let1 log (reverse (atom-ref *preload-log*))
+            (list (length log) (car log) (last log))))
+   (test* "all provided" #t
+          (every provided? '("pl/a" "pl/b" "pl/c" "pl/d")))
+   (test* "preload-libraries (nothing to do)" '()
+          (preload-libraries '(pl.a) :threads 4))
+   (test* "preload-libraries (loop)" (test-error)
+          (preload-libraries '(pl.x) :threads 4))
+
+   ;; The script reports how many libraries have been loaded before its
+   ;; first 'use' form is evaluated.  Only the preloader makes it nonzero.
+   (with-output-to-file "test.o/script.scm"
+     (^[]
+       (write '(print (length (atom-ref *preload-log*))))
+       (write '(use pl.b))
+       (write '(use pl.c))
+       (write '(print (length (atom-ref *preload-log*))))))
+   (let1 run (^[flags]
+               (process-output->string
+                `("./gosh" "-ftest" ,@flags "-Itest.o"
+                  "-ugauche.threads" "-e(define *preload-log* (atom '()))"
+                  "test.o/script.scm")))
+     (test* "gosh (without -fparallel-load)" "0 3" (run '()))
+     (test* "gosh -fparallel-load" "3 3" (run '("-fparallel-load")))))
+ '("test.o"))
+
 ;;=======================================================================
 (test-section "gauche-config")
 
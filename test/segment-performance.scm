@@ -0,0 +1,47 @@
+;;;
+;;; Performance test of text segmentation
+;;;
+
+;; Compares word and grapheme cluster segmentation of a string through
+;; the generator-based readers, string->words and string->grapheme-clusters,
+;; and the boundary procedures that return cursors instead of substrings.
+;; Bytes allocated per character is also shown.
+
+(use gauche.time)
+(use gauche.generator)
+(use gauche.unicode)
+
+(define *repeat* 20)
+
+(define *text*
+  (apply string-append
+   (make-list 2000
+              (if (eq? (gauche-character-encoding) 'utf-8)
+                "The quick (\"brown\") fox can't jump 32.3 feet, right? \
+                 e\x301;t\x3b1;\x301; \x3042;\x3044;\x3046; "
+                "The quick (\"brown\") fox can't jump 32.3 feet, right? "))))
+
+(define (allocated) (cadr (assq :total-bytes (gc-stat))))
+
+(define (run tag thunk)
+  (let ([counter (make <real-time-counter>)]
+        [bytes0 (allocated)])
+    (with-time-counter counter (dotimes [_ *repeat*] (thunk)))
+    (format #t "~40a: ~8,3f sec, ~6,1f bytes/char\n"
+            tag (time-counter-value counter)
+            (/. (- (allocated) bytes0) (* *repeat* (string-length *text*))))))
+
+;; What string->words used to do
+(define (via-reader reader-maker str)
+  (with-input-from-string str
+    (cut generator->list (reader-maker read-char list->string))))
+
+(print #"~(string-length *text*) characters, repeated ~*repeat* times")
+(run "make-word-reader" (cut via-reader make-word-reader *text*))
+(run "string->words" (cut string->words *text*))
+(run "string-word-boundaries" (cut string-word-boundaries *text*))
+(run "make-grapheme-cluster-reader"
+     (cut via-reader make-grapheme-cluster-reader *text*))
+(run "string->grapheme-clusters" (cut string->grapheme-clusters *text*))
+(run "string-grapheme-cluster-boundaries"
+     (cut string-grapheme-cluster-boundaries *text*))
@@ -0,0 +1,80 @@
+;;;
+;;; Performance test of in-kernel transfer
+;;;
+
+;; Sends a large file over a loopback socket, copying through a buffer
+;; with read-uvector!/write-uvector, with copy-port (which lets the kernel
+;; move the data between fd-backed ports) and with socket-sendfile.
+;; A file-to-file copy is also measured the same ways.
+;; The receiver runs in another thread and discards the data.
+
+(use gauche.time)
+(use gauche.uvector)
+(use gauche.net)
+(use gauche.threads)
+
+(define *file* "sendfile-performance.o")
+(define *copy* "sendfile-performance-copy.o")
+(define *size* (* 256 1024 1024))
+(define *repeat* 3)
+
+(call-with-output-file *file*
+  (^p (let1 v (make-u8vector (* 1024 1024) 1)
+        (dotimes [_ (quotient *size* (* 1024 1024))]
+          (write-uvector v p)))))
+
+(define (run tag proc)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter (dotimes [_ *repeat*] (proc)))
+    (let1 t (time-counter-value counter)
+      (format #t "~32a: ~8,3f sec, ~8,1f MB/s\n" tag t
+              (/. (* *repeat* *size*) t 1024 1024)))))
+
+(define (buffered-copy in out)
+  (let1 buf (make-u8vector 65536)
+    (let loop ()
+      (let1 n (read-uvector! buf in)
+        (unless (eof-object? n)
+          (write-uvector buf out 0 n)
+          (loop))))
+    (flush out)))
+
+;; Calls (SEND socket) to send the file, while another thread reads it.
+(define (over-socket send)
+  (let* ([serv (make-server-socket (make <sockaddr-in> :host :loopback :port 0)
+                                   :reuse-addr? #t)]
+         [clnt (make-client-socket (socket-address serv))]
+         [acc (socket-accept serv)]
+         [recv (thread-start!
+                (make-thread
+                 (^[] (let ([in (socket-input-port acc :buffering :full)]
+                            [buf (make-u8vector 65536)])
+                        (let loop ([s 0])
+                          (let1 n (read-uvector! buf in)
+                            (if (eof-object? n) s (loop (+ s n)))))))))])
+    (send clnt)
+    (socket-shutdown clnt SHUT_WR)
+    (unless (= (thread-join! recv) *size*) (error "size mismatch"))
+    (socket-close acc)
+    (socket-close clnt)
+    (socket-close serv)))
+
+(define (to-file copy)
+  (call-with-input-file *file*
+    (^[in] (call-with-output-file *copy* (cut copy in <>))))
+  (sys-unlink *copy*))
+
+(print #"~*size* bytes, repeated ~*repeat* times")
+(run "socket, buffered"
+     (^[] (over-socket
+           (^s (call-with-input-file *file*
+                 (cut buffered-copy <> (socket-output-port s)))))))
+(run "socket, copy-port"
+     (^[] (over-socket
+           (^s (call-with-input-file *file*
+                 (cut copy-port <> (socket-output-port s)))))))
+(run "socket, socket-sendfile"
+     (^[] (over-socket (cut socket-sendfile <> *file*))))
+(run "file, buffered" (^[] (to-file buffered-copy)))
+(run "file, copy-port" (^[] (to-file copy-port)))
+(sys-unlink *file*)
@@ -0,0 +1,51 @@
+;;;
+;;; Performance test of symbol interning
+;;;
+
+;; Measures string->symbol from multiple threads, both for the names
+;; already interned (hit) and for fresh names (miss).  Then interns
+;; lots of throw-away symbols to see the heap and the symbol table
+;; don't grow without bound.
+
+(use gauche.time)
+(use gauche.threads)
+
+(define *count* 200000)
+(define *names* (map (cut format "sym~d" <>) (iota 1000)))
+(for-each string->symbol *names*)
+
+(define symbol-table-stats (with-module gauche.internal %symbol-table-stats))
+
+(define (run tag nthreads thunk)
+  (let1 counter (make <real-time-counter>)
+    (with-time-counter counter
+      (for-each thread-join!
+                (map (^_ (thread-start! (make-thread thunk)))
+                     (iota nthreads))))
+    (format #t "~10a threads=~2d: ~8,1f Kinterns/s\n"
+            tag nthreads
+            (/. (* nthreads *count*) (time-counter-value counter) 1000))))
+
+(define (hit)
+  (let loop ([i 0] [names *names*])
+    (cond [(= i *count*)]
+          [(null? names) (loop i *names*)]
+          [else (string->symbol (car names)) (loop (+ i 1) (cdr names))])))
+
+(define (miss)
+  (let1 prefix (format "~a-" (current-thread))
+    (dotimes [i *count*] (string->symbol (format "~a~d" prefix i)))))
+
+(dolist [n (delete-duplicates `(1 2 4 ,(sys-available-processors)))]
+  (run "hit" n hit)
+  (run "miss" n miss))
+
+(define (heap-size) (cadr (assq :total-heap-size (gc-stat))))
+
+(print "Interning throw-away symbols:")
+(dotimes [round 10]
+  (dotimes [i *count*] (string->symbol (format "garbage-~d-~d" round i)))
+  (gc)
+  (apply format #t "round ~d: heap ~d bytes, table ~d buckets, \
+                    ~d entries, ~d live\n"
+         round (heap-size) (symbol-table-stats)))
@@ -968,5 +968,40 @@
   ] 
  [else]) ; gauche.os.windows
 
+;;-------------------------------------------------------------------
+(test-section "gc")
+
+(test* "gc-configuration" '(:markers :free-space-divisor :incremental :heap-size)
+       (map car (gc-configuration)))
+
+(test* "gc-configure" #t
+       (let1 size (cadr (assq :heap-size (gc-configuration)))
+         (gc-configure :heap-size (+ size (* 1024 1024)))
+         (>= (cadr (assq :heap-size (gc-configuration)))
+             (+ size (* 1024 1024)))))
+
+(test* "gc-pause-stats" #t
+       (begin
+         (gc-pause-stats :reset #t)
+         (dotimes [i 3] (gc))
+         (let1 st (gc-pause-stats)
+           (and (>= (cadr (assq :collections st)) 3)
+                (>= (cadr (assq :pauses st)) 3)
+                (>= (cadr (assq :max-pause-time st)) 0)
+                (= (apply + (map cdr (cadr (assq :pause-histogram st))))
+                   (cadr (assq :pauses st)))))))
+
+(test* "gc-recent-collections" #t
+       (let1 cs (gc-recent-collections)
+         (and (>= (length cs) 3)
+              (every (^c (and (exact-integer? (get-keyword :gc-no c))
+                              (real? (get-keyword :pause-time c))
+                              (exact-integer? (get-keyword :heap-before c))
+                              (exact-integer? (get-keyword :heap-after c))
+                              (exact-integer? (get-keyword :reclaimed c))))
+                     cs)
+              ;; newest first
+              (apply >= (map (cut get-keyword :gc-no <>) cs)))))
+
 (test-end)
 
@@ -50,6 +50,72 @@
        (eof-object?
         (call-with-input-string "" (make-csv-reader #\,))))
 
+(test* "csv-reader (crlf)" '(("a" "b") ("" "c d") ("e\r\nf" ""))
+       (call-with-input-string "a,b\r\n,c d \r\n\"e\r\nf\",\r\n"
+         (cut port->list (make-csv-reader #\,) <>)))
+
+(test* "csv-reader (tab)" '("a" "" "b c")
+       (call-with-input-string "a\t\t b c \n"
+         (make-csv-reader #\tab)))
+
+(test* "csv-reader (quote char)" '("a,b" "c'd")
+       (call-with-input-string "'a,b', 'c''d'"
+         (make-csv-reader #\, #\')))
+
+(test* "csv-reader (row-type)" '(#("a" "b") #("c"))
+       (call-with-input-string "a,b\nc"
+         (cut port->list (make-csv-reader #\, :row-type 'vector) <>)))
+
+(test* "csv-reader doesn't read ahead" '(("a" "b") "rest\n")
+       (call-with-input-string "a,b\nrest\n"
+         (^p (let1 row ((make-csv-reader #\,) p)
+               (list row (read-string 100 p))))))
+
+(test* "csv-reader after peek-char" '(("ab" "c"))
+       (call-with-input-string "ab,c"
+         (^p (peek-char p) (port->list (make-csv-reader #\,) p))))
+
+(test* "csv-reader counts lines" '(2 4 5 6)
+       (call-with-input-string "a,b\n\"c\nd\",e\nf\ng\n"
+         (^p (let1 r (make-csv-reader #\,)
+               (map (^_ (r p) (port-current-line p)) '(1 2 3 4))))))
+
+(test* "csv-reader counts lines after peek-char" '(2 3)
+       (call-with-input-string "\na,b\nc"
+         (^p (let1 r (make-csv-reader #\,)
+               (peek-char p)
+               (map (^_ (r p) (port-current-line p)) '(1 2))))))
+
+(test* "csv-reader (long field)" (list (make-string 10000 #\a) "b")
+       (call-with-input-string #"~(make-string 10000 #\a),b"
+         (make-csv-reader #\,)))
+
+(cond-expand
+ [gauche.ces.utf8
+  (test* "csv-reader (non-ascii)" '("\u3042 \u3044" "\u3046")
+         (call-with-input-string "\u3000\u3042 \u3044\u3000,\u3046"
+           (make-csv-reader #\,)))
+  (test* "csv-reader (non-ascii separator)" '("a" "b c" "d")
+         (call-with-input-string "a\u3001 b c \u3001d"
+           (make-csv-reader #\u3001)))]
+ [else])
+
+(let ([file "test.o.csv"]
+      [rows (map (^i `(,(x->string i) ,#"line ~i\nwith, comma" "x"))
+                 (iota 2000))])
+  (call-with-output-file file
+    (^p (for-each (cut (make-csv-writer #\,) p <>) rows)))
+  (test* "csv-file->rows" rows (csv-file->rows file #\,))
+  (test* "csv-reader counts lines (file)" 21
+         (call-with-input-file file
+           (^p (let1 r (make-csv-reader #\,)
+                 (dotimes [10] (r p))
+                 (port-current-line p)))))
+  (test* "csv-file->rows (threads)" rows (csv-file->rows file #\, :threads 4))
+  (test* "csv-file->rows (vector)" (map list->vector rows)
+         (csv-file->rows file #\, :row-type 'vector :threads 3))
+  (sys-unlink file))
+
 (test* "csv-writer"
        "abc,def,123,\"what's up?\",\"he said, \"\"nothing new.\"\"\"\n"
        (call-with-output-string
@@ -0,0 +1,49 @@
+;;;
+;;; Performance test of tree-map backends
+;;;
+
+;; Compares the red-black tree (make-tree-map) and the B+tree
+;; (make-btree-map) on insertion in random and ascending order, lookup,
+;; floor queries, traversal and deletion.  Also compares building a map
+;; from a sorted alist by insertion and by bulk loading.  Bytes allocated
+;; per entry is shown for the builds.
+
+(use gauche.time)
+
+(define *count* 200000)
+
+;; A permutation of [0, *count*) in a scattered order
+(define *random-keys* (map (^i (modulo (* i 7919) *count*)) (iota *count*)))
+(define *ascending-keys* (iota *count*))
+(define *sorted-alist* (map (^k (cons k k)) *ascending-keys*))
+
+(define (allocated) (cadr (assq :total-bytes (gc-stat))))
+
+(define (run tag thunk)
+  (let ([counter (make <real-time-counter>)]
+        [bytes0 (allocated)])
+    (rlet1 r (with-time-counter counter (thunk))
+      (format #t "~32a: ~8,3f sec, ~6,1f bytes/entry\n"
+              tag (time-counter-value counter)
+              (/. (- (allocated) bytes0) *count*)))))
+
+(define (build make keys)
+  (rlet1 tm (make)
+    (dolist [k keys] (tree-map-put! tm k k))))
+
+(define (bench name make)
+  (print name)
+  (let1 tm (run "  insert (random)" (cut build make *random-keys*))
+    (run "  insert (ascending)" (cut build make *ascending-keys*))
+    (run "  lookup" (^[] (dolist [k *random-keys*] (tree-map-get tm k #f))))
+    (run "  floor" (^[] (dolist [k *random-keys*]
+                          (tree-map-floor-key tm (+ k 1)))))
+    (run "  traverse" (^[] (tree-map-fold tm (^[k v n] (+ n 1)) 0)))
+    (run "  delete" (^[] (dolist [k *random-keys*] (tree-map-delete! tm k))))))
+
+(bench "red-black tree" make-tree-map)
+(bench "B+tree" make-btree-map)
+
+(print "building from sorted alist")
+(run "  alist->tree-map" (cut alist->tree-map *sorted-alist*))
+(run "  sorted-alist->btree-map" (cut sorted-alist->btree-map *sorted-alist*))
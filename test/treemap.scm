@@ -104,6 +104,8 @@
 (do-tree-map (cut make-tree-map = <))
 (do-tree-map (cut make-tree-map (^[a b] (cond [(< a b) -1][(= a b) 0][else 1]))))
 (do-tree-map (cut make-tree-map))
+(do-tree-map (cut make-btree-map = <))
+(do-tree-map (cut make-btree-map))
 
 ;; Min, max, iterators
 (let ((empty (make-tree-map = <))
@@ -567,5 +569,85 @@
          (tree-map-compare-as-sequences tm1 tm7 string-ci-comparator))
   )
 
+;;
+;; B+tree backend
+;;
+
+(let ()
+  (define (random-ops tm ref n)
+    (dotimes [i n]
+      (let ([k (modulo (* i 7919) 1009)])
+        (case (modulo (* i 31) 5)
+          [(0 1 2) (tree-map-put! tm k i) (tree-map-put! ref k i)]
+          [(3) (tree-map-delete! tm k) (tree-map-delete! ref k)]
+          [else (tree-map-pop-min! tm) (tree-map-pop-min! ref)]))))
+
+  (test* "btree random operations" #t
+         (let ([tm (make-btree-map)]
+               [ref (make-tree-map)])
+           (random-ops tm ref 20000)
+           (%tree-map-check-consistency tm)
+           (and (equal? (tree-map->alist tm) (tree-map->alist ref))
+                (equal? (tree-map-fold-right tm list* '())
+                        (tree-map-fold-right ref list* '())))))
+
+  (test* "btree ascending insertion and deletion" '(10000 #t 0)
+         (let1 tm (make-btree-map = <)
+           (dotimes [i 10000] (tree-map-put! tm i (- i)))
+           (%tree-map-check-consistency tm)
+           (let1 r (list (tree-map-num-entries tm)
+                         (equal? (tree-map-keys tm) (iota 10000)))
+             (dotimes [i 10000] (tree-map-delete! tm (- 9999 i))
+               (when (zero? (modulo i 1000))
+                 (%tree-map-check-consistency tm)))
+             (append r (list (tree-map-num-entries tm))))))
+
+  (test* "btree floor and ceiling" '((10 . 20) (12 . 12) (#f . 0) (98 . #f))
+         (let1 tm (make-btree-map)
+           (dotimes [i 50] (tree-map-put! tm (* i 2) i))
+           (list (cons (tree-map-floor-key tm 11) (tree-map-ceiling-key tm 19.5))
+                 (cons (tree-map-predecessor-key tm 14)
+                       (tree-map-successor-key tm 10))
+                 (cons (tree-map-predecessor-key tm 0)
+                       (tree-map-ceiling-key tm -1))
+                 (cons (car (tree-map-max tm))
+                       (tree-map-successor-key tm 98)))))
+
+  (test* "btree deletion during traversal" '(0 2 4 6 8)
+         (let1 tm (make-btree-map)
+           (dotimes [i 100] (tree-map-put! tm i i))
+           (tree-map-for-each tm (^[k v] (when (or (odd? k) (> k 8))
+                                           (tree-map-delete! tm k))))
+           (%tree-map-check-consistency tm)
+           (tree-map-keys tm)))
+
+  (test* "btree copy" #t
+         (let* ([tm (make-btree-map)]
+                [_ (dotimes [i 1000] (tree-map-put! tm i i))]
+                [tm2 (tree-map-copy tm)])
+           (tree-map-delete! tm 0)
+           (%tree-map-check-consistency tm2)
+           (and (= (tree-map-num-entries tm2) 1000)
+                (equal? (tree-map->alist tm2)
+                        (map (^i (cons i i)) (iota 1000))))))
+
+  (test* "sorted-alist->btree-map" #t
+         (let* ([alist (map (^i (cons (* i 3) i)) (iota 5000))]
+                [tm (sorted-alist->btree-map alist)])
+           (%tree-map-check-consistency tm)
+           (tree-map-put! tm 1 'x)
+           (tree-map-delete! tm 0)
+           (%tree-map-check-consistency tm)
+           (and (equal? (tree-map-get tm 3000) 1000)
+                (equal? (tree-map-get tm 1) 'x)
+                (= (tree-map-num-entries tm) 5000))))
+  (test* "sorted-alist->btree-map (empty)" '()
+         (tree-map->alist (sorted-alist->btree-map '() = <)))
+  (test* "sorted-alist->btree-map (unsorted)" (test-error)
+         (sorted-alist->btree-map '((1 . a) (3 . b) (2 . c))))
+  (test* "sorted-alist->btree-map (duplicate)" (test-error)
+         (sorted-alist->btree-map '((1 . a) (1 . b))))
+  )
+
 (test-end)
 
@@ -0,0 +1,46 @@
+;;;
+;;; Throughput of utf-8/16/32 transcoding
+;;;
+
+;; Measures utf16->string, string->utf16 and friends of gauche.unicode on
+;; mostly-ASCII text and on Japanese text, along with u8vector-copy as
+;; the baseline of a memory copy.  utf8->string is measured with
+;; input that has an invalid octet, which takes the decoding path.
+
+(use gauche.time)
+(use gauche.uvector)
+(use gauche.unicode)
+
+(define *size* 4000000)                 ; characters
+(define *repeat* 5)
+
+(define (make-text unit)
+  (string-concatenate (make-list (quotient *size* (string-length unit)) unit)))
+
+(define (run tag octets thunk)
+  (let1 counter (make <real-time-counter>)
+    (dotimes [_ *repeat*] (with-time-counter counter (thunk)))
+    (format #t "~36a: ~8,1f MB/s\n" tag
+            (/. (* octets *repeat*) (time-counter-value counter) 1e6))))
+
+(define (bench name text)
+  (let* ([u8 (string->utf8 text)]
+         [u8-bad (u8vector-append u8 #u8(#xff))]
+         [u16 (string->utf16 text 'little)]
+         [u32 (string->utf32 text 'little)])
+    (print name)
+    (run "  u8vector-copy (utf-16 size)" (u8vector-length u16)
+         (cut u8vector-copy u16))
+    (run "  utf8->string (with invalid octet)" (u8vector-length u8)
+         (cut utf8->string u8-bad))
+    (run "  utf16->string" (u8vector-length u16)
+         (cut utf16->string u16 'little))
+    (run "  string->utf16" (u8vector-length u16)
+         (cut string->utf16 text 'little))
+    (run "  utf32->string" (u8vector-length u32)
+         (cut utf32->string u32 'little))
+    (run "  string->utf32" (u8vector-length u32)
+         (cut string->utf32 text 'little))))
+
+(bench "ASCII" (make-text "The quick brown fox jumps over the lazy dog. "))
+(bench "Japanese" (make-text "いろはにほへとちりぬるを、わかよたれそつねならむ。"))
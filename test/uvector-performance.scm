@@ -0,0 +1,50 @@
+;;;
+;;; Performance test of uvector arithmetic and reductions
+;;;
+
+;; Run this as is, and with the environment variable
+;; GAUCHE_UVECTOR_KERNEL=scalar to compare the vectorized kernels
+;; with the plain C loops.
+
+(use gauche.time)
+(use gauche.uvector)
+
+(define *size* 1000000)
+
+(define (make-data ctor)
+  (let1 v (ctor *size*)
+    (dotimes [i *size*]
+      (uvector-set! v i (- (* (modulo (* i 7919) 1000) 0.001) 0.5)))
+    v))
+
+(define (reductions tag ctor fold sum dot min max)
+  (let ([v0 (make-data ctor)]
+        [v1 (make-data ctor)])
+    (print #"~|tag|vector reductions, ~|*size*| elements")
+    (time-these/report
+     '(cpu 5)
+     `((fold-sum . ,(^[] (fold + 0 v0)))
+       (sum      . ,(^[] (sum v0)))
+       (fold-min . ,(^[] (fold (^[a b] (if (< a b) a b)) +inf.0 v0)))
+       (min      . ,(^[] (min v0)))
+       (max      . ,(^[] (max v0)))
+       (dot      . ,(^[] (dot v0 v1)))))))
+
+(define (arithmetic tag ctor add add! mul)
+  (let ([v0 (make-data ctor)]
+        [v1 (make-data ctor)])
+    (print #"~|tag|vector arithmetic, ~|*size*| elements")
+    (time-these/report
+     '(cpu 5)
+     `((add  . ,(^[] (add v0 v1)))
+       (add! . ,(^[] (add! v0 v1)))
+       (mul  . ,(^[] (mul v0 v1)))))))
+
+(print "kernel: " ((with-module gauche.uvector %uvector-kernel-name)))
+
+(reductions 'f64 make-f64vector f64vector-fold
+            f64vector-sum f64vector-dot f64vector-min f64vector-max)
+(reductions 'f32 make-f32vector f32vector-fold
+            f32vector-sum f32vector-dot f32vector-min f32vector-max)
+(arithmetic 'f64 make-f64vector f64vector-add f64vector-add! f64vector-mul)
+(arithmetic 'f32 make-f32vector f32vector-add f32vector-add! f32vector-mul)
@@ -121,6 +121,50 @@
 ;        (list (weak-hash-table-keys x)
 ;              (weak-hash-table-values x)))
 
+;;---------------------------------------------------------------------
+(test-section "symbol table")
+
+;; Symbols interned at runtime that nobody refers to can be collected.
+;; NB: Don't write the names as symbols literally, or the reader interns them.
+(define (fresh-symbol-name i) (format "weak-test-symbol-~d" i))
+
+(define y (make-weak-vector 10))
+(dotimes [i 10]
+  (weak-vector-set! y i (string->symbol (fresh-symbol-name i))))
+
+(test* "interned symbols are weakly held" #t
+       (let1 before (map (cut weak-vector-ref y <>) (iota 10))
+         (every symbol? before)))
+
+(clear-references)
+
+(test* "unreferenced symbols are collected" #t
+       (< (count identity (map (cut weak-vector-ref y <>) (iota 10))) 10))
+
+(test* "re-intern" '(#t #t)
+       (let ([a (string->symbol (fresh-symbol-name 0))]
+             [b (string->symbol (string-copy (fresh-symbol-name 0)))])
+         (list (eq? a b)
+               (equal? (symbol->string a) (fresh-symbol-name 0)))))
+
+(test* "referenced symbol stays" 'weak-test-literal
+       (let1 z (make-weak-vector 1)
+         (weak-vector-set! z 0 'weak-test-literal)
+         (clear-references)
+         (weak-vector-ref z 0)))
+
+;; Interning lots of throw-away symbols shouldn't grow the table
+;; without bound.
+(test* "bounded growth of the symbol table" #t
+       (let ([stats (with-module gauche.internal %symbol-table-stats)]
+             [n 100000])
+         (dotimes [i n] (string->symbol (fresh-symbol-name (+ i 100))))
+         (clear-references)
+         (dotimes [i n] (string->symbol (fresh-symbol-name (+ i 100))))
+         (clear-references)
+         (let1 s (stats)
+           (< (caddr s) n))))
+
 (test-end)
 
 
@@ -0,0 +1,50 @@
+;;;
+;;; Performance test of deflating ports
+;;;
+
+;; Compares the single-threaded deflating port with the parallel one
+;; using various number of threads.  Since the parallel port uses
+;; more cpu time in total, we measure the throughput in real time.
+
+(use gauche.time)
+(use gauche.uvector)
+(use rfc.zlib)
+
+(define *size* 20000000)
+(define *repeat* 3)
+
+;; Something like a log file; compressible, but not too repetitive.
+(define *data*
+  (string->u8vector
+   (with-output-to-string
+     (^[] (let loop ([i 0] [n 0])
+            (when (< n *size*)
+              (let1 line (format "~d INFO request ~x served in ~dms\n"
+                                 (+ 1500000000 i)
+                                 (* (modulo (* i 7919) 65521) 2654435761)
+                                 (modulo (* i 31) 997))
+                (display line)
+                (loop (+ i 1) (+ n (string-size line))))))))))
+
+(define (deflate-with threads)
+  (let* ([out (open-output-string)]
+         [p (open-deflating-port out :threads threads)])
+    (write-uvector *data* p)
+    (close-output-port p)
+    (string-size (get-output-string out))))
+
+(define (run threads)
+  (let ([counter (make <real-time-counter>)]
+        [size 0])
+    (with-time-counter counter
+      (dotimes [_ *repeat*] (set! size (deflate-with threads))))
+    (format #t "threads=~3d: ~8,1f MB/s, ~d bytes (~,2f%)\n"
+            threads
+            (/. (* *repeat* (u8vector-length *data*))
+                (time-counter-value counter) 1e6)
+            size
+            (* 100.0 (/. size (u8vector-length *data*))))))
+
+(print #"deflating ~(u8vector-length *data*) bytes, "
+       #"~(sys-available-processors) processors available")
+(for-each run (delete-duplicates `(1 2 4 8 ,(sys-available-processors))))